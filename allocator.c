@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "allocator.h"
+
+#define MPOL_INTERLEAVE_MODE 3
+#define MAX_NUMA_NODES 64
+#define HUGE_PAGE_1GB (1UL << 30)
+
+static AllocationPolicy allocation_policy = ALLOC_FIRST_TOUCH;
+// NUMA node count read from sysfs on first use; 0 until then
+static _Atomic int numa_nodes = 0;
+
+// Function to choose how large allocations are placed across NUMA nodes
+void setAllocationPolicy(AllocationPolicy policy) {
+    allocation_policy = policy;
+}
+
+// Function to count the NUMA nodes with memory, from sysfs. Returns 1 if unknown.
+// The scan runs once; threads racing on the first call store the same count.
+int numaNodeCount(void) {
+    int cached = atomic_load_explicit(&numa_nodes, memory_order_relaxed);
+    if (cached > 0) {
+        return cached;
+    }
+    int count = 0;
+    for (int node = 0; node < MAX_NUMA_NODES; node++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", node);
+        if (access(path, F_OK) == 0) {
+            count = node + 1;
+        }
+    }
+    count = count > 0 ? count : 1;
+    atomic_store_explicit(&numa_nodes, count, memory_order_relaxed);
+    return count;
+}
+
+// Function to round a large allocation up to the huge page size it may use,
+// so that mapping and unmapping agree whichever page size was granted
+static size_t mappedLength(size_t bytes) {
+    size_t page = bytes >= HUGE_PAGE_1GB ? HUGE_PAGE_1GB : HUGE_PAGE_THRESHOLD;
+    return (bytes + page - 1) & ~(page - 1);
+}
+
+// Function to map anonymous memory, trying 1 GB then 2 MB explicit huge pages
+// and falling back to normal pages with transparent huge pages requested
+static void* mapHugePages(size_t length) {
+    void* ptr = MAP_FAILED;
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+    if (length >= HUGE_PAGE_1GB) {
+        ptr = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (30 << MAP_HUGE_SHIFT), -1, 0);
+    }
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+    }
+#endif
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+    }
+    return ptr;
+}
+
+// Function to allocate a 64-byte aligned amplitude array.
+// Small arrays come from the heap. Large ones are mapped directly on huge pages
+// to cut TLB misses during sweeps; with ALLOC_INTERLEAVE their pages are bound
+// round-robin to all nodes, otherwise they are left unplaced so the parallel
+// first touch in resetRegister puts each thread's slice on its own node.
+void* allocateAmplitudes(size_t bytes) {
+    if (bytes < 64) {
+        bytes = 64;
+    }
+    if (bytes < HUGE_PAGE_THRESHOLD) {
+        return aligned_alloc(64, (bytes + 63) & ~(size_t)63);
+    }
+
+    size_t length = mappedLength(bytes);
+    void* ptr = mapHugePages(length);
+    if (ptr == NULL) {
+        return NULL;
+    }
+    int nodes = numaNodeCount();
+    if (allocation_policy == ALLOC_INTERLEAVE && nodes > 1) {
+        unsigned long nodemask = nodes >= 64 ? ~0UL : (1UL << nodes) - 1;
+        // Best effort: an unsupported mbind leaves the default local policy
+        syscall(SYS_mbind, ptr, length, MPOL_INTERLEAVE_MODE, &nodemask, (unsigned long)MAX_NUMA_NODES + 1, 0);
+    }
+    return ptr;
+}
+
+// Function to free an array from allocateAmplitudes, given the same byte count
+void freeAmplitudes(void* ptr, size_t bytes) {
+    if (ptr == NULL) {
+        return;
+    }
+    if (bytes < 64) {
+        bytes = 64;
+    }
+    if (bytes < HUGE_PAGE_THRESHOLD) {
+        free(ptr);
+    } else {
+        munmap(ptr, mappedLength(bytes));
+    }
+}
+
+// Function to parse a sysfs cpulist such as "0-15,32-47" into a membership table
+static void parseCpuList(const char* text, unsigned char* member, int max_cpus) {
+    const char* p = text;
+    while (*p != '\0' && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p) {
+            return;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for (long cpu = first; cpu <= last && cpu < max_cpus; cpu++) {
+            if (cpu >= 0) {
+                member[cpu] = 1;
+            }
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+}
+
+// Function to pin each OpenMP worker thread to its own CPU.
+// Allowed CPUs are ordered node by node, so with the static schedule used by all
+// sweeps consecutive slices of the register (and the pages those threads first
+// touched) stay on one node. The calling thread is team thread 0 and is left
+// alone: threads it starts later inherit its mask, and pinning it would confine
+// them all to one CPU. Worker threads persist between regions of the same size,
+// so call this once before allocating registers.
+// Returns the number of worker threads pinned, or -1 on failure.
+int pinWorkerThreads(void) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        fprintf(stderr, "Error: Could not read the CPU affinity mask\n");
+        return -1;
+    }
+
+    int order[CPU_SETSIZE];
+    int num_cpus = 0;
+    unsigned char* placed = (unsigned char*)calloc(CPU_SETSIZE, 1);
+    unsigned char* member = (unsigned char*)malloc(CPU_SETSIZE);
+    if (placed == NULL || member == NULL) {
+        free(placed);
+        free(member);
+        return -1;
+    }
+    int nodes = numaNodeCount();
+    for (int node = 0; node < nodes; node++) {
+        char path[80], text[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE* file = fopen(path, "r");
+        if (file == NULL) {
+            continue;
+        }
+        memset(member, 0, CPU_SETSIZE);
+        if (fgets(text, sizeof(text), file) != NULL) {
+            parseCpuList(text, member, CPU_SETSIZE);
+        }
+        fclose(file);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (member[cpu] && !placed[cpu] && CPU_ISSET(cpu, &allowed)) {
+                order[num_cpus++] = cpu;
+                placed[cpu] = 1;
+            }
+        }
+    }
+    // CPUs sysfs did not report, or no NUMA information at all
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!placed[cpu] && CPU_ISSET(cpu, &allowed)) {
+            order[num_cpus++] = cpu;
+        }
+    }
+    free(placed);
+    free(member);
+    if (num_cpus == 0) {
+        return -1;
+    }
+
+    int pinned = 0;
+    #pragma omp parallel reduction(+:pinned)
+    {
+        int thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+        if (thread != 0) {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(order[thread % num_cpus], &one);
+            if (sched_setaffinity(0, sizeof(one), &one) == 0) {
+                pinned++;
+            }
+        }
+    }
+    return pinned;
+}
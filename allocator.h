@@ -0,0 +1,23 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stddef.h>
+
+// Allocations of at least this many bytes are mapped directly and backed by huge pages
+#define HUGE_PAGE_THRESHOLD (2UL << 20)
+
+// Placement of large amplitude arrays across NUMA nodes
+typedef enum {
+    ALLOC_FIRST_TOUCH,   // Pages land on the node of the thread that first writes them
+    ALLOC_INTERLEAVE     // Pages are spread round-robin over all nodes
+} AllocationPolicy;
+
+void setAllocationPolicy(AllocationPolicy policy);
+int numaNodeCount(void);
+
+void* allocateAmplitudes(size_t bytes);
+void freeAmplitudes(void* ptr, size_t bytes);
+
+int pinWorkerThreads(void);
+
+#endif
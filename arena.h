@@ -0,0 +1,133 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+#include <stddef.h>
+
+// Bump allocator for short-lived objects such as the qubits and scratch strings
+// of one protocol round. Allocation is a pointer increment, and everything is
+// released at once by arenaReset or arenaRelease in O(1); blocks are kept for
+// the next round, so a steady-state loop does no malloc at all.
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t capacity;
+    size_t used;
+    unsigned char* data;
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;
+    ArenaBlock* current;
+} Arena;
+
+// Position in an arena, to release everything allocated after it
+typedef struct {
+    ArenaBlock* block;
+    size_t used;
+} ArenaMark;
+
+// Function to allocate an arena block of the given capacity
+static inline ArenaBlock* newArenaBlock(size_t capacity) {
+    ArenaBlock* block = (ArenaBlock*)malloc(sizeof(ArenaBlock));
+    if (block == NULL) {
+        return NULL;
+    }
+    block->data = (unsigned char*)aligned_alloc(ARENA_ALIGNMENT, capacity);
+    if (block->data == NULL) {
+        free(block);
+        return NULL;
+    }
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    return block;
+}
+
+// Function to initialize an empty arena; blocks are allocated on first use
+static inline void initializeArena(Arena* arena) {
+    arena->head = NULL;
+    arena->current = NULL;
+}
+
+// Function to free every block of an arena
+static inline void freeArena(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block->data);
+        free(block);
+        block = next;
+    }
+    initializeArena(arena);
+}
+
+// Function to allocate bytes from an arena, 16-byte aligned. Returns NULL if out of memory.
+static inline void* arenaAlloc(Arena* arena, size_t bytes) {
+    bytes = (bytes + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (arena->head == NULL) {
+        size_t capacity = bytes > ARENA_BLOCK_SIZE ? bytes : ARENA_BLOCK_SIZE;
+        if ((arena->head = newArenaBlock(capacity)) == NULL) {
+            return NULL;
+        }
+        arena->current = arena->head;
+    }
+    ArenaBlock* block = arena->current;
+    while (block->used + bytes > block->capacity) {
+        // Move on to a block kept from an earlier round, or chain a larger one
+        if (block->next == NULL) {
+            size_t capacity = block->capacity * 2;
+            if (capacity < bytes) {
+                capacity = bytes;
+            }
+            if ((block->next = newArenaBlock(capacity)) == NULL) {
+                return NULL;
+            }
+        }
+        block = block->next;
+        block->used = 0;
+    }
+    arena->current = block;
+    void* ptr = block->data + block->used;
+    block->used += bytes;
+    return ptr;
+}
+
+// Function to record the current position of an arena
+static inline ArenaMark arenaMark(const Arena* arena) {
+    ArenaMark mark;
+    mark.block = arena->current;
+    mark.used = arena->current != NULL ? arena->current->used : 0;
+    return mark;
+}
+
+// Function to release everything allocated from an arena
+static inline void arenaReset(Arena* arena) {
+    arena->current = arena->head;
+    if (arena->head != NULL) {
+        arena->head->used = 0;
+    }
+}
+
+// Function to release everything allocated since a mark
+static inline void arenaRelease(Arena* arena, ArenaMark mark) {
+    if (mark.block == NULL) {
+        arenaReset(arena);
+        return;
+    }
+    arena->current = mark.block;
+    mark.block->used = mark.used;
+}
+
+// Function to get the calling thread's arena, so protocol instances running on
+// different threads never share or lock an allocator. Its blocks are kept for the
+// life of the thread.
+static inline Arena* threadArena(void) {
+    static _Thread_local Arena arena;
+    return &arena;
+}
+
+#endif
@@ -1,12 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
-
-// Define the qubit structure
-typedef struct {
-    double alpha; // Complex coefficient for |0>
-    double beta;  // Complex coefficient for |1>
-} Qubit;
+#include <string.h>
+#include "resultsink.h"
+#include "qubitstate.h"
 
 // Function to initialize a qubit
 Qubit* initializeQubit(double alpha, double beta) {
@@ -29,12 +26,6 @@ int measureQubit(Qubit* qubit) {
     }
 }
 
-// Function to print the state of a qubit
-void printQubit(Qubit* qubit) {
-    printf("|0>: %.2f\n", qubit->alpha);
-    printf("|1>: %.2f\n", qubit->beta);
-}
-
 // Function to encode data in qubits
 Qubit** encodeData(int* data, int size) {
     Qubit** qubits = (Qubit**)malloc(size * sizeof(Qubit*));
@@ -57,7 +48,32 @@ int* decodeData(Qubit** qubits, int size) {
     return data;
 }
 
-int main() {
+// Usage: bitsize [result file] [--text]
+// With a result file, the qubit parameters and the decoded data are written to
+// it as binary columns (see resultsink.h) and the per-qubit text is only
+// printed with --text. Without one, everything is printed as text.
+int main(int argc, char** argv) {
+    const char* result_path = NULL;
+    int text = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--text") == 0) {
+            text = 1;
+        } else {
+            result_path = argv[i];
+        }
+    }
+    ResultSink* sink = NULL;
+    if (result_path != NULL) {
+        sink = openResultSink(result_path);
+        if (sink == NULL) {
+            return 1;
+        }
+    } else {
+        text = 1;
+    }
+    // Set when a result column could not be written; the run still finishes
+    int failed = 0;
+
     // Example usage
     int dataSize;
     printf("Enter the size of the data: ");
@@ -77,20 +93,36 @@ int main() {
     }
     printf("\n\n");
 
-    printf("Qubit Parameters:\n");
-    for (int i = 0; i < dataSize; i++) {
-        printf("Qubit %d:\n", i);
-        printQubit(qubits[i]);
-        printf("\n");
-    }
+    failed |= reportQubitStates(sink, text, "Qubit Parameters:", "qubits", qubits, dataSize) != 0;
 
     int* decodedData = decodeData(qubits, dataSize);
 
-    printf("Decoded Data:\n");
-    for (int i = 0; i < dataSize; i++) {
-        printf("%d ", decodedData[i]);
+    if (sink != NULL) {
+        uint64_t* records = (uint64_t*)malloc(dataSize * sizeof(uint64_t));
+        if (records == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for the decoded records.\n");
+            failed = 1;
+        } else {
+            for (int i = 0; i < dataSize; i++) {
+                records[i] = (uint64_t)decodedData[i];
+            }
+            failed |= writeShotColumn(sink, "decoded", records, dataSize, 1) != 0;
+            free(records);
+        }
+        failed |= closeResultSink(sink) != 0;
+        if (failed) {
+            fprintf(stderr, "Error: Results in %s are incomplete\n", result_path);
+        } else {
+            printf("Results written to %s\n", result_path);
+        }
+    }
+    if (text) {
+        printf("Decoded Data:\n");
+        for (int i = 0; i < dataSize; i++) {
+            printf("%d ", decodedData[i]);
+        }
+        printf("\n");
     }
-    printf("\n");
 
     // Clean up memory
     for (int i = 0; i < dataSize; i++) {
@@ -100,5 +132,5 @@ int main() {
     free(data);
     free(decodedData);
 
-    return 0;
+    return failed ? 1 : 0;
 }
@@ -0,0 +1,507 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "instrument.h"
+
+#define CACHE_FILE_MAGIC 0x31524351ULL   // "QCR1"
+
+// Growable list of 64-bit words that a key is hashed from
+typedef struct {
+    uint64_t* words;
+    size_t count;
+    size_t capacity;
+} WordBuffer;
+
+static int appendWord(WordBuffer* buffer, uint64_t word) {
+    if (buffer->count == buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        uint64_t* words = (uint64_t*)realloc(buffer->words, capacity * sizeof(uint64_t));
+        if (words == NULL) {
+            return -1;
+        }
+        buffer->words = words;
+        buffer->capacity = capacity;
+    }
+    buffer->words[buffer->count++] = word;
+    return 0;
+}
+
+// Function to turn a double into hashable bits, with -0.0 folded into 0.0
+static uint64_t doubleBits(double value) {
+    uint64_t bits;
+    if (value == 0.0) {
+        value = 0.0;
+    }
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t finalMix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xFF51AFD7ED558CCDULL;
+    k ^= k >> 33;
+    k *= 0xC4CEB9FE1A85EC53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// Function to hash a word list to 128 bits (MurmurHash3 x64_128 rounds, one word per lane)
+static CircuitKey hashWords(const uint64_t* words, size_t count) {
+    const uint64_t c1 = 0x87C37B91114253D5ULL, c2 = 0x4CF5AD432745937FULL;
+    uint64_t h1 = 0x243F6A8885A308D3ULL, h2 = 0x13198A2E03707344ULL;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t k1 = rotl64(words[i] * c1, 31) * c2;
+        h1 ^= k1;
+        h1 = rotl64(h1, 27) + h2;
+        h1 = h1 * 5 + 0x52DCE729;
+        uint64_t k2 = rotl64(words[i] * c2, 33) * c1;
+        h2 ^= k2;
+        h2 = rotl64(h2, 31) + h1;
+        h2 = h2 * 5 + 0x38495AB5;
+    }
+    h1 ^= count;
+    h2 ^= count;
+    h1 += h2;
+    h2 += h1;
+    h1 = finalMix64(h1);
+    h2 = finalMix64(h2);
+    h1 += h2;
+    h2 += h1;
+    CircuitKey key = { h1, h2 };
+    return key;
+}
+
+// Canonical form of a gate: its moment (earliest layer it can run in) and lowest qubit
+typedef struct {
+    int moment;
+    int first_qubit;
+    uint64_t words[5];
+} CanonicalGate;
+
+static int compareCanonicalGates(const void* a, const void* b) {
+    const CanonicalGate* x = (const CanonicalGate*)a;
+    const CanonicalGate* y = (const CanonicalGate*)b;
+    if (x->moment != y->moment) {
+        return x->moment < y->moment ? -1 : 1;
+    }
+    return (x->first_qubit > y->first_qubit) - (x->first_qubit < y->first_qubit);
+}
+
+static int comparePauliTerms(const void* a, const void* b) {
+    const PauliTerm* x = (const PauliTerm*)a;
+    const PauliTerm* y = (const PauliTerm*)b;
+    if (x->xmask != y->xmask) {
+        return x->xmask < y->xmask ? -1 : 1;
+    }
+    return (x->zmask > y->zmask) - (x->zmask < y->zmask);
+}
+
+// Function to serialize a circuit in canonical form. Gates are grouped into
+// moments and sorted by lowest qubit within each moment, so reorderings of gates
+// on disjoint qubits give the same key. Parameters are resolved to values and
+// symmetric two-qubit gates list their qubits in ascending order.
+static int serializeCircuit(WordBuffer* buffer, const Circuit* circuit) {
+    int last_moment[64] = { 0 };
+    CanonicalGate* gates = (CanonicalGate*)malloc((circuit->num_gates + 1) * sizeof(CanonicalGate));
+    if (gates == NULL) {
+        return -1;
+    }
+    for (int g = 0; g < circuit->num_gates; g++) {
+        const Gate* gate = &circuit->gates[g];
+        int two = isTwoQubitGate(gate->type);
+        int t0 = gate->targets[0], t1 = two ? gate->targets[1] : -1;
+        if (two && t1 < t0) {
+            int t = t0;
+            t0 = t1;
+            t1 = t;
+        }
+        uint64_t support = gate->controls | (1ULL << t0) | (two ? 1ULL << t1 : 0);
+        int moment = 0;
+        for (uint64_t s = support; s != 0; s &= s - 1) {
+            int q = __builtin_ctzll(s);
+            if (last_moment[q] > moment) {
+                moment = last_moment[q];
+            }
+        }
+        moment++;
+        for (uint64_t s = support; s != 0; s &= s - 1) {
+            last_moment[__builtin_ctzll(s)] = moment;
+        }
+        gates[g].moment = moment;
+        gates[g].first_qubit = __builtin_ctzll(support);
+        gates[g].words[0] = (uint64_t)gate->type;
+        gates[g].words[1] = (uint64_t)(int64_t)t0;
+        gates[g].words[2] = (uint64_t)(int64_t)t1;
+        gates[g].words[3] = gate->controls;
+        gates[g].words[4] = isParameterizedGate(gate->type) ? doubleBits(gateParameter(circuit, gate)) : 0;
+    }
+    qsort(gates, circuit->num_gates, sizeof(CanonicalGate), compareCanonicalGates);
+
+    int status = appendWord(buffer, (uint64_t)circuit->num_qubits);
+    status |= appendWord(buffer, (uint64_t)circuit->num_gates);
+    for (int g = 0; g < circuit->num_gates && status == 0; g++) {
+        for (int w = 0; w < 5; w++) {
+            status |= appendWord(buffer, gates[g].words[w]);
+        }
+    }
+    free(gates);
+    return status;
+}
+
+// Function to serialize an observable with its terms sorted by Pauli string
+static int serializeObservable(WordBuffer* buffer, const Observable* obs) {
+    PauliTerm* terms = (PauliTerm*)malloc((obs->num_terms + 1) * sizeof(PauliTerm));
+    if (terms == NULL) {
+        return -1;
+    }
+    memcpy(terms, obs->terms, obs->num_terms * sizeof(PauliTerm));
+    qsort(terms, obs->num_terms, sizeof(PauliTerm), comparePauliTerms);
+
+    int status = appendWord(buffer, (uint64_t)obs->num_terms);
+    for (int t = 0; t < obs->num_terms && status == 0; t++) {
+        status |= appendWord(buffer, terms[t].xmask);
+        status |= appendWord(buffer, terms[t].zmask);
+        status |= appendWord(buffer, doubleBits(terms[t].coefficient));
+    }
+    free(terms);
+    return status;
+}
+
+// Function to compute the content key of a circuit and the outputs requested
+// from it. Returns the all-zero key if serialization runs out of memory.
+CircuitKey circuitKey(const Circuit* circuit, const CacheRequest* request) {
+    INSTRUMENT_SCOPE("circuitKey");
+    INSTRUMENT_COUNT(COUNTER_HASHES, 1);
+    WordBuffer buffer = { NULL, 0, 0 };
+    CircuitKey key = { 0, 0 };
+    int status = serializeCircuit(&buffer, circuit);
+    status |= appendWord(&buffer, (uint64_t)(request->want_state != 0));
+    status |= appendWord(&buffer, request->num_samples);
+    status |= appendWord(&buffer, request->num_samples > 0 ? request->sample_seed : 0);
+    status |= appendWord(&buffer, (uint64_t)request->num_observables);
+    for (int o = 0; o < request->num_observables && status == 0; o++) {
+        status |= serializeObservable(&buffer, &request->observables[o]);
+    }
+    if (status == 0) {
+        key = hashWords(buffer.words, buffer.count);
+    }
+    free(buffer.words);
+    return key;
+}
+
+// Function to free the arrays of a result
+static void freeCachedResult(CachedResult* result) {
+    free(result->state);
+    free(result->samples);
+    free(result->expectations);
+    memset(result, 0, sizeof(CachedResult));
+}
+
+static size_t resultBytes(const CachedResult* result) {
+    size_t bytes = sizeof(CacheEntry);
+    if (result->state != NULL) {
+        bytes += (sizeof(double complex) << result->num_qubits);
+    }
+    bytes += result->num_samples * sizeof(uint64_t);
+    bytes += result->num_observables * sizeof(double);
+    return bytes;
+}
+
+// Function to create a cache holding up to capacity_bytes of results in memory.
+// With a disk_dir, results are also written there and looked up on a memory miss.
+// Returns 0 on success, -1 on failure.
+int initializeResultCache(ResultCache* cache, size_t capacity_bytes, const char* disk_dir) {
+    memset(cache, 0, sizeof(ResultCache));
+    cache->capacity_bytes = capacity_bytes;
+    cache->num_buckets = 64;
+    cache->buckets = (CacheEntry**)calloc(cache->num_buckets, sizeof(CacheEntry*));
+    if (cache->buckets == NULL) {
+        return -1;
+    }
+    if (disk_dir != NULL) {
+        if (mkdir(disk_dir, 0755) != 0 && access(disk_dir, W_OK) != 0) {
+            fprintf(stderr, "Error: Cache directory %s is not writable\n", disk_dir);
+            free(cache->buckets);
+            return -1;
+        }
+        cache->disk_dir = strdup(disk_dir);
+    }
+    return 0;
+}
+
+// Function to free every cached result (the disk tier is left in place)
+void freeResultCache(ResultCache* cache) {
+    CacheEntry* entry = cache->newest;
+    while (entry != NULL) {
+        CacheEntry* older = entry->older;
+        freeCachedResult(&entry->result);
+        free(entry);
+        entry = older;
+    }
+    free(cache->buckets);
+    free(cache->disk_dir);
+    memset(cache, 0, sizeof(ResultCache));
+}
+
+static inline int sameKey(CircuitKey a, CircuitKey b) {
+    return a.hi == b.hi && a.lo == b.lo;
+}
+
+static void unlinkEntry(ResultCache* cache, CacheEntry* entry) {
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+}
+
+static void pushNewest(ResultCache* cache, CacheEntry* entry) {
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest != NULL) {
+        cache->newest->newer = entry;
+    }
+    cache->newest = entry;
+    if (cache->oldest == NULL) {
+        cache->oldest = entry;
+    }
+}
+
+static CacheEntry* findEntry(const ResultCache* cache, CircuitKey key) {
+    CacheEntry* entry = cache->buckets[key.lo & (cache->num_buckets - 1)];
+    while (entry != NULL && !sameKey(entry->key, key)) {
+        entry = entry->next;
+    }
+    return entry;
+}
+
+// Function to drop the least recently used entry from memory
+static void evictOldest(ResultCache* cache) {
+    CacheEntry* victim = cache->oldest;
+    CacheEntry** link = &cache->buckets[victim->key.lo & (cache->num_buckets - 1)];
+    while (*link != victim) {
+        link = &(*link)->next;
+    }
+    *link = victim->next;
+    unlinkEntry(cache, victim);
+    cache->used_bytes -= victim->bytes;
+    cache->num_entries--;
+    freeCachedResult(&victim->result);
+    free(victim);
+}
+
+// Function to double the bucket array once entries outnumber buckets
+static void growBuckets(ResultCache* cache) {
+    int num_buckets = cache->num_buckets * 2;
+    CacheEntry** buckets = (CacheEntry**)calloc(num_buckets, sizeof(CacheEntry*));
+    if (buckets == NULL) {
+        return;
+    }
+    for (CacheEntry* entry = cache->newest; entry != NULL; entry = entry->older) {
+        CacheEntry** head = &buckets[entry->key.lo & (num_buckets - 1)];
+        entry->next = *head;
+        *head = entry;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->num_buckets = num_buckets;
+}
+
+// Function to insert a result into the memory tier, taking ownership of its arrays
+static CacheEntry* insertEntry(ResultCache* cache, CircuitKey key, CachedResult* result) {
+    CacheEntry* entry = (CacheEntry*)malloc(sizeof(CacheEntry));
+    if (entry == NULL) {
+        freeCachedResult(result);
+        return NULL;
+    }
+    entry->key = key;
+    entry->result = *result;
+    entry->bytes = resultBytes(result);
+    memset(result, 0, sizeof(CachedResult));
+
+    // The newest entry always stays, even if it alone exceeds the capacity
+    while (cache->oldest != NULL && cache->used_bytes + entry->bytes > cache->capacity_bytes) {
+        evictOldest(cache);
+    }
+    if (cache->num_entries >= cache->num_buckets) {
+        growBuckets(cache);
+    }
+    CacheEntry** head = &cache->buckets[key.lo & (cache->num_buckets - 1)];
+    entry->next = *head;
+    *head = entry;
+    pushNewest(cache, entry);
+    cache->used_bytes += entry->bytes;
+    cache->num_entries++;
+    return entry;
+}
+
+static void diskPath(const ResultCache* cache, CircuitKey key, char* path, size_t size, const char* suffix) {
+    snprintf(path, size, "%s/%016llx%016llx.qcr%s", cache->disk_dir,
+             (unsigned long long)key.hi, (unsigned long long)key.lo, suffix);
+}
+
+// Function to write a result to the disk tier through a temporary file and rename
+static void writeDiskResult(const ResultCache* cache, CircuitKey key, const CachedResult* result) {
+    char path[4096], temp[4096];
+    diskPath(cache, key, path, sizeof(path), "");
+    diskPath(cache, key, temp, sizeof(temp), ".tmp");
+    FILE* file = fopen(temp, "wb");
+    if (file == NULL) {
+        return;
+    }
+    uint64_t header[6] = { CACHE_FILE_MAGIC, (uint64_t)result->num_qubits, (uint64_t)(result->state != NULL),
+                           result->num_samples, (uint64_t)result->num_observables, 0 };
+    int ok = fwrite(header, sizeof(header), 1, file) == 1;
+    if (ok && result->state != NULL) {
+        ok = fwrite(result->state, sizeof(double complex), 1ULL << result->num_qubits, file) == (1ULL << result->num_qubits);
+    }
+    if (ok && result->num_samples > 0) {
+        ok = fwrite(result->samples, sizeof(uint64_t), result->num_samples, file) == result->num_samples;
+    }
+    if (ok && result->num_observables > 0) {
+        ok = fwrite(result->expectations, sizeof(double), result->num_observables, file) == (size_t)result->num_observables;
+    }
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(temp, path) != 0) {
+        remove(temp);
+    }
+}
+
+// Function to read a result from the disk tier. Returns 0 if found and valid.
+static int readDiskResult(const ResultCache* cache, CircuitKey key, CachedResult* result) {
+    char path[4096];
+    diskPath(cache, key, path, sizeof(path), "");
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    memset(result, 0, sizeof(CachedResult));
+    uint64_t header[6];
+    int ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == CACHE_FILE_MAGIC &&
+             header[1] >= 1 && header[1] <= 62;
+    if (ok) {
+        result->num_qubits = (int)header[1];
+        result->num_samples = header[3];
+        result->num_observables = (int)header[4];
+        if (header[2]) {
+            uint64_t size = 1ULL << result->num_qubits;
+            result->state = (double complex*)malloc(size * sizeof(double complex));
+            ok = result->state != NULL && fread(result->state, sizeof(double complex), size, file) == size;
+        }
+    }
+    if (ok && result->num_samples > 0) {
+        result->samples = (uint64_t*)malloc(result->num_samples * sizeof(uint64_t));
+        ok = result->samples != NULL && fread(result->samples, sizeof(uint64_t), result->num_samples, file) == result->num_samples;
+    }
+    if (ok && result->num_observables > 0) {
+        result->expectations = (double*)malloc(result->num_observables * sizeof(double));
+        ok = result->expectations != NULL &&
+             fread(result->expectations, sizeof(double), result->num_observables, file) == (size_t)result->num_observables;
+    }
+    fclose(file);
+    if (!ok) {
+        freeCachedResult(result);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to look up a result by key, in memory first and then on disk.
+// The result stays valid until the next lookup or store on this cache.
+// Returns NULL on a miss.
+const CachedResult* lookupResult(ResultCache* cache, CircuitKey key) {
+    CacheEntry* entry = findEntry(cache, key);
+    if (entry != NULL) {
+        unlinkEntry(cache, entry);
+        pushNewest(cache, entry);
+        cache->hits++;
+        return &entry->result;
+    }
+    if (cache->disk_dir != NULL) {
+        CachedResult loaded;
+        if (readDiskResult(cache, key, &loaded) == 0 && (entry = insertEntry(cache, key, &loaded)) != NULL) {
+            cache->disk_hits++;
+            return &entry->result;
+        }
+    }
+    cache->misses++;
+    return NULL;
+}
+
+// Function to add a result under key, taking ownership of its arrays.
+// Returns the cached copy, or NULL if it could not be stored.
+const CachedResult* storeResult(ResultCache* cache, CircuitKey key, CachedResult* result) {
+    CacheEntry* entry = findEntry(cache, key);
+    if (entry != NULL) {
+        freeCachedResult(result);
+        return &entry->result;
+    }
+    if (cache->disk_dir != NULL) {
+        writeDiskResult(cache, key, result);
+    }
+    entry = insertEntry(cache, key, result);
+    return entry != NULL ? &entry->result : NULL;
+}
+
+// Function to get the requested outputs of a circuit, simulating it only if
+// neither tier has a result for the same canonical circuit and request.
+// Returns NULL on failure.
+const CachedResult* runCircuitCached(ResultCache* cache, const Circuit* circuit, const CacheRequest* request) {
+    CircuitKey key = circuitKey(circuit, request);
+    if (key.hi == 0 && key.lo == 0) {
+        fprintf(stderr, "Error: Out of memory while hashing a circuit\n");
+        return NULL;
+    }
+    const CachedResult* cached = lookupResult(cache, key);
+    if (cached != NULL) {
+        return cached;
+    }
+
+    QubitRegister* reg = initializeRegister(circuit->num_qubits);
+    if (reg == NULL) {
+        return NULL;
+    }
+    applyCircuit(reg, circuit);
+
+    CachedResult result;
+    memset(&result, 0, sizeof(result));
+    result.num_qubits = circuit->num_qubits;
+    int ok = 1;
+    if (request->want_state) {
+        result.state = (double complex*)malloc(reg->size * sizeof(double complex));
+        ok = result.state != NULL;
+        if (ok) {
+            memcpy(result.state, reg->amplitudes, reg->size * sizeof(double complex));
+        }
+    }
+    if (ok && request->num_samples > 0) {
+        result.num_samples = request->num_samples;
+        result.samples = (uint64_t*)malloc(request->num_samples * sizeof(uint64_t));
+        ok = result.samples != NULL &&
+             sampleRegister(reg, request->num_samples, request->sample_seed, result.samples) == 0;
+    }
+    if (ok && request->num_observables > 0) {
+        result.num_observables = request->num_observables;
+        result.expectations = (double*)malloc(request->num_observables * sizeof(double));
+        ok = result.expectations != NULL &&
+             computeExpectations(reg, request->observables, request->num_observables, result.expectations) == 0;
+    }
+    freeRegister(reg);
+    if (!ok) {
+        freeCachedResult(&result);
+        return NULL;
+    }
+    return storeResult(cache, key, &result);
+}
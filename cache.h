@@ -0,0 +1,68 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <complex.h>
+#include "statevector.h"
+#include "circuit.h"
+#include "expectation.h"
+
+// 128-bit content hash of a circuit and the outputs requested from it
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} CircuitKey;
+
+// Outputs to compute for a circuit run from |0...0>
+typedef struct {
+    int want_state;               // Keep the final amplitudes
+    uint64_t num_samples;         // Basis-state samples to draw, with sample_seed
+    uint64_t sample_seed;
+    int num_observables;          // Expectation values to compute
+    const Observable* observables;
+} CacheRequest;
+
+typedef struct {
+    int num_qubits;
+    double complex* state;        // NULL unless requested
+    uint64_t num_samples;
+    uint64_t* samples;
+    int num_observables;
+    double* expectations;
+} CachedResult;
+
+typedef struct CacheEntry {
+    CircuitKey key;
+    CachedResult result;
+    size_t bytes;
+    struct CacheEntry* newer;     // LRU list, most recently used at the head
+    struct CacheEntry* older;
+    struct CacheEntry* next;      // Hash bucket chain
+} CacheEntry;
+
+// Result cache with an in-memory LRU tier bounded by capacity_bytes and an
+// optional write-through directory tier. Not safe for concurrent use.
+typedef struct {
+    size_t capacity_bytes;
+    size_t used_bytes;
+    int num_entries;
+    int num_buckets;
+    CacheEntry** buckets;
+    CacheEntry* newest;
+    CacheEntry* oldest;
+    char* disk_dir;
+    uint64_t hits;
+    uint64_t disk_hits;
+    uint64_t misses;
+} ResultCache;
+
+int initializeResultCache(ResultCache* cache, size_t capacity_bytes, const char* disk_dir);
+void freeResultCache(ResultCache* cache);
+
+CircuitKey circuitKey(const Circuit* circuit, const CacheRequest* request);
+const CachedResult* lookupResult(ResultCache* cache, CircuitKey key);
+const CachedResult* storeResult(ResultCache* cache, CircuitKey key, CachedResult* result);
+const CachedResult* runCircuitCached(ResultCache* cache, const Circuit* circuit, const CacheRequest* request);
+
+#endif
@@ -0,0 +1,333 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "allocator.h"
+
+// Function to get the file offset of the amplitudes: header and chunk table,
+// rounded up to a page so the data can be mapped
+static uint64_t dataOffset(uint64_t num_chunks) {
+    const uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t bytes = sizeof(CheckpointHeader) + num_chunks * sizeof(CheckpointChunk);
+    return (bytes + page - 1) / page * page;
+}
+
+// Function to hash a chunk of amplitudes over four independent lanes so the
+// multiply chains overlap. Returns 0 only for an all-zero chunk.
+static uint64_t chunkChecksum(const uint64_t* words, uint64_t count, int* is_zero) {
+    uint64_t lane[4] = { 0, 0, 0, 0 };
+    uint64_t any = 0;
+    for (uint64_t i = 0; i + 4 <= count; i += 4) {
+        for (int l = 0; l < 4; l++) {
+            any |= words[i + l];
+            lane[l] = (lane[l] ^ words[i + l]) * 0x9E3779B97F4A7C15ULL;
+            lane[l] ^= lane[l] >> 29;
+        }
+    }
+    for (uint64_t i = count & ~3ULL; i < count; i++) {
+        any |= words[i];
+        lane[i & 3] = (lane[i & 3] ^ words[i]) * 0x9E3779B97F4A7C15ULL;
+    }
+    *is_zero = any == 0;
+    if (any == 0) {
+        return 0;
+    }
+    uint64_t h = count;
+    for (int l = 0; l < 4; l++) {
+        h = (h ^ lane[l]) * 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+    }
+    return h | 1;
+}
+
+// Function to write a whole buffer at an offset, retrying short writes
+static int writeAll(int fd, const void* data, uint64_t bytes, uint64_t offset) {
+    const char* p = (const char*)data;
+    while (bytes > 0) {
+        ssize_t n = pwrite(fd, p, bytes > (1ULL << 30) ? (1ULL << 30) : bytes, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        offset += (uint64_t)n;
+        bytes -= (uint64_t)n;
+    }
+    return 0;
+}
+
+// Function to read a whole buffer at an offset, retrying short reads
+static int readAll(int fd, void* data, uint64_t bytes, uint64_t offset) {
+    char* p = (char*)data;
+    while (bytes > 0) {
+        ssize_t n = pread(fd, p, bytes > (1ULL << 30) ? (1ULL << 30) : bytes, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        offset += (uint64_t)n;
+        bytes -= (uint64_t)n;
+    }
+    return 0;
+}
+
+// Function to write a checkpoint of amplitude_bytes-wide amplitudes.
+// The file is sized first, so chunks that are entirely zero are never written
+// and stay holes. Other chunks are written in parallel with pwrite at their
+// final offsets. The header goes last, and the file replaces path only after
+// fsync, so a crash mid-save leaves the previous checkpoint intact.
+static int saveAmplitudes(const char* path, const void* amplitudes, int num_qubits, int amplitude_bytes,
+                          const CheckpointState* state) {
+    const int chunk_qubits = num_qubits < CHECKPOINT_CHUNK_QUBITS ? num_qubits : CHECKPOINT_CHUNK_QUBITS;
+    const uint64_t num_chunks = 1ULL << (num_qubits - chunk_qubits);
+    const uint64_t chunk_bytes = (uint64_t)amplitude_bytes << chunk_qubits;
+    const uint64_t offset = dataOffset(num_chunks);
+
+    size_t path_length = strlen(path);
+    char* tmp_path = (char*)malloc(path_length + 5);
+    CheckpointChunk* table = (CheckpointChunk*)calloc(num_chunks, sizeof(CheckpointChunk));
+    if (tmp_path == NULL || table == NULL) {
+        free(tmp_path);
+        free(table);
+        return -1;
+    }
+    memcpy(tmp_path, path, path_length);
+    memcpy(tmp_path + path_length, ".tmp", 5);
+
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)(offset + (chunk_bytes * num_chunks))) != 0) {
+        fprintf(stderr, "Error: Could not create checkpoint %s\n", tmp_path);
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmp_path);
+        }
+        free(tmp_path);
+        free(table);
+        return -1;
+    }
+
+    int failed = 0;
+    #pragma omp parallel for schedule(dynamic, 1) if (num_chunks > 1)
+    for (int64_t c = 0; c < (int64_t)num_chunks; c++) {
+        const char* chunk = (const char*)amplitudes + (uint64_t)c * chunk_bytes;
+        int is_zero;
+        table[c].checksum = chunkChecksum((const uint64_t*)chunk, chunk_bytes / sizeof(uint64_t), &is_zero);
+        table[c].is_zero = (uint64_t)is_zero;
+        if (!is_zero && writeAll(fd, chunk, chunk_bytes, offset + (uint64_t)c * chunk_bytes) != 0) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+    }
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.amplitude_bytes = (uint32_t)amplitude_bytes;
+    header.num_qubits = (uint32_t)num_qubits;
+    header.chunk_qubits = (uint32_t)chunk_qubits;
+    header.num_chunks = num_chunks;
+    header.data_offset = offset;
+    if (state != NULL) {
+        header.position = state->position;
+        header.circuit_id[0] = state->circuit_id[0];
+        header.circuit_id[1] = state->circuit_id[1];
+        header.has_rng = (uint64_t)(state->has_rng != 0);
+        memcpy(header.rng, state->rng.s, sizeof(header.rng));
+    }
+
+    if (failed || writeAll(fd, table, num_chunks * sizeof(CheckpointChunk), sizeof(header)) != 0 ||
+        writeAll(fd, &header, sizeof(header), 0) != 0 || fsync(fd) != 0) {
+        fprintf(stderr, "Error: Could not write checkpoint %s\n", tmp_path);
+        close(fd);
+        unlink(tmp_path);
+        free(tmp_path);
+        free(table);
+        return -1;
+    }
+    close(fd);
+    int status = rename(tmp_path, path);
+    if (status != 0) {
+        fprintf(stderr, "Error: Could not move checkpoint into place at %s\n", path);
+        unlink(tmp_path);
+    }
+    free(tmp_path);
+    free(table);
+    return status == 0 ? 0 : -1;
+}
+
+// Function to save a register and the run state. Returns 0 on success, -1 on failure.
+int saveCheckpoint(const char* path, const QubitRegister* reg, const CheckpointState* state) {
+    return saveAmplitudes(path, reg->amplitudes, reg->num_qubits, sizeof(double complex), state);
+}
+
+// Function to save a single-precision register. Returns 0 on success, -1 on failure.
+int saveCheckpoint32(const char* path, const QubitRegister32* reg, const CheckpointState* state) {
+    return saveAmplitudes(path, reg->amplitudes, reg->num_qubits, sizeof(float complex), state);
+}
+
+// Function to open a checkpoint and return its amplitudes, in an array that
+// freeAmplitudes can release. Large states are mapped privately straight from
+// the file, so restoring costs a page fault per page as it is first touched and
+// writes never reach the checkpoint. Small states are read into the heap.
+// With verify set, every chunk is read and compared with its checksum.
+// Returns NULL on failure.
+static void* restoreAmplitudes(const char* path, int amplitude_bytes, int* num_qubits,
+                               CheckpointState* state, int verify) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not open checkpoint %s\n", path);
+        return NULL;
+    }
+    CheckpointHeader header;
+    struct stat info;
+    if (readAll(fd, &header, sizeof(header), 0) != 0 || fstat(fd, &info) != 0 ||
+        memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CHECKPOINT_VERSION || header.num_qubits < 1 || header.num_qubits > 62 ||
+        header.chunk_qubits > header.num_qubits ||
+        header.num_chunks != 1ULL << (header.num_qubits - header.chunk_qubits) ||
+        header.data_offset != dataOffset(header.num_chunks) ||
+        (uint64_t)info.st_size != header.data_offset + ((uint64_t)header.amplitude_bytes << header.num_qubits)) {
+        fprintf(stderr, "Error: %s is not a valid checkpoint\n", path);
+        close(fd);
+        return NULL;
+    }
+    if (header.amplitude_bytes != (uint32_t)amplitude_bytes) {
+        fprintf(stderr, "Error: Checkpoint %s holds %u-byte amplitudes, not %d-byte\n",
+                path, header.amplitude_bytes, amplitude_bytes);
+        close(fd);
+        return NULL;
+    }
+
+    const uint64_t chunk_bytes = (uint64_t)amplitude_bytes << header.chunk_qubits;
+    const uint64_t bytes = chunk_bytes * header.num_chunks;
+    CheckpointChunk* table = (CheckpointChunk*)malloc(header.num_chunks * sizeof(CheckpointChunk));
+    if (table == NULL || readAll(fd, table, header.num_chunks * sizeof(CheckpointChunk), sizeof(header)) != 0) {
+        fprintf(stderr, "Error: Could not read the chunk table of %s\n", path);
+        free(table);
+        close(fd);
+        return NULL;
+    }
+
+    void* amplitudes;
+    int failed = 0;
+    if (bytes >= HUGE_PAGE_THRESHOLD) {
+        amplitudes = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)header.data_offset);
+        if (amplitudes == MAP_FAILED) {
+            amplitudes = NULL;
+        }
+    } else {
+        amplitudes = allocateAmplitudes(bytes);
+        for (uint64_t c = 0; amplitudes != NULL && c < header.num_chunks && !failed; c++) {
+            char* chunk = (char*)amplitudes + c * chunk_bytes;
+            if (table[c].is_zero) {
+                memset(chunk, 0, chunk_bytes);
+            } else {
+                failed = readAll(fd, chunk, chunk_bytes, header.data_offset + c * chunk_bytes) != 0;
+            }
+        }
+    }
+    close(fd);
+    if (amplitudes == NULL || failed) {
+        fprintf(stderr, "Error: Could not load the amplitudes of %s\n", path);
+        freeAmplitudes(amplitudes, bytes);
+        free(table);
+        return NULL;
+    }
+
+    if (verify) {
+        #pragma omp parallel for schedule(dynamic, 1) if (header.num_chunks > 1)
+        for (int64_t c = 0; c < (int64_t)header.num_chunks; c++) {
+            int is_zero;
+            const uint64_t* chunk = (const uint64_t*)((const char*)amplitudes + (uint64_t)c * chunk_bytes);
+            if (chunkChecksum(chunk, chunk_bytes / sizeof(uint64_t), &is_zero) != table[c].checksum ||
+                (uint64_t)is_zero != table[c].is_zero) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+        }
+        if (failed) {
+            fprintf(stderr, "Error: Checkpoint %s is corrupt\n", path);
+            freeAmplitudes(amplitudes, bytes);
+            free(table);
+            return NULL;
+        }
+    }
+    free(table);
+
+    *num_qubits = (int)header.num_qubits;
+    if (state != NULL) {
+        state->position = header.position;
+        state->circuit_id[0] = header.circuit_id[0];
+        state->circuit_id[1] = header.circuit_id[1];
+        state->has_rng = header.has_rng != 0;
+        memcpy(state->rng.s, header.rng, sizeof(header.rng));
+    }
+    return amplitudes;
+}
+
+// Function to restore a register and the run state from a checkpoint.
+// The register is released with freeRegister as usual. Returns NULL on failure.
+QubitRegister* restoreCheckpoint(const char* path, CheckpointState* state, int verify) {
+    QubitRegister* reg = (QubitRegister*)malloc(sizeof(QubitRegister));
+    if (reg == NULL) {
+        return NULL;
+    }
+    reg->amplitudes = (double complex*)restoreAmplitudes(path, sizeof(double complex), &reg->num_qubits, state, verify);
+    if (reg->amplitudes == NULL) {
+        free(reg);
+        return NULL;
+    }
+    reg->size = 1ULL << reg->num_qubits;
+    return reg;
+}
+
+// Function to restore a single-precision register from a checkpoint.
+// Returns NULL on failure.
+QubitRegister32* restoreCheckpoint32(const char* path, CheckpointState* state, int verify) {
+    QubitRegister32* reg = (QubitRegister32*)malloc(sizeof(QubitRegister32));
+    if (reg == NULL) {
+        return NULL;
+    }
+    reg->amplitudes = (float complex*)restoreAmplitudes(path, sizeof(float complex), &reg->num_qubits, state, verify);
+    if (reg->amplitudes == NULL) {
+        free(reg);
+        return NULL;
+    }
+    reg->size = 1ULL << reg->num_qubits;
+    return reg;
+}
+
+// Function to run the rest of a circuit from state->position, saving a
+// checkpoint to path after every checkpoint_every gates and at the end.
+// Each segment is run with applyCircuit on a view of the gate list, so
+// diagonal runs inside a segment are still fused.
+// Returns 0 on success, -1 if a checkpoint could not be written.
+int applyCircuitCheckpointed(QubitRegister* reg, const Circuit* circuit, CheckpointState* state,
+                             int checkpoint_every, const char* path) {
+    const uint64_t total = (uint64_t)circuit->num_gates;
+    const uint64_t step = checkpoint_every > 0 ? (uint64_t)checkpoint_every : total;
+
+    while (state->position < total) {
+        Circuit segment = *circuit;
+        segment.gates = circuit->gates + state->position;
+        segment.num_gates = (int)(total - state->position < step ? total - state->position : step);
+        applyCircuit(reg, &segment);
+        state->position += (uint64_t)segment.num_gates;
+        if (saveCheckpoint(path, reg, state) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
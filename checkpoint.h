@@ -0,0 +1,54 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include "statevector.h"
+#include "statevector32.h"
+#include "circuit.h"
+#include "rng.h"
+
+#define CHECKPOINT_MAGIC "QSIMCKP1"
+#define CHECKPOINT_VERSION 1
+// Amplitudes per chunk are 2^this; chunks are written, skipped and checked independently
+#define CHECKPOINT_CHUNK_QUBITS 20
+
+// Where a run was when it was checkpointed, saved next to the amplitudes
+typedef struct {
+    uint64_t position;        // Gates of the circuit already applied
+    uint64_t circuit_id[2];   // Caller's identifier for the circuit, e.g. a CircuitKey
+    int has_rng;
+    Rng rng;
+} CheckpointState;
+
+// Fixed-size file header. Amplitudes follow at data_offset, page aligned and in
+// register order, so the file can be mapped as the live state. All-zero chunks
+// are left as holes in a sparse file and flagged in the chunk table.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t amplitude_bytes;   // 16 for double complex, 8 for float complex
+    uint32_t num_qubits;
+    uint32_t chunk_qubits;
+    uint64_t num_chunks;
+    uint64_t data_offset;
+    uint64_t position;
+    uint64_t circuit_id[2];
+    uint64_t has_rng;
+    uint64_t rng[4];
+} CheckpointHeader;
+
+// Entry of the chunk table that follows the header
+typedef struct {
+    uint64_t checksum;
+    uint64_t is_zero;
+} CheckpointChunk;
+
+int saveCheckpoint(const char* path, const QubitRegister* reg, const CheckpointState* state);
+int saveCheckpoint32(const char* path, const QubitRegister32* reg, const CheckpointState* state);
+QubitRegister* restoreCheckpoint(const char* path, CheckpointState* state, int verify);
+QubitRegister32* restoreCheckpoint32(const char* path, CheckpointState* state, int verify);
+
+int applyCircuitCheckpointed(QubitRegister* reg, const Circuit* circuit, CheckpointState* state,
+                             int checkpoint_every, const char* path);
+
+#endif
@@ -0,0 +1,432 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "circuit.h"
+#include "diagonal.h"
+#include "instrument.h"
+
+// Function to initialize an empty circuit over num_qubits qubits
+void initializeCircuit(Circuit* circuit, int num_qubits) {
+    circuit->num_qubits = num_qubits;
+    circuit->num_gates = 0;
+    circuit->capacity = 0;
+    circuit->gates = NULL;
+    circuit->num_params = 0;
+    circuit->param_capacity = 0;
+    circuit->params = NULL;
+}
+
+// Function to free memory allocated for a circuit
+void freeCircuit(Circuit* circuit) {
+    free(circuit->gates);
+    free(circuit->params);
+    initializeCircuit(circuit, circuit->num_qubits);
+}
+
+// Function to append a gate, growing the gate list as needed. Returns its index.
+static int appendGate(Circuit* circuit, Gate gate) {
+    for (int t = 0; t < (isTwoQubitGate(gate.type) ? 2 : 1); t++) {
+        if (gate.targets[t] < 0 || gate.targets[t] >= circuit->num_qubits) {
+            return -1;
+        }
+    }
+    if (circuit->num_qubits < 64 && (gate.controls >> circuit->num_qubits) != 0) {
+        return -1;
+    }
+    if (circuit->num_gates == circuit->capacity) {
+        int capacity = circuit->capacity ? circuit->capacity * 2 : 16;
+        Gate* gates = (Gate*)realloc(circuit->gates, capacity * sizeof(Gate));
+        if (gates == NULL) {
+            return -1;
+        }
+        circuit->gates = gates;
+        circuit->capacity = capacity;
+    }
+    circuit->gates[circuit->num_gates] = gate;
+    return circuit->num_gates++;
+}
+
+// Function to add a fixed single-qubit gate such as H or X
+int addGate(Circuit* circuit, GateType type, int target) {
+    Gate gate = { type, { target, -1 }, 0, 0.0, -1 };
+    return appendGate(circuit, gate);
+}
+
+// Function to add a single-qubit rotation or power gate with a fixed parameter
+int addRotationGate(Circuit* circuit, GateType type, int target, double parameter) {
+    Gate gate = { type, { target, -1 }, 0, parameter, -1 };
+    return appendGate(circuit, gate);
+}
+
+// Function to add a single-qubit gate that only acts when all control qubits are |1>
+int addControlledGate(Circuit* circuit, GateType type, uint64_t controls, int target, double parameter) {
+    if (controls & (1ULL << target)) {
+        return -1;
+    }
+    Gate gate = { type, { target, -1 }, controls, parameter, -1 };
+    return appendGate(circuit, gate);
+}
+
+// Function to add a two-qubit gate such as ZZ**t or SWAP
+int addTwoQubitGate(Circuit* circuit, GateType type, int q0, int q1, double parameter) {
+    if (q0 == q1) {
+        return -1;
+    }
+    Gate gate = { type, { q0, q1 }, 0, parameter, -1 };
+    return appendGate(circuit, gate);
+}
+
+// Function to add a trainable parameter to the circuit. Returns its index.
+int addParameter(Circuit* circuit, double value) {
+    if (circuit->num_params == circuit->param_capacity) {
+        int capacity = circuit->param_capacity ? circuit->param_capacity * 2 : 16;
+        double* params = (double*)realloc(circuit->params, capacity * sizeof(double));
+        if (params == NULL) {
+            return -1;
+        }
+        circuit->params = params;
+        circuit->param_capacity = capacity;
+    }
+    circuit->params[circuit->num_params] = value;
+    return circuit->num_params++;
+}
+
+// Function to make a gate read its parameter from circuit->params[param_index].
+// Several gates may share one parameter.
+int bindParameter(Circuit* circuit, int gate_index, int param_index) {
+    if (gate_index < 0 || gate_index >= circuit->num_gates ||
+        param_index < 0 || param_index >= circuit->num_params ||
+        !isParameterizedGate(circuit->gates[gate_index].type)) {
+        return -1;
+    }
+    circuit->gates[gate_index].param_index = param_index;
+    return 0;
+}
+
+// Names used by the text circuit format, indexed by GateType
+static const char* gate_names[NUM_GATE_TYPES] = {
+    "H", "X", "Y", "Z", "S", "T", "RX", "RY", "RZ", "ZPOW", "ZZPOW", "SWAP"
+};
+
+// Function to get the text-format name of a gate type
+const char* gateName(GateType type) {
+    return (type >= 0 && type < NUM_GATE_TYPES) ? gate_names[type] : "?";
+}
+
+// Function to append one gate given as a line of the text circuit format:
+//   NAME q [param]          e.g. "H 0", "RX 2 0.5"
+//   NAME q0 q1 [param]      e.g. "SWAP 0 1", "ZZPOW 1 2 0.25"
+//   C..CNAME c.. q [param]  one leading C per control, e.g. "CX 0 1", "CCZ 0 1 2"
+// CNOT is accepted for CX. Returns the gate index, or -1 if the line is invalid.
+int parseGateLine(Circuit* circuit, const char* line) {
+    char name[32];
+    int offset = 0;
+    if (sscanf(line, " %31s%n", name, &offset) != 1) {
+        return -1;
+    }
+    if (strcmp(name, "CNOT") == 0) {
+        strcpy(name, "CX");
+    }
+    int num_controls = 0;
+    while (name[num_controls] == 'C') {
+        num_controls++;
+    }
+    int type = -1;
+    for (int t = 0; t < NUM_GATE_TYPES; t++) {
+        if (strcmp(name + num_controls, gate_names[t]) == 0) {
+            type = t;
+        }
+    }
+    if (type < 0 || (num_controls > 0 && isTwoQubitGate((GateType)type))) {
+        return -1;
+    }
+
+    const char* p = line + offset;
+    int qubits[66];
+    int num_qubits = num_controls + (isTwoQubitGate((GateType)type) ? 2 : 1);
+    if (num_qubits > 64) {
+        return -1;
+    }
+    for (int q = 0; q < num_qubits; q++) {
+        int used = 0;
+        if (sscanf(p, " %d%n", &qubits[q], &used) != 1 || qubits[q] < 0 || qubits[q] >= 64) {
+            return -1;
+        }
+        p += used;
+    }
+    double parameter = 0.0;
+    if (isParameterizedGate((GateType)type)) {
+        int used = 0;
+        if (sscanf(p, " %lf%n", &parameter, &used) != 1) {
+            return -1;
+        }
+        p += used;
+    }
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+        p++;
+    }
+    if (*p != '\0') {
+        return -1;
+    }
+
+    if (isTwoQubitGate((GateType)type)) {
+        return addTwoQubitGate(circuit, (GateType)type, qubits[0], qubits[1], parameter);
+    }
+    uint64_t controls = 0;
+    for (int c = 0; c < num_controls; c++) {
+        controls |= 1ULL << qubits[c];
+    }
+    return addControlledGate(circuit, (GateType)type, controls, qubits[num_controls], parameter);
+}
+
+// Function to check whether a gate type acts on two target qubits
+int isTwoQubitGate(GateType type) {
+    return type == GATE_ZZPOW || type == GATE_SWAP;
+}
+
+// Function to check whether a gate type takes a continuous parameter
+int isParameterizedGate(GateType type) {
+    switch (type) {
+        case GATE_RX:
+        case GATE_RY:
+        case GATE_RZ:
+        case GATE_ZPOW:
+        case GATE_ZZPOW:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Function to get the value a gate should be applied with
+double gateParameter(const Circuit* circuit, const Gate* gate) {
+    if (gate->param_index >= 0) {
+        return circuit->params[gate->param_index];
+    }
+    return gate->parameter;
+}
+
+// Function to build the 2x2 matrix of a single-qubit gate type
+void singleQubitGateMatrix(GateType type, double parameter, double complex m[2][2]) {
+    double c = cos(parameter / 2);
+    double s = sin(parameter / 2);
+    m[0][0] = 1; m[0][1] = 0;
+    m[1][0] = 0; m[1][1] = 1;
+
+    switch (type) {
+        case GATE_H:
+            m[0][0] = M_SQRT1_2; m[0][1] = M_SQRT1_2;
+            m[1][0] = M_SQRT1_2; m[1][1] = -M_SQRT1_2;
+            break;
+        case GATE_X:
+            m[0][0] = 0; m[0][1] = 1;
+            m[1][0] = 1; m[1][1] = 0;
+            break;
+        case GATE_Y:
+            m[0][0] = 0; m[0][1] = -I;
+            m[1][0] = I; m[1][1] = 0;
+            break;
+        case GATE_Z:
+            m[1][1] = -1;
+            break;
+        case GATE_S:
+            m[1][1] = I;
+            break;
+        case GATE_T:
+            m[1][1] = cexp(I * M_PI / 4);
+            break;
+        case GATE_RX:
+            m[0][0] = c; m[0][1] = -I * s;
+            m[1][0] = -I * s; m[1][1] = c;
+            break;
+        case GATE_RY:
+            m[0][0] = c; m[0][1] = -s;
+            m[1][0] = s; m[1][1] = c;
+            break;
+        case GATE_RZ:
+            m[0][0] = cexp(-I * parameter / 2);
+            m[1][1] = cexp(I * parameter / 2);
+            break;
+        case GATE_ZPOW:
+            m[1][1] = cexp(I * M_PI * parameter);
+            break;
+        default:
+            break;
+    }
+}
+
+// Function to build the 4x4 matrix of a two-qubit gate type
+void twoQubitGateMatrix(GateType type, double parameter, double complex m[4][4]) {
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            m[r][c] = (r == c) ? 1 : 0;
+        }
+    }
+    switch (type) {
+        case GATE_ZZPOW:
+            m[1][1] = cexp(I * M_PI * parameter);
+            m[2][2] = m[1][1];
+            break;
+        case GATE_SWAP:
+            m[1][1] = 0; m[1][2] = 1;
+            m[2][1] = 1; m[2][2] = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+// Function to build the derivative of a single-qubit gate matrix with respect to its parameter
+static void singleQubitDerivativeMatrix(GateType type, double parameter, double complex m[2][2]) {
+    double c = cos(parameter / 2);
+    double s = sin(parameter / 2);
+    m[0][0] = 0; m[0][1] = 0;
+    m[1][0] = 0; m[1][1] = 0;
+
+    switch (type) {
+        case GATE_RX:
+            m[0][0] = -s / 2; m[0][1] = -I * c / 2;
+            m[1][0] = -I * c / 2; m[1][1] = -s / 2;
+            break;
+        case GATE_RY:
+            m[0][0] = -s / 2; m[0][1] = -c / 2;
+            m[1][0] = c / 2; m[1][1] = -s / 2;
+            break;
+        case GATE_RZ:
+            m[0][0] = -I / 2 * cexp(-I * parameter / 2);
+            m[1][1] = I / 2 * cexp(I * parameter / 2);
+            break;
+        case GATE_ZPOW:
+            m[1][1] = I * M_PI * cexp(I * M_PI * parameter);
+            break;
+        default:
+            break;
+    }
+}
+
+// Function to apply a gate (or its inverse) through the dense matrix kernels
+static void applyGateMatrix(QubitRegister* reg, const Gate* gate, double parameter, int inverse) {
+    if (isTwoQubitGate(gate->type)) {
+        double complex m[4][4], inv[4][4];
+        twoQubitGateMatrix(gate->type, parameter, m);
+        if (inverse) {
+            for (int r = 0; r < 4; r++) {
+                for (int c = 0; c < 4; c++) {
+                    inv[r][c] = conj(m[c][r]);
+                }
+            }
+            memcpy(m, inv, sizeof(m));
+        }
+        applyTwoQubitGate(reg, gate->targets[0], gate->targets[1], m);
+    } else {
+        double complex m[2][2], inv[2][2];
+        singleQubitGateMatrix(gate->type, parameter, m);
+        if (inverse) {
+            inv[0][0] = conj(m[0][0]); inv[0][1] = conj(m[1][0]);
+            inv[1][0] = conj(m[0][1]); inv[1][1] = conj(m[1][1]);
+            memcpy(m, inv, sizeof(m));
+        }
+        applyControlledGate(reg, gate->controls, gate->targets[0], m);
+    }
+}
+
+// Function to apply a single diagonal gate (or its inverse) through the phase-table path
+static void applyDiagonalGate(QubitRegister* reg, const Gate* gate, double parameter, int inverse) {
+    DiagonalLayer layer;
+    initializeDiagonalLayer(&layer);
+    int status = addGateToDiagonalLayer(&layer, gate, parameter);
+    if (status == 0) {
+        if (inverse) {
+            invertDiagonalLayer(&layer);
+        }
+        status = applyDiagonalLayer(reg, &layer);
+    }
+    freeDiagonalLayer(&layer);
+    if (status != 0) {
+        // No memory for the layer or its tables; the matrix kernels need none
+        applyGateMatrix(reg, gate, parameter, inverse);
+    }
+}
+
+// Function to apply a gate with the given parameter value
+// Controlled gates go to the active-subspace kernel even when diagonal, since it
+// touches only the amplitudes whose control bits are all set.
+void applyGate(QubitRegister* reg, const Gate* gate, double parameter) {
+    INSTRUMENT_GATE(gate->type, reg->size >> __builtin_popcountll(gate->controls), sizeof(double complex));
+    if (isDiagonalGate(gate) && gate->controls == 0) {
+        applyDiagonalGate(reg, gate, parameter, 0);
+    } else if (gate->type == GATE_SWAP) {
+        applySwap(reg, gate->targets[0], gate->targets[1]);
+    } else {
+        applyGateMatrix(reg, gate, parameter, 0);
+    }
+}
+
+// Function to apply the inverse (conjugate transpose) of a gate
+void applyGateInverse(QubitRegister* reg, const Gate* gate, double parameter) {
+    if (isDiagonalGate(gate) && gate->controls == 0) {
+        applyDiagonalGate(reg, gate, parameter, 1);
+    } else {
+        applyGateMatrix(reg, gate, parameter, 1);
+    }
+}
+
+// Function to run every gate of a circuit on a register, in order.
+// Each run of consecutive diagonal gates is fused into a single phase sweep,
+// except a lone controlled phase, which is cheaper on its active subspace.
+void applyCircuit(QubitRegister* reg, const Circuit* circuit) {
+    INSTRUMENT_SCOPE("applyCircuit");
+    int g = 0;
+    while (g < circuit->num_gates) {
+        const Gate* gate = &circuit->gates[g];
+        int lone_controlled = gate->controls != 0 &&
+            (g + 1 == circuit->num_gates || !isDiagonalGate(&circuit->gates[g + 1]));
+        if (isDiagonalGate(gate) && !lone_controlled) {
+            DiagonalLayer layer;
+            initializeDiagonalLayer(&layer);
+            const int start = g;
+            g = collectDiagonalRun(&layer, circuit, g);
+            if (g == start) {
+                // Out of memory for the layer: apply the gate on its own
+                freeDiagonalLayer(&layer);
+                applyGate(reg, gate, gateParameter(circuit, gate));
+                g++;
+                continue;
+            }
+            if (applyDiagonalLayer(reg, &layer) != 0) {
+                // No memory for the phase tables: the register is untouched, so
+                // run the gates one by one on the matrix kernels
+                for (int d = start; d < g; d++) {
+                    applyGateMatrix(reg, &circuit->gates[d], gateParameter(circuit, &circuit->gates[d]), 0);
+                }
+            }
+            freeDiagonalLayer(&layer);
+            // The fused run is one sweep over the state, however many gates it holds
+            for (int d = start; d < g; d++) {
+                INSTRUMENT_GATE(circuit->gates[d].type, d == start ? reg->size : 0, sizeof(double complex));
+            }
+        } else {
+            applyGate(reg, gate, gateParameter(circuit, gate));
+            g++;
+        }
+    }
+}
+
+// Function to compute <bra| dU/dparameter |ket> without building dU|ket>.
+// The derivative of a controlled gate vanishes outside the control subspace.
+double complex gateDerivativeOverlap(const QubitRegister* bra, const QubitRegister* ket,
+                                     const Gate* gate, double parameter) {
+    if (gate->type == GATE_ZZPOW) {
+        double complex m[4][4] = { { 0 } };
+        m[1][1] = I * M_PI * cexp(I * M_PI * parameter);
+        m[2][2] = m[1][1];
+        return twoQubitOverlap(bra, ket, gate->targets[0], gate->targets[1], m);
+    }
+    if (!isParameterizedGate(gate->type) || isTwoQubitGate(gate->type)) {
+        return 0.0;
+    }
+    double complex m[2][2];
+    singleQubitDerivativeMatrix(gate->type, parameter, m);
+    return singleQubitOverlap(bra, ket, gate->controls, gate->targets[0], m);
+}
@@ -0,0 +1,71 @@
+#ifndef CIRCUIT_H
+#define CIRCUIT_H
+
+#include <stdint.h>
+#include "statevector.h"
+
+// Gate types of the circuit IR. The *POW gates follow Cirq's exponent convention.
+typedef enum {
+    GATE_H,
+    GATE_X,
+    GATE_Y,
+    GATE_Z,
+    GATE_S,
+    GATE_T,
+    GATE_RX,       // exp(-i theta X / 2)
+    GATE_RY,       // exp(-i theta Y / 2)
+    GATE_RZ,       // exp(-i theta Z / 2)
+    GATE_ZPOW,     // diag(1, e^(i pi t))
+    GATE_ZZPOW,    // diag(1, e^(i pi t), e^(i pi t), 1)
+    GATE_SWAP,
+    NUM_GATE_TYPES
+} GateType;
+
+// One gate. Single-qubit types act on targets[0] and may carry control qubits;
+// two-qubit types act on targets[0] and targets[1].
+typedef struct {
+    GateType type;
+    int targets[2];
+    uint64_t controls;   // Qubits that must all be |1> for the gate to act
+    double parameter;    // Angle in radians, or exponent for the *POW gates
+    int param_index;     // Index into Circuit.params, or -1 for a fixed parameter
+} Gate;
+
+typedef struct {
+    int num_qubits;
+    int num_gates;
+    int capacity;
+    Gate* gates;
+    int num_params;
+    int param_capacity;
+    double* params;
+} Circuit;
+
+void initializeCircuit(Circuit* circuit, int num_qubits);
+void freeCircuit(Circuit* circuit);
+
+int addGate(Circuit* circuit, GateType type, int target);
+int addRotationGate(Circuit* circuit, GateType type, int target, double parameter);
+int addControlledGate(Circuit* circuit, GateType type, uint64_t controls, int target, double parameter);
+int addTwoQubitGate(Circuit* circuit, GateType type, int q0, int q1, double parameter);
+int addParameter(Circuit* circuit, double value);
+int bindParameter(Circuit* circuit, int gate_index, int param_index);
+int parseGateLine(Circuit* circuit, const char* line);
+const char* gateName(GateType type);
+
+int isTwoQubitGate(GateType type);
+int isParameterizedGate(GateType type);
+double gateParameter(const Circuit* circuit, const Gate* gate);
+
+void singleQubitGateMatrix(GateType type, double parameter, double complex m[2][2]);
+void twoQubitGateMatrix(GateType type, double parameter, double complex m[4][4]);
+
+void applyGate(QubitRegister* reg, const Gate* gate, double parameter);
+void applyGateInverse(QubitRegister* reg, const Gate* gate, double parameter);
+void applyCircuit(QubitRegister* reg, const Circuit* circuit);
+
+// <bra| dU/dparameter |ket> for a parameterized gate
+double complex gateDerivativeOverlap(const QubitRegister* bra, const QubitRegister* ket,
+                                     const Gate* gate, double parameter);
+
+#endif
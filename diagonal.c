@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "diagonal.h"
+
+// Function to initialize an empty (identity) diagonal layer
+void initializeDiagonalLayer(DiagonalLayer* layer) {
+    layer->num_monomials = 0;
+    layer->capacity = 0;
+    layer->monomials = NULL;
+}
+
+// Function to free memory allocated for a diagonal layer
+void freeDiagonalLayer(DiagonalLayer* layer) {
+    free(layer->monomials);
+    initializeDiagonalLayer(layer);
+}
+
+// Function to add weight to the monomial over mask, merging with an existing one
+static int addPhaseMonomial(DiagonalLayer* layer, uint64_t mask, double weight) {
+    for (int m = 0; m < layer->num_monomials; m++) {
+        if (layer->monomials[m].mask == mask) {
+            layer->monomials[m].weight += weight;
+            return 0;
+        }
+    }
+    if (layer->num_monomials == layer->capacity) {
+        int capacity = layer->capacity ? layer->capacity * 2 : 16;
+        PhaseMonomial* monomials = (PhaseMonomial*)realloc(layer->monomials, capacity * sizeof(PhaseMonomial));
+        if (monomials == NULL) {
+            return -1;
+        }
+        layer->monomials = monomials;
+        layer->capacity = capacity;
+    }
+    layer->monomials[layer->num_monomials].mask = mask;
+    layer->monomials[layer->num_monomials].weight = weight;
+    layer->num_monomials++;
+    return 0;
+}
+
+// Function to make room for count more monomials, so a gate is added whole or not at all
+static int reserveMonomials(DiagonalLayer* layer, int count) {
+    if (layer->num_monomials + count <= layer->capacity) {
+        return 0;
+    }
+    int capacity = layer->capacity ? layer->capacity * 2 : 16;
+    while (capacity < layer->num_monomials + count) {
+        capacity *= 2;
+    }
+    PhaseMonomial* monomials = (PhaseMonomial*)realloc(layer->monomials, capacity * sizeof(PhaseMonomial));
+    if (monomials == NULL) {
+        return -1;
+    }
+    layer->monomials = monomials;
+    layer->capacity = capacity;
+    return 0;
+}
+
+// Function to check whether a gate is diagonal in the computational basis
+int isDiagonalGate(const Gate* gate) {
+    switch (gate->type) {
+        case GATE_Z:
+        case GATE_S:
+        case GATE_T:
+        case GATE_RZ:
+        case GATE_ZPOW:
+        case GATE_ZZPOW:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Function to fold a diagonal gate into the layer's phase function.
+// Controls just widen the monomial masks. Returns -1 for non-diagonal gates or
+// on allocation failure, leaving the layer unchanged.
+int addGateToDiagonalLayer(DiagonalLayer* layer, const Gate* gate, double parameter) {
+    uint64_t controls = gate->controls;
+    uint64_t target = 1ULL << gate->targets[0];
+    int status = 0;
+
+    // A gate contributes at most three monomials
+    if (isDiagonalGate(gate) && reserveMonomials(layer, 3) != 0) {
+        return -1;
+    }
+
+    switch (gate->type) {
+        case GATE_Z:
+            status = addPhaseMonomial(layer, controls | target, M_PI);
+            break;
+        case GATE_S:
+            status = addPhaseMonomial(layer, controls | target, M_PI / 2);
+            break;
+        case GATE_T:
+            status = addPhaseMonomial(layer, controls | target, M_PI / 4);
+            break;
+        case GATE_ZPOW:
+            status = addPhaseMonomial(layer, controls | target, M_PI * parameter);
+            break;
+        case GATE_RZ:
+            // diag(e^(-i theta/2), e^(i theta/2)) = e^(-i theta/2) * diag(1, e^(i theta))
+            status = addPhaseMonomial(layer, controls, -parameter / 2);
+            if (status == 0) {
+                status = addPhaseMonomial(layer, controls | target, parameter);
+            }
+            break;
+        case GATE_ZZPOW: {
+            // e^(i pi t (b0 xor b1)) = e^(i pi t (b0 + b1 - 2 b0 b1))
+            uint64_t other = 1ULL << gate->targets[1];
+            double w = M_PI * parameter;
+            status = addPhaseMonomial(layer, target, w);
+            if (status == 0) {
+                status = addPhaseMonomial(layer, other, w);
+            }
+            if (status == 0) {
+                status = addPhaseMonomial(layer, target | other, -2 * w);
+            }
+            break;
+        }
+        default:
+            return -1;
+    }
+    return status;
+}
+
+// Function to fold the run of consecutive diagonal gates starting at gate index
+// start into the layer. Diagonal gates commute, so the run is one phase function.
+// Returns the index of the first gate not folded in, which is start itself if
+// the layer could not grow at all.
+int collectDiagonalRun(DiagonalLayer* layer, const Circuit* circuit, int start) {
+    int g = start;
+    while (g < circuit->num_gates && isDiagonalGate(&circuit->gates[g])) {
+        const Gate* gate = &circuit->gates[g];
+        if (addGateToDiagonalLayer(layer, gate, gateParameter(circuit, gate)) != 0) {
+            break;
+        }
+        g++;
+    }
+    return g;
+}
+
+// Function to turn a layer into its inverse by negating every phase
+void invertDiagonalLayer(DiagonalLayer* layer) {
+    for (int m = 0; m < layer->num_monomials; m++) {
+        layer->monomials[m].weight = -layer->monomials[m].weight;
+    }
+}
+
+// Function to specialize a layer to the block of indices whose bits at and above
+// low_qubits equal fixed_bits, giving a layer over the low qubits only. Monomials
+// whose high part is not satisfied drop out. Returns -1 on allocation failure.
+int restrictDiagonalLayer(const DiagonalLayer* layer, uint64_t fixed_bits, int low_qubits, DiagonalLayer* out) {
+    const uint64_t low_mask = (1ULL << low_qubits) - 1;
+    initializeDiagonalLayer(out);
+    for (int m = 0; m < layer->num_monomials; m++) {
+        uint64_t high = layer->monomials[m].mask & ~low_mask;
+        if ((fixed_bits & high) != high) {
+            continue;
+        }
+        if (addPhaseMonomial(out, layer->monomials[m].mask & low_mask, layer->monomials[m].weight) != 0) {
+            freeDiagonalLayer(out);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to multiply table[l] by e^(i weight) for every l in the tile that
+// contains all bits of mask, by walking the supersets of mask
+static void multiplySupersets(double complex* table, uint64_t tile_mask, uint64_t mask, double complex factor) {
+    uint64_t free_bits = tile_mask & ~mask;
+    uint64_t s = 0;
+    do {
+        table[mask | s] *= factor;
+        s = (s - free_bits) & free_bits;
+    } while (s != 0);
+}
+
+// Function to allocate tables for layers of up to max_monomials monomials over
+// tiles of 2^low_bits amplitudes. Returns 0 on success, -1 on allocation failure.
+int allocateDiagonalTables(DiagonalTables* tables, int low_bits, int max_monomials) {
+    tables->low_bits = low_bits;
+    tables->max_monomials = max_monomials;
+    tables->num_high = 0;
+    tables->num_cross = 0;
+    tables->low_table = (double complex*)malloc((1ULL << low_bits) * sizeof(double complex));
+    tables->high = (PhaseMonomial*)malloc((max_monomials + 1) * sizeof(PhaseMonomial));
+    tables->cross = (PhaseMonomial*)malloc((max_monomials + 1) * sizeof(PhaseMonomial));
+    if (tables->low_table == NULL || tables->high == NULL || tables->cross == NULL) {
+        freeDiagonalTables(tables);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to free memory allocated for diagonal tables
+void freeDiagonalTables(DiagonalTables* tables) {
+    free(tables->low_table);
+    free(tables->high);
+    free(tables->cross);
+    tables->low_table = NULL;
+    tables->high = NULL;
+    tables->cross = NULL;
+}
+
+// Function to fill the tables for a layer with at most max_monomials monomials:
+//  - monomials entirely inside the tile form a 2^L phase table built once,
+//  - monomials entirely above the tile give one phase per tile,
+//  - monomials straddling both only fire in tiles whose high bits match.
+void fillDiagonalTables(DiagonalTables* tables, const DiagonalLayer* layer) {
+    const uint64_t tile = 1ULL << tables->low_bits;
+    const uint64_t tile_mask = tile - 1;
+    double complex* low_table = tables->low_table;
+
+    // Phases are summed in the real parts, then turned into factors in place
+    for (uint64_t l = 0; l < tile; l++) {
+        low_table[l] = 0.0;
+    }
+    tables->num_high = 0;
+    tables->num_cross = 0;
+    for (int m = 0; m < layer->num_monomials; m++) {
+        const PhaseMonomial* mono = &layer->monomials[m];
+        if ((mono->mask & ~tile_mask) == 0) {
+            uint64_t free_bits = tile_mask & ~mono->mask;
+            uint64_t s = 0;
+            do {
+                low_table[mono->mask | s] += mono->weight;
+                s = (s - free_bits) & free_bits;
+            } while (s != 0);
+        } else if ((mono->mask & tile_mask) == 0) {
+            tables->high[tables->num_high++] = *mono;
+        } else {
+            tables->cross[tables->num_cross++] = *mono;
+        }
+    }
+    for (uint64_t l = 0; l < tile; l++) {
+        low_table[l] = cexp(I * creal(low_table[l]));
+    }
+}
+
+// Function to multiply the tile of 2^low_bits amplitudes starting at amp + base
+// by the layer's phases. Straddling monomials are multiplied into scratch, a
+// tile-sized buffer of the calling thread, which may be NULL when num_cross is 0.
+void applyDiagonalTile(const DiagonalTables* tables, double complex* amp, uint64_t base, double complex* scratch) {
+    const uint64_t tile = 1ULL << tables->low_bits;
+    const uint64_t tile_mask = tile - 1;
+
+    double high_phase = 0.0;
+    for (int m = 0; m < tables->num_high; m++) {
+        if ((base & tables->high[m].mask) == tables->high[m].mask) {
+            high_phase += tables->high[m].weight;
+        }
+    }
+    const double complex scale = cexp(I * high_phase);
+
+    const double complex* table = tables->low_table;
+    int active = 0;
+    for (int m = 0; m < tables->num_cross; m++) {
+        const PhaseMonomial* cross = &tables->cross[m];
+        uint64_t high_part = cross->mask & ~tile_mask;
+        if ((base & high_part) != high_part) {
+            continue;
+        }
+        if (!active) {
+            memcpy(scratch, tables->low_table, tile * sizeof(double complex));
+            active = 1;
+        }
+        multiplySupersets(scratch, tile_mask, cross->mask & tile_mask, cexp(I * cross->weight));
+    }
+    if (active) {
+        table = scratch;
+    }
+
+    double complex* restrict out = amp + base;
+    for (uint64_t l = 0; l < tile; l++) {
+        out[l] *= scale * table[l];
+    }
+}
+
+// Function to apply a diagonal layer in one multiply-only sweep.
+// The index is split into a low tile of L bits and the high bits above it; see
+// fillDiagonalTables. Every buffer is allocated before the first amplitude
+// changes, so on failure it returns -1 with the register untouched and the
+// caller can fall back.
+int applyDiagonalLayer(QubitRegister* reg, const DiagonalLayer* layer) {
+    const int low_bits = reg->num_qubits < DIAGONAL_TILE_BITS ? reg->num_qubits : DIAGONAL_TILE_BITS;
+    const uint64_t tile = 1ULL << low_bits;
+    const int64_t num_tiles = (int64_t)(reg->size >> low_bits);
+    double complex* amp = reg->amplitudes;
+
+    DiagonalTables tables;
+    if (allocateDiagonalTables(&tables, low_bits, layer->num_monomials) != 0) {
+        return -1;
+    }
+    fillDiagonalTables(&tables, layer);
+
+    int failed = 0;
+    #pragma omp parallel if (reg->size >= PARALLEL_THRESHOLD)
+    {
+        double complex* scratch = NULL;
+        if (tables.num_cross > 0) {
+            scratch = (double complex*)malloc(tile * sizeof(double complex));
+            if (scratch == NULL) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+        }
+        // Every thread sees the same flag after the barrier, so either all of
+        // them run the sweep or none does
+        #pragma omp barrier
+        int skip;
+        #pragma omp atomic read
+        skip = failed;
+        if (!skip) {
+            #pragma omp for schedule(static)
+            for (int64_t t = 0; t < num_tiles; t++) {
+                applyDiagonalTile(&tables, amp, (uint64_t)t << low_bits, scratch);
+            }
+        }
+        free(scratch);
+    }
+
+    freeDiagonalTables(&tables);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,56 @@
+#ifndef DIAGONAL_H
+#define DIAGONAL_H
+
+#include <stdint.h>
+#include "statevector.h"
+#include "circuit.h"
+
+// Bits of the basis index covered by the precomputed phase table
+#define DIAGONAL_TILE_BITS 10
+
+// Phase weight applied to every basis state whose index has all bits of mask set.
+// mask == 0 is a global phase, one bit a single-qubit phase, two bits a CZ-like term.
+typedef struct {
+    uint64_t mask;
+    double weight;
+} PhaseMonomial;
+
+// Product of diagonal gates, stored as the phase function
+// phi(j) = sum over monomials of weight * [j & mask == mask]
+typedef struct {
+    int num_monomials;
+    int capacity;
+    PhaseMonomial* monomials;
+} DiagonalLayer;
+
+// A layer prepared for tile-by-tile application over tiles of 2^low_bits
+// amplitudes: the phase factors of the monomials inside the tile and the
+// monomials that reach above it. The buffers hold any layer of up to
+// max_monomials monomials, so one allocation serves many layers.
+typedef struct {
+    int low_bits;
+    int max_monomials;
+    double complex* low_table;
+    int num_high;
+    int num_cross;
+    PhaseMonomial* high;
+    PhaseMonomial* cross;
+} DiagonalTables;
+
+void initializeDiagonalLayer(DiagonalLayer* layer);
+void freeDiagonalLayer(DiagonalLayer* layer);
+
+int isDiagonalGate(const Gate* gate);
+int addGateToDiagonalLayer(DiagonalLayer* layer, const Gate* gate, double parameter);
+int collectDiagonalRun(DiagonalLayer* layer, const Circuit* circuit, int start);
+void invertDiagonalLayer(DiagonalLayer* layer);
+int restrictDiagonalLayer(const DiagonalLayer* layer, uint64_t fixed_bits, int low_qubits, DiagonalLayer* out);
+
+int allocateDiagonalTables(DiagonalTables* tables, int low_bits, int max_monomials);
+void freeDiagonalTables(DiagonalTables* tables);
+void fillDiagonalTables(DiagonalTables* tables, const DiagonalLayer* layer);
+void applyDiagonalTile(const DiagonalTables* tables, double complex* amp, uint64_t base, double complex* scratch);
+
+int applyDiagonalLayer(QubitRegister* reg, const DiagonalLayer* layer);
+
+#endif
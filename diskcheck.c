@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include "outofcore.h"
+#include "rng.h"
+
+// Check of the out-of-core register against the dense one.
+//
+// Usage: diskcheck [file] [qubits] [chunk qubits] [gates] [rounds] [seed]
+//
+// Each round runs one random circuit on a register backed by file and on a dense
+// register. Half of the gate qubits are drawn from above the chunk, so passes
+// have to gather chunks: two-qubit gates on two high qubits, single-qubit gates
+// with high controls, and chains of gates that the scheduler reorders past a
+// deferred one. The file's amplitudes and its norm are then compared with the
+// dense state. The file is removed at the end. Exits 0 when every round matches.
+
+#define DISKCHECK_TOLERANCE 1e-9
+
+// Function to draw a qubit, from above the chunk half of the time
+static int drawQubit(Rng* rng, int num_qubits, int chunk_qubits) {
+    if (nextRng(rng) % 2 == 0) {
+        return chunk_qubits + (int)(nextRng(rng) % (uint64_t)(num_qubits - chunk_qubits));
+    }
+    return (int)(nextRng(rng) % (uint64_t)num_qubits);
+}
+
+// Function to build one random circuit biased towards high-order qubits
+static int buildDiskCircuit(Circuit* circuit, int num_qubits, int chunk_qubits, int num_gates, Rng* rng) {
+    static const GateType single[] = { GATE_H, GATE_X, GATE_Y, GATE_Z, GATE_S, GATE_T,
+                                       GATE_RX, GATE_RY, GATE_RZ, GATE_ZPOW };
+    const int num_single = (int)(sizeof(single) / sizeof(single[0]));
+    initializeCircuit(circuit, num_qubits);
+    for (int g = 0; g < num_gates; g++) {
+        uint64_t kind = nextRng(rng) % 10;
+        int q0 = drawQubit(rng, num_qubits, chunk_qubits);
+        int q1 = drawQubit(rng, num_qubits, chunk_qubits);
+        int q2 = drawQubit(rng, num_qubits, chunk_qubits);
+        double parameter = 2 * M_PI * uniformRng(rng) - M_PI;
+        GateType type = single[nextRng(rng) % (uint64_t)num_single];
+        int status = 0;
+        if (kind == 0 && q0 != q1) {
+            status = addTwoQubitGate(circuit, GATE_ZZPOW, q0, q1, parameter);
+        } else if (kind == 1 && q0 != q1) {
+            status = addTwoQubitGate(circuit, GATE_SWAP, q0, q1, 0.0);
+        } else if (kind < 4 && q0 != q1) {
+            uint64_t controls = (1ULL << q1) | (q2 != q0 ? 1ULL << q2 : 0);
+            status = addControlledGate(circuit, type, controls, q0, parameter);
+        } else {
+            status = addControlledGate(circuit, type, 0, q0, parameter);
+        }
+        if (status < 0) {
+            freeCircuit(circuit);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to run one round and compare. Returns the number of mismatches.
+static int checkRound(DiskRegister* disk, const Circuit* circuit, int round) {
+    QubitRegister* dense = initializeRegister(circuit->num_qubits);
+    if (dense == NULL) {
+        fprintf(stderr, "Error: Out of memory for the dense register\n");
+        return 1;
+    }
+    applyCircuit(dense, circuit);
+    if (resetDiskRegister(disk) != 0 || applyDiskCircuit(disk, circuit) != 0) {
+        fprintf(stderr, "Error: Out-of-core run of round %d failed\n", round);
+        freeRegister(dense);
+        return 1;
+    }
+
+    int mismatches = 0;
+    double worst = 0.0;
+    for (uint64_t i = 0; i < dense->size; i++) {
+        double error = cabs(dense->amplitudes[i] - disk->amplitudes[i]);
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    if (worst > DISKCHECK_TOLERANCE) {
+        fprintf(stderr, "Error: Round %d differs from the dense state by %g\n", round, worst);
+        mismatches++;
+    }
+    double norm = diskRegisterNorm(disk);
+    if (fabs(norm - 1.0) > DISKCHECK_TOLERANCE) {
+        fprintf(stderr, "Error: Round %d has norm %.12f on disk\n", round, norm);
+        mismatches++;
+    }
+    printf("round %3d: %d gates on %d qubits, chunks of %d: %s\n", round, circuit->num_gates,
+           circuit->num_qubits, disk->chunk_qubits, mismatches ? "FAIL" : "ok");
+    freeRegister(dense);
+    return mismatches;
+}
+
+int main(int argc, char* argv[]) {
+    const char* path = argc > 1 ? argv[1] : "diskcheck.state";
+    int num_qubits = argc > 2 ? atoi(argv[2]) : 16;
+    int chunk_qubits = argc > 3 ? atoi(argv[3]) : 10;
+    int num_gates = argc > 4 ? atoi(argv[4]) : 300;
+    int rounds = argc > 5 ? atoi(argv[5]) : 10;
+    uint64_t seed = argc > 6 ? strtoull(argv[6], NULL, 10) : 1;
+    if (num_qubits < 2 || num_qubits > 30 || chunk_qubits < 1 || chunk_qubits >= num_qubits ||
+        num_gates < 1 || rounds < 1) {
+        fprintf(stderr, "Usage: %s [file] [qubits] [chunk qubits (below qubits)] [gates] [rounds] [seed]\n",
+                argv[0]);
+        return 1;
+    }
+
+    DiskRegister* disk = createDiskRegister(path, num_qubits, chunk_qubits);
+    if (disk == NULL) {
+        return 1;
+    }
+    Rng rng;
+    seedRng(&rng, seed, 0);
+    int failures = 0;
+    for (int round = 0; round < rounds; round++) {
+        Circuit circuit;
+        if (buildDiskCircuit(&circuit, num_qubits, chunk_qubits, num_gates, &rng) != 0) {
+            fprintf(stderr, "Error: Out of memory building round %d\n", round);
+            failures++;
+            break;
+        }
+        failures += checkRound(disk, &circuit, round);
+        freeCircuit(&circuit);
+    }
+    closeDiskRegister(disk);
+    unlink(path);
+
+    printf("%s\n", failures ? "FAILED" : "Out-of-core runs match the dense register");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "distributed.h"
+#include "rng.h"
+
+// Check of the distributed register against the dense one.
+//
+// Usage: distcheck [ranks] [qubits] [gates] [rounds] [seed]
+//
+// Forks the ranks with launchLocalRanks, then every rank builds the same random
+// circuit per round - single-qubit gates with and without a control, ZZPow and
+// SWAP over all qubits, so global qubits are swapped in and out and diagonal
+// gates hit rank bits - and runs it on its slice. Rank 0 gathers the state and
+// compares it, its norm and a few Pauli expectations with applyCircuit on a
+// dense register. Exits 0 when every round matches.
+
+#define DISTCHECK_OBSERVABLES 4
+#define DISTCHECK_TOLERANCE 1e-9
+
+typedef struct {
+    int num_qubits;
+    int num_gates;
+    int rounds;
+    uint64_t seed;
+} CheckConfig;
+
+// Function to build one random circuit; every rank draws the same one
+static int buildRandomCircuit(Circuit* circuit, int num_qubits, int num_gates, Rng* rng) {
+    static const GateType single[] = { GATE_H, GATE_X, GATE_Y, GATE_Z, GATE_S, GATE_T,
+                                       GATE_RX, GATE_RY, GATE_RZ, GATE_ZPOW };
+    const int num_single = (int)(sizeof(single) / sizeof(single[0]));
+    initializeCircuit(circuit, num_qubits);
+    for (int g = 0; g < num_gates; g++) {
+        uint64_t kind = nextRng(rng) % 10;
+        int q0 = (int)(nextRng(rng) % (uint64_t)num_qubits);
+        int q1 = (q0 + 1 + (int)(nextRng(rng) % (uint64_t)(num_qubits - 1))) % num_qubits;
+        double parameter = 2 * M_PI * uniformRng(rng) - M_PI;
+        GateType type = single[nextRng(rng) % (uint64_t)num_single];
+        int status;
+        if (kind == 0) {
+            status = addTwoQubitGate(circuit, GATE_ZZPOW, q0, q1, parameter);
+        } else if (kind == 1) {
+            status = addTwoQubitGate(circuit, GATE_SWAP, q0, q1, 0.0);
+        } else if (kind < 4) {
+            status = addControlledGate(circuit, type, 1ULL << q1, q0, parameter);
+        } else {
+            status = addControlledGate(circuit, type, 0, q0, parameter);
+        }
+        if (status < 0) {
+            freeCircuit(circuit);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to build random Pauli-string observables of one to three terms. At
+// most max_support qubits carry X or Y across all of them, since those have to
+// fit in a rank's local positions at once; other picks fall back to Z.
+static int buildRandomObservables(Observable* observables, int count, int num_qubits, int max_support, Rng* rng) {
+    static const char paulis[] = { 'X', 'Y', 'Z' };
+    uint64_t support = 0;
+    for (int o = 0; o < count; o++) {
+        initializeObservable(&observables[o]);
+    }
+    for (int o = 0; o < count; o++) {
+        int terms = 1 + (int)(nextRng(rng) % 3);
+        for (int t = 0; t < terms; t++) {
+            char text[256];
+            int length = 0;
+            for (int q = 0; q < num_qubits; q++) {
+                if (nextRng(rng) % 3 == 0) {
+                    char pauli = paulis[nextRng(rng) % 3];
+                    if (pauli != 'Z' && !(support & (1ULL << q))) {
+                        if (__builtin_popcountll(support) < max_support) {
+                            support |= 1ULL << q;
+                        } else {
+                            pauli = 'Z';
+                        }
+                    }
+                    length += snprintf(text + length, sizeof(text) - length, "%s%c%d",
+                                       length ? " " : "", pauli, q);
+                }
+            }
+            if (length == 0) {
+                snprintf(text, sizeof(text), "Z%d", (int)(nextRng(rng) % (uint64_t)num_qubits));
+            }
+            if (addPauliTerm(&observables[o], uniformRng(rng) * 2 - 1, text) != 0) {
+                for (int i = 0; i < count; i++) {
+                    freeObservable(&observables[i]);
+                }
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Function to compare rank 0's gathered state and results with the dense run.
+// Returns the number of mismatches.
+static int compareWithDense(const QubitRegister* gathered, const Circuit* circuit, const Observable* observables,
+                            const double* results, double norm) {
+    QubitRegister* dense = initializeRegister(circuit->num_qubits);
+    if (dense == NULL) {
+        return 1;
+    }
+    applyCircuit(dense, circuit);
+
+    int mismatches = 0;
+    double worst = 0.0;
+    for (uint64_t i = 0; i < dense->size; i++) {
+        double error = cabs(dense->amplitudes[i] - gathered->amplitudes[i]);
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    if (worst > DISTCHECK_TOLERANCE) {
+        fprintf(stderr, "Error: Gathered state differs from the dense state by %g\n", worst);
+        mismatches++;
+    }
+    if (fabs(norm - 1.0) > DISTCHECK_TOLERANCE) {
+        fprintf(stderr, "Error: Distributed norm is %.12f\n", norm);
+        mismatches++;
+    }
+    for (int o = 0; o < DISTCHECK_OBSERVABLES; o++) {
+        double expected = computeExpectation(dense, &observables[o]);
+        if (isnan(expected) || fabs(expected - results[o]) > DISTCHECK_TOLERANCE) {
+            fprintf(stderr, "Error: Observable %d is %.12f distributed, %.12f dense\n", o, results[o], expected);
+            mismatches++;
+        }
+    }
+    freeRegister(dense);
+    return mismatches;
+}
+
+// Function to run every round on one rank. Any failure makes the rank return
+// non-zero; a rank that stops early closes its sockets, so its partners fail too.
+static int checkRank(int rank, int num_ranks, const int* peer_fds, void* arg) {
+    const CheckConfig* config = (const CheckConfig*)arg;
+    DistributedRegister* reg = initializeDistributedRegister(config->num_qubits, rank, num_ranks, peer_fds);
+    if (reg == NULL) {
+        fprintf(stderr, "Error: Rank %d could not set up its register\n", rank);
+        return 1;
+    }
+    QubitRegister* gathered = NULL;
+    if (rank == 0) {
+        gathered = initializeRegister(config->num_qubits);
+        if (gathered == NULL) {
+            freeDistributedRegister(reg);
+            return 1;
+        }
+    }
+
+    Rng rng;
+    seedRng(&rng, config->seed, 0);
+    int failures = 0;
+    for (int round = 0; round < config->rounds && failures == 0; round++) {
+        Circuit circuit;
+        Observable observables[DISTCHECK_OBSERVABLES];
+        if (buildRandomCircuit(&circuit, config->num_qubits, config->num_gates, &rng) != 0) {
+            fprintf(stderr, "Error: Rank %d could not build round %d\n", rank, round);
+            failures++;
+            break;
+        }
+        if (buildRandomObservables(observables, DISTCHECK_OBSERVABLES, config->num_qubits,
+                                   reg->local_qubits, &rng) != 0) {
+            fprintf(stderr, "Error: Rank %d could not build round %d\n", rank, round);
+            freeCircuit(&circuit);
+            failures++;
+            break;
+        }
+
+        double results[DISTCHECK_OBSERVABLES];
+        resetDistributedRegister(reg);
+        if (applyDistributedCircuit(reg, &circuit) != 0) {
+            fprintf(stderr, "Error: Rank %d failed to run round %d\n", rank, round);
+            failures++;
+        }
+        double norm = failures ? NAN : distributedNorm(reg);
+        if (failures == 0 &&
+            computeDistributedExpectations(reg, observables, DISTCHECK_OBSERVABLES, results) != 0) {
+            fprintf(stderr, "Error: Rank %d failed to compute expectations in round %d\n", rank, round);
+            failures++;
+        }
+        if (failures == 0 && gatherDistributedRegister(reg, gathered) != 0) {
+            fprintf(stderr, "Error: Rank %d failed to gather round %d\n", rank, round);
+            failures++;
+        }
+        if (failures == 0 && rank == 0) {
+            failures += compareWithDense(gathered, &circuit, observables, results, norm);
+            printf("round %3d: %d gates on %d qubits over %d ranks: %s\n", round, circuit.num_gates,
+                   config->num_qubits, num_ranks, failures ? "FAIL" : "ok");
+        }
+        for (int o = 0; o < DISTCHECK_OBSERVABLES; o++) {
+            freeObservable(&observables[o]);
+        }
+        freeCircuit(&circuit);
+    }
+
+    freeRegister(gathered);
+    freeDistributedRegister(reg);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    int num_ranks = argc > 1 ? atoi(argv[1]) : 4;
+    CheckConfig config;
+    config.num_qubits = argc > 2 ? atoi(argv[2]) : 12;
+    config.num_gates = argc > 3 ? atoi(argv[3]) : 200;
+    config.rounds = argc > 4 ? atoi(argv[4]) : 10;
+    config.seed = argc > 5 ? strtoull(argv[5], NULL, 10) : 1;
+    int global_qubits = num_ranks > 0 ? __builtin_ctz((unsigned)num_ranks) : 0;
+    if (num_ranks < 1 || (num_ranks & (num_ranks - 1)) != 0 || config.num_qubits - global_qubits < 2 ||
+        config.num_qubits > 30 || config.num_gates < 1 || config.rounds < 1) {
+        fprintf(stderr, "Usage: %s [ranks (power of two)] [qubits] [gates] [rounds] [seed]\n", argv[0]);
+        return 1;
+    }
+
+    // Rank 0 waits for every child, so one status covers all of them
+    int status = launchLocalRanks(num_ranks, checkRank, &config);
+    printf("%s\n", status ? "FAILED" : "Distributed runs match the dense register");
+    return status ? 1 : 0;
+}
@@ -0,0 +1,523 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "distributed.h"
+#include "diagonal.h"
+
+// Outgoing half of a swap, streamed by a helper thread while the main thread
+// receives the partner's half and applies the pending gate chunk by chunk
+typedef struct {
+    int fd;
+    const double complex* amp;
+    double complex* staging;
+    uint64_t lbit;
+    uint64_t send_bit;
+    uint64_t half;
+    atomic_uint_fast64_t sent;
+    int failed;
+} HalfSender;
+
+// Function to write exactly len bytes to a socket
+static int writeFully(int fd, const void* data, size_t len) {
+    const char* p = (const char*)data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Function to read exactly len bytes from a socket
+static int readFully(int fd, void* data, size_t len) {
+    char* p = (char*)data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Function to create this rank's share of a register in the |0...0> state.
+// peer_fds[k] must be a connected stream socket to rank ^ (1 << k).
+DistributedRegister* initializeDistributedRegister(int num_qubits, int rank, int num_ranks, const int* peer_fds) {
+    if (num_ranks < 1 || (num_ranks & (num_ranks - 1)) != 0 || rank < 0 || rank >= num_ranks) {
+        return NULL;
+    }
+    int global_qubits = __builtin_ctz((unsigned)num_ranks);
+    if (num_qubits - global_qubits < 2 || num_qubits > 62) {
+        return NULL;
+    }
+    DistributedRegister* reg = (DistributedRegister*)malloc(sizeof(DistributedRegister));
+    if (reg == NULL) {
+        return NULL;
+    }
+    reg->rank = rank;
+    reg->num_ranks = num_ranks;
+    reg->num_qubits = num_qubits;
+    reg->global_qubits = global_qubits;
+    reg->local_qubits = num_qubits - global_qubits;
+    reg->local = initializeRegister(reg->local_qubits);
+    if (reg->local == NULL) {
+        free(reg);
+        return NULL;
+    }
+    reg->exchange = (double complex*)malloc(reg->local->size * sizeof(double complex));
+    if (reg->exchange == NULL) {
+        freeRegister(reg->local);
+        free(reg);
+        return NULL;
+    }
+    for (int k = 0; k < global_qubits; k++) {
+        reg->peers[k] = peer_fds[k];
+    }
+    resetDistributedRegister(reg);
+    return reg;
+}
+
+// Function to free this rank's share. The peer sockets belong to the caller.
+void freeDistributedRegister(DistributedRegister* reg) {
+    if (reg == NULL) {
+        return;
+    }
+    freeRegister(reg->local);
+    free(reg->exchange);
+    free(reg);
+}
+
+// Function to put the register back into |0...0> with the identity qubit layout
+void resetDistributedRegister(DistributedRegister* reg) {
+    for (int q = 0; q < reg->num_qubits; q++) {
+        reg->position[q] = q;
+        reg->logical[q] = q;
+    }
+    resetRegister(reg->local);
+    if (reg->rank != 0) {
+        reg->local->amplitudes[0] = 0.0;
+    }
+}
+
+// Function to get the rank bits of this process as a physical index mask
+static uint64_t rankBits(const DistributedRegister* reg) {
+    return (uint64_t)reg->rank << reg->local_qubits;
+}
+
+// Function to translate a mask of logical qubits into physical positions
+static uint64_t physicalMask(const DistributedRegister* reg, uint64_t logical_mask) {
+    uint64_t mask = 0;
+    while (logical_mask != 0) {
+        int q = __builtin_ctzll(logical_mask);
+        mask |= 1ULL << reg->position[q];
+        logical_mask &= logical_mask - 1;
+    }
+    return mask;
+}
+
+// Function to pack and stream the outgoing half to the partner, publishing how
+// much has been sent so the receiver knows which slots it may overwrite
+static void* sendHalf(void* arg) {
+    HalfSender* job = (HalfSender*)arg;
+    for (uint64_t start = 0; start < job->half; start += EXCHANGE_CHUNK) {
+        uint64_t len = job->half - start < EXCHANGE_CHUNK ? job->half - start : EXCHANGE_CHUNK;
+        for (uint64_t e = 0; e < len; e++) {
+            job->staging[start + e] = job->amp[insertZeroBits(start + e, job->lbit) | job->send_bit];
+        }
+        if (writeFully(job->fd, job->staging + start, len * sizeof(double complex)) != 0) {
+            job->failed = 1;
+            atomic_store(&job->sent, job->half);
+            return NULL;
+        }
+        atomic_store(&job->sent, start + len);
+    }
+    return NULL;
+}
+
+// Function to swap the logical qubits at global position global_pos and local
+// position local_pos. The partner rank differs only in that rank bit; each side
+// sends the half whose local bit disagrees with its own rank bit and receives the
+// partner's matching half in its place. If gate is not NULL it is applied to the
+// (now local) qubit at local_pos, overlapped with the transfer.
+static int swapIntoLocal(DistributedRegister* reg, int global_pos, int local_pos,
+                         double complex (*gate)[2], uint64_t local_controls) {
+    const int g = global_pos - reg->local_qubits;
+    const uint64_t lbit = 1ULL << local_pos;
+    const uint64_t my_bit = ((uint64_t)reg->rank >> g) & 1;
+    double complex* amp = reg->local->amplitudes;
+    const uint64_t half = reg->local->size >> 1;
+    double complex* incoming = reg->exchange + half;
+
+    HalfSender job;
+    job.fd = reg->peers[g];
+    job.amp = amp;
+    job.staging = reg->exchange;
+    job.lbit = lbit;
+    job.send_bit = my_bit ? 0 : lbit;
+    job.half = half;
+    atomic_init(&job.sent, 0);
+    job.failed = 0;
+
+    pthread_t sender;
+    if (pthread_create(&sender, NULL, sendHalf, &job) != 0) {
+        return -1;
+    }
+
+    int failed = 0;
+    for (uint64_t start = 0; start < half && !failed; start += EXCHANGE_CHUNK) {
+        uint64_t len = half - start < EXCHANGE_CHUNK ? half - start : EXCHANGE_CHUNK;
+        if (readFully(job.fd, incoming + start, len * sizeof(double complex)) != 0) {
+            failed = 1;
+            break;
+        }
+        while (atomic_load(&job.sent) < start + len) {
+            sched_yield();
+        }
+        const int64_t n = (int64_t)len;
+        #pragma omp parallel for schedule(static) if (len >= PARALLEL_THRESHOLD)
+        for (int64_t e = 0; e < n; e++) {
+            uint64_t i0 = insertZeroBits(start + (uint64_t)e, lbit);
+            amp[i0 | job.send_bit] = incoming[start + (uint64_t)e];
+            if (gate != NULL && (i0 & local_controls) == local_controls) {
+                double complex a0 = amp[i0];
+                double complex a1 = amp[i0 | lbit];
+                amp[i0] = gate[0][0] * a0 + gate[0][1] * a1;
+                amp[i0 | lbit] = gate[1][0] * a0 + gate[1][1] * a1;
+            }
+        }
+    }
+    pthread_join(sender, NULL);
+    if (failed || job.failed) {
+        fprintf(stderr, "Error: Rank %d lost its partner during a qubit swap.\n", reg->rank);
+        return -1;
+    }
+
+    int moved_in = reg->logical[global_pos];
+    int moved_out = reg->logical[local_pos];
+    reg->logical[local_pos] = moved_in;
+    reg->logical[global_pos] = moved_out;
+    reg->position[moved_in] = local_pos;
+    reg->position[moved_out] = global_pos;
+    return 0;
+}
+
+// Function to pick the highest local position outside the given physical mask
+static int freeLocalPosition(const DistributedRegister* reg, uint64_t busy) {
+    for (int p = reg->local_qubits - 1; p >= 0; p--) {
+        if (!(busy & (1ULL << p))) {
+            return p;
+        }
+    }
+    return -1;
+}
+
+// Function to apply a gate to the distributed register.
+//  - SWAP only relabels qubits, no data moves.
+//  - Diagonal gates never communicate: rank bits are known, so monomials over
+//    global positions reduce to phases on the local amplitudes.
+//  - Other gates on local targets run locally; high-order controls only decide
+//    whether this rank takes part.
+//  - A gate on a global target first swaps that qubit into a local position with
+//    the partner rank, applying the gate as each chunk arrives.
+// Every rank must call this with the same gates in the same order.
+int applyDistributedGate(DistributedRegister* reg, const Gate* gate, double parameter) {
+    const uint64_t local_mask = (1ULL << reg->local_qubits) - 1;
+    const uint64_t rank_bits = rankBits(reg);
+
+    if (gate->type == GATE_SWAP) {
+        int a = gate->targets[0], b = gate->targets[1];
+        int pa = reg->position[a], pb = reg->position[b];
+        reg->position[a] = pb;
+        reg->position[b] = pa;
+        reg->logical[pa] = b;
+        reg->logical[pb] = a;
+        return 0;
+    }
+
+    Gate phys = *gate;
+    phys.targets[0] = reg->position[gate->targets[0]];
+    if (isTwoQubitGate(gate->type)) {
+        phys.targets[1] = reg->position[gate->targets[1]];
+    }
+    phys.controls = physicalMask(reg, gate->controls);
+
+    if (isDiagonalGate(gate)) {
+        DiagonalLayer layer, local_layer;
+        initializeDiagonalLayer(&layer);
+        int status = addGateToDiagonalLayer(&layer, &phys, parameter);
+        if (status == 0) {
+            status = restrictDiagonalLayer(&layer, rank_bits, reg->local_qubits, &local_layer);
+        }
+        if (status == 0) {
+            status = applyDiagonalLayer(reg->local, &local_layer);
+            freeDiagonalLayer(&local_layer);
+        }
+        freeDiagonalLayer(&layer);
+        return status;
+    }
+
+    uint64_t high_controls = phys.controls & ~local_mask;
+    int active = (rank_bits & high_controls) == high_controls;
+    phys.controls &= local_mask;
+
+    if (phys.targets[0] < reg->local_qubits) {
+        if (active) {
+            applyGate(reg->local, &phys, parameter);
+        }
+        return 0;
+    }
+
+    int local_pos = freeLocalPosition(reg, phys.controls);
+    if (local_pos < 0) {
+        return -1;
+    }
+    double complex m[2][2];
+    singleQubitGateMatrix(gate->type, parameter, m);
+    return swapIntoLocal(reg, phys.targets[0], local_pos, active ? m : NULL, phys.controls);
+}
+
+// Function to run every gate of a circuit on the distributed register
+int applyDistributedCircuit(DistributedRegister* reg, const Circuit* circuit) {
+    for (int g = 0; g < circuit->num_gates; g++) {
+        const Gate* gate = &circuit->gates[g];
+        if (applyDistributedGate(reg, gate, gateParameter(circuit, gate)) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to sum count doubles over all ranks by recursive doubling along the
+// hypercube links. Every rank ends up with the totals.
+int allReduceSum(DistributedRegister* reg, double* values, int count) {
+    double* incoming = (double*)malloc((count + 1) * sizeof(double));
+    if (incoming == NULL) {
+        return -1;
+    }
+    for (int k = 0; k < reg->global_qubits; k++) {
+        size_t bytes = count * sizeof(double);
+        if (writeFully(reg->peers[k], values, bytes) != 0 ||
+            readFully(reg->peers[k], incoming, bytes) != 0) {
+            free(incoming);
+            return -1;
+        }
+        for (int i = 0; i < count; i++) {
+            values[i] += incoming[i];
+        }
+    }
+    free(incoming);
+    return 0;
+}
+
+// Function to compute the squared norm of the whole distributed state
+double distributedNorm(DistributedRegister* reg) {
+    double norm = registerNorm(reg->local);
+    allReduceSum(reg, &norm, 1);
+    return norm;
+}
+
+// Function to rewrite an observable for this rank's block: masks move to physical
+// positions and Z on a global position folds into the coefficient's sign.
+// Every X or Y must already be local. Returns 0 on success, -1 if out of memory.
+static int localizeObservable(const DistributedRegister* reg, const Observable* obs,
+                              uint64_t local_mask, Observable* local_obs) {
+    initializeObservable(local_obs);
+    for (int t = 0; t < obs->num_terms; t++) {
+        const PauliTerm* term = &obs->terms[t];
+        uint64_t z = physicalMask(reg, term->zmask);
+        int flip = __builtin_parityll(rankBits(reg) & z & ~local_mask);
+        if (addPauliTerm(local_obs, flip ? -term->coefficient : term->coefficient, "") != 0) {
+            return -1;
+        }
+        PauliTerm* local_term = &local_obs->terms[local_obs->num_terms - 1];
+        local_term->xmask = physicalMask(reg, term->xmask);
+        local_term->zmask = z & local_mask;
+    }
+    return 0;
+}
+
+// Function to evaluate observables on the distributed state. Qubits carrying X or
+// Y in any term are swapped into local positions first; Z on a global position is
+// then just a sign from the rank bits, so every rank runs one fused local sweep
+// and the partial sums are reduced.
+int computeDistributedExpectations(DistributedRegister* reg, const Observable* observables,
+                                   int num_observables, double* results) {
+    const uint64_t local_mask = (1ULL << reg->local_qubits) - 1;
+    uint64_t xsupport = 0;
+    for (int o = 0; o < num_observables; o++) {
+        for (int t = 0; t < observables[o].num_terms; t++) {
+            xsupport |= observables[o].terms[t].xmask;
+        }
+    }
+    if (__builtin_popcountll(xsupport) > reg->local_qubits) {
+        return -1;
+    }
+
+    uint64_t xphys = physicalMask(reg, xsupport);
+    while ((xphys & ~local_mask) != 0) {
+        int global_pos = __builtin_ctzll(xphys & ~local_mask);
+        int local_pos = freeLocalPosition(reg, xphys);
+        if (swapIntoLocal(reg, global_pos, local_pos, NULL, 0) != 0) {
+            return -1;
+        }
+        xphys = physicalMask(reg, xsupport);
+    }
+
+    // calloc leaves every observable empty, so all of them can be freed on any path
+    Observable* local_obs = (Observable*)calloc(num_observables + 1, sizeof(Observable));
+    if (local_obs == NULL) {
+        return -1;
+    }
+    int status = 0;
+    for (int o = 0; o < num_observables && status == 0; o++) {
+        status = localizeObservable(reg, &observables[o], local_mask, &local_obs[o]);
+    }
+    if (status == 0) {
+        status = computeExpectations(reg->local, local_obs, num_observables, results);
+    }
+    for (int o = 0; o < num_observables; o++) {
+        freeObservable(&local_obs[o]);
+    }
+    free(local_obs);
+    if (status != 0) {
+        return -1;
+    }
+    return allReduceSum(reg, results, num_observables);
+}
+
+// Function to collect the full state on rank 0, in logical qubit order.
+// Blocks are merged along the hypercube; out is only written on rank 0 and must
+// have num_qubits qubits there (other ranks may pass NULL).
+int gatherDistributedRegister(DistributedRegister* reg, QubitRegister* out) {
+    const uint64_t local_size = reg->local->size;
+    int steps = reg->rank == 0 ? reg->global_qubits : __builtin_ctz((unsigned)reg->rank);
+    double complex* block = (double complex*)malloc((local_size << steps) * sizeof(double complex));
+    if (block == NULL) {
+        return -1;
+    }
+    memcpy(block, reg->local->amplitudes, local_size * sizeof(double complex));
+
+    uint64_t have = local_size;
+    for (int k = 0; k < reg->global_qubits; k++) {
+        int status;
+        if (reg->rank & (1 << k)) {
+            status = writeFully(reg->peers[k], block, have * sizeof(double complex));
+            free(block);
+            return status;
+        }
+        status = readFully(reg->peers[k], block + have, have * sizeof(double complex));
+        if (status != 0) {
+            free(block);
+            return -1;
+        }
+        have *= 2;
+    }
+
+    // Physical index -> logical index
+    const int64_t size = (int64_t)out->size;
+    #pragma omp parallel for schedule(static) if (out->size >= PARALLEL_THRESHOLD)
+    for (int64_t p = 0; p < size; p++) {
+        uint64_t index = 0;
+        for (int b = 0; b < reg->num_qubits; b++) {
+            index |= (((uint64_t)p >> b) & 1) << reg->logical[b];
+        }
+        out->amplitudes[index] = block[p];
+    }
+    free(block);
+    return 0;
+}
+
+// Function to start num_ranks processes on this machine, connected pairwise by
+// Unix socket pairs along the hypercube, and run rank_main in each. The caller
+// becomes rank 0. Call before any OpenMP region has started in this process.
+int launchLocalRanks(int num_ranks, int (*rank_main)(int rank, int num_ranks, const int* peer_fds, void* arg),
+                     void* arg) {
+    if (num_ranks < 1 || (num_ranks & (num_ranks - 1)) != 0) {
+        return -1;
+    }
+    int dims = __builtin_ctz((unsigned)num_ranks);
+    int* fds = (int*)malloc((size_t)num_ranks * 64 * sizeof(int));
+    pid_t* children = (pid_t*)malloc((size_t)num_ranks * sizeof(pid_t));
+    if (fds == NULL || children == NULL) {
+        free(fds);
+        free(children);
+        return -1;
+    }
+
+    for (int i = 0; i < num_ranks * 64; i++) {
+        fds[i] = -1;
+    }
+    for (int r = 0; r < num_ranks; r++) {
+        for (int k = 0; k < dims; k++) {
+            int partner = r ^ (1 << k);
+            if (r < partner) {
+                int pair[2];
+                if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+                    // Close the pairs already opened
+                    for (int i = 0; i < num_ranks * 64; i++) {
+                        if (fds[i] >= 0) {
+                            close(fds[i]);
+                        }
+                    }
+                    free(fds);
+                    free(children);
+                    return -1;
+                }
+                fds[r * 64 + k] = pair[0];
+                fds[partner * 64 + k] = pair[1];
+            }
+        }
+    }
+
+    for (int r = 1; r < num_ranks; r++) {
+        children[r] = fork();
+        if (children[r] == 0) {
+            for (int other = 0; other < num_ranks; other++) {
+                for (int k = 0; k < dims && other != r; k++) {
+                    close(fds[other * 64 + k]);
+                }
+            }
+            int status = rank_main(r, num_ranks, &fds[r * 64], arg);
+            _exit(status == 0 ? 0 : 1);
+        }
+    }
+    for (int other = 1; other < num_ranks; other++) {
+        for (int k = 0; k < dims; k++) {
+            close(fds[other * 64 + k]);
+        }
+    }
+
+    int result = rank_main(0, num_ranks, &fds[0], arg);
+    for (int r = 1; r < num_ranks; r++) {
+        int status = 0;
+        if (children[r] < 0 || waitpid(children[r], &status, 0) < 0 ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            result = -1;
+        }
+    }
+    for (int k = 0; k < dims; k++) {
+        close(fds[k]);
+    }
+    free(fds);
+    free(children);
+    return result;
+}
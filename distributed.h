@@ -0,0 +1,45 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <stdint.h>
+#include "statevector.h"
+#include "circuit.h"
+#include "expectation.h"
+
+// Amplitudes per message while exchanging halves with a partner rank
+#define EXCHANGE_CHUNK (1ULL << 16)
+
+// State vector split across num_ranks processes (a power of two).
+// Physical positions below local_qubits index the local amplitudes; the rest are
+// the rank bits. Logical qubits move between positions through pairwise swaps.
+typedef struct {
+    int rank;
+    int num_ranks;
+    int num_qubits;
+    int local_qubits;
+    int global_qubits;
+    QubitRegister* local;
+    double complex* exchange;   // Staging for one outgoing and one incoming half
+    int peers[64];              // peers[k] is a stream socket to rank ^ (1 << k)
+    int position[64];           // Logical qubit -> physical position
+    int logical[64];            // Physical position -> logical qubit
+} DistributedRegister;
+
+DistributedRegister* initializeDistributedRegister(int num_qubits, int rank, int num_ranks, const int* peer_fds);
+void freeDistributedRegister(DistributedRegister* reg);
+void resetDistributedRegister(DistributedRegister* reg);
+
+int applyDistributedGate(DistributedRegister* reg, const Gate* gate, double parameter);
+int applyDistributedCircuit(DistributedRegister* reg, const Circuit* circuit);
+int allReduceSum(DistributedRegister* reg, double* values, int count);
+double distributedNorm(DistributedRegister* reg);
+int computeDistributedExpectations(DistributedRegister* reg, const Observable* observables,
+                                   int num_observables, double* results);
+int gatherDistributedRegister(DistributedRegister* reg, QubitRegister* out);
+
+// Fork num_ranks - 1 children wired as a hypercube of Unix socket pairs and run
+// rank_main in every rank. Returns 0 if every rank returned 0.
+int launchLocalRanks(int num_ranks, int (*rank_main)(int rank, int num_ranks, const int* peer_fds, void* arg),
+                     void* arg);
+
+#endif
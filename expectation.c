@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+#include "expectation.h"
+#include "instrument.h"
+
+// Amplitudes per tile of the fused sweep; a tile and its probabilities stay in L1
+#define EXPECTATION_TILE 1024
+
+// Function to initialize an empty observable
+void initializeObservable(Observable* obs) {
+    obs->num_terms = 0;
+    obs->capacity = 0;
+    obs->terms = NULL;
+}
+
+// Function to free memory allocated for an observable
+void freeObservable(Observable* obs) {
+    free(obs->terms);
+    initializeObservable(obs);
+}
+
+// Function to append a term such as "Z0 Z1" or "X2 Y5" to an observable.
+// An empty string or "I" is the identity. Returns 0 on success, -1 on bad input.
+int addPauliTerm(Observable* obs, double coefficient, const char* paulis) {
+    PauliTerm term = { coefficient, 0, 0 };
+    const char* p = paulis;
+
+    while (*p != '\0') {
+        if (isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+        char op = (char)toupper((unsigned char)*p++);
+        if (op == 'I' && !isdigit((unsigned char)*p)) {
+            continue;
+        }
+        if (!isdigit((unsigned char)*p)) {
+            return -1;
+        }
+        int qubit = 0;
+        while (isdigit((unsigned char)*p)) {
+            qubit = qubit * 10 + (*p++ - '0');
+            if (qubit > 63) {
+                return -1;
+            }
+        }
+        uint64_t bit = 1ULL << qubit;
+        if ((term.xmask | term.zmask) & bit) {
+            return -1; // Same qubit named twice
+        }
+        switch (op) {
+            case 'I': break;
+            case 'X': term.xmask |= bit; break;
+            case 'Y': term.xmask |= bit; term.zmask |= bit; break;
+            case 'Z': term.zmask |= bit; break;
+            default: return -1;
+        }
+    }
+
+    if (obs->num_terms == obs->capacity) {
+        int capacity = obs->capacity ? obs->capacity * 2 : 8;
+        PauliTerm* terms = (PauliTerm*)realloc(obs->terms, capacity * sizeof(PauliTerm));
+        if (terms == NULL) {
+            return -1;
+        }
+        obs->terms = terms;
+        obs->capacity = capacity;
+    }
+    obs->terms[obs->num_terms++] = term;
+    return 0;
+}
+
+// Function to find or insert a Pauli string in the list of distinct strings
+static int internPauliString(uint64_t* xs, uint64_t* zs, int* count, uint64_t x, uint64_t z) {
+    for (int u = 0; u < *count; u++) {
+        if (xs[u] == x && zs[u] == z) {
+            return u;
+        }
+    }
+    xs[*count] = x;
+    zs[*count] = z;
+    return (*count)++;
+}
+
+// Function to accumulate the diagonal (Z-only) strings over one tile.
+// Sign of each probability is the parity of the basis index under zmask.
+static void accumulateDiagonalTile(const double complex* amp, uint64_t base, int len,
+                                   const uint64_t* zs, int num_diag, double complex* acc) {
+    double prob[EXPECTATION_TILE];
+    for (int j = 0; j < len; j++) {
+        double re = creal(amp[base + j]);
+        double im = cimag(amp[base + j]);
+        prob[j] = re * re + im * im;
+    }
+    for (int d = 0; d < num_diag; d++) {
+        uint64_t zlow = zs[d] & (EXPECTATION_TILE - 1);
+        double s = 0.0;
+        for (int j = 0; j < len; j++) {
+            double sign = 1.0 - 2.0 * (double)__builtin_parityll((uint64_t)j & zlow);
+            s += sign * prob[j];
+        }
+        acc[d] += __builtin_parityll(base & zs[d]) ? -s : s;
+    }
+}
+
+// Function to accumulate sum_j (-1)^|j & z| conj(psi[j ^ x]) psi[j] over one tile
+static void accumulateOffDiagonalTile(const double complex* amp, uint64_t base, int len,
+                                      const uint64_t* xs, const uint64_t* zs, int count,
+                                      double complex* acc) {
+    for (int t = 0; t < count; t++) {
+        const uint64_t x = xs[t];
+        const uint64_t z = zs[t];
+        double re = 0.0, im = 0.0;
+        for (int j = 0; j < len; j++) {
+            uint64_t idx = base + (uint64_t)j;
+            double complex a = amp[idx];
+            double complex b = amp[idx ^ x];
+            double sign = 1.0 - 2.0 * (double)__builtin_parityll(idx & z);
+            // conj(b) * a, written out so it vectorizes without a complex multiply call
+            re += sign * (creal(b) * creal(a) + cimag(b) * cimag(a));
+            im += sign * (creal(b) * cimag(a) - cimag(b) * creal(a));
+        }
+        acc[t] += re + im * I;
+    }
+}
+
+// Function to check that every term of an observable acts inside the register
+static int observableFits(const Observable* obs, int num_qubits) {
+    for (int t = 0; t < obs->num_terms; t++) {
+        if ((obs->terms[t].xmask | obs->terms[t].zmask) >> num_qubits != 0) {
+            fprintf(stderr, "Error: Pauli term acts on a qubit outside the %d-qubit register\n", num_qubits);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Function to evaluate several observables with one fused pass over the register.
+// Distinct Pauli strings are shared between observables, so "Z0 Z1" that appears
+// in ten observables is reduced once. Returns 0 on success, -1 if a term names a
+// qubit outside the register or memory runs out.
+int computeExpectations(const QubitRegister* reg, const Observable* observables,
+                        int num_observables, double* results) {
+    INSTRUMENT_SCOPE("computeExpectations");
+    int total = 0;
+    for (int o = 0; o < num_observables; o++) {
+        if (!observableFits(&observables[o], reg->num_qubits)) {
+            return -1;
+        }
+        total += observables[o].num_terms;
+    }
+    if (total == 0) {
+        for (int o = 0; o < num_observables; o++) {
+            results[o] = 0.0;
+        }
+        return 0;
+    }
+
+    // Diagonal strings go to the front of the distinct list, off-diagonal after
+    uint64_t* xs = (uint64_t*)malloc(2 * total * sizeof(uint64_t));
+    uint64_t* zs = (uint64_t*)malloc(2 * total * sizeof(uint64_t));
+    int* slot = (int*)malloc(total * sizeof(int));
+    double complex* sums = (double complex*)calloc(2 * total, sizeof(double complex));
+    if (xs == NULL || zs == NULL || slot == NULL || sums == NULL) {
+        free(xs);
+        free(zs);
+        free(slot);
+        free(sums);
+        return -1;
+    }
+    uint64_t* diag_z = zs;
+    uint64_t* off_x = xs + total;
+    uint64_t* off_z = zs + total;
+    int num_diag = 0, num_off = 0;
+
+    for (int o = 0, n = 0; o < num_observables; o++) {
+        for (int t = 0; t < observables[o].num_terms; t++, n++) {
+            const PauliTerm* term = &observables[o].terms[t];
+            if (term->xmask == 0) {
+                slot[n] = internPauliString(xs, diag_z, &num_diag, 0, term->zmask);
+            } else {
+                slot[n] = total + internPauliString(off_x, off_z, &num_off, term->xmask, term->zmask);
+            }
+        }
+    }
+
+    const double complex* amp = reg->amplitudes;
+    const int64_t num_tiles = (int64_t)((reg->size + EXPECTATION_TILE - 1) / EXPECTATION_TILE);
+    const int tile_len = reg->size < EXPECTATION_TILE ? (int)reg->size : EXPECTATION_TILE;
+    int failed = 0;
+
+    #pragma omp parallel if (reg->size >= PARALLEL_THRESHOLD)
+    {
+        double complex* acc = (double complex*)calloc(num_diag + num_off + 1, sizeof(double complex));
+        if (acc == NULL) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        // Every thread still reaches the worksharing loop; one without
+        // accumulators skips its tiles and the call reports failure
+        #pragma omp for schedule(static)
+        for (int64_t tile = 0; tile < num_tiles; tile++) {
+            if (acc == NULL) {
+                continue;
+            }
+            uint64_t base = (uint64_t)tile * EXPECTATION_TILE;
+            accumulateDiagonalTile(amp, base, tile_len, diag_z, num_diag, acc);
+            accumulateOffDiagonalTile(amp, base, tile_len, off_x, off_z, num_off, acc + num_diag);
+        }
+
+        #pragma omp critical
+        if (acc != NULL) {
+            for (int d = 0; d < num_diag; d++) {
+                sums[d] += acc[d];
+            }
+            for (int t = 0; t < num_off; t++) {
+                sums[total + t] += acc[num_diag + t];
+            }
+        }
+        free(acc);
+    }
+
+    if (failed) {
+        free(xs);
+        free(zs);
+        free(slot);
+        free(sums);
+        return -1;
+    }
+
+    // Apply the i^(#Y) phase of each string, then combine with the weights
+    for (int o = 0, n = 0; o < num_observables; o++) {
+        double value = 0.0;
+        for (int t = 0; t < observables[o].num_terms; t++, n++) {
+            const PauliTerm* term = &observables[o].terms[t];
+            double complex s = sums[slot[n]];
+            double re;
+            switch (__builtin_popcountll(term->xmask & term->zmask) & 3) {
+                case 0: re = creal(s); break;
+                case 1: re = -cimag(s); break;
+                case 2: re = -creal(s); break;
+                default: re = cimag(s); break;
+            }
+            value += term->coefficient * re;
+        }
+        results[o] = value;
+    }
+
+    free(xs);
+    free(zs);
+    free(slot);
+    free(sums);
+    return 0;
+}
+
+// Function to evaluate a single observable. Returns NAN on error.
+double computeExpectation(const QubitRegister* reg, const Observable* obs) {
+    double result;
+    if (computeExpectations(reg, obs, 1, &result) != 0) {
+        return NAN;
+    }
+    return result;
+}
+
+// Function to compute out = O |in> in one gather sweep over the output amplitudes.
+// P|j> = i^(#Y) (-1)^|j & z| |j ^ x>, so out[k] collects in[k ^ x] from every term.
+// Returns 0 on success, -1 if a term names a qubit outside the register or
+// memory runs out.
+int applyObservable(QubitRegister* out, const QubitRegister* in, const Observable* obs) {
+    if (!observableFits(obs, in->num_qubits)) {
+        return -1;
+    }
+    double complex* dst = out->amplitudes;
+    const double complex* src = in->amplitudes;
+    const int64_t size = (int64_t)in->size;
+    const int num_terms = obs->num_terms;
+    double complex* weights = (double complex*)malloc((num_terms + 1) * sizeof(double complex));
+    const double complex phases[4] = { 1, I, -1, -I };
+    if (weights == NULL) {
+        return -1;
+    }
+
+    for (int t = 0; t < num_terms; t++) {
+        const PauliTerm* term = &obs->terms[t];
+        weights[t] = term->coefficient * phases[__builtin_popcountll(term->xmask & term->zmask) & 3];
+    }
+
+    #pragma omp parallel for schedule(static) if (in->size >= PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < size; k++) {
+        double complex sum = 0.0;
+        for (int t = 0; t < num_terms; t++) {
+            uint64_t j = (uint64_t)k ^ obs->terms[t].xmask;
+            double complex w = __builtin_parityll(j & obs->terms[t].zmask) ? -weights[t] : weights[t];
+            sum += w * src[j];
+        }
+        dst[k] = sum;
+    }
+    free(weights);
+    return 0;
+}
+
+// Function to compute <O> and all parameter gradients by adjoint differentiation.
+// One forward pass builds |psi>, then psi and lambda = O|psi> are walked back
+// through the inverse gates together; each parameterized gate contributes
+// 2 Re <lambda| dU |psi> from a fused overlap, so no third buffer is needed.
+// Returns 0 on success, -1 if the observable does not fit the circuit or the
+// state buffers cannot be allocated.
+int computeAdjointGradients(const Circuit* circuit, const Observable* obs,
+                            double* expectation, double* gradients) {
+    QubitRegister* psi = initializeRegister(circuit->num_qubits);
+    QubitRegister* lambda = initializeRegister(circuit->num_qubits);
+    if (psi == NULL || lambda == NULL) {
+        freeRegister(psi);
+        freeRegister(lambda);
+        return -1;
+    }
+
+    applyCircuit(psi, circuit);
+    if (applyObservable(lambda, psi, obs) != 0) {
+        freeRegister(psi);
+        freeRegister(lambda);
+        return -1;
+    }
+    *expectation = creal(innerProduct(psi, lambda));
+
+    for (int p = 0; p < circuit->num_params; p++) {
+        gradients[p] = 0.0;
+    }
+
+    for (int g = circuit->num_gates - 1; g >= 0; g--) {
+        const Gate* gate = &circuit->gates[g];
+        double parameter = gateParameter(circuit, gate);
+
+        // psi becomes the state just before gate g
+        applyGateInverse(psi, gate, parameter);
+        if (gate->param_index >= 0) {
+            double complex overlap = gateDerivativeOverlap(lambda, psi, gate, parameter);
+            gradients[gate->param_index] += 2.0 * creal(overlap);
+        }
+        if (g > 0) {
+            applyGateInverse(lambda, gate, parameter);
+        }
+    }
+
+    freeRegister(psi);
+    freeRegister(lambda);
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef EXPECTATION_H
+#define EXPECTATION_H
+
+#include <stdint.h>
+#include "statevector.h"
+#include "circuit.h"
+
+// One weighted Pauli string. Bit k of xmask is set for X or Y on qubit k,
+// bit k of zmask for Z or Y, so the string is i^(#Y) X^xmask Z^zmask.
+typedef struct {
+    double coefficient;
+    uint64_t xmask;
+    uint64_t zmask;
+} PauliTerm;
+
+// Weighted sum of Pauli strings, e.g. 0.5 Z0 Z1 + 0.25 X2
+typedef struct {
+    int num_terms;
+    int capacity;
+    PauliTerm* terms;
+} Observable;
+
+void initializeObservable(Observable* obs);
+void freeObservable(Observable* obs);
+int addPauliTerm(Observable* obs, double coefficient, const char* paulis);
+
+// Evaluate <psi|O|psi> for every observable in a single sweep over the register
+int computeExpectations(const QubitRegister* reg, const Observable* observables,
+                        int num_observables, double* results);
+double computeExpectation(const QubitRegister* reg, const Observable* obs);
+
+// out = O |in>, for a weighted sum of Pauli strings O
+int applyObservable(QubitRegister* out, const QubitRegister* in, const Observable* obs);
+
+// Adjoint differentiation: <O> after running the circuit from |0...0>, and
+// d<O>/d params[p] for every circuit parameter, using two state buffers
+int computeAdjointGradients(const Circuit* circuit, const Observable* obs,
+                            double* expectation, double* gradients);
+
+#endif
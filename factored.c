@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "factored.h"
+#include "instrument.h"
+
+// What a task of the circuit's graph needs: its gates, in circuit order
+typedef struct {
+    FactoredState* state;
+    const Circuit* circuit;
+    const int* first_gate;      // Gates of task t are gate_list[first_gate[t] .. first_gate[t + 1]]
+    const int* gate_list;
+    _Atomic int failed;
+} FactoredRun;
+
+// Function to get the qubits a gate acts on, controls included
+static uint64_t gateQubits(const Gate* gate) {
+    uint64_t qubits = gate->controls | (1ULL << gate->targets[0]);
+    if (isTwoQubitGate(gate->type)) {
+        qubits |= 1ULL << gate->targets[1];
+    }
+    return qubits;
+}
+
+// Function to get the local bit of a global qubit within a cluster's qubits
+static int localQubit(uint64_t qubits, int q) {
+    return __builtin_popcountll(qubits & ((1ULL << q) - 1));
+}
+
+// Function to allocate a cluster of one qubit in |0>
+static QubitCluster* initializeCluster(int q) {
+    QubitCluster* cluster = (QubitCluster*)malloc(sizeof(QubitCluster));
+    if (cluster == NULL) {
+        return NULL;
+    }
+    cluster->qubits = 1ULL << q;
+    cluster->reg = initializeRegister(1);
+    if (cluster->reg == NULL) {
+        free(cluster);
+        return NULL;
+    }
+    return cluster;
+}
+
+static void freeCluster(QubitCluster* cluster) {
+    if (cluster != NULL) {
+        freeRegister(cluster->reg);
+        free(cluster);
+    }
+}
+
+// Function to allocate a product state of num_qubits qubits, all in |0>
+FactoredState* initializeFactoredState(int num_qubits) {
+    if (num_qubits < 1 || num_qubits > 64) {
+        fprintf(stderr, "Error: A factored state holds 1 to 64 qubits, not %d.\n", num_qubits);
+        return NULL;
+    }
+    FactoredState* state = (FactoredState*)calloc(1, sizeof(FactoredState));
+    if (state == NULL) {
+        return NULL;
+    }
+    state->num_qubits = num_qubits;
+    for (int q = 0; q < num_qubits; q++) {
+        state->cluster[q] = initializeCluster(q);
+        if (state->cluster[q] == NULL) {
+            fprintf(stderr, "Error: Out of memory for qubit %d.\n", q);
+            freeFactoredState(state);
+            return NULL;
+        }
+    }
+    return state;
+}
+
+// Function to free a factored state and every cluster in it
+void freeFactoredState(FactoredState* state) {
+    if (state == NULL) {
+        return;
+    }
+    // Each cluster is freed through its lowest qubit, reached after its others
+    for (int q = state->num_qubits - 1; q >= 0; q--) {
+        QubitCluster* cluster = state->cluster[q];
+        if (cluster != NULL && __builtin_ctzll(cluster->qubits) == q) {
+            freeCluster(cluster);
+        }
+    }
+    free(state);
+}
+
+// Function to count the clusters of a factored state
+int factoredClusters(const FactoredState* state) {
+    int count = 0;
+    for (int q = 0; q < state->num_qubits; q++) {
+        count += __builtin_ctzll(state->cluster[q]->qubits) == q;
+    }
+    return count;
+}
+
+// Function to list, for every index of a register on qubits, the index of the
+// same basis state in a register on the larger set of qubits outer
+static void depositTable(uint64_t* table, uint64_t qubits, uint64_t outer) {
+    uint64_t bits[64];
+    int count = 0;
+    for (uint64_t rest = qubits; rest != 0; rest &= rest - 1) {
+        bits[count++] = 1ULL << localQubit(outer, __builtin_ctzll(rest));
+    }
+    table[0] = 0;
+    for (uint64_t i = 1; i < (1ULL << count); i++) {
+        table[i] = table[i & (i - 1)] | bits[__builtin_ctzll(i)];
+    }
+}
+
+// Function to form the tensor product of two registers on disjoint qubits as a
+// register on their union. Returns NULL on allocation failure.
+static QubitRegister* tensorRegisters(const QubitRegister* a, uint64_t a_qubits,
+                                      const QubitRegister* b, uint64_t b_qubits) {
+    const uint64_t qubits = a_qubits | b_qubits;
+    QubitRegister* reg = initializeRegister(__builtin_popcountll(qubits));
+    uint64_t* a_index = (uint64_t*)malloc(a->size * sizeof(uint64_t));
+    uint64_t* b_index = (uint64_t*)malloc(b->size * sizeof(uint64_t));
+    if (reg == NULL || a_index == NULL || b_index == NULL) {
+        freeRegister(reg);
+        free(a_index);
+        free(b_index);
+        return NULL;
+    }
+    depositTable(a_index, a_qubits, qubits);
+    depositTable(b_index, b_qubits, qubits);
+
+    double complex* amp = reg->amplitudes;
+    const int64_t b_size = (int64_t)b->size;
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t j = 0; j < b_size; j++) {
+        const double complex bj = b->amplitudes[j];
+        for (uint64_t i = 0; i < a->size; i++) {
+            amp[a_index[i] | b_index[j]] = a->amplitudes[i] * bj;
+        }
+    }
+    INSTRUMENT_COUNT(COUNTER_AMPLITUDES, reg->size);
+    free(a_index);
+    free(b_index);
+    return reg;
+}
+
+// Function to replace two clusters of a state by their tensor product.
+// Returns the merged cluster, or NULL on allocation failure (state unchanged).
+static QubitCluster* mergeClusters(FactoredState* state, QubitCluster* a, QubitCluster* b) {
+    QubitCluster* merged = (QubitCluster*)malloc(sizeof(QubitCluster));
+    if (merged == NULL) {
+        return NULL;
+    }
+    merged->qubits = a->qubits | b->qubits;
+    merged->reg = tensorRegisters(a->reg, a->qubits, b->reg, b->qubits);
+    if (merged->reg == NULL) {
+        fprintf(stderr, "Error: Out of memory merging %d qubits.\n", __builtin_popcountll(merged->qubits));
+        free(merged);
+        return NULL;
+    }
+    for (uint64_t rest = merged->qubits; rest != 0; rest &= rest - 1) {
+        state->cluster[__builtin_ctzll(rest)] = merged;
+    }
+    freeCluster(a);
+    freeCluster(b);
+    return merged;
+}
+
+// Function to run one task: merge the clusters its first gate spans, then apply
+// its gates on the merged cluster's local qubits. The task graph guarantees no
+// other task touches these clusters meanwhile.
+static void runFactoredTask(void* context, int task, int worker) {
+    FactoredRun* run = (FactoredRun*)context;
+    FactoredState* state = run->state;
+    (void)worker;
+    if (atomic_load_explicit(&run->failed, memory_order_relaxed)) {
+        return;
+    }
+
+    for (int i = run->first_gate[task]; i < run->first_gate[task + 1]; i++) {
+        const Gate* gate = &run->circuit->gates[run->gate_list[i]];
+        const uint64_t touched = gateQubits(gate);
+        QubitCluster* cluster = state->cluster[__builtin_ctzll(touched)];
+        for (uint64_t rest = touched & ~cluster->qubits; rest != 0; rest &= ~cluster->qubits) {
+            cluster = mergeClusters(state, cluster, state->cluster[__builtin_ctzll(rest)]);
+            if (cluster == NULL) {
+                atomic_store_explicit(&run->failed, 1, memory_order_relaxed);
+                return;
+            }
+        }
+
+        Gate local = *gate;
+        local.param_index = -1;
+        local.targets[0] = localQubit(cluster->qubits, gate->targets[0]);
+        if (isTwoQubitGate(gate->type)) {
+            local.targets[1] = localQubit(cluster->qubits, gate->targets[1]);
+        }
+        local.controls = 0;
+        for (uint64_t rest = gate->controls; rest != 0; rest &= rest - 1) {
+            local.controls |= 1ULL << localQubit(cluster->qubits, __builtin_ctzll(rest));
+        }
+        applyGate(cluster->reg, &local, gateParameter(run->circuit, gate));
+    }
+}
+
+// Function to run a circuit on a factored state. Gates are grouped into tasks:
+// consecutive gates on the same cluster share a task, and a gate that spans
+// clusters starts a new one over their union. The tasks then run on a task graph
+// over the qubits with num_workers workers (0 for the OpenMP default), and
+// stats, if not NULL, receives the executor's counts. Returns 0, or -1 on
+// failure, in which case the state is only partly updated.
+int applyCircuitFactored(FactoredState* state, const Circuit* circuit, int num_workers, TaskStats* stats) {
+    INSTRUMENT_SCOPE("applyCircuitFactored");
+    if (circuit->num_qubits > state->num_qubits) {
+        fprintf(stderr, "Error: Circuit on %d qubits does not fit a %d-qubit state.\n",
+                circuit->num_qubits, state->num_qubits);
+        return -1;
+    }
+    const int num_gates = circuit->num_gates;
+    uint64_t* resources = (uint64_t*)malloc(((size_t)num_gates + 1) * sizeof(uint64_t));
+    int* task_of = (int*)malloc(((size_t)num_gates + 1) * sizeof(int));
+    int* first_gate = (int*)calloc((size_t)num_gates + 2, sizeof(int));
+    int* gate_list = (int*)malloc(((size_t)num_gates + 1) * sizeof(int));
+    if (resources == NULL || task_of == NULL || first_gate == NULL || gate_list == NULL) {
+        fprintf(stderr, "Error: Out of memory planning %d gates.\n", num_gates);
+        free(resources);
+        free(task_of);
+        free(first_gate);
+        free(gate_list);
+        return -1;
+    }
+
+    // Follow the clusters through the circuit without touching amplitudes. A
+    // gate joins the open task of its cluster, which nothing has depended on
+    // yet since any later use of these qubits would have become their last task.
+    uint64_t group[64];
+    int last[64];
+    for (int q = 0; q < state->num_qubits; q++) {
+        group[q] = state->cluster[q]->qubits;
+        last[q] = -1;
+    }
+    int num_tasks = 0;
+    for (int g = 0; g < num_gates; g++) {
+        const uint64_t touched = gateQubits(&circuit->gates[g]);
+        uint64_t qubits = 0;
+        for (uint64_t rest = touched; rest != 0; rest &= rest - 1) {
+            qubits |= group[__builtin_ctzll(rest)];
+        }
+        const int low = __builtin_ctzll(qubits);
+        if (last[low] >= 0 && resources[last[low]] == qubits) {
+            task_of[g] = last[low];
+        } else {
+            task_of[g] = num_tasks;
+            resources[num_tasks++] = qubits;
+        }
+        for (uint64_t rest = qubits; rest != 0; rest &= rest - 1) {
+            group[__builtin_ctzll(rest)] = qubits;
+            last[__builtin_ctzll(rest)] = task_of[g];
+        }
+        first_gate[task_of[g] + 1]++;
+    }
+    for (int t = 0; t < num_tasks; t++) {
+        first_gate[t + 1] += first_gate[t];
+    }
+    for (int g = 0; g < num_gates; g++) {
+        gate_list[first_gate[task_of[g]]++] = g;
+    }
+    // Filling advanced every start to the next task's; shift them back
+    memmove(first_gate + 1, first_gate, (size_t)num_tasks * sizeof(int));
+    first_gate[0] = 0;
+    free(task_of);
+
+    TaskGraph graph;
+    int status = buildTaskGraph(&graph, resources, num_tasks);
+    free(resources);
+    if (status == 0) {
+        FactoredRun run = { state, circuit, first_gate, gate_list, 0 };
+        status = runTaskGraph(&graph, runFactoredTask, &run, num_workers, stats);
+        if (status == 0 && atomic_load(&run.failed)) {
+            status = -1;
+        }
+        freeTaskGraph(&graph);
+    }
+    free(first_gate);
+    free(gate_list);
+    return status;
+}
+
+// Function to expand a factored state into the full dense register.
+// Returns NULL if the state is too wide or memory runs out.
+QubitRegister* expandFactoredState(const FactoredState* state) {
+    QubitRegister* reg = NULL;
+    uint64_t qubits = 0;
+    for (int q = 0; q < state->num_qubits; q++) {
+        const QubitCluster* cluster = state->cluster[q];
+        if (__builtin_ctzll(cluster->qubits) != q) {
+            continue;
+        }
+        QubitRegister* next;
+        if (reg == NULL) {
+            next = initializeRegister(cluster->reg->num_qubits);
+            if (next != NULL) {
+                copyRegister(next, cluster->reg);
+            }
+        } else {
+            next = tensorRegisters(reg, qubits, cluster->reg, cluster->qubits);
+        }
+        freeRegister(reg);
+        reg = next;
+        if (reg == NULL) {
+            fprintf(stderr, "Error: Cannot expand a factored state of %d qubits.\n", state->num_qubits);
+            return NULL;
+        }
+        qubits |= cluster->qubits;
+    }
+    return reg;
+}
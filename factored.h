@@ -0,0 +1,32 @@
+#ifndef FACTORED_H
+#define FACTORED_H
+
+#include <stdint.h>
+#include "statevector.h"
+#include "circuit.h"
+#include "taskgraph.h"
+
+// Clustered product-state simulation. Every qubit starts in its own one-qubit
+// register; a gate that spans several clusters first replaces them by their
+// tensor product. A cluster's local bit j is the j-th lowest global qubit it
+// holds. Runs of gates on one cluster become one task of a task graph whose
+// resources are the qubits, so gate chains on different clusters run on
+// different cores and only merges wait for more than one chain.
+
+typedef struct {
+    uint64_t qubits;            // Global qubits held, as a bitmask
+    QubitRegister* reg;
+} QubitCluster;
+
+typedef struct {
+    int num_qubits;
+    QubitCluster* cluster[64];  // Cluster holding each qubit
+} FactoredState;
+
+FactoredState* initializeFactoredState(int num_qubits);
+void freeFactoredState(FactoredState* state);
+int applyCircuitFactored(FactoredState* state, const Circuit* circuit, int num_workers, TaskStats* stats);
+int factoredClusters(const FactoredState* state);
+QubitRegister* expandFactoredState(const FactoredState* state);
+
+#endif
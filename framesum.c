@@ -0,0 +1,427 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "framesum.h"
+#include "instrument.h"
+
+// Pixels per accumulator chunk; a chunk's partial sums stay in L1 for a whole block
+#define FRAME_CHUNK 4096
+// Frames with fewer pixels are accumulated on one thread
+#define FRAME_PARALLEL_PIXELS (1 << 16)
+// Bytes of frames buffered per block when reading from a pipe
+#define FRAME_READ_BUFFER (64 << 20)
+// Longest Y4M stream or frame header accepted
+#define FRAME_HEADER_MAX 1024
+#define Y4M_MAGIC "YUV4MPEG2"
+
+// Source of frame bytes: the whole file mapped, or a buffer refilled by read()
+typedef struct {
+    int fd;
+    int mapped;
+    uint8_t* data;
+    size_t length;     // Valid bytes in data
+    size_t offset;     // Next unread byte
+    size_t capacity;   // Buffer size when reading
+    size_t released;   // Mapped bytes already dropped from the page cache
+    int eof;
+} FrameReader;
+
+typedef struct {
+    size_t pixels;
+    uint16_t* partial;   // Sums of the last pending frames
+    uint64_t* totals;    // Sums of every folded frame
+    int pending;
+    uint64_t frames;
+} FrameAccumulator;
+
+// Function to open a file for streaming, mapping it when it is a regular file.
+// path "-" reads standard input.
+static int openFrameReader(FrameReader* reader, const char* path) {
+    memset(reader, 0, sizeof(FrameReader));
+    reader->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (reader->fd < 0) {
+        fprintf(stderr, "Error: Cannot open video %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(reader->fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, reader->fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+            reader->mapped = 1;
+            reader->data = (uint8_t*)data;
+            reader->length = (size_t)info.st_size;
+            reader->eof = 1;
+            return 0;
+        }
+    }
+
+    reader->capacity = 1 << 16;
+    reader->data = (uint8_t*)malloc(reader->capacity);
+    if (reader->data == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for the video reader.\n");
+        if (reader->fd != STDIN_FILENO) {
+            close(reader->fd);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+static void closeFrameReader(FrameReader* reader) {
+    if (reader->mapped) {
+        munmap(reader->data, reader->length);
+    } else {
+        free(reader->data);
+    }
+    if (reader->fd != STDIN_FILENO) {
+        close(reader->fd);
+    }
+}
+
+// Function to make at least n unread bytes available without moving the data
+// already handed out. Returns 1 if they are there, 0 at end of input.
+static int readerEnsure(FrameReader* reader, size_t n) {
+    while (reader->length - reader->offset < n && !reader->eof) {
+        if (reader->length == reader->capacity) {
+            return 0;
+        }
+        ssize_t got = read(reader->fd, reader->data + reader->length, reader->capacity - reader->length);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            reader->eof = 1;
+            break;
+        }
+        reader->length += (size_t)got;
+    }
+    return reader->length - reader->offset >= n;
+}
+
+// Function to start a new block: drop consumed bytes, from the page cache when
+// mapped or by moving the remainder to the front of the buffer when reading
+static void readerRecycle(FrameReader* reader) {
+    if (reader->mapped) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t done = reader->offset & ~(page - 1);
+        if (done > reader->released) {
+            madvise(reader->data + reader->released, done - reader->released, MADV_DONTNEED);
+            reader->released = done;
+        }
+        return;
+    }
+    memmove(reader->data, reader->data + reader->offset, reader->length - reader->offset);
+    reader->length -= reader->offset;
+    reader->offset = 0;
+}
+
+// Function to take the next line, without its newline, as a NUL-terminated copy
+static int readerLine(FrameReader* reader, char* line, size_t max) {
+    size_t n = 0;
+    for (;;) {
+        if (!readerEnsure(reader, n + 1)) {
+            return -1;
+        }
+        char c = (char)reader->data[reader->offset + n];
+        if (c == '\n') {
+            break;
+        }
+        if (++n >= max) {
+            return -1;
+        }
+    }
+    memcpy(line, reader->data + reader->offset, n);
+    line[n] = '\0';
+    reader->offset += n + 1;
+    return 0;
+}
+
+// Function to read the sizes and chroma layout from a Y4M stream header.
+// Returns the bytes of chroma that follow each luma plane, or -1.
+static int64_t parseY4mHeader(FrameReader* reader, int* width, int* height) {
+    char line[FRAME_HEADER_MAX];
+    if (readerLine(reader, line, sizeof(line)) != 0 || strncmp(line, Y4M_MAGIC, strlen(Y4M_MAGIC)) != 0) {
+        fprintf(stderr, "Error: Missing YUV4MPEG2 header.\n");
+        return -1;
+    }
+    const char* colorspace = "420";
+    *width = 0;
+    *height = 0;
+    for (char* token = strtok(line + strlen(Y4M_MAGIC), " "); token != NULL; token = strtok(NULL, " ")) {
+        if (token[0] == 'W') {
+            *width = atoi(token + 1);
+        } else if (token[0] == 'H') {
+            *height = atoi(token + 1);
+        } else if (token[0] == 'C') {
+            colorspace = token + 1;
+        }
+    }
+    if (*width <= 0 || *height <= 0) {
+        fprintf(stderr, "Error: Invalid frame size in YUV4MPEG2 header.\n");
+        return -1;
+    }
+
+    // Colorspace tokens are matched whole: the high bit depth variants
+    // (C420p10, C422p12, Cmono16, ...) share these prefixes but store two bytes
+    // per sample, which the 8-bit accumulator cannot read
+    int64_t w = *width, h = *height;
+    int64_t half_w = (w + 1) / 2, half_h = (h + 1) / 2;
+    if (strcmp(colorspace, "mono") == 0) {
+        return 0;
+    } else if (strcmp(colorspace, "444alpha") == 0) {
+        return 3 * w * h;
+    } else if (strcmp(colorspace, "444") == 0) {
+        return 2 * w * h;
+    } else if (strcmp(colorspace, "422") == 0) {
+        return 2 * half_w * h;
+    } else if (strcmp(colorspace, "411") == 0) {
+        return 2 * ((w + 3) / 4) * h;
+    } else if (strcmp(colorspace, "420") == 0 || strcmp(colorspace, "420jpeg") == 0 ||
+               strcmp(colorspace, "420paldv") == 0 || strcmp(colorspace, "420mpeg2") == 0) {
+        return 2 * half_w * half_h;
+    }
+    fprintf(stderr, "Error: Unsupported YUV4MPEG2 colorspace C%s (only 8-bit streams are read).\n", colorspace);
+    return -1;
+}
+
+// Function to add one frame's luma into 16-bit partial sums, widening bytes to
+// words a vector at a time
+static inline void addLuma(uint16_t* partial, const uint8_t* luma, size_t count) {
+    size_t i = 0;
+#ifdef __AVX2__
+    for (; i + 32 <= count; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(luma + i));
+        __m256i low = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes));
+        __m256i high = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1));
+        __m256i* sums = (__m256i*)(partial + i);
+        _mm256_storeu_si256(sums, _mm256_add_epi16(_mm256_loadu_si256(sums), low));
+        _mm256_storeu_si256(sums + 1, _mm256_add_epi16(_mm256_loadu_si256(sums + 1), high));
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(luma + i));
+        __m128i* sums = (__m128i*)(partial + i);
+        _mm_storeu_si128(sums, _mm_add_epi16(_mm_loadu_si128(sums), _mm_unpacklo_epi8(bytes, zero)));
+        _mm_storeu_si128(sums + 1, _mm_add_epi16(_mm_loadu_si128(sums + 1), _mm_unpackhi_epi8(bytes, zero)));
+    }
+#endif
+    for (; i < count; i++) {
+        partial[i] = (uint16_t)(partial[i] + luma[i]);
+    }
+}
+
+// Function to fold the partial sums into the totals and clear them
+static void foldPartials(FrameAccumulator* acc) {
+    uint16_t* partial = acc->partial;
+    uint64_t* totals = acc->totals;
+    const int64_t pixels = (int64_t)acc->pixels;
+
+    #pragma omp parallel for schedule(static) if (acc->pixels >= FRAME_PARALLEL_PIXELS)
+    for (int64_t i = 0; i < pixels; i++) {
+        totals[i] += partial[i];
+        partial[i] = 0;
+    }
+    acc->pending = 0;
+}
+
+// Function to add a block of frames. Each thread owns a range of pixels and
+// runs every frame of the block over it, so its partial sums stay in cache.
+static void accumulateBlock(FrameAccumulator* acc, const uint8_t* const* frames, int count) {
+    if (acc->pending + count > FRAME_PARTIAL_FRAMES) {
+        foldPartials(acc);
+    }
+    uint16_t* partial = acc->partial;
+    const size_t pixels = acc->pixels;
+    const int64_t chunks = (int64_t)((pixels + FRAME_CHUNK - 1) / FRAME_CHUNK);
+
+    #pragma omp parallel for schedule(static) if (pixels >= FRAME_PARALLEL_PIXELS)
+    for (int64_t chunk = 0; chunk < chunks; chunk++) {
+        size_t begin = (size_t)chunk * FRAME_CHUNK;
+        size_t n = pixels - begin < FRAME_CHUNK ? pixels - begin : FRAME_CHUNK;
+        for (int f = 0; f < count; f++) {
+            addLuma(partial + begin, frames[f] + begin, n);
+        }
+    }
+    acc->pending += count;
+    acc->frames += (uint64_t)count;
+    INSTRUMENT_COUNT(COUNTER_BYTES, (uint64_t)count * pixels);
+}
+
+// Function to average the luma of every frame of a video. Y4M files are
+// recognized by their header whatever format says; headerless GRAY8 and I420
+// input need width and height. Returns NULL on error or if there are no frames.
+FrameAverage* averageFrames(const char* path, FrameFormat format, int width, int height) {
+    INSTRUMENT_SCOPE("averageFrames");
+    FrameReader reader;
+    if (openFrameReader(&reader, path) != 0) {
+        return NULL;
+    }
+
+    int y4m = format == FRAME_Y4M ||
+              (readerEnsure(&reader, strlen(Y4M_MAGIC)) && memcmp(reader.data, Y4M_MAGIC, strlen(Y4M_MAGIC)) == 0);
+    int64_t chroma_bytes;
+    if (y4m) {
+        chroma_bytes = parseY4mHeader(&reader, &width, &height);
+    } else if (width <= 0 || height <= 0) {
+        fprintf(stderr, "Error: Raw video needs a frame width and height.\n");
+        chroma_bytes = -1;
+    } else {
+        chroma_bytes = format == FRAME_I420 ? 2 * (int64_t)((width + 1) / 2) * ((height + 1) / 2) : 0;
+    }
+    if (chroma_bytes < 0) {
+        closeFrameReader(&reader);
+        return NULL;
+    }
+
+    size_t pixels = (size_t)width * (size_t)height;
+    size_t frame_bytes = pixels + (size_t)chroma_bytes;
+    int block = FRAME_BLOCK;
+    if (!reader.mapped) {
+        // Room for a whole block with its frame headers, so no frame moves mid-block
+        if ((size_t)block * frame_bytes > FRAME_READ_BUFFER) {
+            block = frame_bytes >= FRAME_READ_BUFFER ? 1 : (int)(FRAME_READ_BUFFER / frame_bytes);
+        }
+        size_t capacity = (size_t)block * (frame_bytes + FRAME_HEADER_MAX) + FRAME_HEADER_MAX;
+        readerRecycle(&reader);
+        uint8_t* data = (uint8_t*)realloc(reader.data, capacity);
+        if (data == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for the video reader.\n");
+            closeFrameReader(&reader);
+            return NULL;
+        }
+        reader.data = data;
+        reader.capacity = capacity;
+    }
+
+    FrameAccumulator acc;
+    acc.pixels = pixels;
+    acc.partial = (uint16_t*)calloc(pixels, sizeof(uint16_t));
+    acc.totals = (uint64_t*)calloc(pixels, sizeof(uint64_t));
+    acc.pending = 0;
+    acc.frames = 0;
+    FrameAverage* average = (FrameAverage*)malloc(sizeof(FrameAverage));
+    double* mean = (double*)malloc(pixels * sizeof(double));
+    if (acc.partial == NULL || acc.totals == NULL || average == NULL || mean == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for the frame accumulator.\n");
+        free(acc.partial);
+        free(acc.totals);
+        free(average);
+        free(mean);
+        closeFrameReader(&reader);
+        return NULL;
+    }
+
+    const uint8_t* frames[FRAME_BLOCK];
+    int done = 0;
+    while (!done) {
+        readerRecycle(&reader);
+        int count = 0;
+        while (count < block) {
+            if (y4m) {
+                char line[FRAME_HEADER_MAX];
+                if (readerLine(&reader, line, sizeof(line)) != 0) {
+                    done = 1;
+                    break;
+                }
+                if (strncmp(line, "FRAME", 5) != 0) {
+                    fprintf(stderr, "Warning: Stopping at a malformed YUV4MPEG2 frame header.\n");
+                    done = 1;
+                    break;
+                }
+            }
+            if (!readerEnsure(&reader, frame_bytes)) {
+                done = 1;
+                break;
+            }
+            frames[count++] = reader.data + reader.offset;
+            reader.offset += frame_bytes;
+        }
+        if (count > 0) {
+            accumulateBlock(&acc, frames, count);
+        }
+    }
+    foldPartials(&acc);
+    closeFrameReader(&reader);
+
+    if (acc.frames == 0) {
+        fprintf(stderr, "Error: No complete frames in %s.\n", path);
+        free(acc.partial);
+        free(acc.totals);
+        free(average);
+        free(mean);
+        return NULL;
+    }
+
+    const double scale = 1.0 / (double)acc.frames;
+    const int64_t n = (int64_t)pixels;
+    #pragma omp parallel for schedule(static) if (pixels >= FRAME_PARALLEL_PIXELS)
+    for (int64_t i = 0; i < n; i++) {
+        mean[i] = (double)acc.totals[i] * scale;
+    }
+    free(acc.partial);
+    free(acc.totals);
+
+    average->width = width;
+    average->height = height;
+    average->frames = acc.frames;
+    average->mean = mean;
+    return average;
+}
+
+void freeFrameAverage(FrameAverage* average) {
+    if (average == NULL) {
+        return;
+    }
+    free(average->mean);
+    free(average);
+}
+
+// Function to compute the RX encoding angle 2 acos(sqrt(v / 255)) of each cell
+// of a rows x cols grid, where v is the average luma over the pixels the cell
+// covers. Returns 0, or -1 if the grid is empty.
+int encodingAngles(const FrameAverage* average, int rows, int cols, double* angles) {
+    if (rows <= 0 || cols <= 0) {
+        fprintf(stderr, "Error: Encoding grid must be at least 1x1.\n");
+        return -1;
+    }
+
+    #pragma omp parallel for schedule(static) if ((size_t)rows * (size_t)cols >= FRAME_PARALLEL_PIXELS)
+    for (int r = 0; r < rows; r++) {
+        int y0 = (int)((int64_t)r * average->height / rows);
+        int y1 = (int)((int64_t)(r + 1) * average->height / rows);
+        if (y1 <= y0) {
+            y1 = y0 + 1;
+        }
+        for (int c = 0; c < cols; c++) {
+            int x0 = (int)((int64_t)c * average->width / cols);
+            int x1 = (int)((int64_t)(c + 1) * average->width / cols);
+            if (x1 <= x0) {
+                x1 = x0 + 1;
+            }
+            double sum = 0.0;
+            for (int y = y0; y < y1; y++) {
+                const double* row = average->mean + (size_t)y * (size_t)average->width;
+                for (int x = x0; x < x1; x++) {
+                    sum += row[x];
+                }
+            }
+            double value = sum / ((double)(y1 - y0) * (double)(x1 - x0));
+            double level = fmin(fmax(value / 255.0, 0.0), 1.0);
+            angles[(size_t)r * (size_t)cols + (size_t)c] = 2.0 * acos(sqrt(level));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef FRAMESUM_H
+#define FRAMESUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Streaming per-pixel average of the luma plane of a video. Frames are taken
+// from a memory-mapped file, or read in large blocks from a pipe, and added
+// into 16-bit per-pixel partial sums with widening vector adds; the partial
+// sums are folded into 64-bit totals before they can overflow.
+
+// Frames added per pass over the accumulators
+#define FRAME_BLOCK 32
+// Frames a 16-bit partial sum holds before it is folded: 257 * 255 = 65535
+#define FRAME_PARTIAL_FRAMES 257
+
+typedef enum {
+    FRAME_Y4M,     // YUV4MPEG2 stream; size and chroma layout come from its header
+    FRAME_GRAY8,   // Headerless 8-bit luma frames
+    FRAME_I420     // Headerless planar 4:2:0 frames (Y, then U and V at half size)
+} FrameFormat;
+
+typedef struct {
+    int width;
+    int height;
+    uint64_t frames;
+    double* mean;   // Average luma of each pixel, row-major, 0..255
+} FrameAverage;
+
+FrameAverage* averageFrames(const char* path, FrameFormat format, int width, int height);
+void freeFrameAverage(FrameAverage* average);
+int encodingAngles(const FrameAverage* average, int rows, int cols, double* angles);
+
+#endif
@@ -0,0 +1,275 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "instrument.h"
+
+#ifdef QSIM_INSTRUMENT
+
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+
+// Gate names come from circuit.c when it is linked; the hash tools link without it
+const char* gateName(int type) __attribute__((weak));
+
+static const char* const counter_names[NUM_COUNTERS] = {
+    "amplitudes", "bytes", "hashes", "rng draws"
+};
+
+static const char* const perf_names[3] = { "cycles", "instructions", "cache misses" };
+
+_Thread_local InstrumentThread* instrument_self = NULL;
+
+static pthread_mutex_t instrument_lock = PTHREAD_MUTEX_INITIALIZER;
+static InstrumentThread* instrument_threads = NULL;
+static int instrument_num_threads = 0;
+static int hardware_counters = 0;
+static uint64_t instrument_epoch = 0;
+
+// Function to read the monotonic clock in nanoseconds
+uint64_t instrumentNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Function to open one hardware counter for the calling thread, user space only
+static int openPerfCounter(unsigned long long config) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void)config;
+    return -1;
+#endif
+}
+
+// Function to create the calling thread's counters and add them to the list
+// that summaries and traces walk. Threads stay listed until the process exits,
+// since OpenMP keeps its workers for the life of the program.
+InstrumentThread* registerInstrumentThread(void) {
+    InstrumentThread* self = (InstrumentThread*)calloc(1, sizeof(InstrumentThread));
+    if (self == NULL) {
+        fprintf(stderr, "Error: Could not allocate instrumentation counters\n");
+        abort();
+    }
+    self->events = (TraceEvent*)malloc(INSTRUMENT_MAX_EVENTS * sizeof(TraceEvent));
+    for (int i = 0; i < 3; i++) {
+        self->perf_fds[i] = -1;
+    }
+
+    pthread_mutex_lock(&instrument_lock);
+    if (instrument_epoch == 0) {
+        instrument_epoch = instrumentNow();
+    }
+#ifdef __linux__
+    if (hardware_counters) {
+        self->perf_fds[0] = openPerfCounter(PERF_COUNT_HW_CPU_CYCLES);
+        self->perf_fds[1] = openPerfCounter(PERF_COUNT_HW_INSTRUCTIONS);
+        self->perf_fds[2] = openPerfCounter(PERF_COUNT_HW_CACHE_MISSES);
+    }
+#endif
+    self->tid = instrument_num_threads++;
+    self->next = instrument_threads;
+    instrument_threads = self;
+    pthread_mutex_unlock(&instrument_lock);
+
+    instrument_self = self;
+    return self;
+}
+
+// Function to close a scope: add its time to the per-name total and, while
+// there is room, keep it as a trace event
+void endInstrumentScope(InstrumentScope* scope) {
+    const uint64_t duration = instrumentNow() - scope->start;
+    InstrumentThread* self = instrumentThread();
+
+    int s = 0;
+    while (s < self->num_scopes && self->scopes[s].name != scope->name) {
+        s++;
+    }
+    if (s == self->num_scopes && s < INSTRUMENT_MAX_SCOPES) {
+        self->scopes[self->num_scopes++].name = scope->name;
+    }
+    if (s < INSTRUMENT_MAX_SCOPES) {
+        self->scopes[s].count++;
+        self->scopes[s].total += duration;
+    }
+    if (self->events != NULL && self->num_events < INSTRUMENT_MAX_EVENTS) {
+        TraceEvent* event = &self->events[self->num_events++];
+        event->name = scope->name;
+        event->start = scope->start;
+        event->duration = duration;
+    }
+}
+
+// Function to count cycles, instructions and cache misses on threads that start
+// counting after this call. Returns 0 if the kernel allows it, -1 otherwise.
+int enableHardwareCounters(void) {
+    int fd = openPerfCounter(0);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Hardware counters are not available (check perf_event_paranoid)\n");
+        return -1;
+    }
+    close(fd);
+    pthread_mutex_lock(&instrument_lock);
+    hardware_counters = 1;
+    pthread_mutex_unlock(&instrument_lock);
+    return 0;
+}
+
+// Function to zero every thread's counters, scope totals and trace events.
+// Call it only while no instrumented code is running.
+void resetInstrumentation(void) {
+    pthread_mutex_lock(&instrument_lock);
+    for (InstrumentThread* t = instrument_threads; t != NULL; t = t->next) {
+        memset(t->counters, 0, sizeof(t->counters));
+        memset(t->gates, 0, sizeof(t->gates));
+        t->num_scopes = 0;
+        t->num_events = 0;
+        for (int i = 0; i < 3; i++) {
+            if (t->perf_fds[i] >= 0) {
+                ioctl(t->perf_fds[i], PERF_EVENT_IOC_RESET, 0);
+            }
+        }
+    }
+    instrument_epoch = instrumentNow();
+    pthread_mutex_unlock(&instrument_lock);
+}
+
+// Function to print totals over all threads: counters, gates by type, time per
+// scope name and, if enabled, hardware counters
+void writeInstrumentSummary(FILE* out) {
+    uint64_t counters[NUM_COUNTERS] = { 0 };
+    uint64_t gates[INSTRUMENT_GATE_TYPES] = { 0 };
+    uint64_t perf[3] = { 0 };
+    int have_perf = 0;
+    ScopeTotal scopes[INSTRUMENT_MAX_SCOPES];
+    int num_scopes = 0;
+
+    pthread_mutex_lock(&instrument_lock);
+    for (InstrumentThread* t = instrument_threads; t != NULL; t = t->next) {
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+            counters[c] += t->counters[c];
+        }
+        for (int g = 0; g < INSTRUMENT_GATE_TYPES; g++) {
+            gates[g] += t->gates[g];
+        }
+        for (int i = 0; i < 3; i++) {
+            uint64_t value;
+            if (t->perf_fds[i] >= 0 && read(t->perf_fds[i], &value, sizeof(value)) == sizeof(value)) {
+                perf[i] += value;
+                have_perf = 1;
+            }
+        }
+        for (int s = 0; s < t->num_scopes; s++) {
+            int m = 0;
+            while (m < num_scopes && strcmp(scopes[m].name, t->scopes[s].name) != 0) {
+                m++;
+            }
+            if (m == num_scopes) {
+                if (num_scopes == INSTRUMENT_MAX_SCOPES) {
+                    continue;
+                }
+                scopes[num_scopes].name = t->scopes[s].name;
+                scopes[num_scopes].count = 0;
+                scopes[num_scopes].total = 0;
+                num_scopes++;
+            }
+            scopes[m].count += t->scopes[s].count;
+            scopes[m].total += t->scopes[s].total;
+        }
+    }
+    const int num_threads = instrument_num_threads;
+    pthread_mutex_unlock(&instrument_lock);
+
+    fprintf(out, "Instrumentation summary (%d threads)\n", num_threads);
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        fprintf(out, "  %-14s %llu\n", counter_names[c], (unsigned long long)counters[c]);
+    }
+    for (int g = 0; g < INSTRUMENT_GATE_TYPES; g++) {
+        if (gates[g] != 0) {
+            if (gateName != NULL) {
+                fprintf(out, "  gate %-9s %llu\n", gateName(g), (unsigned long long)gates[g]);
+            } else {
+                fprintf(out, "  gate type %-4d %llu\n", g, (unsigned long long)gates[g]);
+            }
+        }
+    }
+    for (int s = 0; s < num_scopes; s++) {
+        fprintf(out, "  %-24s %10llu calls %12.3f ms %10.3f us/call\n", scopes[s].name,
+                (unsigned long long)scopes[s].count, scopes[s].total * 1e-6,
+                scopes[s].total * 1e-3 / scopes[s].count);
+    }
+    if (have_perf) {
+        for (int i = 0; i < 3; i++) {
+            fprintf(out, "  %-14s %llu\n", perf_names[i], (unsigned long long)perf[i]);
+        }
+    }
+}
+
+// Function to write the recorded scopes as Chrome trace JSON, which
+// chrome://tracing and Perfetto open directly. Returns 0 on success, -1 on failure.
+int writeChromeTrace(const char* path) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Error: Could not open %s for writing\n", path);
+        return -1;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    int first = 1;
+    pthread_mutex_lock(&instrument_lock);
+    for (InstrumentThread* t = instrument_threads; t != NULL; t = t->next) {
+        fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                first ? "" : ",\n", t->tid, t->tid);
+        first = 0;
+        for (uint64_t e = 0; e < t->num_events; e++) {
+            const TraceEvent* event = &t->events[e];
+            const uint64_t start = event->start > instrument_epoch ? event->start - instrument_epoch : 0;
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    event->name, t->tid, start * 1e-3, event->duration * 1e-3);
+        }
+    }
+    pthread_mutex_unlock(&instrument_lock);
+    fprintf(out, "\n]}\n");
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Error: Could not write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+#else
+
+int enableHardwareCounters(void) {
+    return -1;
+}
+
+void resetInstrumentation(void) {
+}
+
+void writeInstrumentSummary(FILE* out) {
+    fprintf(out, "Instrumentation is compiled out (build with -DQSIM_INSTRUMENT)\n");
+}
+
+int writeChromeTrace(const char* path) {
+    (void)path;
+    fprintf(stderr, "Error: Instrumentation is compiled out (build with -DQSIM_INSTRUMENT)\n");
+    return -1;
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Low-overhead counters and scoped timers for the hot paths. Everything below
+// compiles to nothing unless QSIM_INSTRUMENT is defined, in which case
+// instrument.c must be linked. Counters are per thread and unsynchronized;
+// they are only summed when a summary or trace is written.
+
+// Slots for per-gate-type counts; must be at least NUM_GATE_TYPES
+#define INSTRUMENT_GATE_TYPES 16
+// Trace events a thread keeps; later scopes still count toward the summary
+#define INSTRUMENT_MAX_EVENTS (1 << 20)
+// Distinct scope names a thread aggregates
+#define INSTRUMENT_MAX_SCOPES 64
+
+typedef enum {
+    COUNTER_AMPLITUDES,   // Amplitudes read and written by gate kernels
+    COUNTER_BYTES,        // Bytes of amplitude traffic (read plus write)
+    COUNTER_HASHES,       // Digests and circuit keys computed
+    COUNTER_RNG_DRAWS,    // 64-bit draws from rng.h generators
+    NUM_COUNTERS
+} InstrumentCounter;
+
+#ifdef QSIM_INSTRUMENT
+
+typedef struct {
+    const char* name;
+    uint64_t start;
+    uint64_t duration;
+} TraceEvent;
+
+typedef struct {
+    const char* name;
+    uint64_t count;
+    uint64_t total;
+} ScopeTotal;
+
+typedef struct InstrumentThread {
+    int tid;
+    uint64_t counters[NUM_COUNTERS];
+    uint64_t gates[INSTRUMENT_GATE_TYPES];
+    int num_scopes;
+    ScopeTotal scopes[INSTRUMENT_MAX_SCOPES];
+    uint64_t num_events;
+    TraceEvent* events;
+    int perf_fds[3];             // cycles, instructions, cache misses; -1 if unavailable
+    struct InstrumentThread* next;
+} InstrumentThread;
+
+typedef struct {
+    const char* name;
+    uint64_t start;
+} InstrumentScope;
+
+extern _Thread_local InstrumentThread* instrument_self;
+
+InstrumentThread* registerInstrumentThread(void);
+uint64_t instrumentNow(void);
+void endInstrumentScope(InstrumentScope* scope);
+
+static inline InstrumentThread* instrumentThread(void) {
+    return instrument_self != NULL ? instrument_self : registerInstrumentThread();
+}
+
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+
+// Count n events of a kind on the calling thread
+#define INSTRUMENT_COUNT(counter, n) (instrumentThread()->counters[(counter)] += (uint64_t)(n))
+// Count one gate and the traffic of its kernel over amplitudes of the given size
+#define INSTRUMENT_GATE(type, amplitudes, amplitude_bytes) do { \
+        InstrumentThread* instrument_thread_ = instrumentThread(); \
+        instrument_thread_->gates[(type)]++; \
+        instrument_thread_->counters[COUNTER_AMPLITUDES] += (uint64_t)(amplitudes); \
+        instrument_thread_->counters[COUNTER_BYTES] += 2 * (uint64_t)(amplitude_bytes) * (uint64_t)(amplitudes); \
+    } while (0)
+// Time from here to the end of the enclosing block under a string-literal name
+#define INSTRUMENT_SCOPE(name) \
+    InstrumentScope INSTRUMENT_CONCAT(instrument_scope_, __LINE__) \
+        __attribute__((cleanup(endInstrumentScope))) = { (name), instrumentNow() }
+
+#else
+
+#define INSTRUMENT_COUNT(counter, n) ((void)0)
+#define INSTRUMENT_GATE(type, amplitudes, amplitude_bytes) ((void)0)
+#define INSTRUMENT_SCOPE(name)
+
+#endif
+
+int enableHardwareCounters(void);
+void resetInstrumentation(void);
+void writeInstrumentSummary(FILE* out);
+int writeChromeTrace(const char* path);
+
+#endif
@@ -0,0 +1,783 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "statevector.h"
+#include "circuit.h"
+#include "cache.h"
+#include "planner.h"
+
+// Long-running simulation server on a Unix domain socket.
+//
+// Usage: jobserver <socket path> [workers] [preallocate qubits]
+//
+// Clients send jobs as text lines; several jobs may be pipelined on one
+// connection and results come back as soon as each job finishes:
+//   CIRCUIT <id> <deadline ms> <qubits> <shots> <seed>   then gate lines
+//   ...                                                  (see parseGateLine)
+//   END
+//   SEARCH <id> <deadline ms> <qubits> <marked index> <shots> <seed>
+// Replies:
+//   SAMPLES <id> <basis state> ...     up to JOB_SAMPLES_PER_LINE per line
+//   FOUND <id> <index> <frequency>     most frequent sample of a search
+//   DONE <id> <microseconds in server> <late 0/1>
+//   ERROR <id> <message>
+//
+// Jobs wait in one queue ordered by deadline. Each worker thread keeps warm
+// registers of every width it has used, its own OpenMP team and its own result
+// cache, and takes up to JOB_BATCH queued jobs of the same width at a time.
+// Jobs that cannot fit in memory or meet their deadline are refused up front.
+// Replies go through a per-client outbox that the main loop drains as the
+// socket takes them, so a slow reader never stalls the accept/read loop; a
+// worker streaming samples waits while that client's outbox is full.
+
+#define JOB_BATCH 8
+#define JOB_LINE 4096
+#define JOB_MAX_QUBITS 30
+#define JOB_SAMPLES_PER_LINE 64
+#define JOB_MAX_SHOTS (1ULL << 24)
+#define JOB_OUTBOX_LIMIT (1UL << 20)
+#define JOB_DRAIN_POLL_MS 20
+#define JOB_CACHE_BYTES (64UL << 20)
+#define MAX_CLIENTS 1024
+
+typedef struct Client {
+    int fd;
+    int refs;                  // Main loop plus queued or running jobs
+    int reading;               // Main loop still reads requests
+    int broken;                // Replies can no longer be delivered
+    int blocking;              // Shutting down: replies are written synchronously
+    pthread_mutex_t lock;      // Serializes the outbox and refs
+    pthread_cond_t drained;    // Signaled whenever the outbox shrinks
+    char* outbox;              // Replies the socket has not taken yet
+    size_t out_start;
+    size_t out_length;
+    size_t out_capacity;
+    char buffer[JOB_LINE];
+    size_t length;
+    struct Job* pending;       // CIRCUIT job whose gate lines are still arriving
+} Client;
+
+typedef enum {
+    JOB_CIRCUIT,
+    JOB_SEARCH
+} JobType;
+
+typedef struct Job {
+    JobType type;
+    unsigned long long id;
+    double received;
+    double deadline;
+    uint64_t sequence;
+    Client* client;
+    int num_qubits;
+    uint64_t shots;
+    uint64_t seed;
+    uint64_t marked;
+    int failed;
+    Circuit circuit;
+} Job;
+
+// Deadline-ordered binary heap of jobs shared by the workers
+typedef struct {
+    Job** jobs;
+    int count;
+    int capacity;
+    uint64_t next_sequence;
+    int num_workers;
+    int stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+} JobQueue;
+
+typedef struct {
+    JobQueue* queue;
+    int threads_per_worker;
+    int preallocate;
+} WorkerConfig;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handleStop(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+static double monotonicSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Function to write as much of the outbox as the socket takes without blocking,
+// or all of it once the server is shutting down. The client lock must be held.
+static void flushOutboxLocked(Client* client) {
+    while (client->out_start < client->out_length) {
+        ssize_t n = send(client->fd, client->outbox + client->out_start, client->out_length - client->out_start,
+                         MSG_NOSIGNAL | (client->blocking ? 0 : MSG_DONTWAIT));
+        if (n > 0) {
+            client->out_start += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        // The client went away: drop what is left
+        client->broken = 1;
+        client->out_start = client->out_length;
+    }
+    if (client->out_start == client->out_length) {
+        client->out_start = 0;
+        client->out_length = 0;
+    }
+    pthread_cond_broadcast(&client->drained);
+}
+
+// Function to queue a reply line for a client and send what the socket takes
+// now. Never waits for the client; a client whose unread replies pass four
+// times JOB_OUTBOX_LIMIT is treated as gone.
+static void sendReply(Client* client, const char* text, size_t length) {
+    pthread_mutex_lock(&client->lock);
+    if (!client->broken && client->out_length - client->out_start + length > 4 * JOB_OUTBOX_LIMIT) {
+        client->broken = 1;
+        client->out_start = 0;
+        client->out_length = 0;
+        pthread_cond_broadcast(&client->drained);
+    }
+    if (client->broken) {
+        pthread_mutex_unlock(&client->lock);
+        return;
+    }
+    if (client->out_length + length > client->out_capacity) {
+        memmove(client->outbox, client->outbox + client->out_start, client->out_length - client->out_start);
+        client->out_length -= client->out_start;
+        client->out_start = 0;
+    }
+    if (client->out_length + length > client->out_capacity) {
+        size_t capacity = client->out_capacity ? client->out_capacity : 4096;
+        while (capacity < client->out_length + length) {
+            capacity *= 2;
+        }
+        char* outbox = (char*)realloc(client->outbox, capacity);
+        if (outbox == NULL) {
+            client->broken = 1;
+            pthread_cond_broadcast(&client->drained);
+            pthread_mutex_unlock(&client->lock);
+            return;
+        }
+        client->outbox = outbox;
+        client->out_capacity = capacity;
+    }
+    memcpy(client->outbox + client->out_length, text, length);
+    client->out_length += length;
+    flushOutboxLocked(client);
+    pthread_mutex_unlock(&client->lock);
+}
+
+// Function to wait until a client's outbox has room, so a worker streaming a
+// large result to a slow reader holds back instead of buffering all of it
+static void waitForRoom(Client* client) {
+    pthread_mutex_lock(&client->lock);
+    while (!client->broken && !client->blocking && client->out_length - client->out_start > JOB_OUTBOX_LIMIT) {
+        pthread_cond_wait(&client->drained, &client->lock);
+    }
+    pthread_mutex_unlock(&client->lock);
+}
+
+static void replyf(Client* client, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void replyf(Client* client, const char* format, ...) {
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > 0) {
+        sendReply(client, line, length < (int)sizeof(line) ? (size_t)length : sizeof(line) - 1);
+    }
+}
+
+static void retainClient(Client* client) {
+    pthread_mutex_lock(&client->lock);
+    client->refs++;
+    pthread_mutex_unlock(&client->lock);
+}
+
+// Function to drop a reference; the last one closes the socket
+static void releaseClient(Client* client) {
+    pthread_mutex_lock(&client->lock);
+    int refs = --client->refs;
+    pthread_mutex_unlock(&client->lock);
+    if (refs == 0) {
+        close(client->fd);
+        pthread_cond_destroy(&client->drained);
+        pthread_mutex_destroy(&client->lock);
+        free(client->outbox);
+        free(client);
+    }
+}
+
+static void freeJob(Job* job) {
+    freeCircuit(&job->circuit);
+    free(job);
+}
+
+// Function to order jobs by deadline, then by arrival
+static int jobBefore(const Job* a, const Job* b) {
+    if (a->deadline != b->deadline) {
+        return a->deadline < b->deadline;
+    }
+    return a->sequence < b->sequence;
+}
+
+static int pushJob(JobQueue* queue, Job* job) {
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count == queue->capacity) {
+        int capacity = queue->capacity ? queue->capacity * 2 : 64;
+        Job** jobs = (Job**)realloc(queue->jobs, capacity * sizeof(Job*));
+        if (jobs == NULL) {
+            pthread_mutex_unlock(&queue->lock);
+            return -1;
+        }
+        queue->jobs = jobs;
+        queue->capacity = capacity;
+    }
+    job->sequence = queue->next_sequence++;
+    int i = queue->count++;
+    while (i > 0 && jobBefore(job, queue->jobs[(i - 1) / 2])) {
+        queue->jobs[i] = queue->jobs[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    queue->jobs[i] = job;
+    pthread_cond_signal(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+}
+
+// Function to remove the most urgent job; the queue lock must be held
+static Job* popJobLocked(JobQueue* queue) {
+    Job* top = queue->jobs[0];
+    Job* last = queue->jobs[--queue->count];
+    int i = 0;
+    while (2 * i + 1 < queue->count) {
+        int child = 2 * i + 1;
+        if (child + 1 < queue->count && jobBefore(queue->jobs[child + 1], queue->jobs[child])) {
+            child++;
+        }
+        if (!jobBefore(queue->jobs[child], last)) {
+            break;
+        }
+        queue->jobs[i] = queue->jobs[child];
+        i = child;
+    }
+    if (queue->count > 0) {
+        queue->jobs[i] = last;
+    }
+    return top;
+}
+
+// Function to wait for work and take a batch: the most urgent job plus the
+// following jobs in deadline order while they have the same width.
+// Returns 0 once the queue is stopping and empty.
+static int takeBatch(JobQueue* queue, Job** batch) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->stopping) {
+        pthread_cond_wait(&queue->ready, &queue->lock);
+    }
+    int count = 0;
+    if (queue->count > 0) {
+        batch[count++] = popJobLocked(queue);
+        while (count < JOB_BATCH && queue->count > 0 && queue->jobs[0]->num_qubits == batch[0]->num_qubits) {
+            batch[count++] = popJobLocked(queue);
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+// Function to build a Grover search for one marked basis state
+static int buildGroverCircuit(Circuit* circuit, int num_qubits, uint64_t marked) {
+    const uint64_t all = (num_qubits == 64) ? ~0ULL : (1ULL << num_qubits) - 1;
+    const uint64_t others = all & ~1ULL;
+    const int iterations = (int)floor(M_PI / 4 * sqrt((double)(1ULL << num_qubits)));
+    int status = 0;
+
+    for (int q = 0; q < num_qubits; q++) {
+        status |= addGate(circuit, GATE_H, q) < 0;
+    }
+    for (int it = 0; it < iterations && status == 0; it++) {
+        // Oracle: phase flip on |marked>
+        for (int q = 0; q < num_qubits; q++) {
+            if (!((marked >> q) & 1)) {
+                status |= addGate(circuit, GATE_X, q) < 0;
+            }
+        }
+        status |= addControlledGate(circuit, GATE_Z, others, 0, 0.0) < 0;
+        for (int q = 0; q < num_qubits; q++) {
+            if (!((marked >> q) & 1)) {
+                status |= addGate(circuit, GATE_X, q) < 0;
+            }
+        }
+        // Diffusion: reflection about the uniform superposition
+        for (int q = 0; q < num_qubits; q++) {
+            status |= addGate(circuit, GATE_H, q) < 0;
+            status |= addGate(circuit, GATE_X, q) < 0;
+        }
+        status |= addControlledGate(circuit, GATE_Z, others, 0, 0.0) < 0;
+        for (int q = 0; q < num_qubits; q++) {
+            status |= addGate(circuit, GATE_X, q) < 0;
+            status |= addGate(circuit, GATE_H, q) < 0;
+        }
+    }
+    return status ? -1 : 0;
+}
+
+// Function to stream samples back in lines of JOB_SAMPLES_PER_LINE values
+static void sendSamples(Client* client, unsigned long long id, const uint64_t* samples, uint64_t count) {
+    char line[32 + JOB_SAMPLES_PER_LINE * 21];
+    for (uint64_t start = 0; start < count; start += JOB_SAMPLES_PER_LINE) {
+        int length = snprintf(line, sizeof(line), "SAMPLES %llu", id);
+        waitForRoom(client);
+        for (uint64_t s = start; s < count && s < start + JOB_SAMPLES_PER_LINE; s++) {
+            length += snprintf(line + length, sizeof(line) - length, " %llu", (unsigned long long)samples[s]);
+        }
+        line[length++] = '\n';
+        sendReply(client, line, (size_t)length);
+    }
+}
+
+static int compareSamples(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Function to report the most frequent sample of a search as its answer, by
+// sorting a copy of the samples and taking the longest run
+static void sendSearchResult(Client* client, unsigned long long id, const uint64_t* samples, uint64_t count) {
+    uint64_t* sorted = (uint64_t*)malloc((count + 1) * sizeof(uint64_t));
+    if (sorted == NULL) {
+        replyf(client, "ERROR %llu out of memory\n", id);
+        return;
+    }
+    memcpy(sorted, samples, count * sizeof(uint64_t));
+    qsort(sorted, count, sizeof(uint64_t), compareSamples);
+
+    uint64_t best = sorted[0];
+    uint64_t best_count = 0;
+    for (uint64_t s = 0; s < count;) {
+        uint64_t run = s + 1;
+        while (run < count && sorted[run] == sorted[s]) {
+            run++;
+        }
+        if (run - s > best_count) {
+            best_count = run - s;
+            best = sorted[s];
+        }
+        s = run;
+    }
+    free(sorted);
+    replyf(client, "FOUND %llu %llu %.6f\n", id, (unsigned long long)best, (double)best_count / count);
+}
+
+// Function to run one job on the worker's warm register for its width. Results
+// are looked up in the worker's cache first, so repeated circuits cost a hash.
+static void runJob(Job* job, QubitRegister** registers, ResultCache* cache) {
+    Client* client = job->client;
+    CacheRequest request = { 0, job->shots, job->seed, 0, NULL };
+    CircuitKey key = circuitKey(&job->circuit, &request);
+    const CachedResult* result = (key.hi != 0 || key.lo != 0) ? lookupResult(cache, key) : NULL;
+    if (result == NULL) {
+        QubitRegister* reg = registers[job->num_qubits];
+        if (reg == NULL && (reg = registers[job->num_qubits] = initializeRegister(job->num_qubits)) == NULL) {
+            replyf(client, "ERROR %llu out of memory\n", job->id);
+            return;
+        }
+        resetRegister(reg);
+        applyCircuit(reg, &job->circuit);
+
+        CachedResult fresh;
+        memset(&fresh, 0, sizeof(fresh));
+        fresh.num_qubits = job->num_qubits;
+        fresh.num_samples = job->shots;
+        fresh.samples = (uint64_t*)malloc((job->shots + 1) * sizeof(uint64_t));
+        if (fresh.samples == NULL || sampleRegister(reg, job->shots, job->seed, fresh.samples) != 0) {
+            free(fresh.samples);
+            replyf(client, "ERROR %llu out of memory\n", job->id);
+            return;
+        }
+        if ((result = storeResult(cache, key, &fresh)) == NULL) {
+            replyf(client, "ERROR %llu out of memory\n", job->id);
+            return;
+        }
+    }
+
+    if (job->type == JOB_SEARCH) {
+        sendSearchResult(client, job->id, result->samples, result->num_samples);
+    }
+    sendSamples(client, job->id, result->samples, result->num_samples);
+}
+
+// Function run by each worker thread: take batches in deadline order and
+// stream each job's results back as soon as it finishes
+static void* workerMain(void* arg) {
+    const WorkerConfig* config = (const WorkerConfig*)arg;
+    QubitRegister* registers[JOB_MAX_QUBITS + 1] = { NULL };
+    ResultCache cache;
+    Job* batch[JOB_BATCH];
+
+#ifdef _OPENMP
+    omp_set_num_threads(config->threads_per_worker);
+#endif
+    if (initializeResultCache(&cache, JOB_CACHE_BYTES, NULL) != 0) {
+        return NULL;
+    }
+    if (config->preallocate > 0) {
+        registers[config->preallocate] = initializeRegister(config->preallocate);
+    }
+
+    int count;
+    while ((count = takeBatch(config->queue, batch)) > 0) {
+        for (int b = 0; b < count; b++) {
+            Job* job = batch[b];
+            runJob(job, registers, &cache);
+            double now = monotonicSeconds();
+            replyf(job->client, "DONE %llu %.0f %d\n", job->id, (now - job->received) * 1e6, now > job->deadline);
+            releaseClient(job->client);
+            freeJob(job);
+        }
+    }
+
+    for (int n = 0; n <= JOB_MAX_QUBITS; n++) {
+        freeRegister(registers[n]);
+    }
+    freeResultCache(&cache);
+    return NULL;
+}
+
+// Function to admit a complete job and queue it, or refuse it before anything is
+// allocated for its state. A job is refused if its register and sample buffer
+// would not fit in this worker's share of memory, or if it cannot finish by its
+// deadline. Search jobs arrive here with their Grover circuit already built.
+static void submitJob(Client* client, JobQueue* queue, Job* job) {
+    CircuitProfile profile;
+    ResourcePlan plan;
+    profileCircuit(&job->circuit, &profile);
+    estimateBackend(&job->circuit, &profile, BACKEND_DENSE, &plan);
+    plan.memory_bytes += (double)(job->shots + 1) * sizeof(uint64_t);
+
+    const double budget = availableMemory() / queue->num_workers;
+    if (plan.memory_bytes > budget) {
+        replyf(client, "ERROR %llu refused: needs %.3g MiB, %.3g MiB available per worker\n",
+               job->id, plan.memory_bytes / (1 << 20), budget / (1 << 20));
+        freeJob(job);
+        return;
+    }
+    if (job->received + plan.seconds > job->deadline) {
+        replyf(client, "ERROR %llu refused: needs about %.3g ms, past its deadline\n", job->id, plan.seconds * 1e3);
+        freeJob(job);
+        return;
+    }
+    retainClient(client);
+    if (pushJob(queue, job) != 0) {
+        replyf(client, "ERROR %llu out of memory\n", job->id);
+        releaseClient(client);
+        freeJob(job);
+    }
+}
+
+// Function to start a job from a CIRCUIT or SEARCH header line.
+// Circuit jobs stay pending on the client until their END line.
+static void parseHeader(Client* client, JobQueue* queue, const char* line) {
+    unsigned long long id = 0, shots = 0, seed = 0, marked = 0;
+    double deadline_ms = 0.0;
+    int num_qubits = 0;
+    JobType type;
+
+    if (sscanf(line, "CIRCUIT %llu %lf %d %llu %llu", &id, &deadline_ms, &num_qubits, &shots, &seed) == 5) {
+        type = JOB_CIRCUIT;
+    } else if (sscanf(line, "SEARCH %llu %lf %d %llu %llu %llu", &id, &deadline_ms, &num_qubits, &marked, &shots, &seed) == 6) {
+        type = JOB_SEARCH;
+        if (shots == 0 || (num_qubits >= 2 && num_qubits <= JOB_MAX_QUBITS && (marked >> num_qubits) != 0)) {
+            replyf(client, "ERROR %llu search needs shots and a marked index in range\n", id);
+            return;
+        }
+    } else {
+        replyf(client, "ERROR %llu unrecognized request\n", id);
+        return;
+    }
+    if (num_qubits < (type == JOB_SEARCH ? 2 : 1) || num_qubits > JOB_MAX_QUBITS) {
+        replyf(client, "ERROR %llu unsupported register width\n", id);
+        return;
+    }
+    if (shots > JOB_MAX_SHOTS) {
+        replyf(client, "ERROR %llu at most %llu shots per job\n", id, (unsigned long long)JOB_MAX_SHOTS);
+        return;
+    }
+
+    Job* job = (Job*)calloc(1, sizeof(Job));
+    if (job == NULL) {
+        replyf(client, "ERROR %llu out of memory\n", id);
+        return;
+    }
+    job->type = type;
+    job->id = id;
+    job->received = monotonicSeconds();
+    job->deadline = job->received + deadline_ms * 1e-3;
+    job->num_qubits = num_qubits;
+    job->shots = shots;
+    job->seed = seed;
+    job->marked = marked;
+    job->client = client;
+    initializeCircuit(&job->circuit, num_qubits);
+
+    if (type == JOB_CIRCUIT) {
+        client->pending = job;
+        return;
+    }
+    if (buildGroverCircuit(&job->circuit, num_qubits, marked) != 0) {
+        replyf(client, "ERROR %llu could not build search circuit\n", id);
+        freeJob(job);
+        return;
+    }
+    submitJob(client, queue, job);
+}
+
+// Function to handle one complete request line from a client
+static void handleLine(Client* client, JobQueue* queue, const char* line) {
+    Job* job = client->pending;
+    if (job == NULL) {
+        if (line[0] != '\0') {
+            parseHeader(client, queue, line);
+        }
+        return;
+    }
+    if (strcmp(line, "END") != 0) {
+        if (!job->failed && parseGateLine(&job->circuit, line) < 0) {
+            job->failed = 1;
+            replyf(client, "ERROR %llu bad gate line: %.200s\n", job->id, line);
+        }
+        return;
+    }
+    client->pending = NULL;
+    if (job->failed) {
+        freeJob(job);
+        return;
+    }
+    submitJob(client, queue, job);
+}
+
+// Function to read what a client sent and handle every complete line.
+// Returns -1 once the client has closed its end.
+static int readClient(Client* client, JobQueue* queue) {
+    ssize_t n = read(client->fd, client->buffer + client->length, sizeof(client->buffer) - 1 - client->length);
+    if (n < 0 && errno == EINTR) {
+        return 0;
+    }
+    if (n <= 0) {
+        return -1;
+    }
+    client->length += (size_t)n;
+
+    size_t start = 0;
+    for (size_t i = 0; i < client->length; i++) {
+        if (client->buffer[i] == '\n') {
+            client->buffer[i] = '\0';
+            if (i > start && client->buffer[i - 1] == '\r') {
+                client->buffer[i - 1] = '\0';
+            }
+            handleLine(client, queue, client->buffer + start);
+            start = i + 1;
+        }
+    }
+    memmove(client->buffer, client->buffer + start, client->length - start);
+    client->length -= start;
+    if (client->length == sizeof(client->buffer) - 1) {
+        replyf(client, "ERROR 0 line too long\n");
+        client->length = 0;
+    }
+    return 0;
+}
+
+// Function to create, bind and listen on the server socket
+static int openServerSocket(const char* path) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path is too long\n");
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 128) != 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <socket path> [workers] [preallocate qubits]\n", argv[0]);
+        return 1;
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_workers = argc > 2 ? atoi(argv[2]) : (int)(cpus > 0 ? cpus : 1);
+    int preallocate = argc > 3 ? atoi(argv[3]) : 0;
+    if (num_workers < 1 || preallocate < 0 || preallocate > JOB_MAX_QUBITS) {
+        fprintf(stderr, "Error: Invalid worker count or register width\n");
+        return 1;
+    }
+
+    int listen_fd = openServerSocket(argv[1]);
+    if (listen_fd < 0) {
+        return 1;
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handleStop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    JobQueue queue;
+    memset(&queue, 0, sizeof(queue));
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.ready, NULL);
+    queue.num_workers = num_workers;
+
+    // Split the cores between workers so their OpenMP teams do not oversubscribe
+    WorkerConfig config = { &queue, (int)(cpus > num_workers ? cpus / num_workers : 1), preallocate };
+    pthread_t* workers = (pthread_t*)malloc(num_workers * sizeof(pthread_t));
+    if (workers == NULL) {
+        return 1;
+    }
+    for (int w = 0; w < num_workers; w++) {
+        pthread_create(&workers[w], NULL, workerMain, &config);
+    }
+    printf("Listening on %s with %d workers\n", argv[1], num_workers);
+    fflush(stdout);
+
+    struct pollfd fds[MAX_CLIENTS + 1];
+    Client* clients[MAX_CLIENTS];
+    int num_clients = 0;
+
+    while (!stop_requested) {
+        // Clients that stopped sending stay until their jobs are answered; their
+        // last references are dropped by workers, so look again every few ms
+        int draining = 0;
+        fds[0].fd = listen_fd;
+        fds[0].events = num_clients < MAX_CLIENTS ? POLLIN : 0;
+        for (int c = 0; c < num_clients; c++) {
+            Client* client = clients[c];
+            pthread_mutex_lock(&client->lock);
+            int has_output = client->out_length > client->out_start;
+            pthread_mutex_unlock(&client->lock);
+            short events = (client->reading ? POLLIN : 0) | (has_output ? POLLOUT : 0);
+            fds[c + 1].fd = events != 0 ? client->fd : -1;
+            fds[c + 1].events = events;
+            fds[c + 1].revents = 0;
+            draining |= !client->reading;
+        }
+        if (poll(fds, num_clients + 1, draining ? JOB_DRAIN_POLL_MS : -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+
+        for (int c = num_clients - 1; c >= 0; c--) {
+            Client* client = clients[c];
+            pthread_mutex_lock(&client->lock);
+            if (fds[c + 1].revents & (POLLOUT | POLLERR | POLLHUP)) {
+                flushOutboxLocked(client);
+            }
+            int broken = client->broken;
+            pthread_mutex_unlock(&client->lock);
+            if (client->reading && (broken || ((fds[c + 1].revents & (POLLIN | POLLERR | POLLHUP)) &&
+                                               readClient(client, &queue) != 0))) {
+                if (client->pending != NULL) {
+                    freeJob(client->pending);
+                    client->pending = NULL;
+                }
+                shutdown(client->fd, SHUT_RD);
+                client->reading = 0;
+            }
+            if (!client->reading) {
+                pthread_mutex_lock(&client->lock);
+                int finished = client->refs == 1 && client->out_length == client->out_start;
+                pthread_mutex_unlock(&client->lock);
+                if (finished) {
+                    releaseClient(client);
+                    clients[c] = clients[--num_clients];
+                }
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            Client* client = fd >= 0 ? (Client*)calloc(1, sizeof(Client)) : NULL;
+            if (client == NULL) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+                continue;
+            }
+            client->fd = fd;
+            client->refs = 1;
+            client->reading = 1;
+            pthread_mutex_init(&client->lock, NULL);
+            pthread_cond_init(&client->drained, NULL);
+            clients[num_clients++] = client;
+        }
+    }
+
+    // Let queued jobs finish, writing their replies synchronously now that the
+    // main loop no longer drains outboxes, then stop the workers
+    for (int c = 0; c < num_clients; c++) {
+        pthread_mutex_lock(&clients[c]->lock);
+        clients[c]->blocking = 1;
+        flushOutboxLocked(clients[c]);
+        pthread_mutex_unlock(&clients[c]->lock);
+    }
+    pthread_mutex_lock(&queue.lock);
+    queue.stopping = 1;
+    pthread_cond_broadcast(&queue.ready);
+    pthread_mutex_unlock(&queue.lock);
+    for (int w = 0; w < num_workers; w++) {
+        pthread_join(workers[w], NULL);
+    }
+    for (int c = 0; c < num_clients; c++) {
+        if (clients[c]->pending != NULL) {
+            freeJob(clients[c]->pending);
+        }
+        releaseClient(clients[c]);
+    }
+    close(listen_fd);
+    unlink(argv[1]);
+    free(workers);
+    free(queue.jobs);
+    return 0;
+}
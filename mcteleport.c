@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include "montecarlo.h"
+#include "noise.h"
+
+// Input state RY(TELEPORT_ANGLE)|0> teleported in the noisy study
+#define TELEPORT_ANGLE 1.1
+
+// Function to estimate how well a state survives teleportation under
+// depolarizing noise after every gate. The protocol runs in deferred-measurement
+// form on noise.c's trajectory executor: Alice's measurements become a CX and a
+// CZ onto Bob's qubit. Bob's Bloch vector gives the fidelity with the input.
+// Returns 0 on success, -1 on failure.
+static int runNoisyTeleportation(double probability, uint64_t trajectories, uint64_t seed) {
+    Circuit circuit;
+    initializeCircuit(&circuit, 3);
+    addRotationGate(&circuit, GATE_RY, 0, TELEPORT_ANGLE);
+    const char* lines[] = { "H 1", "CX 1 2", "CX 0 1", "H 0", "CX 1 2", "CZ 0 2", NULL };
+    for (int i = 0; lines[i] != NULL; i++) {
+        if (parseGateLine(&circuit, lines[i]) < 0) {
+            fprintf(stderr, "Error: Bad teleportation gate %s\n", lines[i]);
+            freeCircuit(&circuit);
+            return -1;
+        }
+    }
+
+    NoisyCircuit noisy;
+    initializeNoisyCircuit(&noisy, &circuit);
+    Observable bloch[3];
+    const char* axes[3] = { "X2", "Y2", "Z2" };
+    int status = addNoiseAfterEveryGate(&noisy, NOISE_DEPOLARIZING, probability);
+    for (int a = 0; a < 3; a++) {
+        initializeObservable(&bloch[a]);
+        status |= addPauliTerm(&bloch[a], 1.0, axes[a]);
+    }
+
+    TrajectoryStats stats;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (status == 0) {
+        status = runTrajectories(&noisy, bloch, 3, trajectories, seed, 0, NULL, NULL, &stats);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (status == 0) {
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+        double overlap = stats.mean[0] * sin(TELEPORT_ANGLE) + stats.mean[2] * cos(TELEPORT_ANGLE);
+        printf("Noisy trajectories: %llu in %.3f s, depolarizing p = %g after every gate\n",
+               (unsigned long long)stats.trajectories, seconds, probability);
+        printf("Bob's Bloch vector: (%.4f, %.4f, %.4f)\n", stats.mean[0], stats.mean[1], stats.mean[2]);
+        printf("Teleportation fidelity: %.6f\n", 0.5 * (1.0 + overlap));
+        freeTrajectoryStats(&stats);
+    }
+
+    for (int a = 0; a < 3; a++) {
+        freeObservable(&bloch[a]);
+    }
+    freeNoisyCircuit(&noisy);
+    freeCircuit(&circuit);
+    return status == 0 ? 0 : -1;
+}
+
+// Monte Carlo study of the teleportation protocol: runs many independent
+// instances with random input bits and reports the outcome statistics. With a
+// noise probability, it also teleports a fixed state through noisy trajectories.
+// Usage: mcteleport [runs] [seed] [noise probability] [trajectories]
+int main(int argc, char* argv[]) {
+    uint64_t runs = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000000ULL;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+    double noise = argc > 3 ? atof(argv[3]) : 0.0;
+    uint64_t trajectories = argc > 4 ? strtoull(argv[4], NULL, 10) : 10000;
+
+    McProtocol protocol;
+    buildTeleportationProtocol(&protocol);
+
+    McTally tally;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (runMonteCarlo(&protocol, runs, seed, &tally) != 0) {
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    uint64_t ones = 0;
+    for (int r = 0; r < (1 << tally.num_bits); r++) {
+        if (r & 1) {
+            ones += tally.counts[r];
+        }
+    }
+    printf("Runs: %llu in %.3f s (%.3g runs per minute)\n",
+           (unsigned long long)runs, seconds, runs / seconds * 60.0);
+    printf("Input bit 1 fraction: %.6f\n", (double)ones / (double)runs);
+    printf("Bit-error rate: %.3g\n", tallyMismatchRate(&tally, 0, 3));
+    for (int m = 0; m < 4; m++) {
+        uint64_t count = 0;
+        for (int r = 0; r < (1 << tally.num_bits); r++) {
+            if (((r >> 1) & 3) == m) {
+                count += tally.counts[r];
+            }
+        }
+        printf("Alice measured %d%d: %.6f\n", m & 1, (m >> 1) & 1, (double)count / (double)runs);
+    }
+    if (noise > 0.0 && runNoisyTeleportation(noise, trajectories, seed) != 0) {
+        return 1;
+    }
+    return 0;
+}
@@ -5,6 +5,10 @@
 #include <openssl/md5.h>
 #include <openssl/evp.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <time.h>
+#include "instrument.h"
+#include "pipeline.h"
 
 // Define the qubit structure
 typedef struct {
@@ -42,6 +46,7 @@ void applyPauliXGate(Qubit* qubit) {
 
 // Function to convert a string to MD5 hash
 void md5Hash(const char *str, unsigned char *hash) {
+    INSTRUMENT_COUNT(COUNTER_HASHES, 1);
     EVP_MD_CTX *ctx = EVP_MD_CTX_new();
     EVP_DigestInit_ex(ctx, EVP_md5(), NULL);
     EVP_DigestUpdate(ctx, str, strlen(str));
@@ -49,46 +54,38 @@ void md5Hash(const char *str, unsigned char *hash) {
     EVP_MD_CTX_free(ctx);
 }
 
-// Function to simulate a brute-force attack using qubits
+// Function to simulate a brute-force attack using qubits. Candidates are
+// generated, hashed and matched by separate thread stages (see pipeline.c).
 void bruteForceMD5(const char *target_hash) {
-    char candidate[4] = {'a', 'a', 'a', '\0'}; // Start with 'aaa'
-    unsigned char hash[MD5_DIGEST_LENGTH];
-
-    // Iterate through all possible strings
-    while (1) {
-        // Calculate the MD5 hash of the candidate string
-        md5Hash(candidate, hash);
+    INSTRUMENT_SCOPE("bruteForceMD5");
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    PipelineConfig config;
+    config.alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"; // main() uppercases the input
+    config.length = 3;
+    memcpy(config.target, target_hash, MD5_DIGEST_LENGTH);
+    config.samplers = 1;
+    config.hashers = cores > 2 ? (int)cores - 2 : 1;
+    config.ring_batches = 16;
+    config.random_order = 1;        // Measured candidates arrive in random order, without repeats
+    config.seed = (uint64_t)time(NULL);
+
+    PipelineStats stats;
+    if (runHashPipeline(&config, &stats) != 0) {
+        return;
+    }
 
-        // Check if the hash matches the target hash
-        int match = 1;
+    // If a match is found, print the encoded message and the hash
+    if (stats.found) {
+        printf("Encoded message: %s\n", stats.match);
+        printf("Hash: ");
         for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
-            if (hash[i] != target_hash[i]) {
-                match = 0;
-                break;
-            }
-        }
-
-        // If a match is found, print the encoded message and the hash
-        if (match) {
-            printf("Encoded message: %s\n", candidate);
-            printf("Hash: ");
-            for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
-                printf("%02x", hash[i]);
-            }
-            printf("\n");
-            break;
-        }
-
-        // Increment the candidate string (brute-force)
-        for (int i = 2; i >= 0; i--) {
-            if (candidate[i] == 'z') {
-                candidate[i] = 'a'; // Reset to 'a' if 'z' is reached
-            } else {
-                candidate[i]++;
-                break;
-            }
+            printf("%02x", (unsigned char)target_hash[i]);
         }
+        printf("\n");
+    } else {
+        printf("No match found.\n");
     }
+    printPipelineStats(&stats);
 }
 
 int main() {
@@ -116,5 +113,8 @@ int main() {
     // Simulate a brute-force attack using qubits
     bruteForceMD5(target_hash);
 
+#ifdef QSIM_INSTRUMENT
+    writeInstrumentSummary(stderr);
+#endif
     return 0;
 }
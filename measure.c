@@ -0,0 +1,350 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "measure.h"
+#include "instrument.h"
+
+// Function to draw a measurement outcome of target with |1> probability p1 and
+// return the probability of the outcome drawn
+static int drawOutcome(double p1, double u, double* probability) {
+    p1 = fmin(fmax(p1, 0.0), 1.0);
+    int outcome = u < p1;
+    *probability = outcome ? p1 : 1.0 - p1;
+    return outcome;
+}
+
+// Function to collapse target onto outcome, which had the given probability,
+// and renormalize, all in one pass over the amplitude pairs of target. When
+// next_target is a qubit, the same pass sums its |1> marginal in the collapsed
+// state, which is returned; otherwise 0 is returned.
+double collapseQubit(QubitRegister* reg, int target, int outcome, double probability, int next_target) {
+    double complex* amp = reg->amplitudes;
+    const uint64_t stride = 1ULL << target;
+    const uint64_t keep_bit = outcome ? stride : 0;
+    const uint64_t next = next_target >= 0 && next_target != target ? 1ULL << next_target : 0;
+    const int64_t half = (int64_t)(reg->size >> 1);
+    const double scale = probability > 0.0 ? 1.0 / sqrt(probability) : 0.0;
+    double sum = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:sum) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < half; k++) {
+        uint64_t i0 = insertZeroBits((uint64_t)k, stride);
+        double complex kept = amp[i0 | keep_bit] * scale;
+        amp[i0 | keep_bit] = kept;
+        amp[i0 | (keep_bit ^ stride)] = 0.0;
+        if ((i0 | keep_bit) & next) {
+            sum += creal(kept) * creal(kept) + cimag(kept) * cimag(kept);
+        }
+    }
+    INSTRUMENT_COUNT(COUNTER_AMPLITUDES, reg->size);
+    if (next_target == target) {
+        return outcome ? 1.0 : 0.0;
+    }
+    return sum;
+}
+
+// Function to collapse target onto outcome and bring it back to |0> in the
+// same pass (measure, then X if the outcome was 1). Returns the |1> marginal
+// of next_target afterwards as collapseQubit does.
+double resetQubit(QubitRegister* reg, int target, int outcome, double probability, int next_target) {
+    double complex* amp = reg->amplitudes;
+    const uint64_t stride = 1ULL << target;
+    const uint64_t keep_bit = outcome ? stride : 0;
+    const uint64_t next = next_target >= 0 && next_target != target ? 1ULL << next_target : 0;
+    const int64_t half = (int64_t)(reg->size >> 1);
+    const double scale = probability > 0.0 ? 1.0 / sqrt(probability) : 0.0;
+    double sum = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:sum) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < half; k++) {
+        uint64_t i0 = insertZeroBits((uint64_t)k, stride);
+        double complex kept = amp[i0 | keep_bit] * scale;
+        amp[i0] = kept;
+        amp[i0 | stride] = 0.0;
+        if (i0 & next) {
+            sum += creal(kept) * creal(kept) + cimag(kept) * cimag(kept);
+        }
+    }
+    INSTRUMENT_COUNT(COUNTER_AMPLITUDES, reg->size);
+    return sum;
+}
+
+// Function to measure target given a uniform draw u in [0, 1): one reduction
+// for the marginal, one fused collapse pass. Returns the outcome.
+int measureAndCollapse(QubitRegister* reg, int target, double u) {
+    double probability;
+    int outcome = drawOutcome(qubitProbability(reg, target), u, &probability);
+    collapseQubit(reg, target, outcome, probability, -1);
+    return outcome;
+}
+
+// Function to initialize an empty dynamic circuit on num_qubits qubits and
+// num_bits classical bits
+void initializeDynamicCircuit(DynamicCircuit* circuit, int num_qubits, int num_bits) {
+    circuit->num_qubits = num_qubits;
+    circuit->num_bits = num_bits;
+    circuit->num_ops = 0;
+    circuit->capacity = 0;
+    circuit->ops = NULL;
+}
+
+void freeDynamicCircuit(DynamicCircuit* circuit) {
+    free(circuit->ops);
+    circuit->ops = NULL;
+    circuit->num_ops = 0;
+    circuit->capacity = 0;
+}
+
+// Function to append an operation, growing the array geometrically.
+// Returns its index, or -1 on bad indices or allocation failure.
+static int appendDynamicOp(DynamicCircuit* circuit, const DynamicOp* op) {
+    if (circuit->num_bits < 0 || circuit->num_bits > MAX_CLASSICAL_BITS) {
+        fprintf(stderr, "Error: A circuit holds at most %d classical bits.\n", MAX_CLASSICAL_BITS);
+        return -1;
+    }
+    if (op->type != DYNAMIC_GATE && (op->gate.targets[0] < 0 || op->gate.targets[0] >= circuit->num_qubits)) {
+        return -1;
+    }
+    if (op->type == DYNAMIC_MEASURE && (op->bit < 0 || op->bit >= circuit->num_bits)) {
+        return -1;
+    }
+    if (circuit->num_ops == circuit->capacity) {
+        int capacity = circuit->capacity > 0 ? 2 * circuit->capacity : 16;
+        DynamicOp* ops = (DynamicOp*)realloc(circuit->ops, capacity * sizeof(DynamicOp));
+        if (ops == NULL) {
+            fprintf(stderr, "Error: Out of memory for dynamic circuit operations.\n");
+            return -1;
+        }
+        circuit->ops = ops;
+        circuit->capacity = capacity;
+    }
+    circuit->ops[circuit->num_ops] = *op;
+    return circuit->num_ops++;
+}
+
+// Function to get the mask of a classical bit, or 0 if it is out of range
+static uint64_t bitMask(const DynamicCircuit* circuit, int bit) {
+    return bit >= 0 && bit < circuit->num_bits ? 1ULL << bit : 0;
+}
+
+// Function to append every gate of a circuit, parameters resolved, under one
+// condition (mask 0 for none). Returns 0, or -1 if the gates do not fit.
+int addDynamicGates(DynamicCircuit* circuit, const Circuit* gates, uint64_t condition_mask, uint64_t condition_value) {
+    if (gates->num_qubits > circuit->num_qubits) {
+        fprintf(stderr, "Error: Gates on %d qubits do not fit a %d-qubit circuit.\n",
+                gates->num_qubits, circuit->num_qubits);
+        return -1;
+    }
+    for (int g = 0; g < gates->num_gates; g++) {
+        DynamicOp op;
+        memset(&op, 0, sizeof(op));
+        op.type = DYNAMIC_GATE;
+        op.gate = gates->gates[g];
+        op.gate.parameter = gateParameter(gates, &gates->gates[g]);
+        op.gate.param_index = -1;
+        op.bit = -1;
+        op.condition_mask = condition_mask;
+        op.condition_value = condition_value & condition_mask;
+        if (appendDynamicOp(circuit, &op) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to append a measurement of target into a classical bit
+int addMeasurement(DynamicCircuit* circuit, int target, int bit) {
+    DynamicOp op;
+    memset(&op, 0, sizeof(op));
+    op.type = DYNAMIC_MEASURE;
+    op.gate.targets[0] = target;
+    op.gate.param_index = -1;
+    op.bit = bit;
+    return appendDynamicOp(circuit, &op);
+}
+
+// Function to append a reset of target to |0>
+int addReset(DynamicCircuit* circuit, int target) {
+    DynamicOp op;
+    memset(&op, 0, sizeof(op));
+    op.type = DYNAMIC_RESET;
+    op.gate.targets[0] = target;
+    op.gate.param_index = -1;
+    op.bit = -1;
+    return appendDynamicOp(circuit, &op);
+}
+
+// Function to append a single-qubit gate that only acts when a classical bit is 1
+int addConditionalGate(DynamicCircuit* circuit, GateType type, int target, double parameter, int bit) {
+    const uint64_t mask = bitMask(circuit, bit);
+    if (mask == 0 || isTwoQubitGate(type) || target < 0 || target >= circuit->num_qubits) {
+        return -1;
+    }
+    DynamicOp op;
+    memset(&op, 0, sizeof(op));
+    op.type = DYNAMIC_GATE;
+    op.gate.type = type;
+    op.gate.targets[0] = target;
+    op.gate.parameter = parameter;
+    op.gate.param_index = -1;
+    op.bit = -1;
+    op.condition_mask = mask;
+    op.condition_value = mask;
+    return appendDynamicOp(circuit, &op);
+}
+
+// Function to append one operation given as a line of the text format, which
+// extends the gate lines of parseGateLine with
+//   M q b           measure qubit q into classical bit b
+//   RESET q         measure qubit q and return it to |0>
+//   IF b LINE       run LINE only when classical bit b is 1, e.g. "IF 1 X 2"
+// Returns the operation index, or -1 if the line is invalid.
+int parseDynamicLine(DynamicCircuit* circuit, const char* line) {
+    char name[32];
+    int offset = 0;
+    if (sscanf(line, " %31s%n", name, &offset) != 1) {
+        return -1;
+    }
+    const char* p = line + offset;
+    int q, b, used = 0;
+
+    if (strcmp(name, "IF") == 0) {
+        if (sscanf(p, " %d%n", &b, &used) != 1 || bitMask(circuit, b) == 0) {
+            return -1;
+        }
+        int index = parseDynamicLine(circuit, p + used);
+        if (index >= 0) {
+            circuit->ops[index].condition_mask |= 1ULL << b;
+            circuit->ops[index].condition_value |= 1ULL << b;
+        }
+        return index;
+    }
+    if (strcmp(name, "M") == 0 || strcmp(name, "MEASURE") == 0) {
+        if (sscanf(p, " %d %d %n", &q, &b, &used) != 2 || p[used] != '\0') {
+            return -1;
+        }
+        return addMeasurement(circuit, q, b);
+    }
+    if (strcmp(name, "RESET") == 0) {
+        if (sscanf(p, " %d %n", &q, &used) != 1 || p[used] != '\0') {
+            return -1;
+        }
+        return addReset(circuit, q);
+    }
+
+    Circuit scratch;
+    initializeCircuit(&scratch, circuit->num_qubits);
+    int index = -1;
+    if (parseGateLine(&scratch, line) >= 0) {
+        const Gate* gate = &scratch.gates[0];
+        uint64_t qubits = gate->controls | (1ULL << gate->targets[0]);
+        if (isTwoQubitGate(gate->type)) {
+            qubits |= 1ULL << gate->targets[1];
+        }
+        if (circuit->num_qubits >= 64 || (qubits >> circuit->num_qubits) == 0) {
+            index = circuit->num_ops;
+            if (addDynamicGates(circuit, &scratch, 0, 0) != 0) {
+                index = -1;
+            }
+        }
+    }
+    freeCircuit(&scratch);
+    return index;
+}
+
+// Function to check whether an operation runs under the current classical bits
+static int conditionHolds(const DynamicOp* op, uint64_t bits) {
+    return (bits & op->condition_mask) == op->condition_value;
+}
+
+// Function to run a dynamic circuit on a register, drawing measurement
+// outcomes from rng and keeping outcomes in *bits (set it to 0 first for a
+// fresh classical register). Returns 0, or -1 if the circuit does not fit.
+int runDynamicCircuit(QubitRegister* reg, const DynamicCircuit* circuit, Rng* rng, uint64_t* bits) {
+    if (circuit->num_qubits > reg->num_qubits) {
+        fprintf(stderr, "Error: Dynamic circuit on %d qubits does not fit a %d-qubit register.\n",
+                circuit->num_qubits, reg->num_qubits);
+        return -1;
+    }
+    // |1> marginal of the next measured qubit when the last collapse pass
+    // already summed it, or -1
+    double marginal = -1.0;
+
+    for (int i = 0; i < circuit->num_ops; i++) {
+        const DynamicOp* op = &circuit->ops[i];
+        if (!conditionHolds(op, *bits)) {
+            continue;
+        }
+        if (op->type == DYNAMIC_GATE) {
+            applyGate(reg, &op->gate, op->gate.parameter);
+            marginal = -1.0;
+            continue;
+        }
+
+        const int target = op->gate.targets[0];
+        if (marginal < 0.0) {
+            marginal = qubitProbability(reg, target);
+        }
+        double probability;
+        const int outcome = drawOutcome(marginal, uniformRng(rng), &probability);
+        if (op->type == DYNAMIC_MEASURE) {
+            *bits = (*bits & ~(1ULL << op->bit)) | ((uint64_t)outcome << op->bit);
+        }
+
+        // Fuse the next marginal into this pass if the next operation is a
+        // measurement or reset that will run
+        int next_target = -1;
+        if (i + 1 < circuit->num_ops) {
+            const DynamicOp* next = &circuit->ops[i + 1];
+            if (next->type != DYNAMIC_GATE && conditionHolds(next, *bits)) {
+                next_target = next->gate.targets[0];
+            }
+        }
+        marginal = op->type == DYNAMIC_MEASURE
+            ? collapseQubit(reg, target, outcome, probability, next_target)
+            : resetQubit(reg, target, outcome, probability, next_target);
+        if (next_target < 0) {
+            marginal = -1.0;
+        }
+    }
+    return 0;
+}
+
+// Function to run a dynamic circuit shots times from |0...0> and store each
+// shot's classical register in records. Shot s draws from stream s of seed, so
+// results do not depend on the thread count. Small registers run one shot per
+// thread; wide ones run shots in turn with every pass parallel.
+// Returns 0, or -1 if a register cannot be allocated.
+int sampleDynamicCircuit(const DynamicCircuit* circuit, uint64_t shots, uint64_t seed, uint64_t* records) {
+    INSTRUMENT_SCOPE("sampleDynamicCircuit");
+    const int per_thread = (1ULL << circuit->num_qubits) < PARALLEL_THRESHOLD;
+    const int64_t n = (int64_t)shots;
+    int failed = 0;
+
+    #pragma omp parallel if (per_thread && shots > 1)
+    {
+        QubitRegister* reg = initializeRegister(circuit->num_qubits);
+        if (reg == NULL) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        #pragma omp for schedule(dynamic, 16)
+        for (int64_t s = 0; s < n; s++) {
+            if (reg == NULL) {
+                continue;
+            }
+            Rng rng;
+            seedRng(&rng, seed, (uint64_t)s);
+            resetRegister(reg);
+            records[s] = 0;
+            runDynamicCircuit(reg, circuit, &rng, &records[s]);
+        }
+        freeRegister(reg);
+    }
+    if (failed) {
+        fprintf(stderr, "Error: Out of memory for a %d-qubit shot register.\n", circuit->num_qubits);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef MEASURE_H
+#define MEASURE_H
+
+#include <stdint.h>
+#include "statevector.h"
+#include "circuit.h"
+#include "rng.h"
+
+// Mid-circuit measurement on the dense register with classical feed-forward.
+// A measurement takes the marginal of its qubit with one reduction over the
+// |1> half of the state, then collapses and renormalizes in a single fused
+// pass; when another measurement or reset follows, that pass also takes the
+// next qubit's marginal, so a run of k measurements costs k + 1 passes
+// instead of 2k. Outcomes go into a classical register of up to 64 bits,
+// which conditional gates read while the circuit runs.
+
+#define MAX_CLASSICAL_BITS 64
+
+typedef enum {
+    DYNAMIC_GATE,        // gate, applied when the condition holds
+    DYNAMIC_MEASURE,     // measure gate.targets[0] into bit and collapse
+    DYNAMIC_RESET        // measure gate.targets[0] and return it to |0>
+} DynamicOpType;
+
+// One operation. Every type may be conditioned on the classical register: it
+// runs only when (bits & condition_mask) == condition_value.
+typedef struct {
+    DynamicOpType type;
+    Gate gate;                  // Parameter already resolved
+    int bit;
+    uint64_t condition_mask;
+    uint64_t condition_value;
+} DynamicOp;
+
+typedef struct {
+    int num_qubits;
+    int num_bits;
+    int num_ops;
+    int capacity;
+    DynamicOp* ops;
+} DynamicCircuit;
+
+int measureAndCollapse(QubitRegister* reg, int target, double u);
+double collapseQubit(QubitRegister* reg, int target, int outcome, double probability, int next_target);
+double resetQubit(QubitRegister* reg, int target, int outcome, double probability, int next_target);
+
+void initializeDynamicCircuit(DynamicCircuit* circuit, int num_qubits, int num_bits);
+void freeDynamicCircuit(DynamicCircuit* circuit);
+int addDynamicGates(DynamicCircuit* circuit, const Circuit* gates, uint64_t condition_mask, uint64_t condition_value);
+int addMeasurement(DynamicCircuit* circuit, int target, int bit);
+int addReset(DynamicCircuit* circuit, int target);
+int addConditionalGate(DynamicCircuit* circuit, GateType type, int target, double parameter, int bit);
+int parseDynamicLine(DynamicCircuit* circuit, const char* line);
+
+int runDynamicCircuit(QubitRegister* reg, const DynamicCircuit* circuit, Rng* rng, uint64_t* bits);
+int sampleDynamicCircuit(const DynamicCircuit* circuit, uint64_t shots, uint64_t seed, uint64_t* records);
+
+#endif
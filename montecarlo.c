@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "montecarlo.h"
+#include "rng.h"
+#include "instrument.h"
+
+// One batch of instances in structure-of-arrays form, with one RNG stream per instance
+typedef struct {
+    double re[MC_STATES][MC_BATCH];
+    double im[MC_STATES][MC_BATCH];
+    uint64_t bits[MC_MAX_BITS][MC_BATCH];
+    uint64_t rng[4][MC_BATCH];
+    double uniform[MC_BATCH];
+    double scale[MC_BATCH];
+} McBatch;
+
+// Function to initialize an empty protocol over num_bits classical bits
+void initializeProtocol(McProtocol* protocol, int num_bits) {
+    protocol->num_steps = 0;
+    protocol->num_bits = num_bits;
+}
+
+// Function to append a step, checking its qubit and bit indices
+static int appendProtocolStep(McProtocol* protocol, McStepType type, int target, int control, int bit) {
+    if (protocol->num_steps == MC_MAX_STEPS || target < 0 || target >= MC_QUBITS) {
+        return -1;
+    }
+    if (type == MC_CNOT && (control < 0 || control >= MC_QUBITS || control == target)) {
+        return -1;
+    }
+    if (type != MC_GATE && type != MC_CNOT && (bit < 0 || bit >= protocol->num_bits)) {
+        return -1;
+    }
+    McStep* step = &protocol->steps[protocol->num_steps++];
+    memset(step, 0, sizeof(McStep));
+    step->type = type;
+    step->target = target;
+    step->control = control;
+    step->bit = bit;
+    return 0;
+}
+
+// Function to append a single-qubit gate. Returns 0 on success, -1 on bad input.
+int addProtocolGate(McProtocol* protocol, GateType type, int target, double parameter) {
+    if (isTwoQubitGate(type) || appendProtocolStep(protocol, MC_GATE, target, -1, -1) != 0) {
+        return -1;
+    }
+    singleQubitGateMatrix(type, parameter, protocol->steps[protocol->num_steps - 1].m);
+    return 0;
+}
+
+// Function to append a CNOT. Returns 0 on success, -1 on bad input.
+int addProtocolCnot(McProtocol* protocol, int control, int target) {
+    return appendProtocolStep(protocol, MC_CNOT, target, control, -1);
+}
+
+// Function to append a computational-basis measurement of target into a classical bit
+int addProtocolMeasurement(McProtocol* protocol, int target, int bit) {
+    return appendProtocolStep(protocol, MC_MEASURE, target, -1, bit);
+}
+
+// Function to append a fair coin flip into a classical bit
+int addProtocolRandomBit(McProtocol* protocol, int bit) {
+    return appendProtocolStep(protocol, MC_RANDOM_BIT, 0, -1, bit);
+}
+
+// Function to append a gate that only acts when a classical bit is 1
+int addProtocolConditionalGate(McProtocol* protocol, GateType type, int target, double parameter, int bit) {
+    if (isTwoQubitGate(type) || appendProtocolStep(protocol, MC_CONDITIONAL_GATE, target, -1, bit) != 0) {
+        return -1;
+    }
+    singleQubitGateMatrix(type, parameter, protocol->steps[protocol->num_steps - 1].m);
+    return 0;
+}
+
+// Function to build the teleportation protocol of tp.c as a Monte Carlo study.
+// Bit 0 is a random input prepared on qubit 0, bits 1 and 2 are Alice's
+// measurements, and bit 3 is Bob's qubit measured at the end; an ideal run
+// always has bit 3 equal to bit 0.
+void buildTeleportationProtocol(McProtocol* protocol) {
+    initializeProtocol(protocol, 4);
+    addProtocolRandomBit(protocol, 0);
+    addProtocolConditionalGate(protocol, GATE_X, 0, 0.0, 0);
+    addProtocolGate(protocol, GATE_H, 1, 0.0);
+    addProtocolCnot(protocol, 1, 2);
+    addProtocolCnot(protocol, 0, 1);
+    addProtocolGate(protocol, GATE_H, 0, 0.0);
+    addProtocolMeasurement(protocol, 0, 1);
+    addProtocolMeasurement(protocol, 1, 2);
+    addProtocolConditionalGate(protocol, GATE_X, 2, 0.0, 2);
+    addProtocolConditionalGate(protocol, GATE_Z, 2, 0.0, 1);
+    addProtocolMeasurement(protocol, 2, 3);
+}
+
+// Function to seed one RNG stream per instance; stream ids are global run
+// indices, so results do not depend on the thread count
+static void seedBatch(McBatch* batch, uint64_t seed, uint64_t first_run) {
+    for (int k = 0; k < MC_BATCH; k++) {
+        Rng rng;
+        seedRng(&rng, seed, first_run + k);
+        for (int i = 0; i < 4; i++) {
+            batch->rng[i][k] = rng.s[i];
+        }
+    }
+    memset(batch->re, 0, sizeof(batch->re));
+    memset(batch->im, 0, sizeof(batch->im));
+    memset(batch->bits, 0, sizeof(batch->bits));
+    for (int k = 0; k < MC_BATCH; k++) {
+        batch->re[0][k] = 1.0;
+    }
+}
+
+// Function to draw one uniform double in [0, 1) per instance. This is the
+// xoshiro256** step of rng.h across lanes; the double is built from the top
+// 52 bits through the exponent trick, which vectorizes without AVX-512.
+static void drawUniforms(McBatch* batch) {
+    uint64_t* restrict s0 = batch->rng[0];
+    uint64_t* restrict s1 = batch->rng[1];
+    uint64_t* restrict s2 = batch->rng[2];
+    uint64_t* restrict s3 = batch->rng[3];
+    double* restrict out = batch->uniform;
+    INSTRUMENT_COUNT(COUNTER_RNG_DRAWS, MC_BATCH);
+
+    #pragma omp simd
+    for (int k = 0; k < MC_BATCH; k++) {
+        uint64_t x = s1[k] * 5;
+        uint64_t result = ((x << 7) | (x >> 57)) * 9;
+        uint64_t t = s1[k] << 17;
+        s2[k] ^= s0[k];
+        s3[k] ^= s1[k];
+        s1[k] ^= s2[k];
+        s0[k] ^= s3[k];
+        s2[k] ^= t;
+        s3[k] = (s3[k] << 45) | (s3[k] >> 19);
+        union { uint64_t u; double d; } bits = { (result >> 12) | 0x3FF0000000000000ULL };
+        out[k] = bits.d - 1.0;
+    }
+}
+
+// Function to apply a 2x2 gate to every instance, or only to those whose
+// classical bit is set when cond is given
+static void batchGate(McBatch* batch, int target, const double complex m[2][2], const uint64_t* cond) {
+    const int stride = 1 << target;
+    const double m00r = creal(m[0][0]), m00i = cimag(m[0][0]);
+    const double m01r = creal(m[0][1]), m01i = cimag(m[0][1]);
+    const double m10r = creal(m[1][0]), m10i = cimag(m[1][0]);
+    const double m11r = creal(m[1][1]), m11i = cimag(m[1][1]);
+
+    for (int i0 = 0; i0 < MC_STATES; i0++) {
+        if (i0 & stride) {
+            continue;
+        }
+        double* restrict r0 = batch->re[i0];
+        double* restrict q0 = batch->im[i0];
+        double* restrict r1 = batch->re[i0 | stride];
+        double* restrict q1 = batch->im[i0 | stride];
+
+        #pragma omp simd
+        for (int k = 0; k < MC_BATCH; k++) {
+            double ar = r0[k], ai = q0[k], br = r1[k], bi = q1[k];
+            double nr0 = m00r * ar - m00i * ai + m01r * br - m01i * bi;
+            double ni0 = m00r * ai + m00i * ar + m01r * bi + m01i * br;
+            double nr1 = m10r * ar - m10i * ai + m11r * br - m11i * bi;
+            double ni1 = m10r * ai + m10i * ar + m11r * bi + m11i * br;
+            int on = cond == NULL || cond[k] != 0;
+            r0[k] = on ? nr0 : ar;
+            q0[k] = on ? ni0 : ai;
+            r1[k] = on ? nr1 : br;
+            q1[k] = on ? ni1 : bi;
+        }
+    }
+}
+
+// Function to apply a CNOT to every instance by swapping amplitude rows
+static void batchCnot(McBatch* batch, int control, int target) {
+    const int cbit = 1 << control, tbit = 1 << target;
+    for (int i = 0; i < MC_STATES; i++) {
+        if (!(i & cbit) || (i & tbit)) {
+            continue;
+        }
+        double* restrict r0 = batch->re[i];
+        double* restrict q0 = batch->im[i];
+        double* restrict r1 = batch->re[i | tbit];
+        double* restrict q1 = batch->im[i | tbit];
+
+        #pragma omp simd
+        for (int k = 0; k < MC_BATCH; k++) {
+            double tr = r0[k], ti = q0[k];
+            r0[k] = r1[k];
+            q0[k] = q1[k];
+            r1[k] = tr;
+            q1[k] = ti;
+        }
+    }
+}
+
+// Function to measure target in every instance: draw outcomes from the |1>
+// probabilities, then zero the other branch and renormalize, without branches
+static void batchMeasure(McBatch* batch, int target, int bit) {
+    const int stride = 1 << target;
+    double* restrict p1 = batch->scale;
+    uint64_t* restrict outcome = batch->bits[bit];
+
+    memset(p1, 0, sizeof(batch->scale));
+    for (int i = 0; i < MC_STATES; i++) {
+        if (!(i & stride)) {
+            continue;
+        }
+        const double* restrict r = batch->re[i];
+        const double* restrict q = batch->im[i];
+        #pragma omp simd
+        for (int k = 0; k < MC_BATCH; k++) {
+            p1[k] += r[k] * r[k] + q[k] * q[k];
+        }
+    }
+
+    drawUniforms(batch);
+    const double* restrict u = batch->uniform;
+    #pragma omp simd
+    for (int k = 0; k < MC_BATCH; k++) {
+        uint64_t one = u[k] < p1[k];
+        double p = one ? p1[k] : 1.0 - p1[k];
+        outcome[k] = one;
+        p1[k] = 1.0 / sqrt(p > 0.0 ? p : 1.0);
+    }
+
+    for (int i = 0; i < MC_STATES; i++) {
+        const uint64_t is_one = (i & stride) != 0;
+        double* restrict r = batch->re[i];
+        double* restrict q = batch->im[i];
+        #pragma omp simd
+        for (int k = 0; k < MC_BATCH; k++) {
+            int keep = outcome[k] == is_one;
+            r[k] = keep ? r[k] * p1[k] : 0.0;
+            q[k] = keep ? q[k] * p1[k] : 0.0;
+        }
+    }
+}
+
+// Function to run every protocol step on one batch and add its outcomes to counts
+static void runBatch(McBatch* batch, const McProtocol* protocol, uint64_t seed, uint64_t first_run,
+                     int active, uint64_t* counts) {
+    seedBatch(batch, seed, first_run);
+    for (int s = 0; s < protocol->num_steps; s++) {
+        const McStep* step = &protocol->steps[s];
+        switch (step->type) {
+            case MC_GATE:
+                batchGate(batch, step->target, step->m, NULL);
+                break;
+            case MC_CNOT:
+                batchCnot(batch, step->control, step->target);
+                break;
+            case MC_MEASURE:
+                batchMeasure(batch, step->target, step->bit);
+                break;
+            case MC_RANDOM_BIT: {
+                drawUniforms(batch);
+                uint64_t* restrict out = batch->bits[step->bit];
+                const double* restrict u = batch->uniform;
+                #pragma omp simd
+                for (int k = 0; k < MC_BATCH; k++) {
+                    out[k] = u[k] < 0.5;
+                }
+                break;
+            }
+            case MC_CONDITIONAL_GATE:
+                batchGate(batch, step->target, step->m, batch->bits[step->bit]);
+                break;
+        }
+    }
+
+    for (int k = 0; k < active; k++) {
+        uint64_t r = 0;
+        for (int j = 0; j < protocol->num_bits; j++) {
+            r |= batch->bits[j][k] << j;
+        }
+        counts[r]++;
+    }
+}
+
+// Function to run a protocol runs times and tally the final classical registers.
+// Batches are spread over threads; each thread keeps its own counters and
+// merges them once at the end. Returns 0 on success, -1 on failure.
+int runMonteCarlo(const McProtocol* protocol, uint64_t runs, uint64_t seed, McTally* tally) {
+    if (protocol->num_bits < 1 || protocol->num_bits > MC_MAX_BITS) {
+        fprintf(stderr, "Error: Protocols need between 1 and %d classical bits\n", MC_MAX_BITS);
+        return -1;
+    }
+    INSTRUMENT_SCOPE("runMonteCarlo");
+    memset(tally, 0, sizeof(McTally));
+    tally->num_bits = protocol->num_bits;
+    tally->runs = runs;
+
+    const int64_t num_batches = (int64_t)((runs + MC_BATCH - 1) / MC_BATCH);
+    const int num_outcomes = 1 << protocol->num_bits;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        McBatch* batch = (McBatch*)aligned_alloc(64, sizeof(McBatch));
+        uint64_t counts[1 << MC_MAX_BITS] = { 0 };
+
+        #pragma omp for schedule(static)
+        for (int64_t b = 0; b < num_batches; b++) {
+            if (batch == NULL) {
+                continue;
+            }
+            uint64_t first_run = (uint64_t)b * MC_BATCH;
+            int active = runs - first_run < MC_BATCH ? (int)(runs - first_run) : MC_BATCH;
+            runBatch(batch, protocol, seed, first_run, active, counts);
+        }
+
+        #pragma omp critical
+        {
+            if (batch == NULL) {
+                failed = 1;
+            }
+            for (int r = 0; r < num_outcomes; r++) {
+                tally->counts[r] += counts[r];
+            }
+        }
+        free(batch);
+    }
+    return failed ? -1 : 0;
+}
+
+// Function to compute the fraction of runs where two classical bits differ,
+// e.g. the bit-error rate of teleportation from bits 0 and 3
+double tallyMismatchRate(const McTally* tally, int bit_a, int bit_b) {
+    if (tally->runs == 0) {
+        return 0.0;
+    }
+    uint64_t mismatches = 0;
+    for (int r = 0; r < (1 << tally->num_bits); r++) {
+        if (((r >> bit_a) ^ (r >> bit_b)) & 1) {
+            mismatches += tally->counts[r];
+        }
+    }
+    return (double)mismatches / (double)tally->runs;
+}
@@ -0,0 +1,59 @@
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include <stdint.h>
+#include <complex.h>
+#include "circuit.h"
+
+// Batched Monte Carlo engine for small protocols such as teleportation.
+// MC_BATCH independent 3-qubit states are stored structure-of-arrays (amplitude
+// j of every instance is contiguous), so each protocol step is a loop over the
+// instance dimension that the compiler turns into SIMD.
+
+#define MC_QUBITS 3
+#define MC_STATES (1 << MC_QUBITS)
+#define MC_BATCH 256
+#define MC_MAX_STEPS 64
+#define MC_MAX_BITS 8
+
+typedef enum {
+    MC_GATE,              // 2x2 gate on target
+    MC_CNOT,              // X on target when control is |1>
+    MC_MEASURE,           // Measure target into a classical bit and collapse
+    MC_RANDOM_BIT,        // Fair coin into a classical bit (random protocol inputs)
+    MC_CONDITIONAL_GATE   // 2x2 gate on target when a classical bit is 1
+} McStepType;
+
+typedef struct {
+    McStepType type;
+    int target;
+    int control;
+    int bit;
+    double complex m[2][2];
+} McStep;
+
+typedef struct {
+    int num_steps;
+    int num_bits;
+    McStep steps[MC_MAX_STEPS];
+} McProtocol;
+
+// Histogram of final classical registers: counts[r] runs ended with bits r
+typedef struct {
+    int num_bits;
+    uint64_t runs;
+    uint64_t counts[1 << MC_MAX_BITS];
+} McTally;
+
+void initializeProtocol(McProtocol* protocol, int num_bits);
+int addProtocolGate(McProtocol* protocol, GateType type, int target, double parameter);
+int addProtocolCnot(McProtocol* protocol, int control, int target);
+int addProtocolMeasurement(McProtocol* protocol, int target, int bit);
+int addProtocolRandomBit(McProtocol* protocol, int bit);
+int addProtocolConditionalGate(McProtocol* protocol, GateType type, int target, double parameter, int bit);
+void buildTeleportationProtocol(McProtocol* protocol);
+
+int runMonteCarlo(const McProtocol* protocol, uint64_t runs, uint64_t seed, McTally* tally);
+double tallyMismatchRate(const McTally* tally, int bit_a, int bit_b);
+
+#endif
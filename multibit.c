@@ -2,12 +2,9 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
-
-// Define the qubit structure
-typedef struct {
-    double alpha; // Complex coefficient for |0>
-    double beta;  // Complex coefficient for |1>
-} Qubit;
+#include "arena.h"
+#include "resultsink.h"
+#include "qubitstate.h"
 
 // Function to initialize a qubit
 Qubit* initializeQubit(double alpha, double beta) {
@@ -22,6 +19,20 @@ void freeQubit(Qubit* qubit) {
     free(qubit);
 }
 
+// Function to initialize an array of short-lived qubits in an arena.
+// They are released with the arena, not with freeQubit.
+Qubit* initializeArenaQubits(Arena* arena, int count, double alpha, double beta) {
+    Qubit* qubits = (Qubit*)arenaAlloc(arena, count * sizeof(Qubit));
+    if (qubits == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        qubits[i].alpha = alpha;
+        qubits[i].beta = beta;
+    }
+    return qubits;
+}
+
 // Function to measure a qubit
 int measureQubit(Qubit* qubit) {
     double prob_0 = pow(qubit->alpha, 2);
@@ -52,42 +63,46 @@ void applyPauliXGate(Qubit* qubit) {
 
 // Function to simulate quantum teleportation
 void quantumTeleportation(Qubit** sender_qubits, Qubit** receiver_qubits, int num_bits) {
-    // Create entangled qubit pairs (Alice's and Bob's qubits)
-    Qubit** alice_qubits = (Qubit**)malloc(num_bits * sizeof(Qubit*));
-    Qubit** bob_qubits = (Qubit**)malloc(num_bits * sizeof(Qubit*));
-    for (int i = 0; i < num_bits; i++) {
-        alice_qubits[i] = initializeQubit(1/sqrt(2), 0); // |+>
-        bob_qubits[i] = initializeQubit(0, 1/sqrt(2));   // |1>
+    // Create entangled qubit pairs (Alice's and Bob's qubits) in the thread's
+    // arena; they only live for this round
+    Arena* arena = threadArena();
+    ArenaMark mark = arenaMark(arena);
+    Qubit* alice_qubits = initializeArenaQubits(arena, num_bits, 1/sqrt(2), 0); // |+>
+    Qubit* bob_qubits = initializeArenaQubits(arena, num_bits, 0, 1/sqrt(2));   // |1>
+    if (alice_qubits == NULL || bob_qubits == NULL) {
+        fprintf(stderr, "Error: Out of memory for entangled qubit pairs\n");
+        arenaRelease(arena, mark);
+        return;
     }
 
     // Apply Hadamard gate to Alice's qubits
     for (int i = 0; i < num_bits; i++) {
-        applyHadamardGate(alice_qubits[i]);
+        applyHadamardGate(&alice_qubits[i]);
     }
 
     // Apply CNOT gate with Alice's qubits as control and Bob's qubits as target
     for (int i = 0; i < num_bits; i++) {
-        applyPauliXGate(alice_qubits[i]); // Equivalent to a CNOT gate when the control qubit is |1>
-        applyPauliXGate(bob_qubits[i]);   // Equivalent to a CNOT gate when the control qubit is |1>
+        applyPauliXGate(&alice_qubits[i]); // Equivalent to a CNOT gate when the control qubit is |1>
+        applyPauliXGate(&bob_qubits[i]);   // Equivalent to a CNOT gate when the control qubit is |1>
     }
 
     // Apply controlled-Z gate with Alice's qubits as control and sender's qubits as target
     for (int i = 0; i < num_bits; i++) {
         if (measureQubit(sender_qubits[i]) == 1) {
-            applyPauliXGate(bob_qubits[i]); // Apply Pauli-X (bit flip) if sender's qubit is |1>
+            applyPauliXGate(&bob_qubits[i]); // Apply Pauli-X (bit flip) if sender's qubit is |1>
         }
     }
 
     // Apply controlled-Z gate with Alice's qubits as control and Bob's qubits as target
     for (int i = 0; i < num_bits; i++) {
-        if (measureQubit(alice_qubits[i]) == 1) {
+        if (measureQubit(&alice_qubits[i]) == 1) {
             applyPauliXGate(receiver_qubits[i]); // Apply Pauli-X (bit flip) if Alice's qubit is |1>
         }
     }
 
     // Measure Alice's qubits and teleport the state to Bob's qubits
     for (int i = 0; i < num_bits; i++) {
-        int measured_bit_alice = measureQubit(alice_qubits[i]);
+        int measured_bit_alice = measureQubit(&alice_qubits[i]);
         if (measured_bit_alice == 1) {
             applyPauliXGate(receiver_qubits[i]); // Apply Pauli-X (bit flip) to Bob's qubit if Alice's qubit was |1>
         }
@@ -96,13 +111,8 @@ void quantumTeleportation(Qubit** sender_qubits, Qubit** receiver_qubits, int nu
         }
     }
 
-    // Free memory allocated for Alice's and Bob's qubits
-    for (int i = 0; i < num_bits; i++) {
-        freeQubit(alice_qubits[i]);
-        freeQubit(bob_qubits[i]);
-    }
-    free(alice_qubits);
-    free(bob_qubits);
+    // Release Alice's and Bob's qubits in O(1)
+    arenaRelease(arena, mark);
 }
 
 // Function to convert a binary string to an array of qubit states
@@ -122,15 +132,13 @@ Qubit** binaryStringToQubits(char* binary_string, int num_bits) {
     return qubits;
 }
 
-// Function to print the state of a qubit
-void printQubit(Qubit* qubit) {
-    printf("|0>: %.2f\n", qubit->alpha);
-    printf("|1>: %.2f\n", qubit->beta);
-}
-
-// Function to decode the binary string from an array of qubit states
+// Function to decode the binary string from an array of qubit states.
+// The string is scratch in the thread's arena, valid until the arena is reset.
 char* qubitsToBinaryString(Qubit** qubits, int num_bits) {
-    char* binary_string = (char*)malloc((num_bits + 1) * sizeof(char));
+    char* binary_string = (char*)arenaAlloc(threadArena(), (num_bits + 1) * sizeof(char));
+    if (binary_string == NULL) {
+        return NULL;
+    }
     for (int i = 0; i < num_bits; i++) {
         if (qubits[i]->alpha > 0.5) {
             binary_string[i] = '0';
@@ -142,7 +150,32 @@ char* qubitsToBinaryString(Qubit** qubits, int num_bits) {
     return binary_string;
 }
 
-int main() {
+// Usage: multibit [result file] [--text]
+// With a result file, the qubit states and decoded bits are written to it as
+// binary columns (see resultsink.h) and the per-qubit text is only printed with
+// --text. Without one, the states are printed as text.
+int main(int argc, char** argv) {
+    const char* result_path = NULL;
+    int text = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--text") == 0) {
+            text = 1;
+        } else {
+            result_path = argv[i];
+        }
+    }
+    ResultSink* sink = NULL;
+    if (result_path != NULL) {
+        sink = openResultSink(result_path);
+        if (sink == NULL) {
+            return 1;
+        }
+    } else {
+        text = 1;
+    }
+    // Set when a result column could not be written; the run still finishes
+    int failed = 0;
+
     // Prompt the user to input a 4-bit binary string
     char binary_string[5];
     printf("Enter a 4-bit binary string: ");
@@ -158,40 +191,46 @@ int main() {
         receiver_qubits[i] = initializeQubit(1, 0); // |0>
     }
     
-    // Print initial states of sender's and receiver's qubits
-    printf("Initial states of sender's qubits:\n");
-    for (int i = 0; i < num_bits; i++) {
-        printf("Qubit %d:\n", i);
-        printQubit(sender_qubits[i]);
-        printf("\n");
-    }
-    printf("\nInitial states of receiver's qubits:\n");
-    for (int i = 0; i < num_bits; i++) {
-        printf("Qubit %d:\n", i);
-        printQubit(receiver_qubits[i]);
-        printf("\n");
-    }
+    // Report initial states of sender's and receiver's qubits
+    failed |= reportQubitStates(sink, text, "Initial states of sender's qubits:", "sender.initial",
+                                sender_qubits, num_bits) != 0;
+    failed |= reportQubitStates(sink, text, "\nInitial states of receiver's qubits:", "receiver.initial",
+                                receiver_qubits, num_bits) != 0;
 
     // Simulate quantum teleportation
     quantumTeleportation(sender_qubits, receiver_qubits, num_bits);
 
-    // Print final states of sender's and receiver's qubits
-    printf("\nFinal states of sender's qubits (after teleportation):\n");
-    for (int i = 0; i < num_bits; i++) {
-        printf("Qubit %d:\n", i);
-        printQubit(sender_qubits[i]);
-        printf("\n");
-    }
-    printf("\nFinal states of receiver's qubits (after teleportation):\n");
-    for (int i = 0; i < num_bits; i++) {
-        printf("Qubit %d:\n", i);
-        printQubit(receiver_qubits[i]);
-        printf("\n");
-    }
+    // Report final states of sender's and receiver's qubits
+    failed |= reportQubitStates(sink, text, "\nFinal states of sender's qubits (after teleportation):", "sender.final",
+                                sender_qubits, num_bits) != 0;
+    failed |= reportQubitStates(sink, text, "\nFinal states of receiver's qubits (after teleportation):", "receiver.final",
+                                receiver_qubits, num_bits) != 0;
 
     // Decode the data from the receiver's qubits and print it
     char* decoded_data = qubitsToBinaryString(receiver_qubits, num_bits);
-    printf("\nDecoded data from receiver's qubits: %s\n", decoded_data);
+    if (decoded_data == NULL) {
+        fprintf(stderr, "Error: Out of memory for the decoded data\n");
+        failed = 1;
+    } else {
+        printf("\nDecoded data from receiver's qubits: %s\n", decoded_data);
+    }
+
+    // Store the decoded bits as one-bit records; without them the column is left out
+    if (sink != NULL) {
+        if (decoded_data != NULL) {
+            uint64_t records[4];
+            for (int i = 0; i < num_bits; i++) {
+                records[i] = decoded_data[i] == '1';
+            }
+            failed |= writeShotColumn(sink, "receiver.decoded", records, num_bits, 1) != 0;
+        }
+        failed |= closeResultSink(sink) != 0;
+        if (failed) {
+            fprintf(stderr, "Error: Results in %s are incomplete\n", result_path);
+        } else {
+            printf("Results written to %s\n", result_path);
+        }
+    }
 
     // Free memory allocated for qubits
     for (int i = 0; i < num_bits; i++) {
@@ -200,7 +239,9 @@ int main() {
     }
     free(sender_qubits);
     free(receiver_qubits);
-    free(decoded_data);
 
-    return 0;
+    // End of the protocol round: drop the decoded string and other scratch
+    arenaReset(threadArena());
+
+    return failed ? 1 : 0;
 }
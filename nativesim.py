@@ -0,0 +1,140 @@
+# Drop-in replacement for cirq.Simulator backed by the native engine (qusim).
+# Build the extension once with:
+#   gcc -O3 -march=native -fopenmp -fcx-limited-range -shared -fPIC $(python3-config --includes) \
+#       qusimmodule.c allocator.c statevector.c statevector32.c circuit.c diagonal.c \
+#       expectation.c scheduler.c planner.c framesum.c stateprep.c factored.c taskgraph.c \
+#       -o qusim$(python3-config --extension-suffix)
+# Circuits using gates the engine does not have are handed to cirq.Simulator.
+import collections
+import numpy as np
+import cirq
+import qusim
+
+# Function to turn one cirq operation into a native gate line, or None for an
+# identity. The native register stores qubit k as bit k while cirq puts its
+# first qubit in the top bit, so qubit i of n is native qubit n - 1 - i.
+def native_gate_line(op, index):
+    gate = op.gate
+    qubits = [index[q] for q in op.qubits]
+
+    if isinstance(gate, cirq.IdentityGate):
+        return None
+    if isinstance(gate, cirq.ControlledGate):
+        if gate.sub_gate.num_qubits() != 1 or any(values != (1,) for values in gate.control_values):
+            raise NotImplementedError(gate)
+        controls = qubits[:gate.num_controls()]
+        sub_line = native_gate_line(gate.sub_gate.on(*op.qubits[gate.num_controls():]), index)
+        if sub_line is None:
+            return None
+        name, rest = sub_line.split(" ", 1)
+        return "C" * len(controls) + name + " " + " ".join(map(str, controls)) + " " + rest
+    if isinstance(gate, (cirq.Rx, cirq.Ry, cirq.Rz)):
+        name = {cirq.Rx: "RX", cirq.Ry: "RY", cirq.Rz: "RZ"}[type(gate)]
+        return f"{name} {qubits[0]} {gate._rads!r}"
+    if isinstance(gate, cirq.CXPowGate) and gate.exponent == 1:
+        return f"CX {qubits[0]} {qubits[1]}"
+    if isinstance(gate, cirq.CZPowGate):
+        return f"CZPOW {qubits[0]} {qubits[1]} {float(gate.exponent)!r}"
+    if isinstance(gate, cirq.CCXPowGate) and gate.exponent == 1:
+        return f"CCX {qubits[0]} {qubits[1]} {qubits[2]}"
+    if isinstance(gate, cirq.CCZPowGate) and gate.exponent == 1:
+        return f"CCZ {qubits[0]} {qubits[1]} {qubits[2]}"
+    if isinstance(gate, cirq.ZZPowGate) and gate.global_shift == 0:
+        return f"ZZPOW {qubits[0]} {qubits[1]} {float(gate.exponent)!r}"
+    if isinstance(gate, cirq.SwapPowGate) and gate.exponent == 1:
+        return f"SWAP {qubits[0]} {qubits[1]}"
+    if isinstance(gate, cirq.ZPowGate) and gate.global_shift == 0:
+        return f"ZPOW {qubits[0]} {float(gate.exponent)!r}"
+    if isinstance(gate, (cirq.HPowGate, cirq.XPowGate, cirq.YPowGate)) and gate.exponent == 1 and gate.global_shift == 0:
+        name = {cirq.HPowGate: "H", cirq.XPowGate: "X", cirq.YPowGate: "Y"}[type(gate)]
+        return f"{name} {qubits[0]}"
+    raise NotImplementedError(gate)
+
+# Function to split a cirq circuit into native gate lines and its terminal
+# measurements as {key: [native qubit, ...]}. A measurement followed by more
+# operations would collapse the state mid-circuit, which the native engine does
+# not do here, so such circuits are handed to cirq.
+def translate_circuit(circuit):
+    if not circuit.are_all_measurements_terminal():
+        raise NotImplementedError("mid-circuit measurement")
+    ordered = sorted(circuit.all_qubits())
+    index = {q: len(ordered) - 1 - i for i, q in enumerate(ordered)}
+    lines = []
+    measurements = {}
+    for op in circuit.all_operations():
+        if cirq.is_measurement(op):
+            measurements[cirq.measurement_key_name(op)] = [index[q] for q in op.qubits]
+            continue
+        line = native_gate_line(op, index)
+        if line is not None:
+            lines.append(line)
+    return len(ordered), lines, measurements
+
+class NativeSimulationResult:
+    # Final state of a simulate() call; state_vector() shares the native buffer
+    def __init__(self, state):
+        self._state = state
+
+    def state_vector(self, copy=False):
+        vector = np.asarray(self._state)
+        return vector.copy() if copy else vector
+
+    @property
+    def final_state_vector(self):
+        return self.state_vector()
+
+class NativeRunResult:
+    # Samples of a run() call in cirq's layout: measurements[key] is an array of
+    # shape (repetitions, qubits in key)
+    def __init__(self, measurements):
+        self.measurements = measurements
+
+    def histogram(self, *, key, fold_func=None):
+        bits = self.measurements[key]
+        if fold_func is None:
+            fold_func = lambda row: int("".join(str(int(b)) for b in row) or "0", 2)
+        return collections.Counter(fold_func(row) for row in bits)
+
+# Whether qusim.pin_threads has run in this process; workers are pinned once
+_threads_pinned = False
+
+class NativeSimulator:
+    # Function to set the native backend ("auto", "dense", "blocked", "dense32",
+    # "factored"); pin_threads pins the engine's worker threads to CPUs node by
+    # node, for large registers on multi-socket machines
+    def __init__(self, backend="auto", tolerance=0.0, seed=None, pin_threads=False):
+        global _threads_pinned
+        if pin_threads and not _threads_pinned:
+            qusim.pin_threads()
+            _threads_pinned = True
+        self.backend = backend
+        self.tolerance = tolerance
+        self.seed = seed
+        self._fallback = None
+
+    def _cirq(self):
+        if self._fallback is None:
+            self._fallback = cirq.Simulator(seed=self.seed)
+        return self._fallback
+
+    def simulate(self, circuit):
+        try:
+            num_qubits, lines, _ = translate_circuit(circuit)
+        except NotImplementedError:
+            return self._cirq().simulate(circuit)
+        state = qusim.simulate(max(num_qubits, 1), lines, self.backend, self.tolerance)
+        return NativeSimulationResult(state)
+
+    def run(self, circuit, repetitions=1):
+        try:
+            num_qubits, lines, measured = translate_circuit(circuit)
+        except NotImplementedError:
+            return self._cirq().run(circuit, repetitions=repetitions)
+        state = qusim.simulate(max(num_qubits, 1), lines, self.backend, self.tolerance)
+        seed = self.seed if self.seed is not None else np.random.randint(0, 2 ** 63)
+        samples = np.asarray(state.sample(repetitions, seed))
+        measurements = {}
+        for key, qubits in measured.items():
+            shifts = np.array(qubits, dtype=np.uint64)
+            measurements[key] = ((samples[:, None] >> shifts) & np.uint64(1)).astype(np.int8)
+        return NativeRunResult(measurements)
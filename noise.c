@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "noise.h"
+#include "rng.h"
+#include "instrument.h"
+
+// Function to attach an empty noise model to a circuit
+void initializeNoisyCircuit(NoisyCircuit* noisy, const Circuit* circuit) {
+    noisy->circuit = circuit;
+    noisy->num_channels = 0;
+    noisy->capacity = 0;
+    noisy->channels = NULL;
+    noisy->readout_error = 0.0;
+}
+
+// Function to free memory allocated for a noise model (not the circuit)
+void freeNoisyCircuit(NoisyCircuit* noisy) {
+    free(noisy->channels);
+    initializeNoisyCircuit(noisy, noisy->circuit);
+}
+
+// Function to insert a channel after the first position gates, keeping the
+// channel list sorted by position. Returns 0 on success, -1 on bad input.
+int addNoiseChannel(NoisyCircuit* noisy, NoiseType type, int qubit, int position, double probability) {
+    if (qubit < 0 || qubit >= noisy->circuit->num_qubits || position < 0 ||
+        position > noisy->circuit->num_gates || probability < 0.0 || probability > 1.0) {
+        return -1;
+    }
+    if (noisy->num_channels == noisy->capacity) {
+        int capacity = noisy->capacity ? noisy->capacity * 2 : 16;
+        NoiseChannel* channels = (NoiseChannel*)realloc(noisy->channels, capacity * sizeof(NoiseChannel));
+        if (channels == NULL) {
+            return -1;
+        }
+        noisy->channels = channels;
+        noisy->capacity = capacity;
+    }
+    int c = noisy->num_channels++;
+    while (c > 0 && noisy->channels[c - 1].position > position) {
+        noisy->channels[c] = noisy->channels[c - 1];
+        c--;
+    }
+    noisy->channels[c].type = type;
+    noisy->channels[c].qubit = qubit;
+    noisy->channels[c].position = position;
+    noisy->channels[c].probability = probability;
+    return 0;
+}
+
+// Function to add a channel on every qubit a gate touches (targets and
+// controls), after every gate of the circuit
+int addNoiseAfterEveryGate(NoisyCircuit* noisy, NoiseType type, double probability) {
+    const Circuit* circuit = noisy->circuit;
+    for (int g = 0; g < circuit->num_gates; g++) {
+        const Gate* gate = &circuit->gates[g];
+        uint64_t touched = gate->controls | (1ULL << gate->targets[0]);
+        if (isTwoQubitGate(gate->type)) {
+            touched |= 1ULL << gate->targets[1];
+        }
+        for (; touched != 0; touched &= touched - 1) {
+            if (addNoiseChannel(noisy, type, __builtin_ctzll(touched), g + 1, probability) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Function to set the probability that each measured bit is read out flipped
+void setReadoutError(NoisyCircuit* noisy, double probability) {
+    noisy->readout_error = probability;
+}
+
+// Function to apply a Pauli to one qubit
+static void applyPauli(QubitRegister* reg, GateType type, int qubit) {
+    double complex m[2][2];
+    singleQubitGateMatrix(type, 0.0, m);
+    applySingleQubitGate(reg, qubit, m);
+}
+
+// Function to apply one stochastic unravelling of a channel.
+// Pauli channels pick a Pauli or nothing. Amplitude damping jumps to |0> with
+// probability p * P(1) and otherwise applies the no-jump Kraus operator; both
+// branches are renormalized, so the trajectory stays a unit pure state.
+static void applyNoiseChannel(QubitRegister* reg, const NoiseChannel* channel, Rng* rng) {
+    const double p = channel->probability;
+    const double u = uniformRng(rng);
+
+    switch (channel->type) {
+        case NOISE_DEPOLARIZING:
+            if (u < p) {
+                static const GateType paulis[3] = { GATE_X, GATE_Y, GATE_Z };
+                int which = (int)(3.0 * u / p);
+                applyPauli(reg, paulis[which < 3 ? which : 2], channel->qubit);
+            }
+            break;
+        case NOISE_BIT_FLIP:
+            if (u < p) {
+                applyPauli(reg, GATE_X, channel->qubit);
+            }
+            break;
+        case NOISE_PHASE_FLIP:
+            if (u < p) {
+                applyPauli(reg, GATE_Z, channel->qubit);
+            }
+            break;
+        case NOISE_AMPLITUDE_DAMPING: {
+            const double p1 = qubitProbability(reg, channel->qubit);
+            const double jump = p * p1;
+            if (jump <= 0.0) {
+                break;
+            }
+            double complex k[2][2] = { { 0.0, 0.0 }, { 0.0, 0.0 } };
+            if (u < jump) {
+                k[0][1] = 1.0 / sqrt(p1);
+            } else {
+                double scale = 1.0 / sqrt(1.0 - jump);
+                k[0][0] = scale;
+                k[1][1] = sqrt(1.0 - p) * scale;
+            }
+            applySingleQubitGate(reg, channel->qubit, k);
+            break;
+        }
+    }
+}
+
+// Function to run one trajectory of the noisy circuit from |0...0>
+static void runTrajectory(QubitRegister* reg, const NoisyCircuit* noisy, Rng* rng) {
+    const Circuit* circuit = noisy->circuit;
+    int c = 0;
+
+    resetRegister(reg);
+    while (c < noisy->num_channels && noisy->channels[c].position == 0) {
+        applyNoiseChannel(reg, &noisy->channels[c++], rng);
+    }
+    for (int g = 0; g < circuit->num_gates; g++) {
+        const Gate* gate = &circuit->gates[g];
+        applyGate(reg, gate, gateParameter(circuit, gate));
+        while (c < noisy->num_channels && noisy->channels[c].position == g + 1) {
+            applyNoiseChannel(reg, &noisy->channels[c++], rng);
+        }
+    }
+}
+
+// Function to sample a basis state from the trajectory and apply readout errors
+static uint64_t sampleReadout(const QubitRegister* reg, double readout_error, Rng* rng) {
+    const double u = uniformRng(rng);
+    double cumulative = 0.0;
+    uint64_t outcome = 0;
+    for (uint64_t i = 0; i < reg->size; i++) {
+        double re = creal(reg->amplitudes[i]);
+        double im = cimag(reg->amplitudes[i]);
+        double p = re * re + im * im;
+        if (p > 0.0) {
+            outcome = i;
+            cumulative += p;
+            if (u < cumulative) {
+                break;
+            }
+        }
+    }
+    if (readout_error > 0.0) {
+        for (int q = 0; q < reg->num_qubits; q++) {
+            if (uniformRng(rng) < readout_error) {
+                outcome ^= 1ULL << q;
+            }
+        }
+    }
+    return outcome;
+}
+
+// Per-thread statistics since the last merge
+typedef struct {
+    uint64_t count;
+    uint64_t samples[TRAJECTORY_FLUSH];
+    double* mean;
+    double* m2;
+} LocalStats;
+
+// Function to merge a thread's statistics into the totals and report progress.
+// Means and squared deviations are combined with the parallel Welford update.
+static void flushLocalStats(LocalStats* local, TrajectoryStats* stats, uint64_t report_every,
+                            TrajectoryCallback callback, void* arg, uint64_t* last_report) {
+    if (local->count == 0) {
+        return;
+    }
+    #pragma omp critical(trajectory_stats)
+    {
+        const double na = (double)stats->trajectories;
+        const double nb = (double)local->count;
+        const double n = na + nb;
+        for (int o = 0; o < stats->num_observables; o++) {
+            double delta = local->mean[o] - stats->mean[o];
+            stats->mean[o] += delta * nb / n;
+            stats->m2[o] += local->m2[o] + delta * delta * na * nb / n;
+        }
+        if (stats->counts != NULL) {
+            for (uint64_t t = 0; t < local->count; t++) {
+                stats->counts[local->samples[t]]++;
+            }
+        }
+        stats->trajectories += local->count;
+        if (callback != NULL && report_every > 0 &&
+            stats->trajectories / report_every != *last_report / report_every) {
+            *last_report = stats->trajectories;
+            callback(stats, arg);
+        }
+    }
+    local->count = 0;
+    for (int o = 0; o < stats->num_observables; o++) {
+        local->mean[o] = 0.0;
+        local->m2[o] = 0.0;
+    }
+}
+
+// Function to estimate the noisy circuit by averaging pure-state trajectories
+// instead of evolving a 2^n x 2^n density matrix.
+// Trajectories are spread over threads, each holding a single register, and
+// trajectory t draws from its own RNG stream (seed, t), so results do not
+// depend on the thread count. Every trajectory contributes one sampled readout
+// and the expectation of each observable. Totals are merged as trajectories
+// finish and passed to callback every report_every trajectories and at the end.
+// Returns 0 on success, -1 on failure.
+int runTrajectories(const NoisyCircuit* noisy, const Observable* observables, int num_observables,
+                    uint64_t trajectories, uint64_t seed, uint64_t report_every,
+                    TrajectoryCallback callback, void* arg, TrajectoryStats* stats) {
+    const int n = noisy->circuit->num_qubits;
+    stats->trajectories = 0;
+    stats->num_qubits = n;
+    stats->num_observables = num_observables;
+    stats->counts = n <= TRAJECTORY_HISTOGRAM_QUBITS ? (uint64_t*)calloc(1ULL << n, sizeof(uint64_t)) : NULL;
+    stats->mean = (double*)calloc(num_observables + 1, sizeof(double));
+    stats->m2 = (double*)calloc(num_observables + 1, sizeof(double));
+    if ((n <= TRAJECTORY_HISTOGRAM_QUBITS && stats->counts == NULL) || stats->mean == NULL || stats->m2 == NULL) {
+        freeTrajectoryStats(stats);
+        return -1;
+    }
+
+    uint64_t last_report = 0;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        QubitRegister* reg = initializeRegister(n);
+        double* results = (double*)malloc((num_observables + 1) * sizeof(double));
+        LocalStats local;
+        local.count = 0;
+        local.mean = (double*)calloc(num_observables + 1, sizeof(double));
+        local.m2 = (double*)calloc(num_observables + 1, sizeof(double));
+        int ok = reg != NULL && results != NULL && local.mean != NULL && local.m2 != NULL;
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int64_t t = 0; t < (int64_t)trajectories; t++) {
+            if (!ok) {
+                continue;
+            }
+            INSTRUMENT_SCOPE("trajectory");
+            Rng rng;
+            seedRng(&rng, seed, (uint64_t)t);
+            runTrajectory(reg, noisy, &rng);
+
+            if (num_observables > 0) {
+                if (computeExpectations(reg, observables, num_observables, results) != 0) {
+                    ok = 0;
+                    continue;
+                }
+                const double count = (double)(local.count + 1);
+                for (int o = 0; o < num_observables; o++) {
+                    double delta = results[o] - local.mean[o];
+                    local.mean[o] += delta / count;
+                    local.m2[o] += delta * (results[o] - local.mean[o]);
+                }
+            }
+            local.samples[local.count++] = sampleReadout(reg, noisy->readout_error, &rng);
+            if (local.count == TRAJECTORY_FLUSH) {
+                flushLocalStats(&local, stats, report_every, callback, arg, &last_report);
+            }
+        }
+        if (ok) {
+            flushLocalStats(&local, stats, report_every, callback, arg, &last_report);
+        } else {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        freeRegister(reg);
+        free(results);
+        free(local.mean);
+        free(local.m2);
+    }
+
+    if (failed) {
+        fprintf(stderr, "Error: Could not run the trajectories\n");
+        freeTrajectoryStats(stats);
+        return -1;
+    }
+    if (callback != NULL && last_report != stats->trajectories) {
+        callback(stats, arg);
+    }
+    return 0;
+}
+
+// Function to get the sample variance of an observable over trajectories
+double trajectoryVariance(const TrajectoryStats* stats, int observable) {
+    if (stats->trajectories < 2) {
+        return 0.0;
+    }
+    return stats->m2[observable] / (double)(stats->trajectories - 1);
+}
+
+// Function to free memory allocated for trajectory statistics
+void freeTrajectoryStats(TrajectoryStats* stats) {
+    free(stats->counts);
+    free(stats->mean);
+    free(stats->m2);
+    stats->counts = NULL;
+    stats->mean = NULL;
+    stats->m2 = NULL;
+}
@@ -0,0 +1,64 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <stdint.h>
+#include "statevector.h"
+#include "circuit.h"
+#include "expectation.h"
+
+// Registers up to this width keep a full histogram of sampled bitstrings
+#define TRAJECTORY_HISTOGRAM_QUBITS 20
+// Trajectories a thread finishes before merging its statistics into the totals
+#define TRAJECTORY_FLUSH 64
+
+typedef enum {
+    NOISE_DEPOLARIZING,       // X, Y or Z, each with probability p/3
+    NOISE_AMPLITUDE_DAMPING,  // Decay |1> -> |0> with probability p
+    NOISE_BIT_FLIP,           // X with probability p
+    NOISE_PHASE_FLIP          // Z with probability p
+} NoiseType;
+
+// Channel on one qubit, applied after the first position gates of the circuit
+typedef struct {
+    NoiseType type;
+    int qubit;
+    int position;
+    double probability;
+} NoiseChannel;
+
+// A circuit together with its noise: channels between gates, kept sorted by
+// position, and a symmetric bit-flip error on the final readout
+typedef struct {
+    const Circuit* circuit;
+    int num_channels;
+    int capacity;
+    NoiseChannel* channels;
+    double readout_error;
+} NoisyCircuit;
+
+// Statistics aggregated over finished trajectories
+typedef struct {
+    uint64_t trajectories;
+    int num_qubits;
+    uint64_t* counts;       // Sampled (readout) bitstrings, NULL for wide registers
+    int num_observables;
+    double* mean;           // Running mean of each observable
+    double* m2;             // Running sum of squared deviations of each observable
+} TrajectoryStats;
+
+// Called with the running totals every report_every trajectories
+typedef void (*TrajectoryCallback)(const TrajectoryStats* stats, void* arg);
+
+void initializeNoisyCircuit(NoisyCircuit* noisy, const Circuit* circuit);
+void freeNoisyCircuit(NoisyCircuit* noisy);
+int addNoiseChannel(NoisyCircuit* noisy, NoiseType type, int qubit, int position, double probability);
+int addNoiseAfterEveryGate(NoisyCircuit* noisy, NoiseType type, double probability);
+void setReadoutError(NoisyCircuit* noisy, double probability);
+
+int runTrajectories(const NoisyCircuit* noisy, const Observable* observables, int num_observables,
+                    uint64_t trajectories, uint64_t seed, uint64_t report_every,
+                    TrajectoryCallback callback, void* arg, TrajectoryStats* stats);
+double trajectoryVariance(const TrajectoryStats* stats, int observable);
+void freeTrajectoryStats(TrajectoryStats* stats);
+
+#endif
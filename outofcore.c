@@ -0,0 +1,282 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "outofcore.h"
+#include "instrument.h"
+
+// One scheduled pass: gates applied together while each chunk group is resident.
+// gather holds the high-order target qubits, whose chunks are pulled into scratch.
+typedef struct {
+    uint64_t gather;
+    int num_gates;
+    int* gate_indices;
+} DiskPass;
+
+// Function to create a register backed by the file at path, in the |0...0> state.
+// Returns NULL if the file cannot be created, sized or mapped.
+DiskRegister* createDiskRegister(const char* path, int num_qubits, int chunk_qubits) {
+    if (chunk_qubits < 1 || chunk_qubits > num_qubits || num_qubits > 62) {
+        return NULL;
+    }
+    DiskRegister* reg = (DiskRegister*)malloc(sizeof(DiskRegister));
+    if (reg == NULL) {
+        return NULL;
+    }
+    reg->num_qubits = num_qubits;
+    reg->chunk_qubits = chunk_qubits;
+    reg->size = 1ULL << num_qubits;
+    reg->num_chunks = 1ULL << (num_qubits - chunk_qubits);
+
+    int gather = num_qubits - chunk_qubits < MAX_GATHER_QUBITS ? num_qubits - chunk_qubits : MAX_GATHER_QUBITS;
+    reg->scratch = initializeRegister(chunk_qubits + gather);
+    reg->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (reg->scratch == NULL || reg->fd < 0) {
+        fprintf(stderr, "Error: Failed to create disk register at %s.\n", path);
+        freeRegister(reg->scratch);
+        if (reg->fd >= 0) {
+            close(reg->fd);
+        }
+        free(reg);
+        return NULL;
+    }
+
+    size_t bytes = reg->size * sizeof(double complex);
+    reg->amplitudes = MAP_FAILED;
+    if (ftruncate(reg->fd, (off_t)bytes) == 0) {
+        reg->amplitudes = (double complex*)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, reg->fd, 0);
+    }
+    if (reg->amplitudes == MAP_FAILED) {
+        fprintf(stderr, "Error: Failed to map disk register at %s.\n", path);
+        close(reg->fd);
+        freeRegister(reg->scratch);
+        free(reg);
+        return NULL;
+    }
+    reg->amplitudes[0] = 1.0;
+    return reg;
+}
+
+// Function to flush and unmap a disk register. The backing file is left in place.
+void closeDiskRegister(DiskRegister* reg) {
+    if (reg == NULL) {
+        return;
+    }
+    size_t bytes = reg->size * sizeof(double complex);
+    msync(reg->amplitudes, bytes, MS_SYNC);
+    munmap(reg->amplitudes, bytes);
+    close(reg->fd);
+    freeRegister(reg->scratch);
+    free(reg);
+}
+
+// Function to put a disk register back into |0...0>. Truncating and regrowing the
+// file turns it into zero-filled holes without writing 2^n amplitudes.
+int resetDiskRegister(DiskRegister* reg) {
+    size_t bytes = reg->size * sizeof(double complex);
+    madvise(reg->amplitudes, bytes, MADV_DONTNEED);
+    if (ftruncate(reg->fd, 0) != 0 || ftruncate(reg->fd, (off_t)bytes) != 0) {
+        return -1;
+    }
+    reg->amplitudes[0] = 1.0;
+    return 0;
+}
+
+// Function to get the address of the first amplitude of a chunk
+static double complex* chunkAddress(DiskRegister* reg, uint64_t chunk) {
+    return reg->amplitudes + (chunk << reg->chunk_qubits);
+}
+
+// Function to hint the kernel to start reading a chunk we will need next
+static void prefetchChunk(DiskRegister* reg, uint64_t chunk) {
+    if (chunk < reg->num_chunks) {
+        madvise(chunkAddress(reg, chunk), sizeof(double complex) << reg->chunk_qubits, MADV_WILLNEED);
+    }
+}
+
+// Function to start writeback of a finished chunk and drop it from our mapping,
+// so resident memory stays bounded by a few chunks
+static void releaseChunk(DiskRegister* reg, uint64_t chunk) {
+    size_t bytes = sizeof(double complex) << reg->chunk_qubits;
+    off_t offset = (off_t)((chunk << reg->chunk_qubits) * sizeof(double complex));
+    sync_file_range(reg->fd, offset, (off_t)bytes, SYNC_FILE_RANGE_WRITE);
+    madvise(chunkAddress(reg, chunk), bytes, MADV_DONTNEED);
+}
+
+// Function to get every qubit a gate reads or writes, controls included
+static uint64_t gateSupport(const Gate* gate) {
+    uint64_t support = gate->controls | (1ULL << gate->targets[0]);
+    if (isTwoQubitGate(gate->type)) {
+        support |= 1ULL << gate->targets[1];
+    }
+    return support;
+}
+
+// Function to get the high-order target qubits of a gate, i.e. the qubits whose
+// chunks must be resident together. High-order controls only select chunks.
+static uint64_t gateHighTargets(const Gate* gate, int chunk_qubits) {
+    uint64_t targets = 1ULL << gate->targets[0];
+    if (isTwoQubitGate(gate->type)) {
+        targets |= 1ULL << gate->targets[1];
+    }
+    return targets & ~((1ULL << chunk_qubits) - 1);
+}
+
+// Function to map a qubit of the full register to its position in the pass buffer.
+// Low qubits keep their index; gathered qubit k-th lowest goes to chunk_qubits + k.
+static int mapQubit(int qubit, int chunk_qubits, uint64_t gather) {
+    if (qubit < chunk_qubits) {
+        return qubit;
+    }
+    return chunk_qubits + __builtin_popcountll(gather & ((1ULL << qubit) - 1));
+}
+
+// Function to rewrite a gate for one chunk group of a pass.
+// Returns 0 if a high-order control outside the gathered set is |0> for this group.
+static int remapGate(const Gate* gate, int chunk_qubits, uint64_t gather, uint64_t group_base, Gate* out) {
+    uint64_t low_mask = (1ULL << chunk_qubits) - 1;
+    uint64_t high_controls = gate->controls & ~low_mask & ~gather;
+    uint64_t base_bits = group_base << chunk_qubits;
+    if ((base_bits & high_controls) != high_controls) {
+        return 0;
+    }
+    *out = *gate;
+    out->targets[0] = mapQubit(gate->targets[0], chunk_qubits, gather);
+    if (isTwoQubitGate(gate->type)) {
+        out->targets[1] = mapQubit(gate->targets[1], chunk_qubits, gather);
+    }
+    out->controls = gate->controls & low_mask;
+    uint64_t gathered_controls = gate->controls & gather;
+    while (gathered_controls != 0) {
+        int q = __builtin_ctzll(gathered_controls);
+        out->controls |= 1ULL << mapQubit(q, chunk_qubits, gather);
+        gathered_controls &= gathered_controls - 1;
+    }
+    return 1;
+}
+
+// Function to run one pass. Without gathered qubits every chunk is worked on in
+// place through a view register; otherwise each group of 2^h chunks that differ
+// only in the gathered qubits is copied into scratch, updated, and copied back.
+static void runDiskPass(DiskRegister* reg, const Circuit* circuit, const DiskPass* pass) {
+    const int c = reg->chunk_qubits;
+    const size_t chunk_bytes = sizeof(double complex) << c;
+    const uint64_t chunk_gather = pass->gather >> c;
+    const int h = __builtin_popcountll(pass->gather);
+    const uint64_t group_size = 1ULL << h;
+    const uint64_t num_groups = reg->num_chunks >> h;
+
+    for (uint64_t group = 0; group < num_groups; group++) {
+        // Chunks of this group: the group index spread around the gathered bits,
+        // with every combination of the gathered bits filled in
+        uint64_t base = insertZeroBits(group, chunk_gather);
+        QubitRegister view;
+        view.num_qubits = c + h;
+        view.size = 1ULL << (c + h);
+
+        if (group + 1 < num_groups) {
+            uint64_t next_base = insertZeroBits(group + 1, chunk_gather);
+            for (uint64_t k = 0; k < group_size; k++) {
+                prefetchChunk(reg, next_base | insertZeroBits(k, ~chunk_gather));
+            }
+        }
+        if (h == 0) {
+            view.amplitudes = chunkAddress(reg, base);
+        } else {
+            view.amplitudes = reg->scratch->amplitudes;
+            for (uint64_t k = 0; k < group_size; k++) {
+                uint64_t chunk = base | insertZeroBits(k, ~chunk_gather);
+                memcpy(view.amplitudes + (k << c), chunkAddress(reg, chunk), chunk_bytes);
+            }
+        }
+
+        for (int i = 0; i < pass->num_gates; i++) {
+            const Gate* gate = &circuit->gates[pass->gate_indices[i]];
+            Gate local;
+            if (remapGate(gate, c, pass->gather, base, &local)) {
+                applyGate(&view, &local, gateParameter(circuit, gate));
+            }
+        }
+
+        for (uint64_t k = 0; k < group_size; k++) {
+            uint64_t chunk = base | insertZeroBits(k, ~chunk_gather);
+            if (h != 0) {
+                memcpy(chunkAddress(reg, chunk), view.amplitudes + (k << c), chunk_bytes);
+            }
+            releaseChunk(reg, chunk);
+        }
+    }
+}
+
+// Function to run a circuit on a disk register, one pass over the file per batch.
+// Gates are packed greedily into passes whose gathered high-order targets fit in
+// MAX_GATHER_QUBITS. A gate that does not fit is deferred, and later gates that
+// share no qubit with any deferred gate commute past it and join the current
+// pass, so runs of low-order gates are not split by an unrelated high-order one.
+// Returns 0 on success, -1 on allocation failure.
+int applyDiskCircuit(DiskRegister* reg, const Circuit* circuit) {
+    INSTRUMENT_SCOPE("applyDiskCircuit");
+    const int c = reg->chunk_qubits;
+    const int max_gather = reg->scratch->num_qubits - c;
+    char* placed = (char*)calloc(circuit->num_gates + 1, 1);
+    DiskPass pass;
+    pass.gate_indices = (int*)malloc((circuit->num_gates + 1) * sizeof(int));
+    if (placed == NULL || pass.gate_indices == NULL) {
+        free(placed);
+        free(pass.gate_indices);
+        return -1;
+    }
+
+    int next = 0;
+    while (next < circuit->num_gates) {
+        uint64_t blocked = 0;
+        int scanned = 0;
+        pass.gather = 0;
+        pass.num_gates = 0;
+
+        for (int g = next; g < circuit->num_gates && scanned < SCHEDULE_WINDOW; g++) {
+            if (placed[g]) {
+                continue;
+            }
+            scanned++;
+            const Gate* gate = &circuit->gates[g];
+            uint64_t support = gateSupport(gate);
+            uint64_t gather = pass.gather | gateHighTargets(gate, c);
+            if ((support & blocked) == 0 && __builtin_popcountll(gather) <= max_gather) {
+                pass.gather = gather;
+                pass.gate_indices[pass.num_gates++] = g;
+                placed[g] = 1;
+            } else {
+                blocked |= support;
+            }
+        }
+
+        runDiskPass(reg, circuit, &pass);
+        while (next < circuit->num_gates && placed[next]) {
+            next++;
+        }
+    }
+
+    free(placed);
+    free(pass.gate_indices);
+    return 0;
+}
+
+// Function to compute the squared norm of a disk register chunk by chunk
+double diskRegisterNorm(DiskRegister* reg) {
+    double sum = 0.0;
+    QubitRegister view;
+    view.num_qubits = reg->chunk_qubits;
+    view.size = 1ULL << reg->chunk_qubits;
+
+    for (uint64_t chunk = 0; chunk < reg->num_chunks; chunk++) {
+        prefetchChunk(reg, chunk + 1);
+        view.amplitudes = chunkAddress(reg, chunk);
+        sum += registerNorm(&view);
+        madvise(view.amplitudes, sizeof(double complex) << reg->chunk_qubits, MADV_DONTNEED);
+    }
+    return sum;
+}
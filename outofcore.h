@@ -0,0 +1,32 @@
+#ifndef OUTOFCORE_H
+#define OUTOFCORE_H
+
+#include <stdint.h>
+#include "statevector.h"
+#include "circuit.h"
+
+// Most high-order qubits a single pass may gather; a pass holds 2^this chunks in RAM
+#define MAX_GATHER_QUBITS 2
+
+// Gates the scheduler may look past when pulling later gates into the current pass
+#define SCHEDULE_WINDOW 256
+
+// State vector kept in a memory-mapped file and processed one chunk at a time.
+// A chunk holds the 2^chunk_qubits amplitudes that share the same high-order bits.
+typedef struct {
+    int num_qubits;
+    int chunk_qubits;
+    uint64_t size;
+    uint64_t num_chunks;
+    int fd;
+    double complex* amplitudes;   // Whole file, mapped shared
+    QubitRegister* scratch;       // RAM buffer for passes that gather several chunks
+} DiskRegister;
+
+DiskRegister* createDiskRegister(const char* path, int num_qubits, int chunk_qubits);
+void closeDiskRegister(DiskRegister* reg);
+int resetDiskRegister(DiskRegister* reg);
+int applyDiskCircuit(DiskRegister* reg, const Circuit* circuit);
+double diskRegisterNorm(DiskRegister* reg);
+
+#endif
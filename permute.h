@@ -0,0 +1,60 @@
+#ifndef PERMUTE_H
+#define PERMUTE_H
+
+#include <stdint.h>
+#include "rng.h"
+
+// Keyed bijection on [0, size): a balanced Feistel network on the smallest even
+// number of bits covering size, with outputs outside the range walked through
+// the network again until they land inside it. The covering domain is less than
+// four times size, so a lookup averages under four passes. Positions map to
+// distinct indices, so walking any set of positions never repeats a candidate
+// and walking all of them covers the keyspace, with no table in memory.
+
+#define PERMUTE_ROUNDS 6
+
+typedef struct {
+    uint64_t size;
+    int half_bits;
+    uint64_t half_mask;
+    uint64_t keys[PERMUTE_ROUNDS];
+} KeyPermutation;
+
+// Function to key a permutation of [0, size) from a seed
+static inline void initializePermutation(KeyPermutation* perm, uint64_t size, uint64_t seed) {
+    int bits = 0;
+    while (bits < 64 && (bits == 0 || (size - 1) >> bits != 0)) {
+        bits++;
+    }
+    perm->size = size;
+    perm->half_bits = (bits + 1) / 2;
+    perm->half_mask = perm->half_bits == 32 ? 0xFFFFFFFFULL : (1ULL << perm->half_bits) - 1;
+    uint64_t state = seed;
+    for (int r = 0; r < PERMUTE_ROUNDS; r++) {
+        perm->keys[r] = splitMix64(&state);
+    }
+}
+
+// Function to run one pass of the Feistel network over the covering domain
+static inline uint64_t feistelPass(const KeyPermutation* perm, uint64_t value) {
+    uint64_t left = value >> perm->half_bits;
+    uint64_t right = value & perm->half_mask;
+    for (int r = 0; r < PERMUTE_ROUNDS; r++) {
+        uint64_t mixed = right ^ perm->keys[r];
+        uint64_t next = left ^ (splitMix64(&mixed) & perm->half_mask);
+        left = right;
+        right = next;
+    }
+    return (left << perm->half_bits) | right;
+}
+
+// Function to map a position in the random order to its keyspace index
+static inline uint64_t permuteIndex(const KeyPermutation* perm, uint64_t position) {
+    uint64_t value = feistelPass(perm, position);
+    while (value >= perm->size) {
+        value = feistelPass(perm, value);
+    }
+    return value;
+}
+
+#endif
@@ -0,0 +1,521 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "pipeline.h"
+#include "ring.h"
+#include "permute.h"
+#include "instrument.h"
+
+static const uint32_t md5_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const int md5_shift[16] = {7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21};
+
+// One MD5 step on every lane; f is the round function already evaluated per lane
+#define MD5_STEP(i, g, f) do { \
+        uint32_t k_ = md5_k[(i)]; \
+        int s_ = md5_shift[((i) >> 4) * 4 + ((i) & 3)]; \
+        _Pragma("omp simd") \
+        for (int l = 0; l < MD5_LANES; l++) { \
+            uint32_t sum_ = a[l] + (f) + k_ + words[(g)][l]; \
+            uint32_t rotated_ = (sum_ << s_) | (sum_ >> (32 - s_)); \
+            a[l] = d[l]; \
+            d[l] = c[l]; \
+            c[l] = b[l]; \
+            b[l] = b[l] + rotated_; \
+        } \
+    } while (0)
+
+// Function to compute the MD5 digests of MD5_LANES messages of at most
+// PIPE_MAX_LENGTH bytes each. Each message is a single padded block; the words
+// are laid out lane-minor so every step runs across all lanes at once.
+void md5Lanes(const char* const messages[MD5_LANES], const int lengths[MD5_LANES],
+              uint8_t digests[MD5_LANES][16]) {
+    uint32_t words[16][MD5_LANES];
+    uint8_t block[64];
+
+    for (int l = 0; l < MD5_LANES; l++) {
+        memset(block, 0, sizeof(block));
+        memcpy(block, messages[l], (size_t)lengths[l]);
+        block[lengths[l]] = 0x80;
+        uint64_t bits = (uint64_t)lengths[l] * 8;
+        for (int i = 0; i < 8; i++) {
+            block[56 + i] = (uint8_t)(bits >> (8 * i));
+        }
+        for (int w = 0; w < 16; w++) {
+            words[w][l] = (uint32_t)block[4 * w] | ((uint32_t)block[4 * w + 1] << 8) |
+                          ((uint32_t)block[4 * w + 2] << 16) | ((uint32_t)block[4 * w + 3] << 24);
+        }
+    }
+
+    uint32_t a[MD5_LANES], b[MD5_LANES], c[MD5_LANES], d[MD5_LANES];
+    for (int l = 0; l < MD5_LANES; l++) {
+        a[l] = 0x67452301;
+        b[l] = 0xefcdab89;
+        c[l] = 0x98badcfe;
+        d[l] = 0x10325476;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        MD5_STEP(i, i, (b[l] & c[l]) | (~b[l] & d[l]));
+    }
+    for (int i = 16; i < 32; i++) {
+        MD5_STEP(i, (5 * i + 1) & 15, (d[l] & b[l]) | (~d[l] & c[l]));
+    }
+    for (int i = 32; i < 48; i++) {
+        MD5_STEP(i, (3 * i + 5) & 15, b[l] ^ c[l] ^ d[l]);
+    }
+    for (int i = 48; i < 64; i++) {
+        MD5_STEP(i, (7 * i) & 15, c[l] ^ (b[l] | ~d[l]));
+    }
+
+    for (int l = 0; l < MD5_LANES; l++) {
+        uint32_t state[4] = {a[l] + 0x67452301, b[l] + 0xefcdab89, c[l] + 0x98badcfe, d[l] + 0x10325476};
+        for (int w = 0; w < 4; w++) {
+            for (int i = 0; i < 4; i++) {
+                digests[l][4 * w + i] = (uint8_t)(state[w] >> (8 * i));
+            }
+        }
+    }
+}
+
+typedef struct {
+    const PipelineConfig* config;
+    int alphabet_size;
+    uint64_t keyspace;
+    uint64_t num_batches;
+    KeyPermutation order;
+
+    CandidateBatch* pool;
+    MpmcRing free_batches;
+    MpmcRing candidates;
+    SpscRing* digests;   // One per hasher, drained by the matcher
+
+    _Atomic uint64_t next_batch;
+    _Atomic int samplers_done;
+    _Atomic int hashers_done;
+    _Atomic int stop;
+
+    _Atomic uint64_t generated;
+    _Atomic uint64_t hashed;
+    _Atomic uint64_t pool_stalls;
+    _Atomic uint64_t sampler_stalls;
+    _Atomic uint64_t hasher_stalls;
+    _Atomic uint64_t hasher_output_stalls;
+} Pipeline;
+
+typedef struct {
+    Pipeline* pipeline;
+    int index;
+} StageThread;
+
+// Function to back off while a ring is empty or full: spin briefly, then yield
+static void pipelineWait(int* spins) {
+    if (*spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        sched_yield();
+    }
+    (*spins)++;
+}
+
+// Function to write keyspace index into a candidate, leftmost character most significant
+static void indexToCandidate(const Pipeline* pipeline, uint64_t index, char* candidate) {
+    const char* alphabet = pipeline->config->alphabet;
+    int length = pipeline->config->length;
+    for (int i = length - 1; i >= 0; i--) {
+        candidate[i] = alphabet[index % (uint64_t)pipeline->alphabet_size];
+        index /= (uint64_t)pipeline->alphabet_size;
+    }
+    candidate[length] = '\0';
+}
+
+// Function to fill a batch with positions first onward of the traversal order.
+// In keyspace order the candidate is stepped like an odometer; in random order
+// each position goes through the permutation and is spelled out afresh.
+static void fillBatch(const Pipeline* pipeline, CandidateBatch* batch, uint64_t first) {
+    int length = pipeline->config->length;
+    const char* alphabet = pipeline->config->alphabet;
+    int digits[PIPE_MAX_LENGTH];
+    uint64_t remaining = pipeline->keyspace - first;
+
+    batch->first = first;
+    batch->length = length;
+    batch->count = remaining < PIPE_BATCH ? (int)remaining : PIPE_BATCH;
+
+    if (pipeline->config->random_order) {
+        for (int c = 0; c < batch->count; c++) {
+            batch->indices[c] = permuteIndex(&pipeline->order, first + (uint64_t)c);
+            indexToCandidate(pipeline, batch->indices[c], batch->candidates[c]);
+        }
+        return;
+    }
+
+    uint64_t index = first;
+    for (int i = length - 1; i >= 0; i--) {
+        digits[i] = (int)(index % (uint64_t)pipeline->alphabet_size);
+        index /= (uint64_t)pipeline->alphabet_size;
+    }
+    for (int c = 0; c < batch->count; c++) {
+        char* candidate = batch->candidates[c];
+        batch->indices[c] = first + (uint64_t)c;
+        for (int i = 0; i < length; i++) {
+            candidate[i] = alphabet[digits[i]];
+        }
+        candidate[length] = '\0';
+        for (int i = length - 1; i >= 0; i--) {
+            if (++digits[i] < pipeline->alphabet_size) {
+                break;
+            }
+            digits[i] = 0;
+        }
+    }
+}
+
+// Function run by each sampler: claim the next slice of the traversal order,
+// fill a free batch with it and queue it for the hashers. Slices are disjoint,
+// so no candidate is generated twice in either order.
+static void* samplerMain(void* arg) {
+    StageThread* self = (StageThread*)arg;
+    Pipeline* pipeline = self->pipeline;
+    uint64_t generated = 0, pool_stalls = 0, sampler_stalls = 0;
+
+    while (!atomic_load_explicit(&pipeline->stop, memory_order_relaxed)) {
+        uint64_t b = atomic_fetch_add_explicit(&pipeline->next_batch, 1, memory_order_relaxed);
+        if (b >= pipeline->num_batches) {
+            break;
+        }
+
+        CandidateBatch* batch;
+        int spins = 0;
+        while ((batch = (CandidateBatch*)mpmcPop(&pipeline->free_batches)) == NULL) {
+            if (atomic_load_explicit(&pipeline->stop, memory_order_relaxed)) {
+                break;
+            }
+            if (spins == 0) {
+                pool_stalls++;
+            }
+            pipelineWait(&spins);
+        }
+        if (batch == NULL) {
+            break;
+        }
+
+        fillBatch(pipeline, batch, b * PIPE_BATCH);
+        generated += (uint64_t)batch->count;
+
+        spins = 0;
+        while (mpmcPush(&pipeline->candidates, batch) != 0) {
+            if (spins == 0) {
+                sampler_stalls++;
+            }
+            pipelineWait(&spins);
+        }
+    }
+
+    atomic_fetch_add(&pipeline->generated, generated);
+    atomic_fetch_add(&pipeline->pool_stalls, pool_stalls);
+    atomic_fetch_add(&pipeline->sampler_stalls, sampler_stalls);
+    atomic_fetch_add(&pipeline->samplers_done, 1);
+    return NULL;
+}
+
+// Function to digest every candidate of a batch, MD5_LANES at a time. The tail
+// of a short batch repeats its last candidate to keep the lanes full.
+static void hashBatch(CandidateBatch* batch) {
+    const char* messages[MD5_LANES];
+    int lengths[MD5_LANES];
+    uint8_t digests[MD5_LANES][16];
+
+    for (int c = 0; c < batch->count; c += MD5_LANES) {
+        for (int l = 0; l < MD5_LANES; l++) {
+            int i = c + l < batch->count ? c + l : batch->count - 1;
+            messages[l] = batch->candidates[i];
+            lengths[l] = batch->length;
+        }
+        md5Lanes(messages, lengths, digests);
+        int lanes = batch->count - c < MD5_LANES ? batch->count - c : MD5_LANES;
+        memcpy(batch->digests[c], digests, (size_t)lanes * 16);
+    }
+    INSTRUMENT_COUNT(COUNTER_HASHES, batch->count);
+}
+
+// Function run by each hasher: digest whole batches and pass them to the matcher
+// on this hasher's own ring. Once a match is found, batches are passed on
+// unhashed so the samplers' last batches still get recycled.
+static void* hasherMain(void* arg) {
+    StageThread* self = (StageThread*)arg;
+    Pipeline* pipeline = self->pipeline;
+    SpscRing* output = &pipeline->digests[self->index];
+    uint64_t hashed = 0, hasher_stalls = 0, hasher_output_stalls = 0;
+    int spins = 0;
+
+    for (;;) {
+        CandidateBatch* batch = (CandidateBatch*)mpmcPop(&pipeline->candidates);
+        if (batch == NULL) {
+            if (atomic_load(&pipeline->samplers_done) == pipeline->config->samplers) {
+                batch = (CandidateBatch*)mpmcPop(&pipeline->candidates);
+                if (batch == NULL) {
+                    break;
+                }
+            } else {
+                if (spins == 0) {
+                    hasher_stalls++;
+                }
+                pipelineWait(&spins);
+                continue;
+            }
+        }
+        spins = 0;
+
+        if (atomic_load_explicit(&pipeline->stop, memory_order_relaxed)) {
+            batch->count = 0;
+        } else {
+            hashBatch(batch);
+            hashed += (uint64_t)batch->count;
+        }
+
+        int output_spins = 0;
+        while (spscPush(output, batch) != 0) {
+            if (output_spins == 0) {
+                hasher_output_stalls++;
+            }
+            pipelineWait(&output_spins);
+        }
+    }
+
+    atomic_fetch_add(&pipeline->hashed, hashed);
+    atomic_fetch_add(&pipeline->hasher_stalls, hasher_stalls);
+    atomic_fetch_add(&pipeline->hasher_output_stalls, hasher_output_stalls);
+    atomic_fetch_add(&pipeline->hashers_done, 1);
+    return NULL;
+}
+
+// Function to compare a batch against the target and record the match with the
+// lowest keyspace index
+static void matchBatch(Pipeline* pipeline, const CandidateBatch* batch, PipelineStats* stats) {
+    for (int c = 0; c < batch->count; c++) {
+        if (memcmp(batch->digests[c], pipeline->config->target, 16) == 0) {
+            if (!stats->found || batch->indices[c] < stats->match_index) {
+                stats->found = 1;
+                stats->match_index = batch->indices[c];
+                memcpy(stats->match, batch->candidates[c], sizeof(stats->match));
+            }
+            atomic_store(&pipeline->stop, 1);
+        }
+    }
+}
+
+// Function to run the matcher on the calling thread until every hasher has
+// finished and its ring is drained, sampling queue depths as it goes
+static void runMatcher(Pipeline* pipeline, PipelineStats* stats) {
+    int hashers = pipeline->config->hashers;
+    uint64_t samples = 0, candidate_depths = 0, digest_depths = 0;
+    int spins = 0;
+
+    for (;;) {
+        int all_done = atomic_load(&pipeline->hashers_done) == hashers;
+        int drained = 0;
+
+        uint64_t candidate_depth = mpmcDepth(&pipeline->candidates);
+        uint64_t digest_depth = 0;
+        for (int h = 0; h < hashers; h++) {
+            digest_depth += spscDepth(&pipeline->digests[h]);
+        }
+        samples++;
+        candidate_depths += candidate_depth;
+        digest_depths += digest_depth;
+        if (candidate_depth > stats->max_candidate_depth) {
+            stats->max_candidate_depth = candidate_depth;
+        }
+        if (digest_depth > stats->max_digest_depth) {
+            stats->max_digest_depth = digest_depth;
+        }
+
+        for (int h = 0; h < hashers; h++) {
+            CandidateBatch* batch;
+            while ((batch = (CandidateBatch*)spscPop(&pipeline->digests[h])) != NULL) {
+                matchBatch(pipeline, batch, stats);
+                mpmcPush(&pipeline->free_batches, batch);
+                drained++;
+            }
+        }
+
+        if (drained > 0) {
+            spins = 0;
+        } else if (all_done) {
+            break;
+        } else {
+            if (spins == 0) {
+                stats->matcher_stalls++;
+            }
+            pipelineWait(&spins);
+        }
+    }
+
+    stats->average_candidate_depth = (double)candidate_depths / (double)samples;
+    stats->average_digest_depth = (double)digest_depths / (double)samples;
+}
+
+// Function to search the keyspace alphabet^length for a string with the target
+// MD5 digest, in keyspace order or in the keyed random order of config->seed.
+// Returns 0 when the search ran (stats->found tells whether a match exists), or
+// -1 on invalid configuration, allocation failure or if a stage thread could
+// not be started.
+int runHashPipeline(const PipelineConfig* config, PipelineStats* stats) {
+    memset(stats, 0, sizeof(PipelineStats));
+    if (config->alphabet == NULL || config->length < 1 || config->length > PIPE_MAX_LENGTH) {
+        fprintf(stderr, "Error: Candidate length must be between 1 and %d.\n", PIPE_MAX_LENGTH);
+        return -1;
+    }
+    if (config->samplers < 1 || config->hashers < 1 || config->ring_batches < 1) {
+        fprintf(stderr, "Error: Pipeline needs at least one sampler, one hasher and one ring slot.\n");
+        return -1;
+    }
+
+    Pipeline pipeline;
+    memset(&pipeline, 0, sizeof(Pipeline));
+    pipeline.config = config;
+    pipeline.alphabet_size = (int)strlen(config->alphabet);
+    if (pipeline.alphabet_size < 1) {
+        fprintf(stderr, "Error: Empty alphabet.\n");
+        return -1;
+    }
+    pipeline.keyspace = 1;
+    for (int i = 0; i < config->length; i++) {
+        if (pipeline.keyspace > UINT64_MAX / (uint64_t)pipeline.alphabet_size) {
+            fprintf(stderr, "Error: Keyspace of %d characters does not fit in 64 bits.\n", config->length);
+            return -1;
+        }
+        pipeline.keyspace *= (uint64_t)pipeline.alphabet_size;
+    }
+    pipeline.num_batches = pipeline.keyspace / PIPE_BATCH + (pipeline.keyspace % PIPE_BATCH != 0);
+    if (config->random_order) {
+        initializePermutation(&pipeline.order, pipeline.keyspace, config->seed);
+    }
+
+    // Enough batches to fill every ring plus one in hand per thread, so the pool
+    // only runs dry when the matcher falls behind
+    size_t ring_size = ringCapacity((size_t)config->ring_batches);
+    size_t pool_size = ring_size * (size_t)(1 + config->hashers) + (size_t)(config->samplers + config->hashers);
+
+    pipeline.pool = (CandidateBatch*)malloc(pool_size * sizeof(CandidateBatch));
+    pipeline.digests = (SpscRing*)calloc((size_t)config->hashers, sizeof(SpscRing));
+    int failed = pipeline.pool == NULL || pipeline.digests == NULL;
+    failed = failed || initializeMpmcRing(&pipeline.free_batches, pool_size) != 0;
+    failed = failed || initializeMpmcRing(&pipeline.candidates, ring_size) != 0;
+    for (int h = 0; !failed && h < config->hashers; h++) {
+        failed = initializeSpscRing(&pipeline.digests[h], ring_size) != 0;
+    }
+    if (failed) {
+        fprintf(stderr, "Error: Memory allocation failed for the hash pipeline.\n");
+        for (int h = 0; pipeline.digests != NULL && h < config->hashers; h++) {
+            freeSpscRing(&pipeline.digests[h]);
+        }
+        freeMpmcRing(&pipeline.candidates);
+        freeMpmcRing(&pipeline.free_batches);
+        free(pipeline.digests);
+        free(pipeline.pool);
+        return -1;
+    }
+    for (size_t i = 0; i < pool_size; i++) {
+        mpmcPush(&pipeline.free_batches, &pipeline.pool[i]);
+    }
+
+    int num_threads = config->samplers + config->hashers;
+    pthread_t* threads = (pthread_t*)malloc((size_t)num_threads * sizeof(pthread_t));
+    StageThread* stages = (StageThread*)malloc((size_t)num_threads * sizeof(StageThread));
+    if (threads == NULL || stages == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for the pipeline threads.\n");
+        free(threads);
+        free(stages);
+        for (int h = 0; h < config->hashers; h++) {
+            freeSpscRing(&pipeline.digests[h]);
+        }
+        freeMpmcRing(&pipeline.candidates);
+        freeMpmcRing(&pipeline.free_batches);
+        free(pipeline.digests);
+        free(pipeline.pool);
+        return -1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Hashers (threads samplers..num_threads-1) start before samplers, so if a
+    // thread cannot be created every batch already queued still has a consumer.
+    // The run is then stopped, the stages that never started count as done, and
+    // the matcher drains what the started ones pass on before they are joined.
+    int status = 0;
+    int started = 0;
+    for (int i = 0; i < num_threads; i++) {
+        int t = (i + config->samplers) % num_threads;
+        stages[t].pipeline = &pipeline;
+        stages[t].index = t < config->samplers ? t : t - config->samplers;
+        if (pthread_create(&threads[t], NULL, t < config->samplers ? samplerMain : hasherMain, &stages[t]) != 0) {
+            fprintf(stderr, "Error: Could not start pipeline thread %d of %d.\n", i + 1, num_threads);
+            atomic_store(&pipeline.stop, 1);
+            int hashers_started = started < config->hashers ? started : config->hashers;
+            atomic_fetch_add(&pipeline.hashers_done, config->hashers - hashers_started);
+            atomic_fetch_add(&pipeline.samplers_done, config->samplers - (started - hashers_started));
+            status = -1;
+            break;
+        }
+        started++;
+    }
+
+    runMatcher(&pipeline, stats);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[(i + config->samplers) % num_threads], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    stats->candidates = atomic_load(&pipeline.generated);
+    stats->hashed = atomic_load(&pipeline.hashed);
+    stats->pool_stalls = atomic_load(&pipeline.pool_stalls);
+    stats->sampler_stalls = atomic_load(&pipeline.sampler_stalls);
+    stats->hasher_stalls = atomic_load(&pipeline.hasher_stalls);
+    stats->hasher_output_stalls = atomic_load(&pipeline.hasher_output_stalls);
+    stats->seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+    free(stages);
+    free(threads);
+    for (int h = 0; h < config->hashers; h++) {
+        freeSpscRing(&pipeline.digests[h]);
+    }
+    freeMpmcRing(&pipeline.candidates);
+    freeMpmcRing(&pipeline.free_batches);
+    free(pipeline.digests);
+    free(pipeline.pool);
+    return status;
+}
+
+// Function to print the throughput, stalls and queue depths of a run
+void printPipelineStats(const PipelineStats* stats) {
+    printf("Candidates: %llu generated, %llu hashed in %.3f s (%.1f M/s)\n",
+           (unsigned long long)stats->candidates, (unsigned long long)stats->hashed, stats->seconds,
+           stats->seconds > 0 ? (double)stats->hashed / stats->seconds / 1e6 : 0.0);
+    printf("Stalls: pool %llu, sampler %llu, hasher in %llu, hasher out %llu, matcher %llu\n",
+           (unsigned long long)stats->pool_stalls, (unsigned long long)stats->sampler_stalls,
+           (unsigned long long)stats->hasher_stalls, (unsigned long long)stats->hasher_output_stalls,
+           (unsigned long long)stats->matcher_stalls);
+    printf("Queue depth: candidates avg %.2f max %llu, digests avg %.2f max %llu\n",
+           stats->average_candidate_depth, (unsigned long long)stats->max_candidate_depth,
+           stats->average_digest_depth, (unsigned long long)stats->max_digest_depth);
+}
@@ -0,0 +1,68 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+
+// Staged brute-force search over a keyspace of fixed-length strings. Sampler
+// threads fill batches of candidates and push them into a bounded MPMC ring;
+// hasher threads take whole batches and digest them MD5_LANES at a time; a
+// matcher on the calling thread compares digests against the target and
+// recycles the batches. Every stage has its own thread count and the rings
+// between them are lock-free, so a slow stage shows up as stalls and queue
+// depth rather than as lock contention.
+
+#define MD5_LANES 8
+// Candidates per batch; a multiple of MD5_LANES
+#define PIPE_BATCH 256
+// Longest candidate that fits in one MD5 block with its padding
+#define PIPE_MAX_LENGTH 55
+
+// Batch of candidates of one length and their digests. The batch holds positions
+// first to first + count - 1 of the traversal order; indices[i] is the keyspace
+// index of candidate i.
+typedef struct {
+    uint64_t first;
+    int count;
+    int length;
+    char candidates[PIPE_BATCH][PIPE_MAX_LENGTH + 1];
+    uint64_t indices[PIPE_BATCH];
+    uint8_t digests[PIPE_BATCH][16];
+} CandidateBatch;
+
+typedef struct {
+    const char* alphabet;   // Characters of each position, lowest index first
+    int length;             // Candidate length, 1..PIPE_MAX_LENGTH
+    uint8_t target[16];     // MD5 digest to find
+    int samplers;           // Threads generating candidates
+    int hashers;            // Threads computing digests
+    int ring_batches;       // Capacity of each ring in batches
+    int random_order;       // Visit the keyspace in a keyed random order (permute.h)
+    uint64_t seed;          // Key of the random order
+} PipelineConfig;
+
+// Counters of one run. A stall is counted once each time a stage has to wait,
+// however long the wait. Depths are sampled by the matcher.
+typedef struct {
+    uint64_t candidates;          // Candidates generated
+    uint64_t hashed;              // Candidates digested
+    uint64_t pool_stalls;         // Samplers waiting for a free batch
+    uint64_t sampler_stalls;      // Samplers finding the candidate ring full
+    uint64_t hasher_stalls;       // Hashers finding the candidate ring empty
+    uint64_t hasher_output_stalls;// Hashers finding their digest ring full
+    uint64_t matcher_stalls;      // Matcher finding every digest ring empty
+    uint64_t max_candidate_depth; // Batches queued between samplers and hashers
+    uint64_t max_digest_depth;    // Batches queued between hashers and matcher
+    double average_candidate_depth;
+    double average_digest_depth;
+    int found;
+    uint64_t match_index;
+    char match[PIPE_MAX_LENGTH + 1];
+    double seconds;
+} PipelineStats;
+
+void md5Lanes(const char* const messages[MD5_LANES], const int lengths[MD5_LANES],
+              uint8_t digests[MD5_LANES][16]);
+int runHashPipeline(const PipelineConfig* config, PipelineStats* stats);
+void printPipelineStats(const PipelineStats* stats);
+
+#endif
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "planner.h"
+#include "diagonal.h"
+#include "scheduler.h"
+#include "outofcore.h"
+
+static const char* const backend_names[NUM_BACKENDS] = {
+    "dense", "blocked", "dense32", "factored", "out-of-core", "none"
+};
+
+// Function to get the printable name of a backend
+const char* backendName(Backend backend) {
+    return (backend >= 0 && backend < NUM_BACKENDS) ? backend_names[backend] : "unknown";
+}
+
+// Function to check whether x is a whole multiple of step
+static int isMultipleOf(double x, double step) {
+    double k = x / step;
+    return fabs(k - nearbyint(k)) < 1e-9;
+}
+
+// Function to check whether a gate is in the Clifford group (up to global phase)
+static int isCliffordGate(const Circuit* circuit, const Gate* gate) {
+    const double parameter = gateParameter(circuit, gate);
+    const int num_controls = __builtin_popcountll(gate->controls);
+
+    if (num_controls > 1) {
+        return 0;
+    }
+    if (num_controls == 1) {
+        // CNOT, CY, CZ
+        return gate->type == GATE_X || gate->type == GATE_Y || gate->type == GATE_Z ||
+               (gate->type == GATE_ZPOW && isMultipleOf(parameter, 1.0));
+    }
+    switch (gate->type) {
+        case GATE_T:
+            return 0;
+        case GATE_RX:
+        case GATE_RY:
+        case GATE_RZ:
+            return isMultipleOf(parameter, M_PI / 2);
+        case GATE_ZPOW:
+        case GATE_ZZPOW:
+            return isMultipleOf(parameter, 0.5);
+        default:
+            return 1;
+    }
+}
+
+// Function to find the union-find root of a qubit, halving the path on the way
+static int findRoot(int* parent, int q) {
+    while (parent[q] != q) {
+        parent[q] = parent[parent[q]];
+        q = parent[q];
+    }
+    return q;
+}
+
+// Function to gather the facts the planner needs from a circuit in one sweep:
+// whether every gate is Clifford, which qubits are ever entangled with each
+// other, how far apart the qubits of one gate are, and how many gates act
+// above the cache tile. The circuit must have at most 64 qubits.
+void profileCircuit(const Circuit* circuit, CircuitProfile* profile) {
+    const int n = circuit->num_qubits;
+    const int tile_qubits = cacheTileQubits();
+    int parent[64];
+    int size[64];
+
+    memset(profile, 0, sizeof(*profile));
+    profile->num_qubits = n;
+    profile->num_gates = circuit->num_gates;
+    profile->is_clifford = 1;
+    for (int q = 0; q < n; q++) {
+        parent[q] = q;
+        size[q] = 0;
+    }
+
+    for (int g = 0; g < circuit->num_gates; g++) {
+        const Gate* gate = &circuit->gates[g];
+        uint64_t touched = gate->controls | (1ULL << gate->targets[0]);
+        if (isTwoQubitGate(gate->type)) {
+            touched |= 1ULL << gate->targets[1];
+        }
+        const int low = __builtin_ctzll(touched);
+        const int high = 63 - __builtin_clzll(touched);
+
+        if (high - low > profile->max_span) {
+            profile->max_span = high - low;
+        }
+        if (!isDiagonalGate(gate) && gate->targets[0] >= tile_qubits) {
+            profile->high_gates++;
+        }
+        if (profile->is_clifford && !isCliffordGate(circuit, gate)) {
+            profile->is_clifford = 0;
+        }
+        for (uint64_t rest = touched & (touched - 1); rest != 0; rest &= rest - 1) {
+            int a = findRoot(parent, low);
+            int b = findRoot(parent, __builtin_ctzll(rest));
+            if (a != b) {
+                parent[b] = a;
+            }
+        }
+    }
+
+    // Number the groups in order of their lowest qubit
+    int label[64];
+    for (int q = 0; q < n; q++) {
+        label[q] = -1;
+    }
+    for (int q = 0; q < n; q++) {
+        int root = findRoot(parent, q);
+        if (label[root] < 0) {
+            label[root] = profile->num_components++;
+        }
+        profile->component[q] = label[root];
+        if (++size[label[root]] > profile->largest_component) {
+            profile->largest_component = size[label[root]];
+        }
+    }
+}
+
+// Function to get the memory the operating system can hand out right now
+double availableMemory(void) {
+    long pages = -1;
+#ifdef _SC_AVPHYS_PAGES
+    pages = sysconf(_SC_AVPHYS_PAGES);
+#endif
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || page_size <= 0) {
+        return 0.0;
+    }
+    return (double)pages * (double)page_size;
+}
+
+// Function to count the passes over the state that the blocked scheduler makes.
+// Falls back to one pass per gate if the schedule cannot be built.
+static int blockedPasses(const Circuit* circuit) {
+    GateSchedule schedule;
+    if (buildGateSchedule(&schedule, circuit, cacheTileQubits()) != 0) {
+        return circuit->num_gates;
+    }
+    int passes = schedule.num_steps;
+    freeGateSchedule(&schedule);
+    return passes;
+}
+
+// Function to estimate the memory, scratch disk and run time of one backend.
+// Every pass reads and writes the whole state once. Estimates are in doubles so
+// absurd widths give absurd numbers rather than overflowing.
+void estimateBackend(const Circuit* circuit, const CircuitProfile* profile, Backend backend, ResourcePlan* plan) {
+    const double state_bytes = ldexp((double)sizeof(double complex), profile->num_qubits);
+    const double gates = (double)profile->num_gates;
+
+    memset(plan, 0, sizeof(*plan));
+    plan->backend = backend;
+    switch (backend) {
+        case BACKEND_DENSE:
+            plan->memory_bytes = state_bytes;
+            plan->seconds = gates * 2.0 * state_bytes / PLANNER_MEMORY_BANDWIDTH;
+            break;
+        case BACKEND_BLOCKED:
+            plan->memory_bytes = state_bytes;
+            plan->seconds = blockedPasses(circuit) * 2.0 * state_bytes / PLANNER_MEMORY_BANDWIDTH;
+            break;
+        case BACKEND_DENSE32:
+            plan->memory_bytes = state_bytes / 2;
+            plan->seconds = gates * state_bytes / PLANNER_MEMORY_BANDWIDTH;
+            break;
+        case BACKEND_FACTORED: {
+            int size[64] = { 0 };
+            for (int q = 0; q < profile->num_qubits; q++) {
+                size[profile->component[q]]++;
+            }
+            for (int c = 0; c < profile->num_components; c++) {
+                plan->memory_bytes += ldexp((double)sizeof(double complex), size[c]);
+            }
+            for (int g = 0; g < circuit->num_gates; g++) {
+                int c = profile->component[circuit->gates[g].targets[0]];
+                plan->seconds += 2.0 * ldexp((double)sizeof(double complex), size[c]) / PLANNER_MEMORY_BANDWIDTH;
+            }
+            break;
+        }
+        case BACKEND_OUT_OF_CORE: {
+            // Low-order gates share passes; each high-order gate is assumed to need its own
+            const double chunk_bytes = ldexp((double)sizeof(double complex), cacheTileQubits());
+            plan->memory_bytes = chunk_bytes * (1 << MAX_GATHER_QUBITS);
+            plan->disk_bytes = state_bytes;
+            plan->seconds = (profile->high_gates + 1) * 2.0 * state_bytes / PLANNER_DISK_BANDWIDTH;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Function to pick a backend for a circuit and decide whether it may run.
+// Qubits that never interact are simulated as separate registers; otherwise the
+// full state goes in RAM in double precision, then single precision if the
+// tolerance allows, then on disk. Blocked execution is preferred over plain
+// dense once the state outgrows the cache. Nothing is allocated for the state.
+// Returns 0 if the job is admitted, -1 if it is refused (plan->reason says why).
+int planCircuit(const Circuit* circuit, const PlannerLimits* limits, ResourcePlan* plan) {
+    if (circuit->num_qubits < 1 || circuit->num_qubits > 64) {
+        memset(plan, 0, sizeof(*plan));
+        plan->backend = BACKEND_NONE;
+        snprintf(plan->reason, sizeof(plan->reason), "%d qubits is outside the 1-64 the circuit IR supports",
+                 circuit->num_qubits);
+        return -1;
+    }
+    CircuitProfile profile;
+    profileCircuit(circuit, &profile);
+
+    const double memory_limit = limits->memory_limit > 0.0 ? limits->memory_limit : availableMemory();
+    ResourcePlan candidate;
+    Backend order[4];
+    int count = 0;
+
+    if (profile.num_components > 1) {
+        order[count++] = BACKEND_FACTORED;
+    }
+    order[count++] = profile.num_qubits > cacheTileQubits() ? BACKEND_BLOCKED : BACKEND_DENSE;
+    if (limits->tolerance >= PLANNER_FLOAT_TOLERANCE) {
+        order[count++] = BACKEND_DENSE32;
+    }
+    order[count++] = BACKEND_OUT_OF_CORE;
+
+    for (int i = 0; i < count; i++) {
+        estimateBackend(circuit, &profile, order[i], &candidate);
+        if (candidate.memory_bytes > memory_limit || candidate.disk_bytes > limits->disk_limit) {
+            continue;
+        }
+        *plan = candidate;
+        if (limits->time_limit > 0.0 && plan->seconds > limits->time_limit) {
+            plan->admitted = 0;
+            snprintf(plan->reason, sizeof(plan->reason), "%s backend needs about %.3g s, over the %.3g s limit",
+                     backendName(plan->backend), plan->seconds, limits->time_limit);
+            return -1;
+        }
+        plan->admitted = 1;
+        snprintf(plan->reason, sizeof(plan->reason), "%d qubits in %d group(s), largest %d%s",
+                 profile.num_qubits, profile.num_components, profile.largest_component,
+                 profile.is_clifford ? ", Clifford only" : "");
+        return 0;
+    }
+
+    // Nothing fits: report the smallest in-memory footprint we could have used
+    estimateBackend(circuit, &profile, order[0], plan);
+    plan->backend = BACKEND_NONE;
+    plan->admitted = 0;
+    snprintf(plan->reason, sizeof(plan->reason), "needs %.3g GiB of memory, %.3g GiB allowed",
+             plan->memory_bytes / (1 << 30), memory_limit / (1 << 30));
+    return -1;
+}
+
+// Function to copy the gates of one group of interacting qubits into a circuit
+// on just those qubits, renumbered in order. Parameters are resolved to their
+// current values. Returns the width of the part, or -1 on failure.
+int extractComponent(const Circuit* circuit, const CircuitProfile* profile, int component, Circuit* part) {
+    int local[64];
+    int width = 0;
+    for (int q = 0; q < circuit->num_qubits; q++) {
+        local[q] = profile->component[q] == component ? width++ : -1;
+    }
+    initializeCircuit(part, width);
+    if (width == 0) {
+        return -1;
+    }
+
+    for (int g = 0; g < circuit->num_gates; g++) {
+        const Gate* gate = &circuit->gates[g];
+        if (local[gate->targets[0]] < 0) {
+            continue;
+        }
+        const double parameter = gateParameter(circuit, gate);
+        uint64_t controls = 0;
+        for (uint64_t rest = gate->controls; rest != 0; rest &= rest - 1) {
+            controls |= 1ULL << local[__builtin_ctzll(rest)];
+        }
+        int status = isTwoQubitGate(gate->type)
+            ? addTwoQubitGate(part, gate->type, local[gate->targets[0]], local[gate->targets[1]], parameter)
+            : addControlledGate(part, gate->type, controls, local[gate->targets[0]], parameter);
+        if (status < 0) {
+            freeCircuit(part);
+            return -1;
+        }
+    }
+    return width;
+}
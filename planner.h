@@ -0,0 +1,61 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "circuit.h"
+
+// Rough sustained rates used to turn passes over the state into seconds
+#define PLANNER_MEMORY_BANDWIDTH 10e9     // bytes per second over RAM
+#define PLANNER_DISK_BANDWIDTH 1e9        // bytes per second over a scratch file
+// Smallest error tolerance that single-precision amplitudes are trusted with
+#define PLANNER_FLOAT_TOLERANCE 1e-5
+
+typedef enum {
+    BACKEND_DENSE,        // statevector.c, one pass per gate
+    BACKEND_BLOCKED,      // scheduler.c, gates applied tile by tile in cache
+    BACKEND_DENSE32,      // statevector32.c, half the memory of BACKEND_DENSE
+    BACKEND_FACTORED,     // factored.c, one dense register per group of interacting qubits
+    BACKEND_OUT_OF_CORE,  // outofcore.c, state in a memory-mapped file
+    BACKEND_NONE,         // Refused: no backend fits the limits
+    NUM_BACKENDS
+} Backend;
+
+// What the planner learns about a circuit without simulating it
+typedef struct {
+    int num_qubits;
+    int num_gates;
+    int is_clifford;          // Only Clifford gates, so a stabilizer method would do
+    int num_components;       // Groups of qubits connected by multi-qubit gates
+    int largest_component;    // Qubits in the largest group
+    int component[64];        // Group of each qubit, numbered from 0
+    int max_span;             // Largest qubit distance spanned by one gate
+    int high_gates;           // Non-diagonal gates on targets above the cache tile
+} CircuitProfile;
+
+// Limits a job must fit in. Zero memory_limit means the memory currently free;
+// zero disk_limit rules out out-of-core runs; zero time_limit means no limit.
+typedef struct {
+    double memory_limit;
+    double disk_limit;
+    double time_limit;
+    double tolerance;         // Acceptable amplitude error
+} PlannerLimits;
+
+typedef struct {
+    Backend backend;
+    double memory_bytes;
+    double disk_bytes;
+    double seconds;
+    int admitted;
+    char reason[128];         // Why the job was refused, or the choice made
+} ResourcePlan;
+
+void profileCircuit(const Circuit* circuit, CircuitProfile* profile);
+double availableMemory(void);
+void estimateBackend(const Circuit* circuit, const CircuitProfile* profile, Backend backend, ResourcePlan* plan);
+int planCircuit(const Circuit* circuit, const PlannerLimits* limits, ResourcePlan* plan);
+int extractComponent(const Circuit* circuit, const CircuitProfile* profile, int component, Circuit* part);
+const char* backendName(Backend backend);
+
+#endif
@@ -4,22 +4,73 @@ import time
 import random
 import cirq
 
+# Use the native engine when its extension is built, otherwise plain Cirq
+try:
+    from nativesim import NativeSimulator as Simulator
+except ImportError:
+    Simulator = cirq.Simulator
+
 # Function to generate all possible strings of given length and characters
 def generate_strings(length, characters):
     return [''.join(p) for p in itertools.product(characters, repeat=length)]
 
+# Function to spell keyspace index as a string, first character most significant
+def index_to_string(index, length, characters):
+    chars = []
+    for _ in range(length):
+        index, digit = divmod(index, len(characters))
+        chars.append(characters[digit])
+    return ''.join(reversed(chars))
+
+# Keyed bijection on range(size): a balanced Feistel network on the smallest even
+# number of bits covering size, re-running outputs that fall outside the range
+# (cycle walking). Walking positions in order visits every index once, in random
+# order, without building the list of candidates.
+class KeyspacePermutation:
+    ROUNDS = 6
+
+    def __init__(self, size, seed=None):
+        self.size = size
+        self.half_bits = max(1, ((size - 1).bit_length() + 1) // 2)
+        self.mask = (1 << self.half_bits) - 1
+        self.width = (self.half_bits + 7) // 8
+        rng = random.Random(seed)
+        self.keys = [rng.getrandbits(128).to_bytes(16, 'little') for _ in range(self.ROUNDS)]
+
+    def _pass(self, value):
+        left, right = value >> self.half_bits, value & self.mask
+        for key in self.keys:
+            digest = hashlib.blake2b(right.to_bytes(self.width, 'little'), key=key,
+                                     digest_size=min(64, max(8, self.width))).digest()
+            left, right = right, left ^ (int.from_bytes(digest, 'little') & self.mask)
+        return (left << self.half_bits) | right
+
+    # Function to map a position in the random order to its keyspace index
+    def __getitem__(self, position):
+        value = self._pass(position)
+        while value >= self.size:
+            value = self._pass(value)
+        return value
+
+    # Function to walk positions start..stop-1; disjoint slices never overlap
+    def walk(self, start=0, stop=None):
+        stop = self.size if stop is None else min(stop, self.size)
+        for position in range(start, stop):
+            yield self[position]
+
 # Function to hash a string using SHA-256
 def hash_string_sha256(string):
     return hashlib.sha256(string.encode()).hexdigest()
 
-# Function to perform classical brute force using a specified number of bits
-def classical_brute_force(target_hash, num_bits, characters, num_iterations):
+# Function to perform classical brute force over strings of a given length,
+# trying up to num_iterations candidates in a random order without repeats
+def classical_brute_force(target_hash, length, characters, num_iterations, seed=None):
     start_time = time.time()
 
-    possible_strings = generate_strings(num_bits, characters)
-    random.shuffle(possible_strings)
+    order = KeyspacePermutation(len(characters) ** length, seed)
 
-    for string in possible_strings[:num_iterations]:
+    for index in order.walk(0, num_iterations):
+        string = index_to_string(index, length, characters)
         hashed_string = hash_string_sha256(string)
         if hashed_string == target_hash:
             end_time = time.time()
@@ -36,7 +87,7 @@ def simulate_quantum_circuit(num_qubits, target_hash, characters, num_shots):
 
     grover_circuit = grover_iterations(oracle, num_qubits)
 
-    simulator = cirq.Simulator()
+    simulator = Simulator()
     result = simulator.run(grover_circuit, repetitions=num_shots)
     counts = result.histogram(key='result')
 
@@ -89,7 +140,7 @@ if __name__ == "__main__":
     num_iterations = 2 ** 10  # Number of iterations for classical brute force
     num_shots = 1024  # Number of shots for quantum simulation
 
-    classical_result, classical_time = classical_brute_force(target_hash, num_qubits, characters, num_iterations)
+    classical_result, classical_time = classical_brute_force(target_hash, 3, characters, num_iterations)
     print("Classical brute force result:", classical_result)
     print("Time taken by classical brute force:", classical_time, "seconds")
 
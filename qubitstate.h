@@ -0,0 +1,70 @@
+#ifndef QUBITSTATE_H
+#define QUBITSTATE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "resultsink.h"
+
+// Single-qubit states of the small protocol programs (tp.c, multibit.c,
+// bitsize.c), and how they report them: as text, and as the double columns
+// name.alpha and name.beta of a result file.
+
+// Define the qubit structure
+typedef struct {
+    double alpha; // Complex coefficient for |0>
+    double beta;  // Complex coefficient for |1>
+} Qubit;
+
+// Function to print the state of a qubit
+static inline void printQubit(const Qubit* qubit) {
+    printf("|0>: %.2f\n", qubit->alpha);
+    printf("|1>: %.2f\n", qubit->beta);
+}
+
+// Function to write the states of qubits as the columns name.alpha and name.beta.
+// Returns 0 on success, -1 if a column could not be built or written.
+static inline int writeQubitStates(ResultSink* sink, const char* name, Qubit** qubits, int num_qubits) {
+    double* alpha = (double*)malloc(num_qubits * sizeof(double));
+    double* beta = (double*)malloc(num_qubits * sizeof(double));
+    if (alpha == NULL || beta == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for the %s columns.\n", name);
+        free(alpha);
+        free(beta);
+        return -1;
+    }
+    for (int i = 0; i < num_qubits; i++) {
+        alpha[i] = qubits[i]->alpha;
+        beta[i] = qubits[i]->beta;
+    }
+    char column[RESULT_NAME_LENGTH];
+    snprintf(column, sizeof(column), "%s.alpha", name);
+    int status = writeDoubleColumn(sink, column, alpha, num_qubits);
+    if (status == 0) {
+        snprintf(column, sizeof(column), "%s.beta", name);
+        status = writeDoubleColumn(sink, column, beta, num_qubits);
+    }
+    free(alpha);
+    free(beta);
+    return status;
+}
+
+// Function to report the states of qubits: as columns of the result file when
+// there is one, and as text when asked for. Returns -1 if writing the columns failed.
+static inline int reportQubitStates(ResultSink* sink, int text, const char* title, const char* name,
+                                    Qubit** qubits, int num_qubits) {
+    int status = 0;
+    if (sink != NULL) {
+        status = writeQubitStates(sink, name, qubits, num_qubits);
+    }
+    if (text) {
+        printf("%s\n", title);
+        for (int i = 0; i < num_qubits; i++) {
+            printf("Qubit %d:\n", i);
+            printQubit(qubits[i]);
+            printf("\n");
+        }
+    }
+    return status;
+}
+
+#endif
@@ -0,0 +1,693 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "statevector.h"
+#include "statevector32.h"
+#include "circuit.h"
+#include "scheduler.h"
+#include "planner.h"
+#include "framesum.h"
+#include "stateprep.h"
+#include "factored.h"
+#include "allocator.h"
+
+// CPython extension exposing the native engine as the module qusim.
+//
+//   state = qusim.simulate(num_qubits, gates, backend="auto", tolerance=0.0)
+//                               backend is "auto", "dense", "blocked", "dense32"
+//                               or "factored" (one register per cluster of
+//                               interacting qubits, clusters run concurrently)
+//   numpy.asarray(state)        complex128 (complex64 for dense32) view of the amplitudes
+//   state.probabilities()       buffer of float64
+//   state.sample(shots, seed)   buffer of uint64 basis states
+//   state.apply(gates)          run more gates in place
+//
+//   state = qusim.prepare_state(data, encoding="amplitude", rows=0, cols=0, color_bits=8)
+//                               register loaded straight from data: normalized
+//                               amplitudes, or a rows x cols 0..255 image as
+//                               "frqi" or "neqr"
+//   angles, frames = qusim.encode_frames(path, rows, cols, format="y4m", width=0, height=0)
+//                               per-cell RX angles (float64, row-major) from the
+//                               average luma of a Y4M or raw gray8/i420 video
+//   pinned = qusim.pin_threads()
+//                               pin the OpenMP workers to CPUs node by node
+//                               (see pinWorkerThreads); call before simulating
+//
+// gates is a sequence of text lines in the parseGateLine syntax ("H 0",
+// "RX 2 0.5", "CX 0 1") or of tuples of the same fields ("CX", 0, 1).
+// Every result supports the buffer protocol and is exported without copying;
+// simulation runs with the GIL released.
+
+typedef struct {
+    PyObject_HEAD
+    QubitRegister* reg;       // Set for double precision
+    QubitRegister32* reg32;   // Set for dense32
+    Backend backend;
+    Py_ssize_t shape;
+} StateVectorObject;
+
+// Native array owned by Python and exported through the buffer protocol
+typedef struct {
+    PyObject_HEAD
+    void* data;
+    Py_ssize_t count;
+    Py_ssize_t itemsize;
+    const char* format;
+} ArrayObject;
+
+static PyTypeObject StateVectorType;
+static PyTypeObject ArrayType;
+
+// Function to wrap a malloc'd array in a buffer object that frees it
+static PyObject* newArray(void* data, Py_ssize_t count, Py_ssize_t itemsize, const char* format) {
+    ArrayObject* array = PyObject_New(ArrayObject, &ArrayType);
+    if (array == NULL) {
+        free(data);
+        return NULL;
+    }
+    array->data = data;
+    array->count = count;
+    array->itemsize = itemsize;
+    array->format = format;
+    return (PyObject*)array;
+}
+
+static void arrayDealloc(ArrayObject* self) {
+    free(self->data);
+    PyObject_Free(self);
+}
+
+static Py_ssize_t arrayLength(ArrayObject* self) {
+    return self->count;
+}
+
+// Function to export an array as a one-dimensional buffer
+static int arrayGetBuffer(ArrayObject* self, Py_buffer* view, int flags) {
+    if (PyBuffer_FillInfo(view, (PyObject*)self, self->data, self->count * self->itemsize, 0, flags) != 0) {
+        return -1;
+    }
+    view->itemsize = self->itemsize;
+    if (flags & PyBUF_FORMAT) {
+        view->format = (char*)self->format;
+    }
+    if (flags & PyBUF_ND) {
+        view->ndim = 1;
+        view->shape = &self->count;
+    }
+    if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) {
+        view->strides = &view->itemsize;
+    }
+    return 0;
+}
+
+static PyBufferProcs array_buffer = { (getbufferproc)arrayGetBuffer, NULL };
+static PySequenceMethods array_sequence = { .sq_length = (lenfunc)arrayLength };
+
+static PyTypeObject ArrayType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "qusim.Array",
+    .tp_doc = "Native result array; wrap with numpy.asarray or memoryview",
+    .tp_basicsize = sizeof(ArrayObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)arrayDealloc,
+    .tp_as_buffer = &array_buffer,
+    .tp_as_sequence = &array_sequence,
+};
+
+// Function to turn one Python gate (a text line or a tuple of fields) into a
+// gate of the circuit. Returns 0 on success, -1 with a Python error set.
+static int appendPythonGate(Circuit* circuit, PyObject* item) {
+    PyObject* line;
+    if (PyUnicode_Check(item)) {
+        Py_INCREF(item);
+        line = item;
+    } else if (PyTuple_Check(item) || PyList_Check(item)) {
+        PyObject* space = PyUnicode_FromString(" ");
+        PyObject* fields = PySequence_List(item);
+        if (space == NULL || fields == NULL) {
+            Py_XDECREF(space);
+            Py_XDECREF(fields);
+            return -1;
+        }
+        Py_ssize_t count = PyList_GET_SIZE(fields);
+        for (Py_ssize_t f = 0; f < count; f++) {
+            PyObject* text = PyObject_Str(PyList_GET_ITEM(fields, f));
+            if (text == NULL) {
+                Py_DECREF(space);
+                Py_DECREF(fields);
+                return -1;
+            }
+            PyList_SetItem(fields, f, text);
+        }
+        line = PyUnicode_Join(space, fields);
+        Py_DECREF(space);
+        Py_DECREF(fields);
+        if (line == NULL) {
+            return -1;
+        }
+    } else {
+        PyErr_SetString(PyExc_TypeError, "gates must be strings or tuples");
+        return -1;
+    }
+
+    const char* text = PyUnicode_AsUTF8(line);
+    int status = text != NULL ? parseGateLine(circuit, text) : -1;
+    if (status < 0 && text != NULL) {
+        PyErr_Format(PyExc_ValueError, "invalid gate: %s", text);
+    }
+    Py_DECREF(line);
+    return status < 0 ? -1 : 0;
+}
+
+// Function to build a circuit from a Python sequence of gates.
+// Returns 0 on success, -1 with a Python error set.
+static int buildPythonCircuit(Circuit* circuit, int num_qubits, PyObject* gates) {
+    initializeCircuit(circuit, num_qubits);
+    PyObject* iterator = PyObject_GetIter(gates);
+    if (iterator == NULL) {
+        return -1;
+    }
+    PyObject* item;
+    while ((item = PyIter_Next(iterator)) != NULL) {
+        int status = appendPythonGate(circuit, item);
+        Py_DECREF(item);
+        if (status != 0) {
+            Py_DECREF(iterator);
+            freeCircuit(circuit);
+            return -1;
+        }
+    }
+    Py_DECREF(iterator);
+    if (PyErr_Occurred()) {
+        freeCircuit(circuit);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to run a circuit on the state's backend, without the GIL
+static void runOnBackend(StateVectorObject* self, const Circuit* circuit) {
+    Py_BEGIN_ALLOW_THREADS
+    if (self->reg32 != NULL) {
+        applyCircuit32(self->reg32, circuit, 0);
+    } else if (self->backend != BACKEND_BLOCKED || applyCircuitBlocked(self->reg, circuit) != 0) {
+        applyCircuit(self->reg, circuit);
+    }
+    Py_END_ALLOW_THREADS
+}
+
+// Function to map a backend name to a backend, planning it for "auto".
+// Returns -1 with a Python error set if the name is unknown or the job is refused.
+static int chooseBackend(const char* name, const Circuit* circuit, double tolerance, Backend* backend) {
+    if (strcmp(name, "dense") == 0) {
+        *backend = BACKEND_DENSE;
+    } else if (strcmp(name, "blocked") == 0) {
+        *backend = BACKEND_BLOCKED;
+    } else if (strcmp(name, "dense32") == 0) {
+        *backend = BACKEND_DENSE32;
+    } else if (strcmp(name, "factored") == 0) {
+        *backend = BACKEND_FACTORED;
+    } else if (strcmp(name, "auto") == 0) {
+        PlannerLimits limits = { 0.0, 0.0, 0.0, tolerance };
+        ResourcePlan plan;
+        int admitted;
+        Py_BEGIN_ALLOW_THREADS
+        admitted = planCircuit(circuit, &limits, &plan);
+        Py_END_ALLOW_THREADS
+        if (admitted != 0 || plan.backend == BACKEND_OUT_OF_CORE) {
+            PyErr_Format(PyExc_MemoryError, "circuit refused: %s", admitted != 0 ? plan.reason : "state only fits on disk");
+            return -1;
+        }
+        // A full state vector is returned, so a factored plan must still fit dense
+        if (plan.backend == BACKEND_FACTORED) {
+            CircuitProfile profile;
+            ResourcePlan dense;
+            profileCircuit(circuit, &profile);
+            estimateBackend(circuit, &profile, BACKEND_DENSE, &dense);
+            if (dense.memory_bytes > availableMemory()) {
+                char message[128];
+                snprintf(message, sizeof(message), "circuit refused: the full state needs %.3g GiB",
+                         dense.memory_bytes / (1 << 30));
+                PyErr_SetString(PyExc_MemoryError, message);
+                return -1;
+            }
+        }
+        *backend = plan.backend;
+    } else {
+        PyErr_Format(PyExc_ValueError, "unknown backend '%s' (auto, dense, blocked, dense32, factored)", name);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to simulate a circuit from |0...0> and return the final state
+static PyObject* simulate(PyObject* module, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = { "num_qubits", "gates", "backend", "tolerance", NULL };
+    int num_qubits;
+    PyObject* gates;
+    const char* backend_name = "auto";
+    double tolerance = 0.0;
+    (void)module;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iO|sd", keywords, &num_qubits, &gates, &backend_name, &tolerance)) {
+        return NULL;
+    }
+    if (num_qubits < 1 || num_qubits > 62) {
+        PyErr_SetString(PyExc_ValueError, "num_qubits must be between 1 and 62");
+        return NULL;
+    }
+    Circuit circuit;
+    if (buildPythonCircuit(&circuit, num_qubits, gates) != 0) {
+        return NULL;
+    }
+    Backend backend;
+    if (chooseBackend(backend_name, &circuit, tolerance, &backend) != 0) {
+        freeCircuit(&circuit);
+        return NULL;
+    }
+
+    StateVectorObject* self = PyObject_New(StateVectorObject, &StateVectorType);
+    if (self == NULL) {
+        freeCircuit(&circuit);
+        return NULL;
+    }
+    self->reg = NULL;
+    self->reg32 = NULL;
+    self->backend = backend;
+    self->shape = (Py_ssize_t)(1ULL << num_qubits);
+
+    // The factored backend runs the whole circuit on its clusters and only then
+    // expands them into the dense state; later gates run dense. Only allocation
+    // failures are out of memory: a failed run is reported as such, with its
+    // cause already printed by factored.c
+    int factored = 0;
+    int run_failed = 0;
+    Py_BEGIN_ALLOW_THREADS
+    if (backend == BACKEND_DENSE32) {
+        self->reg32 = initializeRegister32(num_qubits);
+    } else if (backend == BACKEND_FACTORED) {
+        FactoredState* state = initializeFactoredState(num_qubits);
+        if (state != NULL) {
+            if (applyCircuitFactored(state, &circuit, 0, NULL) == 0) {
+                self->reg = expandFactoredState(state);
+                factored = 1;
+            } else {
+                run_failed = 1;
+            }
+        }
+        freeFactoredState(state);
+    } else {
+        self->reg = initializeRegister(num_qubits);
+    }
+    Py_END_ALLOW_THREADS
+    if (run_failed) {
+        freeCircuit(&circuit);
+        Py_DECREF(self);
+        PyErr_SetString(PyExc_RuntimeError, "the factored backend failed to run the circuit");
+        return NULL;
+    }
+    if (self->reg == NULL && self->reg32 == NULL) {
+        freeCircuit(&circuit);
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    if (!factored) {
+        runOnBackend(self, &circuit);
+    }
+    freeCircuit(&circuit);
+    return (PyObject*)self;
+}
+
+static void stateVectorDealloc(StateVectorObject* self) {
+    freeRegister(self->reg);
+    freeRegister32(self->reg32);
+    PyObject_Free(self);
+}
+
+// Function to run more gates on a state in place
+static PyObject* stateVectorApply(StateVectorObject* self, PyObject* gates) {
+    Circuit circuit;
+    int num_qubits = self->reg != NULL ? self->reg->num_qubits : self->reg32->num_qubits;
+    if (buildPythonCircuit(&circuit, num_qubits, gates) != 0) {
+        return NULL;
+    }
+    runOnBackend(self, &circuit);
+    freeCircuit(&circuit);
+    Py_RETURN_NONE;
+}
+
+// Function to get |amplitude|^2 of every basis state as a float64 buffer
+static PyObject* stateVectorProbabilities(StateVectorObject* self, PyObject* unused) {
+    (void)unused;
+    const uint64_t size = (uint64_t)self->shape;
+    double* probabilities = (double*)malloc(size * sizeof(double));
+    if (probabilities == NULL) {
+        return PyErr_NoMemory();
+    }
+    Py_BEGIN_ALLOW_THREADS
+    if (self->reg != NULL) {
+        const double complex* amp = self->reg->amplitudes;
+        #pragma omp parallel for schedule(static) if (size >= PARALLEL_THRESHOLD)
+        for (int64_t i = 0; i < (int64_t)size; i++) {
+            probabilities[i] = creal(amp[i]) * creal(amp[i]) + cimag(amp[i]) * cimag(amp[i]);
+        }
+    } else {
+        const float complex* amp = self->reg32->amplitudes;
+        #pragma omp parallel for schedule(static) if (size >= PARALLEL_THRESHOLD)
+        for (int64_t i = 0; i < (int64_t)size; i++) {
+            double re = crealf(amp[i]);
+            double im = cimagf(amp[i]);
+            probabilities[i] = re * re + im * im;
+        }
+    }
+    Py_END_ALLOW_THREADS
+    return newArray(probabilities, self->shape, sizeof(double), "d");
+}
+
+// Function to draw basis-state samples as a uint64 buffer
+static PyObject* stateVectorSample(StateVectorObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = { "shots", "seed", NULL };
+    unsigned long long shots;
+    unsigned long long seed = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "K|K", keywords, &shots, &seed)) {
+        return NULL;
+    }
+    // The result is one Py_ssize_t-indexed array; this also keeps the byte count from wrapping
+    if (shots > (unsigned long long)(PY_SSIZE_T_MAX / sizeof(uint64_t)) - 1) {
+        PyErr_Format(PyExc_ValueError, "shots must be at most %zd", PY_SSIZE_T_MAX / (Py_ssize_t)sizeof(uint64_t) - 1);
+        return NULL;
+    }
+    uint64_t* samples = (uint64_t*)malloc((shots + 1) * sizeof(uint64_t));
+    if (samples == NULL) {
+        return PyErr_NoMemory();
+    }
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = self->reg != NULL ? sampleRegister(self->reg, shots, seed, samples)
+                               : sampleRegister32(self->reg32, shots, seed, samples);
+    Py_END_ALLOW_THREADS
+    if (status != 0) {
+        free(samples);
+        return PyErr_NoMemory();
+    }
+    return newArray(samples, (Py_ssize_t)shots, sizeof(uint64_t), "Q");
+}
+
+static PyObject* stateVectorNumQubits(StateVectorObject* self, void* closure) {
+    (void)closure;
+    return PyLong_FromLong(self->reg != NULL ? self->reg->num_qubits : self->reg32->num_qubits);
+}
+
+static PyObject* stateVectorBackend(StateVectorObject* self, void* closure) {
+    (void)closure;
+    return PyUnicode_FromString(backendName(self->backend));
+}
+
+static Py_ssize_t stateVectorLength(StateVectorObject* self) {
+    return self->shape;
+}
+
+// Function to export the live amplitudes; the view keeps the state alive
+static int stateVectorGetBuffer(StateVectorObject* self, Py_buffer* view, int flags) {
+    void* data = self->reg != NULL ? (void*)self->reg->amplitudes : (void*)self->reg32->amplitudes;
+    Py_ssize_t itemsize = self->reg != NULL ? (Py_ssize_t)sizeof(double complex) : (Py_ssize_t)sizeof(float complex);
+    if (PyBuffer_FillInfo(view, (PyObject*)self, data, self->shape * itemsize, 0, flags) != 0) {
+        return -1;
+    }
+    view->itemsize = itemsize;
+    if (flags & PyBUF_FORMAT) {
+        view->format = self->reg != NULL ? "Zd" : "Zf";
+    }
+    if (flags & PyBUF_ND) {
+        view->ndim = 1;
+        view->shape = &self->shape;
+    }
+    if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) {
+        view->strides = &view->itemsize;
+    }
+    return 0;
+}
+
+static PyMethodDef state_vector_methods[] = {
+    { "apply", (PyCFunction)stateVectorApply, METH_O, "Run more gates on the state in place" },
+    { "probabilities", (PyCFunction)stateVectorProbabilities, METH_NOARGS, "Probability of every basis state" },
+    { "sample", (PyCFunction)(void (*)(void))stateVectorSample, METH_VARARGS | METH_KEYWORDS,
+      "sample(shots, seed=0): basis states drawn from the state" },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyGetSetDef state_vector_getset[] = {
+    { "num_qubits", (getter)stateVectorNumQubits, NULL, "Register width", NULL },
+    { "backend", (getter)stateVectorBackend, NULL, "Backend the state lives on", NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyBufferProcs state_vector_buffer = { (getbufferproc)stateVectorGetBuffer, NULL };
+static PySequenceMethods state_vector_sequence = { .sq_length = (lenfunc)stateVectorLength };
+
+static PyTypeObject StateVectorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "qusim.StateVector",
+    .tp_doc = "Native state vector; numpy.asarray shares its amplitudes",
+    .tp_basicsize = sizeof(StateVectorObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)stateVectorDealloc,
+    .tp_methods = state_vector_methods,
+    .tp_getset = state_vector_getset,
+    .tp_as_buffer = &state_vector_buffer,
+    .tp_as_sequence = &state_vector_sequence,
+};
+
+// Function to copy a Python buffer of float64, or any sequence of numbers, into
+// a malloc'd array. Returns NULL with a Python error set on failure.
+static double* readPythonDoubles(PyObject* data, Py_ssize_t* count) {
+    Py_buffer view;
+    if (PyObject_GetBuffer(data, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) == 0) {
+        if (view.format != NULL && strcmp(view.format, "d") == 0) {
+            double* values = (double*)malloc(view.len > 0 ? (size_t)view.len : 1);
+            if (values == NULL) {
+                PyBuffer_Release(&view);
+                PyErr_NoMemory();
+                return NULL;
+            }
+            memcpy(values, view.buf, (size_t)view.len);
+            *count = view.len / (Py_ssize_t)sizeof(double);
+            PyBuffer_Release(&view);
+            return values;
+        }
+        PyBuffer_Release(&view);
+    } else {
+        PyErr_Clear();
+    }
+
+    PyObject* sequence = PySequence_Fast(data, "data must be a sequence of numbers");
+    if (sequence == NULL) {
+        return NULL;
+    }
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(sequence);
+    double* values = (double*)malloc(n > 0 ? (size_t)n * sizeof(double) : 1);
+    if (values == NULL) {
+        Py_DECREF(sequence);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    PyObject** items = PySequence_Fast_ITEMS(sequence);
+    for (Py_ssize_t i = 0; i < n; i++) {
+        values[i] = PyFloat_AsDouble(items[i]);
+        if (values[i] == -1.0 && PyErr_Occurred()) {
+            free(values);
+            Py_DECREF(sequence);
+            return NULL;
+        }
+    }
+    Py_DECREF(sequence);
+    *count = n;
+    return values;
+}
+
+// Function to build a state directly from classical data
+static PyObject* prepareState(PyObject* module, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = { "data", "encoding", "rows", "cols", "color_bits", NULL };
+    PyObject* data;
+    const char* encoding = "amplitude";
+    int rows = 0, cols = 0, color_bits = 8;
+    (void)module;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|siii", keywords, &data, &encoding, &rows, &cols, &color_bits)) {
+        return NULL;
+    }
+    int is_amplitude = strcmp(encoding, "amplitude") == 0;
+    int is_frqi = strcmp(encoding, "frqi") == 0;
+    int is_neqr = strcmp(encoding, "neqr") == 0;
+    if (!is_amplitude && !is_frqi && !is_neqr) {
+        PyErr_Format(PyExc_ValueError, "unknown encoding '%s' (amplitude, frqi, neqr)", encoding);
+        return NULL;
+    }
+    Py_ssize_t count;
+    double* values = readPythonDoubles(data, &count);
+    if (values == NULL) {
+        return NULL;
+    }
+    if (count == 0 || (!is_amplitude && (rows < 1 || cols < 1 || (Py_ssize_t)rows * cols != count))) {
+        free(values);
+        PyErr_SetString(PyExc_ValueError, "data must be non-empty, with rows * cols pixels for images");
+        return NULL;
+    }
+    if (is_neqr && (color_bits < 1 || color_bits > 8)) {
+        free(values);
+        PyErr_SetString(PyExc_ValueError, "color_bits must be between 1 and 8");
+        return NULL;
+    }
+
+    int num_qubits = is_amplitude ? indexQubits((uint64_t)count)
+                   : is_frqi ? frqiQubits(rows, cols) : neqrQubits(rows, cols, color_bits);
+    if (num_qubits > 62) {
+        free(values);
+        PyErr_SetString(PyExc_ValueError, "data needs more than 62 qubits");
+        return NULL;
+    }
+    StateVectorObject* self = PyObject_New(StateVectorObject, &StateVectorType);
+    if (self == NULL) {
+        free(values);
+        return NULL;
+    }
+    self->reg32 = NULL;
+    self->backend = BACKEND_DENSE;
+    self->shape = (Py_ssize_t)(1ULL << num_qubits);
+
+    int status = -1;
+    Py_BEGIN_ALLOW_THREADS
+    self->reg = initializeRegister(num_qubits);
+    if (self->reg != NULL) {
+        if (is_amplitude) {
+            status = prepareAmplitudes(self->reg, values, (uint64_t)count);
+        } else if (is_frqi) {
+            status = prepareFrqi(self->reg, values, rows, cols);
+        } else {
+            uint8_t* pixels = (uint8_t*)malloc((size_t)count);
+            if (pixels != NULL) {
+                for (Py_ssize_t i = 0; i < count; i++) {
+                    pixels[i] = (uint8_t)lround(fmin(fmax(values[i], 0.0), 255.0));
+                }
+                status = prepareNeqr(self->reg, pixels, rows, cols, color_bits);
+                free(pixels);
+            }
+        }
+    }
+    Py_END_ALLOW_THREADS
+    free(values);
+    if (self->reg == NULL) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    if (status != 0) {
+        Py_DECREF(self);
+        PyErr_SetString(PyExc_ValueError, "cannot prepare the state (all-zero data?)");
+        return NULL;
+    }
+    return (PyObject*)self;
+}
+
+// Function to average a video's luma and turn it into RX encoding angles on a
+// rows x cols grid, returning (angles, frames)
+static PyObject* encodeFrames(PyObject* module, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = { "path", "rows", "cols", "format", "width", "height", NULL };
+    const char* path;
+    int rows, cols;
+    const char* format_name = "y4m";
+    int width = 0, height = 0;
+    (void)module;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sii|sii", keywords, &path, &rows, &cols,
+                                     &format_name, &width, &height)) {
+        return NULL;
+    }
+    FrameFormat format;
+    if (strcmp(format_name, "y4m") == 0) {
+        format = FRAME_Y4M;
+    } else if (strcmp(format_name, "gray8") == 0) {
+        format = FRAME_GRAY8;
+    } else if (strcmp(format_name, "i420") == 0) {
+        format = FRAME_I420;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "format must be 'y4m', 'gray8' or 'i420'");
+        return NULL;
+    }
+    if (rows < 1 || cols < 1) {
+        PyErr_SetString(PyExc_ValueError, "rows and cols must be positive");
+        return NULL;
+    }
+    double* angles = (double*)malloc((size_t)rows * (size_t)cols * sizeof(double));
+    if (angles == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    FrameAverage* average;
+    Py_BEGIN_ALLOW_THREADS
+    average = averageFrames(path, format, width, height);
+    if (average != NULL) {
+        encodingAngles(average, rows, cols, angles);
+    }
+    Py_END_ALLOW_THREADS
+    if (average == NULL) {
+        free(angles);
+        PyErr_Format(PyExc_OSError, "cannot read frames from %s", path);
+        return NULL;
+    }
+    unsigned long long frames = (unsigned long long)average->frames;
+    freeFrameAverage(average);
+
+    PyObject* array = newArray(angles, (Py_ssize_t)rows * cols, sizeof(double), "d");
+    if (array == NULL) {
+        return NULL;
+    }
+    return Py_BuildValue("(NK)", array, frames);
+}
+
+// Function to pin the OpenMP worker threads, returning how many were pinned
+static PyObject* pinThreads(PyObject* module, PyObject* unused) {
+    (void)module;
+    (void)unused;
+    int pinned = pinWorkerThreads();
+    if (pinned < 0) {
+        PyErr_SetString(PyExc_OSError, "cannot pin the worker threads");
+        return NULL;
+    }
+    return PyLong_FromLong(pinned);
+}
+
+static PyMethodDef module_methods[] = {
+    { "simulate", (PyCFunction)(void (*)(void))simulate, METH_VARARGS | METH_KEYWORDS,
+      "simulate(num_qubits, gates, backend='auto', tolerance=0.0): final state from |0...0>" },
+    { "prepare_state", (PyCFunction)(void (*)(void))prepareState, METH_VARARGS | METH_KEYWORDS,
+      "prepare_state(data, encoding='amplitude', rows=0, cols=0, color_bits=8): state loaded from data" },
+    { "encode_frames", (PyCFunction)(void (*)(void))encodeFrames, METH_VARARGS | METH_KEYWORDS,
+      "encode_frames(path, rows, cols, format='y4m', width=0, height=0): (RX angles, frame count)" },
+    { "pin_threads", pinThreads, METH_NOARGS, "pin_threads(): number of OpenMP worker threads pinned to CPUs" },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef qusim_module = {
+    PyModuleDef_HEAD_INIT, "qusim", "Native state-vector engine", -1, module_methods,
+    NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit_qusim(void) {
+    if (PyType_Ready(&ArrayType) < 0 || PyType_Ready(&StateVectorType) < 0) {
+        return NULL;
+    }
+    PyObject* module = PyModule_Create(&qusim_module);
+    if (module == NULL) {
+        return NULL;
+    }
+    Py_INCREF(&StateVectorType);
+    if (PyModule_AddObject(module, "StateVector", (PyObject*)&StateVectorType) < 0) {
+        Py_DECREF(&StateVectorType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "resultsink.h"
+
+// Prints a result file written through resultsink.c.
+//
+// Usage: resultdump <file> [column]
+//
+// With only a file, prints one summary line per column. With a column name,
+// prints every value of that column, one per line.
+
+// Function to print every value of one column
+static void dumpColumn(const ResultColumn* column) {
+    for (uint64_t i = 0; i < column->count; i++) {
+        switch (column->type) {
+            case RESULT_SHOTS:
+                printf("%llu\n", (unsigned long long)shotRecord(column, i));
+                break;
+            case RESULT_HISTOGRAM: {
+                const uint64_t* outcomes = (const uint64_t*)column->data;
+                printf("%llu %llu\n", (unsigned long long)outcomes[i], (unsigned long long)outcomes[column->count + i]);
+                break;
+            }
+            case RESULT_AMPLITUDES: {
+                const double complex* amplitudes = (const double complex*)column->data;
+                printf("%.17g %.17g\n", creal(amplitudes[i]), cimag(amplitudes[i]));
+                break;
+            }
+            case RESULT_DOUBLES:
+                printf("%.17g\n", ((const double*)column->data)[i]);
+                break;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <file> [column]\n", argv[0]);
+        return 1;
+    }
+    ResultFile* file = openResultFile(argv[1]);
+    if (file == NULL) {
+        return 1;
+    }
+    int status = 0;
+    if (argc == 2) {
+        writeResultSummary(file, stdout);
+    } else {
+        const ResultColumn* column = findResultColumn(file, argv[2]);
+        if (column == NULL) {
+            fprintf(stderr, "Error: No column named %s.\n", argv[2]);
+            status = 1;
+        } else {
+            dumpColumn(column);
+        }
+    }
+    closeResultFile(file);
+    return status;
+}
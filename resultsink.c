@@ -0,0 +1,398 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "resultsink.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "resultsink.c writes host arrays as little-endian data"
+#endif
+
+// Shots packed per piece of a shot column: a multiple of 64, so every piece
+// ends on a word boundary whatever the record width
+#define RESULT_PACK_SHOTS 65536
+
+// Function to write a list of buffers, resuming after short writes
+static int writevAll(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count > IOV_MAX ? IOV_MAX : count);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        size_t done = (size_t)n;
+        while (count > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return 0;
+}
+
+// Function to write out the buffered bytes, followed by data if given, in one writev
+static int flushSink(ResultSink* sink, const void* data, size_t bytes) {
+    struct iovec iov[2];
+    int count = 0;
+    if (sink->used > 0) {
+        iov[count].iov_base = sink->buffer;
+        iov[count].iov_len = sink->used;
+        count++;
+    }
+    if (bytes > 0) {
+        iov[count].iov_base = (void*)data;
+        iov[count].iov_len = bytes;
+        count++;
+    }
+    sink->used = 0;
+    if (count > 0 && writevAll(sink->fd, iov, count) != 0) {
+        fprintf(stderr, "Error: Writing results failed: %s\n", strerror(errno));
+        sink->failed = 1;
+        return -1;
+    }
+    return 0;
+}
+
+// Function to append bytes to the file: copied into the buffer when small,
+// written straight from the caller's memory behind the buffer when large
+static int sinkWrite(ResultSink* sink, const void* data, size_t bytes) {
+    if (sink->failed) {
+        return -1;
+    }
+    if (bytes >= RESULT_DIRECT_BYTES) {
+        return flushSink(sink, data, bytes);
+    }
+    if (sink->used + bytes > RESULT_BUFFER_BYTES && flushSink(sink, NULL, 0) != 0) {
+        return -1;
+    }
+    memcpy(sink->buffer + sink->used, data, bytes);
+    sink->used += bytes;
+    return 0;
+}
+
+// Function to append a column header
+static int beginColumn(ResultSink* sink, const char* name, ResultColumnType type, int bits,
+                       uint64_t count, uint64_t bytes) {
+    ResultColumnHeader header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.name, name, RESULT_NAME_LENGTH - 1);
+    header.type = (uint32_t)type;
+    header.bits = (uint32_t)bits;
+    header.count = count;
+    header.bytes = bytes;
+    return sinkWrite(sink, &header, sizeof(header));
+}
+
+// Function to create a result file, replacing any file at path
+ResultSink* openResultSink(const char* path) {
+    ResultSink* sink = (ResultSink*)malloc(sizeof(ResultSink));
+    uint8_t* buffer = (uint8_t*)malloc(RESULT_BUFFER_BYTES);
+    if (sink == NULL || buffer == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for the result sink.\n");
+        free(sink);
+        free(buffer);
+        return NULL;
+    }
+    sink->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (sink->fd < 0) {
+        fprintf(stderr, "Error: Cannot create result file %s: %s\n", path, strerror(errno));
+        free(sink);
+        free(buffer);
+        return NULL;
+    }
+    sink->buffer = buffer;
+    sink->used = 0;
+    sink->failed = 0;
+
+    ResultFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RESULT_MAGIC, 8);
+    header.version = RESULT_VERSION;
+    if (sinkWrite(sink, &header, sizeof(header)) != 0) {
+        close(sink->fd);
+        free(sink->buffer);
+        free(sink);
+        return NULL;
+    }
+    return sink;
+}
+
+// Function to append measurement records of bits bits each (1..64), bit-packed.
+// Bits of a record above bits are ignored.
+int writeShotColumn(ResultSink* sink, const char* name, const uint64_t* shots, uint64_t count, int bits) {
+    if (bits < 1 || bits > 64) {
+        fprintf(stderr, "Error: Shot records must be 1 to 64 bits wide.\n");
+        return -1;
+    }
+    const uint64_t total_words = (count * (uint64_t)bits + 63) / 64;
+    if (beginColumn(sink, name, RESULT_SHOTS, bits, count, total_words * 8) != 0) {
+        return -1;
+    }
+    const uint64_t mask = bits == 64 ? ~0ULL : (1ULL << bits) - 1;
+    uint64_t* words = (uint64_t*)malloc((size_t)RESULT_PACK_SHOTS / 64 * (size_t)bits * sizeof(uint64_t));
+    if (words == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for packing shots.\n");
+        sink->failed = 1;
+        return -1;
+    }
+
+    for (uint64_t start = 0; start < count; start += RESULT_PACK_SHOTS) {
+        uint64_t n = count - start < RESULT_PACK_SHOTS ? count - start : RESULT_PACK_SHOTS;
+        size_t num_words = (size_t)((n * (uint64_t)bits + 63) / 64);
+        memset(words, 0, num_words * sizeof(uint64_t));
+        for (uint64_t i = 0; i < n; i++) {
+            uint64_t value = shots[start + i] & mask;
+            uint64_t position = i * (uint64_t)bits;
+            uint64_t w = position >> 6;
+            int offset = (int)(position & 63);
+            words[w] |= value << offset;
+            if (offset + bits > 64) {
+                words[w + 1] |= value >> (64 - offset);
+            }
+        }
+        if (sinkWrite(sink, words, num_words * sizeof(uint64_t)) != 0) {
+            free(words);
+            return -1;
+        }
+    }
+    free(words);
+    return 0;
+}
+
+// Function to append a histogram as an outcome column and a frequency column
+int writeHistogramColumn(ResultSink* sink, const char* name, const uint64_t* outcomes,
+                         const uint64_t* frequencies, uint64_t count) {
+    uint64_t bytes = count * sizeof(uint64_t);
+    if (beginColumn(sink, name, RESULT_HISTOGRAM, 64, count, 2 * bytes) != 0 ||
+        sinkWrite(sink, outcomes, (size_t)bytes) != 0 ||
+        sinkWrite(sink, frequencies, (size_t)bytes) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Function to append complex amplitudes; a large register is written straight
+// from its own memory
+int writeAmplitudeColumn(ResultSink* sink, const char* name, const double complex* amplitudes, uint64_t count) {
+    uint64_t bytes = count * sizeof(double complex);
+    if (beginColumn(sink, name, RESULT_AMPLITUDES, 0, count, bytes) != 0 ||
+        sinkWrite(sink, amplitudes, (size_t)bytes) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Function to append an array of doubles
+int writeDoubleColumn(ResultSink* sink, const char* name, const double* values, uint64_t count) {
+    uint64_t bytes = count * sizeof(double);
+    if (beginColumn(sink, name, RESULT_DOUBLES, 0, count, bytes) != 0 ||
+        sinkWrite(sink, values, (size_t)bytes) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Function to flush and close a result file. Returns -1 if any write failed.
+int closeResultSink(ResultSink* sink) {
+    if (sink == NULL) {
+        return -1;
+    }
+    if (!sink->failed) {
+        flushSink(sink, NULL, 0);
+    }
+    int status = sink->failed ? -1 : 0;
+    if (close(sink->fd) != 0) {
+        status = -1;
+    }
+    free(sink->buffer);
+    free(sink);
+    return status;
+}
+
+// Function to get the data bytes a column header must carry, or UINT64_MAX for
+// an unknown type or a count whose size does not fit in 64 bits
+static uint64_t expectedBytes(const ResultColumnHeader* header) {
+    uint64_t element_size;
+    switch (header->type) {
+        case RESULT_SHOTS:
+            if (header->bits < 1 || header->bits > 64 || header->count > (UINT64_MAX - 63) / header->bits) {
+                return UINT64_MAX;
+            }
+            return (header->count * header->bits + 63) / 64 * 8;
+        case RESULT_HISTOGRAM:
+            element_size = 2 * sizeof(uint64_t);
+            break;
+        case RESULT_AMPLITUDES:
+            element_size = sizeof(double complex);
+            break;
+        case RESULT_DOUBLES:
+            element_size = sizeof(double);
+            break;
+        default:
+            return UINT64_MAX;
+    }
+    if (header->count > UINT64_MAX / element_size) {
+        return UINT64_MAX;
+    }
+    return header->count * element_size;
+}
+
+// Function to map a result file and index its columns. A truncated last column
+// is dropped with a warning. Returns NULL if the file is not a result file.
+ResultFile* openResultFile(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open result file %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ResultFileHeader)) {
+        fprintf(stderr, "Error: %s is not a result file.\n", path);
+        close(fd);
+        return NULL;
+    }
+    size_t length = (size_t)info.st_size;
+    void* map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map result file %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    const ResultFileHeader* header = (const ResultFileHeader*)map;
+    if (memcmp(header->magic, RESULT_MAGIC, 8) != 0 || header->version != RESULT_VERSION) {
+        fprintf(stderr, "Error: %s is not a version %d result file.\n", path, RESULT_VERSION);
+        munmap(map, length);
+        return NULL;
+    }
+
+    ResultFile* file = (ResultFile*)calloc(1, sizeof(ResultFile));
+    if (file == NULL) {
+        munmap(map, length);
+        return NULL;
+    }
+    file->map = map;
+    file->length = length;
+
+    int capacity = 0;
+    size_t offset = sizeof(ResultFileHeader);
+    while (offset + sizeof(ResultColumnHeader) <= length) {
+        const ResultColumnHeader* column = (const ResultColumnHeader*)((const char*)map + offset);
+        uint64_t data_offset = offset + sizeof(ResultColumnHeader);
+        if (column->bytes != expectedBytes(column) || column->bytes > length - data_offset) {
+            fprintf(stderr, "Warning: %s ends with a truncated or unknown column.\n", path);
+            break;
+        }
+        if (file->num_columns == capacity) {
+            capacity = capacity == 0 ? 16 : 2 * capacity;
+            ResultColumn* columns = (ResultColumn*)realloc(file->columns, (size_t)capacity * sizeof(ResultColumn));
+            if (columns == NULL) {
+                closeResultFile(file);
+                return NULL;
+            }
+            file->columns = columns;
+        }
+        ResultColumn* entry = &file->columns[file->num_columns++];
+        memcpy(entry->name, column->name, RESULT_NAME_LENGTH);
+        entry->name[RESULT_NAME_LENGTH - 1] = '\0';
+        entry->type = (ResultColumnType)column->type;
+        entry->bits = (int)column->bits;
+        entry->count = column->count;
+        entry->data = (const char*)map + data_offset;
+        offset = data_offset + column->bytes;
+    }
+    return file;
+}
+
+void closeResultFile(ResultFile* file) {
+    if (file == NULL) {
+        return;
+    }
+    munmap(file->map, file->length);
+    free(file->columns);
+    free(file);
+}
+
+// Function to find the first column with a name, or NULL
+const ResultColumn* findResultColumn(const ResultFile* file, const char* name) {
+    for (int c = 0; c < file->num_columns; c++) {
+        if (strcmp(file->columns[c].name, name) == 0) {
+            return &file->columns[c];
+        }
+    }
+    return NULL;
+}
+
+// Function to unpack record index of a shot column
+uint64_t shotRecord(const ResultColumn* column, uint64_t index) {
+    const uint64_t* words = (const uint64_t*)column->data;
+    const uint64_t mask = column->bits == 64 ? ~0ULL : (1ULL << column->bits) - 1;
+    uint64_t position = index * (uint64_t)column->bits;
+    uint64_t w = position >> 6;
+    int offset = (int)(position & 63);
+    uint64_t value = words[w] >> offset;
+    if (offset + column->bits > 64) {
+        value |= words[w + 1] << (64 - offset);
+    }
+    return value & mask;
+}
+
+// Function to print one line per column, with the leading values of small columns
+void writeResultSummary(const ResultFile* file, FILE* out) {
+    const uint64_t shown = 8;
+    for (int c = 0; c < file->num_columns; c++) {
+        const ResultColumn* column = &file->columns[c];
+        uint64_t n = column->count < shown ? column->count : shown;
+        switch (column->type) {
+            case RESULT_SHOTS:
+                fprintf(out, "%-24s shots       %llu x %d bits:", column->name,
+                        (unsigned long long)column->count, column->bits);
+                for (uint64_t i = 0; i < n; i++) {
+                    fprintf(out, " %llx", (unsigned long long)shotRecord(column, i));
+                }
+                break;
+            case RESULT_HISTOGRAM: {
+                const uint64_t* outcomes = (const uint64_t*)column->data;
+                const uint64_t* frequencies = outcomes + column->count;
+                fprintf(out, "%-24s histogram   %llu outcomes:", column->name, (unsigned long long)column->count);
+                for (uint64_t i = 0; i < n; i++) {
+                    fprintf(out, " %llu:%llu", (unsigned long long)outcomes[i], (unsigned long long)frequencies[i]);
+                }
+                break;
+            }
+            case RESULT_AMPLITUDES: {
+                const double complex* amplitudes = (const double complex*)column->data;
+                double norm = 0.0;
+                for (uint64_t i = 0; i < column->count; i++) {
+                    norm += creal(amplitudes[i]) * creal(amplitudes[i]) + cimag(amplitudes[i]) * cimag(amplitudes[i]);
+                }
+                fprintf(out, "%-24s amplitudes  %llu, norm %.6f:", column->name, (unsigned long long)column->count, norm);
+                for (uint64_t i = 0; i < n; i++) {
+                    fprintf(out, " %.3f%+.3fi", creal(amplitudes[i]), cimag(amplitudes[i]));
+                }
+                break;
+            }
+            case RESULT_DOUBLES: {
+                const double* values = (const double*)column->data;
+                fprintf(out, "%-24s doubles     %llu:", column->name, (unsigned long long)column->count);
+                for (uint64_t i = 0; i < n; i++) {
+                    fprintf(out, " %.4g", values[i]);
+                }
+                break;
+            }
+        }
+        fprintf(out, "%s\n", column->count > shown ? " ..." : "");
+    }
+}
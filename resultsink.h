@@ -0,0 +1,87 @@
+#ifndef RESULTSINK_H
+#define RESULTSINK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <complex.h>
+
+// Columnar binary result files. A file is the header below followed by
+// columns, each a ResultColumnHeader and its data. Every column holds whole
+// 8-byte words, so all data stays aligned when the file is mapped. Columns are
+// appended as they are produced, so a file can be written as a stream and read
+// back by mapping it. Every number is little-endian.
+//
+//   RESULT_SHOTS       count records of bits bits each, packed into 64-bit words
+//                      lowest bit first (record i starts at bit i * bits)
+//   RESULT_HISTOGRAM   count uint64 outcomes, then count uint64 frequencies
+//   RESULT_AMPLITUDES  count complex128 values (real, imaginary)
+//   RESULT_DOUBLES     count float64 values
+
+#define RESULT_MAGIC "QSIMRES1"
+#define RESULT_VERSION 1
+#define RESULT_NAME_LENGTH 48
+// Columns at least this large are handed to writev from the caller's memory
+// instead of being copied into the write buffer
+#define RESULT_DIRECT_BYTES (1 << 20)
+// Size of the write buffer that batches small columns into one write
+#define RESULT_BUFFER_BYTES (4 << 20)
+
+typedef enum {
+    RESULT_SHOTS = 1,
+    RESULT_HISTOGRAM = 2,
+    RESULT_AMPLITUDES = 3,
+    RESULT_DOUBLES = 4
+} ResultColumnType;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+} ResultFileHeader;
+
+typedef struct {
+    char name[RESULT_NAME_LENGTH];
+    uint32_t type;
+    uint32_t bits;        // Bits per record of a RESULT_SHOTS column
+    uint64_t count;       // Records, outcomes or values
+    uint64_t bytes;       // Data bytes after this header, before padding
+} ResultColumnHeader;
+
+typedef struct {
+    int fd;
+    uint8_t* buffer;
+    size_t used;
+    int failed;
+} ResultSink;
+
+// One column of a mapped result file; data points into the mapping
+typedef struct {
+    char name[RESULT_NAME_LENGTH];
+    ResultColumnType type;
+    int bits;
+    uint64_t count;
+    const void* data;
+} ResultColumn;
+
+typedef struct {
+    void* map;
+    size_t length;
+    int num_columns;
+    ResultColumn* columns;
+} ResultFile;
+
+ResultSink* openResultSink(const char* path);
+int writeShotColumn(ResultSink* sink, const char* name, const uint64_t* shots, uint64_t count, int bits);
+int writeHistogramColumn(ResultSink* sink, const char* name, const uint64_t* outcomes,
+                         const uint64_t* frequencies, uint64_t count);
+int writeAmplitudeColumn(ResultSink* sink, const char* name, const double complex* amplitudes, uint64_t count);
+int writeDoubleColumn(ResultSink* sink, const char* name, const double* values, uint64_t count);
+int closeResultSink(ResultSink* sink);
+
+ResultFile* openResultFile(const char* path);
+void closeResultFile(ResultFile* file);
+const ResultColumn* findResultColumn(const ResultFile* file, const char* name);
+uint64_t shotRecord(const ResultColumn* column, uint64_t index);
+void writeResultSummary(const ResultFile* file, FILE* out);
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Bounded lock-free queues of pointers. SpscRing has one producer and one
+// consumer and needs no read-modify-write operations. MpmcRing takes any number
+// of producers and consumers (Vyukov's sequence-per-cell design). Capacities are
+// rounded up to a power of two. Push and pop never block; callers decide how to
+// wait, so they can count stalls.
+
+#define RING_CACHE_LINE 64
+
+typedef struct {
+    void** slots;
+    size_t mask;
+    _Alignas(RING_CACHE_LINE) _Atomic size_t head;   // Next slot to pop, written by the consumer
+    size_t cached_tail;                              // Consumer's last view of tail
+    _Alignas(RING_CACHE_LINE) _Atomic size_t tail;   // Next slot to push, written by the producer
+    size_t cached_head;                              // Producer's last view of head
+} SpscRing;
+
+typedef struct {
+    _Atomic size_t sequence;
+    void* data;
+} RingCell;
+
+typedef struct {
+    RingCell* cells;
+    size_t mask;
+    _Alignas(RING_CACHE_LINE) _Atomic size_t enqueue_pos;
+    _Alignas(RING_CACHE_LINE) _Atomic size_t dequeue_pos;
+} MpmcRing;
+
+// Function to round a capacity up to a power of two, at least 2
+static inline size_t ringCapacity(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    return size;
+}
+
+// Function to initialize an empty single-producer single-consumer ring.
+// Returns 0 on success, -1 on allocation failure.
+static inline int initializeSpscRing(SpscRing* ring, size_t capacity) {
+    size_t size = ringCapacity(capacity);
+    ring->slots = (void**)calloc(size, sizeof(void*));
+    if (ring->slots == NULL) {
+        return -1;
+    }
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->cached_head = 0;
+    ring->cached_tail = 0;
+    return 0;
+}
+
+static inline void freeSpscRing(SpscRing* ring) {
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+// Function to push from the producer thread. Returns 0, or -1 if the ring is full.
+static inline int spscPush(SpscRing* ring, void* item) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - ring->cached_head > ring->mask) {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail - ring->cached_head > ring->mask) {
+            return -1;
+        }
+    }
+    ring->slots[tail & ring->mask] = item;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+// Function to pop from the consumer thread. Returns NULL if the ring is empty.
+static inline void* spscPop(SpscRing* ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head == ring->cached_tail) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head == ring->cached_tail) {
+            return NULL;
+        }
+    }
+    void* item = ring->slots[head & ring->mask];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return item;
+}
+
+// Function to get the number of queued items, as seen from any thread
+static inline size_t spscDepth(SpscRing* ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return tail - head;
+}
+
+// Function to initialize an empty multi-producer multi-consumer ring.
+// Returns 0 on success, -1 on allocation failure.
+static inline int initializeMpmcRing(MpmcRing* ring, size_t capacity) {
+    size_t size = ringCapacity(capacity);
+    ring->cells = (RingCell*)malloc(size * sizeof(RingCell));
+    if (ring->cells == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&ring->cells[i].sequence, i);
+        ring->cells[i].data = NULL;
+    }
+    ring->mask = size - 1;
+    atomic_init(&ring->enqueue_pos, 0);
+    atomic_init(&ring->dequeue_pos, 0);
+    return 0;
+}
+
+static inline void freeMpmcRing(MpmcRing* ring) {
+    free(ring->cells);
+    ring->cells = NULL;
+}
+
+// Function to push from any thread. Returns 0, or -1 if the ring is full.
+static inline int mpmcPush(MpmcRing* ring, void* item) {
+    size_t pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        RingCell* cell = &ring->cells[pos & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cell->data = item;
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Function to pop from any thread. Returns NULL if the ring is empty.
+static inline void* mpmcPop(MpmcRing* ring) {
+    size_t pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        RingCell* cell = &ring->cells[pos & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                void* item = cell->data;
+                atomic_store_explicit(&cell->sequence, pos + ring->mask + 1, memory_order_release);
+                return item;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Function to get the approximate number of queued items
+static inline size_t mpmcDepth(MpmcRing* ring) {
+    size_t enqueued = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    size_t dequeued = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+#include "instrument.h"
+
+// xoshiro256** generator. Every independent stream (a Monte Carlo instance, a
+// trajectory, a thread) is seeded from (seed, stream id) through splitmix64, so
+// results do not depend on how streams are spread over threads.
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+// Function to advance a splitmix64 state and return its next output
+static inline uint64_t splitMix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Function to seed stream number stream of a generator family
+static inline void seedRng(Rng* rng, uint64_t seed, uint64_t stream) {
+    uint64_t state = seed ^ splitMix64(&stream);
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitMix64(&state);
+    }
+}
+
+static inline uint64_t rotateLeft64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Function to draw the next 64 random bits
+static inline uint64_t nextRng(Rng* rng) {
+    INSTRUMENT_COUNT(COUNTER_RNG_DRAWS, 1);
+    uint64_t* s = rng->s;
+    uint64_t result = rotateLeft64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotateLeft64(s[3], 45);
+    return result;
+}
+
+// Function to draw a uniform double in [0, 1) with 53 random bits
+static inline double uniformRng(Rng* rng) {
+    return (double)(nextRng(rng) >> 11) * 0x1.0p-53;
+}
+
+#endif
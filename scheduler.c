@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "scheduler.h"
+#include "instrument.h"
+
+// Function to pick the tile width: the largest power-of-two block of amplitudes
+// that fits in half of the L2 cache, leaving room for tables and neighbours
+int cacheTileQubits(void) {
+    long l2 = -1;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (l2 <= 0) {
+        l2 = 1L << 20;
+    }
+    int tile_qubits = 4;
+    while (tile_qubits < 24 && (sizeof(double complex) << (tile_qubits + 1)) <= (size_t)l2 / 2) {
+        tile_qubits++;
+    }
+    return tile_qubits;
+}
+
+// Function to append an empty step to a schedule
+static ScheduleStep* appendStep(GateSchedule* schedule) {
+    if (schedule->num_steps == schedule->capacity) {
+        int capacity = schedule->capacity ? schedule->capacity * 2 : 16;
+        ScheduleStep* steps = (ScheduleStep*)realloc(schedule->steps, capacity * sizeof(ScheduleStep));
+        if (steps == NULL) {
+            return NULL;
+        }
+        schedule->steps = steps;
+        schedule->capacity = capacity;
+    }
+    ScheduleStep* step = &schedule->steps[schedule->num_steps++];
+    step->swap_low = -1;
+    step->swap_high = -1;
+    step->num_ops = 0;
+    step->capacity = 0;
+    step->ops = NULL;
+    return step;
+}
+
+// Function to append an operation to a block step
+static BlockOp* appendOp(ScheduleStep* step) {
+    if (step->num_ops == step->capacity) {
+        int capacity = step->capacity ? step->capacity * 2 : 16;
+        BlockOp* ops = (BlockOp*)realloc(step->ops, capacity * sizeof(BlockOp));
+        if (ops == NULL) {
+            return NULL;
+        }
+        step->ops = ops;
+        step->capacity = capacity;
+    }
+    BlockOp* op = &step->ops[step->num_ops++];
+    op->is_diagonal = 0;
+    initializeDiagonalLayer(&op->layer);
+    return op;
+}
+
+// Function to append a swap of two physical qubits and update the qubit layout
+static int appendSwap(GateSchedule* schedule, int low, int high, int* position, int* logical) {
+    ScheduleStep* step = appendStep(schedule);
+    if (step == NULL) {
+        return -1;
+    }
+    step->swap_low = low;
+    step->swap_high = high;
+    int a = logical[low], b = logical[high];
+    logical[low] = b;
+    logical[high] = a;
+    position[a] = high;
+    position[b] = low;
+    return 0;
+}
+
+// Function to choose which low physical qubit to evict for a hot high qubit: the
+// one whose logical qubit is next needed as a non-diagonal target furthest ahead
+static int chooseVictim(const Circuit* circuit, int from, const int* logical, int tile_qubits, uint64_t busy) {
+    int victim = -1;
+    int best = -1;
+    for (int p = tile_qubits - 1; p >= 0; p--) {
+        if (busy & (1ULL << p)) {
+            continue;
+        }
+        int q = logical[p];
+        int distance = EVICTION_LOOKAHEAD;
+        int end = from + EVICTION_LOOKAHEAD < circuit->num_gates ? from + EVICTION_LOOKAHEAD : circuit->num_gates;
+        for (int g = from; g < end; g++) {
+            const Gate* gate = &circuit->gates[g];
+            if (isDiagonalGate(gate)) {
+                continue;
+            }
+            if (gate->targets[0] == q || (isTwoQubitGate(gate->type) && gate->targets[1] == q)) {
+                distance = g - from;
+                break;
+            }
+        }
+        if (distance > best) {
+            best = distance;
+            victim = p;
+        }
+    }
+    return victim;
+}
+
+// Function to partition a circuit into cache-sized blocks.
+// A gate can run tile by tile when its non-diagonal targets are below
+// tile_qubits: controls above the tile only select tiles, and diagonal gates
+// anywhere reduce to per-tile phases. When a gate targets a high qubit, that
+// qubit is swapped with the low qubit needed furthest in the future, so hot
+// qubits stay inside the tile and only the swap costs an extra sweep. The
+// original layout is restored at the end. Returns 0 on success, -1 on failure.
+int buildGateSchedule(GateSchedule* schedule, const Circuit* circuit, int tile_qubits) {
+    const int n = circuit->num_qubits;
+    int position[64], logical[64];
+    ScheduleStep* block = NULL;
+
+    if (tile_qubits > n) {
+        tile_qubits = n;
+    }
+    schedule->num_qubits = n;
+    schedule->tile_qubits = tile_qubits;
+    schedule->num_steps = 0;
+    schedule->capacity = 0;
+    schedule->steps = NULL;
+    for (int q = 0; q < n; q++) {
+        position[q] = q;
+        logical[q] = q;
+    }
+
+    for (int g = 0; g < circuit->num_gates; g++) {
+        const Gate* gate = &circuit->gates[g];
+        int num_targets = isTwoQubitGate(gate->type) ? 2 : 1;
+
+        if (!isDiagonalGate(gate)) {
+            for (int t = 0; t < num_targets; t++) {
+                if (position[gate->targets[t]] < tile_qubits) {
+                    continue;
+                }
+                uint64_t busy = 0;
+                for (int u = 0; u < num_targets; u++) {
+                    busy |= 1ULL << position[gate->targets[u]];
+                }
+                int victim = chooseVictim(circuit, g + 1, logical, tile_qubits, busy);
+                if (victim < 0 || appendSwap(schedule, victim, position[gate->targets[t]], position, logical) != 0) {
+                    freeGateSchedule(schedule);
+                    return -1;
+                }
+                block = NULL;
+            }
+        }
+
+        Gate phys = *gate;
+        phys.parameter = gateParameter(circuit, gate);
+        phys.param_index = -1;
+        phys.controls = 0;
+        for (int t = 0; t < num_targets; t++) {
+            phys.targets[t] = position[gate->targets[t]];
+        }
+        for (uint64_t c = gate->controls; c != 0; c &= c - 1) {
+            phys.controls |= 1ULL << position[__builtin_ctzll(c)];
+        }
+
+        if (block == NULL && (block = appendStep(schedule)) == NULL) {
+            freeGateSchedule(schedule);
+            return -1;
+        }
+        BlockOp* last = block->num_ops > 0 ? &block->ops[block->num_ops - 1] : NULL;
+        if (isDiagonalGate(gate) && last != NULL && last->is_diagonal) {
+            if (addGateToDiagonalLayer(&last->layer, &phys, phys.parameter) != 0) {
+                freeGateSchedule(schedule);
+                return -1;
+            }
+            continue;
+        }
+        BlockOp* op = appendOp(block);
+        if (op == NULL) {
+            freeGateSchedule(schedule);
+            return -1;
+        }
+        op->gate = phys;
+        if (isDiagonalGate(gate)) {
+            op->is_diagonal = 1;
+            if (addGateToDiagonalLayer(&op->layer, &phys, phys.parameter) != 0) {
+                freeGateSchedule(schedule);
+                return -1;
+            }
+        }
+    }
+
+    for (int p = 0; p < n; p++) {
+        if (logical[p] != p && appendSwap(schedule, p, position[p], position, logical) != 0) {
+            freeGateSchedule(schedule);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to free memory allocated for a schedule
+void freeGateSchedule(GateSchedule* schedule) {
+    for (int s = 0; s < schedule->num_steps; s++) {
+        ScheduleStep* step = &schedule->steps[s];
+        for (int o = 0; o < step->num_ops; o++) {
+            freeDiagonalLayer(&step->ops[o].layer);
+        }
+        free(step->ops);
+    }
+    free(schedule->steps);
+    schedule->num_steps = 0;
+    schedule->capacity = 0;
+    schedule->steps = NULL;
+}
+
+// Function to apply every operation of a block to one tile while it is cache-resident.
+// tables holds the filled phase tables of the block's diagonal runs, in order.
+static void runBlockOnTile(double complex* amp, int tile_qubits, uint64_t tile_index, const ScheduleStep* step,
+                           const DiagonalTables* tables, double complex* scratch) {
+    const uint64_t low_mask = (1ULL << tile_qubits) - 1;
+    const uint64_t fixed = tile_index << tile_qubits;
+    QubitRegister view;
+    view.num_qubits = tile_qubits;
+    view.size = 1ULL << tile_qubits;
+    view.amplitudes = amp + fixed;
+
+    int d = 0;
+    for (int o = 0; o < step->num_ops; o++) {
+        const BlockOp* op = &step->ops[o];
+        if (op->is_diagonal) {
+            const DiagonalTables* table = &tables[d++];
+            for (uint64_t sub = 0; sub < view.size; sub += 1ULL << table->low_bits) {
+                applyDiagonalTile(table, amp, fixed + sub, scratch);
+            }
+            continue;
+        }
+        uint64_t high_controls = op->gate.controls & ~low_mask;
+        if ((fixed & high_controls) != high_controls) {
+            continue;
+        }
+        Gate local = op->gate;
+        local.controls &= low_mask;
+        applyGate(&view, &local, local.parameter);
+    }
+}
+
+// Function to free the phase tables of a schedule run
+static void freeScheduleTables(DiagonalTables* tables, int count, double complex* scratch) {
+    for (int d = 0; tables != NULL && d < count; d++) {
+        freeDiagonalTables(&tables[d]);
+    }
+    free(tables);
+    free(scratch);
+}
+
+// Function to run a schedule. Tiles of a block are independent and are spread
+// over threads; each thread runs the whole block on its tile before moving on.
+// The phase tables of a block's diagonal runs are filled once per step, into
+// buffers allocated before the first step, so a run either fails with the
+// register untouched or completes. Returns 0 on success, -1 on allocation failure.
+int runGateSchedule(QubitRegister* reg, const GateSchedule* schedule) {
+    const int tile_qubits = schedule->tile_qubits;
+    const int low_bits = tile_qubits < DIAGONAL_TILE_BITS ? tile_qubits : DIAGONAL_TILE_BITS;
+    const int64_t num_tiles = (int64_t)(reg->size >> tile_qubits);
+    INSTRUMENT_SCOPE("runGateSchedule");
+
+    int max_diagonal = 0, max_monomials = 0;
+    for (int s = 0; s < schedule->num_steps; s++) {
+        int count = 0;
+        for (int o = 0; o < schedule->steps[s].num_ops; o++) {
+            const BlockOp* op = &schedule->steps[s].ops[o];
+            if (op->is_diagonal) {
+                count++;
+                max_monomials = op->layer.num_monomials > max_monomials ? op->layer.num_monomials : max_monomials;
+            }
+        }
+        max_diagonal = count > max_diagonal ? count : max_diagonal;
+    }
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    DiagonalTables* tables = (DiagonalTables*)calloc(max_diagonal + 1, sizeof(DiagonalTables));
+    double complex* scratch = NULL;
+    if (max_diagonal > 0) {
+        scratch = (double complex*)malloc(((size_t)num_threads << low_bits) * sizeof(double complex));
+    }
+    int status = tables != NULL && (max_diagonal == 0 || scratch != NULL) ? 0 : -1;
+    for (int d = 0; d < max_diagonal && status == 0; d++) {
+        status = allocateDiagonalTables(&tables[d], low_bits, max_monomials);
+    }
+    if (status != 0) {
+        freeScheduleTables(tables, max_diagonal, scratch);
+        return -1;
+    }
+
+    for (int s = 0; s < schedule->num_steps; s++) {
+        const ScheduleStep* step = &schedule->steps[s];
+        if (step->swap_low >= 0) {
+            INSTRUMENT_GATE(GATE_SWAP, reg->size, sizeof(double complex));
+            applySwap(reg, step->swap_low, step->swap_high);
+            continue;
+        }
+        // A block reads and writes the state once; fused diagonal runs count as one op
+        INSTRUMENT_COUNT(COUNTER_AMPLITUDES, reg->size);
+        INSTRUMENT_COUNT(COUNTER_BYTES, 2 * sizeof(double complex) * reg->size);
+        int d = 0;
+        for (int o = 0; o < step->num_ops; o++) {
+            if (step->ops[o].is_diagonal) {
+                fillDiagonalTables(&tables[d++], &step->ops[o].layer);
+            } else {
+                INSTRUMENT_GATE(step->ops[o].gate.type, 0, 0);
+            }
+        }
+        #pragma omp parallel for schedule(static) if (num_tiles > 1)
+        for (int64_t t = 0; t < num_tiles; t++) {
+            int thread = 0;
+#ifdef _OPENMP
+            thread = omp_get_thread_num();
+#endif
+            double complex* own = scratch != NULL ? scratch + ((size_t)thread << low_bits) : NULL;
+            runBlockOnTile(reg->amplitudes, tile_qubits, (uint64_t)t, step, tables, own);
+        }
+    }
+    freeScheduleTables(tables, max_diagonal, scratch);
+    return 0;
+}
+
+// Function to run a circuit with the cache-blocked scheduler.
+// Returns 0 on success, -1 with the register untouched if the schedule or its
+// tables cannot be built.
+int applyCircuitBlocked(QubitRegister* reg, const Circuit* circuit) {
+    GateSchedule schedule;
+    if (buildGateSchedule(&schedule, circuit, cacheTileQubits()) != 0) {
+        return -1;
+    }
+    int status = runGateSchedule(reg, &schedule);
+    freeGateSchedule(&schedule);
+    return status;
+}
@@ -0,0 +1,43 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include "statevector.h"
+#include "circuit.h"
+#include "diagonal.h"
+
+// Gates the scheduler looks ahead when picking which low qubit to evict
+#define EVICTION_LOOKAHEAD 256
+
+// One operation inside a block: a gate on physical qubits, or a fused diagonal run
+typedef struct {
+    int is_diagonal;
+    Gate gate;              // Physical qubits, parameter already resolved
+    DiagonalLayer layer;    // Physical qubits, used when is_diagonal
+} BlockOp;
+
+// One step of a schedule: either a block of tile-local operations applied tile by
+// tile, or a swap of a high physical qubit with a low one (num_ops == 0)
+typedef struct {
+    int swap_low;
+    int swap_high;
+    int num_ops;
+    int capacity;
+    BlockOp* ops;
+} ScheduleStep;
+
+typedef struct {
+    int num_qubits;
+    int tile_qubits;
+    int num_steps;
+    int capacity;
+    ScheduleStep* steps;
+} GateSchedule;
+
+int cacheTileQubits(void);
+int buildGateSchedule(GateSchedule* schedule, const Circuit* circuit, int tile_qubits);
+void freeGateSchedule(GateSchedule* schedule);
+int runGateSchedule(QubitRegister* reg, const GateSchedule* schedule);
+int applyCircuitBlocked(QubitRegister* reg, const Circuit* circuit);
+
+#endif
@@ -2,9 +2,16 @@
 import hashlib
 import itertools
 import time
+import os
 import random
 import cirq
 
+# Use the native engine when its extension is built, otherwise plain Cirq
+try:
+    from nativesim import NativeSimulator as Simulator
+except ImportError:
+    Simulator = cirq.Simulator
+
 # Function to generate all possible strings of given length and characters
 def generate_strings(length, characters):
     return [''.join(p) for p in itertools.product(characters, repeat=length)]
@@ -28,6 +35,20 @@ def classical_brute_force(target_hash, num_bits, characters, num_iterations):
 
     return None, time.time() - start_time
 
+# Function to estimate the cost of the simulation before anything is built.
+# The oracle uses one qubit per candidate string and Cirq keeps 2^qubits
+# complex64 amplitudes, so the job is refused unless the state vector fits in
+# the memory that is free right now. Returns None if admitted, else the reason.
+def plan_resources(num_qubits, characters):
+    num_strings = len(characters) ** num_qubits
+    if num_strings > 64:
+        return f"{num_strings} candidate strings need as many qubits; at most 64 can be simulated"
+    state_bytes = 8 * 2 ** num_strings
+    available = os.sysconf('SC_AVPHYS_PAGES') * os.sysconf('SC_PAGE_SIZE')
+    if state_bytes > available:
+        return f"state vector needs {state_bytes / 2 ** 30:.3g} GiB, {available / 2 ** 30:.3g} GiB free"
+    return None
+
 # Function to simulate the quantum circuit
 def simulate_quantum_circuit(num_qubits, target_hash, characters, num_shots):
     start_time = time.time()
@@ -37,7 +58,7 @@ def simulate_quantum_circuit(num_qubits, target_hash, characters, num_shots):
 
     grover_circuit = grover_iterations(oracle, num_qubits)
 
-    simulator = cirq.Simulator()
+    simulator = Simulator()
     result = simulator.run(grover_circuit, repetitions=num_shots)
     counts = result.histogram(key='result')
 
@@ -93,10 +114,15 @@ if __name__ == "__main__":
         num_iterations = 2 ** 10  # Number of iterations for classical brute force
         num_shots = 1024  # Number of shots for quantum simulation
 
-        classical_result, classical_time = classical_brute_force(target_hash, num_qubits, characters, num_iterations)
-        print("Classical brute force result:", classical_result)
-        print("Time taken by classical brute force:", classical_time, "seconds")
+        # Both searches list every candidate string, so plan before either runs
+        refusal = plan_resources(num_qubits, characters)
+        if refusal is not None:
+            print("Job refused:", refusal)
+        else:
+            classical_result, classical_time = classical_brute_force(target_hash, num_qubits, characters, num_iterations)
+            print("Classical brute force result:", classical_result)
+            print("Time taken by classical brute force:", classical_time, "seconds")
 
-        quantum_result, quantum_time = simulate_quantum_circuit(num_qubits, target_hash, characters, num_shots)
-        print("Quantum brute force result:", quantum_result)
-        print("Time taken by quantum simulation:", quantum_time, "seconds")
+            quantum_result, quantum_time = simulate_quantum_circuit(num_qubits, target_hash, characters, num_shots)
+            print("Quantum brute force result:", quantum_result)
+            print("Time taken by quantum simulation:", quantum_time, "seconds")
@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include "arena.h"
+#include "measure.h"
 
 // Define the qubit structure
 typedef struct {
@@ -22,69 +24,61 @@ void freeQubit(Qubit* qubit) {
     free(qubit);
 }
 
-// Function to measure a qubit
-int measureQubit(Qubit* qubit) {
-    double prob_0 = pow(qubit->alpha, 2);
-    double prob_1 = pow(qubit->beta, 2);
-    double rand_num = (double)rand() / RAND_MAX;
-
-    if (rand_num < prob_0) {
-        return 0; // Measured |0>
-    } else {
-        return 1; // Measured |1>
+// Teleportation circuit on the dense register: qubit 0 is the sender's, qubit 1
+// Alice's half and qubit 2 Bob's half of the Bell pair. Alice's measurements go
+// into classical bits 0 and 1 and Bob's corrections read them.
+static const char* const teleportation_lines[] = {
+    "H 1", "CX 1 2",                // Bell pair between Alice and Bob
+    "CX 0 1", "H 0",                // Bell-basis rotation of sender and Alice
+    "M 0 0", "M 1 1",               // Alice measures both qubits
+    "IF 1 X 2", "IF 0 Z 2",         // Bob's corrections
+    NULL
+};
+
+// Function to build the teleportation circuit from its text lines, once.
+// Returns 0 on success, -1 if a line does not parse.
+int buildTeleportationCircuit(DynamicCircuit* circuit) {
+    initializeDynamicCircuit(circuit, 3, 2);
+    for (int i = 0; teleportation_lines[i] != NULL; i++) {
+        if (parseDynamicLine(circuit, teleportation_lines[i]) < 0) {
+            fprintf(stderr, "Error: Invalid teleportation line '%s'\n", teleportation_lines[i]);
+            freeDynamicCircuit(circuit);
+            return -1;
+        }
     }
+    return 0;
 }
 
-// Function to apply the Hadamard gate to a qubit
-void applyHadamardGate(Qubit* qubit) {
-    double new_alpha = (qubit->alpha + qubit->beta) / sqrt(2);
-    double new_beta = (qubit->alpha - qubit->beta) / sqrt(2);
-    qubit->alpha = new_alpha;
-    qubit->beta = new_beta;
-}
-
-// Function to apply the Pauli-X gate to a qubit (bit flip)
-void applyPauliXGate(Qubit* qubit) {
-    double temp = qubit->alpha;
-    qubit->alpha = qubit->beta;
-    qubit->beta = temp;
-}
-
-// Function to simulate quantum teleportation
-void quantumTeleportation(Qubit* sender_qubit, Qubit* receiver_qubit) {
-    // Create an entangled qubit pair (Alice's and Bob's qubits)
-    Qubit* alice_qubit = initializeQubit(1/sqrt(2), 0); // |+>
-    Qubit* bob_qubit = initializeQubit(0, 1/sqrt(2));   // |1>
-
-    // Apply Hadamard gate to Alice's qubit
-    applyHadamardGate(alice_qubit);
-
-    // Apply CNOT gate with Alice's qubit as control and Bob's qubit as target
-    applyPauliXGate(alice_qubit); // Equivalent to a CNOT gate when the control qubit is |1>
-    applyPauliXGate(bob_qubit);   // Equivalent to a CNOT gate when the control qubit is |1>
-
-    // Apply controlled-Z gate with Alice's qubit as control and sender's qubit as target
-    if (measureQubit(sender_qubit) == 1) {
-        applyPauliXGate(bob_qubit); // Apply Pauli-X (bit flip) if sender's qubit is |1>
+// Function to simulate quantum teleportation of the sender's qubit state onto
+// the receiver's qubit, with real measurement and feed-forward.
+// Returns 0 on success, -1 on failure.
+int quantumTeleportation(const DynamicCircuit* circuit, Qubit* sender_qubit, Qubit* receiver_qubit) {
+    QubitRegister* reg = initializeRegister(3);
+    if (reg == NULL) {
+        fprintf(stderr, "Error: Out of memory for the teleportation register\n");
+        return -1;
     }
 
-    // Apply controlled-Z gate with Alice's qubit as control and Bob's qubit as target
-    if (measureQubit(alice_qubit) == 1) {
-        applyPauliXGate(receiver_qubit); // Apply Pauli-X (bit flip) if Alice's qubit is |1>
+    // Load the sender's state on qubit 0, then run the protocol
+    double complex ry[2][2];
+    singleQubitGateMatrix(GATE_RY, 2 * atan2(sender_qubit->beta, sender_qubit->alpha), ry);
+    applySingleQubitGate(reg, 0, ry);
+    Rng rng;
+    seedRng(&rng, (uint64_t)rand(), 0);
+    uint64_t bits = 0;
+    if (runDynamicCircuit(reg, circuit, &rng, &bits) != 0) {
+        freeRegister(reg);
+        return -1;
     }
 
-    // Now, Alice's qubit is entangled with Bob's qubit. Measure Alice's qubit.
-    int measured_bit_alice = measureQubit(alice_qubit);
+    // Alice's qubits are now the basis state bits; Bob's qubit holds the state
+    sender_qubit->alpha = (bits & 1) ? 0 : 1;
+    sender_qubit->beta = (bits & 1) ? 1 : 0;
+    receiver_qubit->alpha = creal(reg->amplitudes[bits]);
+    receiver_qubit->beta = creal(reg->amplitudes[bits | 4]);
 
-    // Apply Pauli-X gate to Bob's qubit if Alice's qubit was |1>
-    if (measured_bit_alice == 1) {
-        applyPauliXGate(receiver_qubit);
-    }
-
-    // Apply Pauli-Z gate to Bob's qubit if Sender's qubit was |1>
-    if (measureQubit(sender_qubit) == 1) {
-        applyPauliXGate(receiver_qubit); // Apply Pauli-X (bit flip) if sender's qubit is |1>
-    }
+    freeRegister(reg);
+    return 0;
 }
 
 // Function to convert a binary string to a qubit state
@@ -106,7 +100,8 @@ void printQubit(Qubit* qubit) {
     printf("|1>: %.2f\n", qubit->beta);
 }
 
-// Function to decode the binary string from the qubit state
+// Function to decode the binary string from the qubit state.
+// The string is scratch in the thread's arena, valid until the arena is reset.
 char* qubitToBinaryString(Qubit* qubit) {
     int bit;
     if (qubit->alpha > 0.5) {
@@ -114,7 +109,10 @@ char* qubitToBinaryString(Qubit* qubit) {
     } else {
         bit = 1;
     }
-    char* binary_string = (char*)malloc(2 * sizeof(char));
+    char* binary_string = (char*)arenaAlloc(threadArena(), 2 * sizeof(char));
+    if (binary_string == NULL) {
+        return NULL;
+    }
     binary_string[0] = bit + '0';
     binary_string[1] = '\0';
     return binary_string;
@@ -139,7 +137,15 @@ int main() {
     printQubit(receiver_qubit);
 
     // Simulate quantum teleportation
-    quantumTeleportation(sender_qubit, receiver_qubit);
+    DynamicCircuit circuit;
+    if (buildTeleportationCircuit(&circuit) != 0 ||
+        quantumTeleportation(&circuit, sender_qubit, receiver_qubit) != 0) {
+        freeDynamicCircuit(&circuit);
+        free(sender_qubit);
+        free(receiver_qubit);
+        return 1;
+    }
+    freeDynamicCircuit(&circuit);
 
     // Print final states of sender's and receiver's qubits
     printf("\nFinal state of sender's qubit (after teleportation):\n");
@@ -154,7 +160,9 @@ int main() {
     // Free memory allocated for qubits
     free(sender_qubit);
     free(receiver_qubit);
-    free(decoded_data);
+
+    // End of the protocol round: drop the decoded string and other scratch
+    arenaReset(threadArena());
 
     return 0;
 }
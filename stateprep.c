@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "stateprep.h"
+#include "instrument.h"
+
+// Function to get the qubits needed to index count items (at least 1)
+int indexQubits(uint64_t count) {
+    int bits = 1;
+    while (bits < 64 && (1ULL << bits) < count) {
+        bits++;
+    }
+    return bits;
+}
+
+// Function to get the bits of an image position, and the column bits within it
+static int positionBits(int rows, int cols, int* col_bits) {
+    int row_bits = rows > 1 ? indexQubits((uint64_t)rows) : 0;
+    *col_bits = cols > 1 ? indexQubits((uint64_t)cols) : 0;
+    return row_bits + *col_bits > 0 ? row_bits + *col_bits : 1;
+}
+
+// Function to check that an image fits in a register that needs the given width
+static int checkImage(const QubitRegister* reg, int rows, int cols, int needed) {
+    if (rows < 1 || cols < 1) {
+        fprintf(stderr, "Error: Image must be at least 1x1.\n");
+        return -1;
+    }
+    if (needed > reg->num_qubits) {
+        fprintf(stderr, "Error: Image needs %d qubits but the register has %d.\n", needed, reg->num_qubits);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to load a real vector as the amplitudes of a register, normalized,
+// with the amplitudes past count set to zero. Returns 0, or -1 if the vector
+// does not fit or is all zeros.
+int prepareAmplitudes(QubitRegister* reg, const double* data, uint64_t count) {
+    if (count == 0 || count > reg->size) {
+        fprintf(stderr, "Error: %llu values do not fit in %d qubits.\n", (unsigned long long)count, reg->num_qubits);
+        return -1;
+    }
+    const int64_t n = (int64_t)count;
+    double norm = 0.0;
+    #pragma omp parallel for reduction(+:norm) schedule(static) if (count >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < n; i++) {
+        norm += data[i] * data[i];
+    }
+    if (norm == 0.0) {
+        fprintf(stderr, "Error: Cannot normalize an all-zero vector.\n");
+        return -1;
+    }
+
+    const double scale = 1.0 / sqrt(norm);
+    double complex* amp = reg->amplitudes;
+    const int64_t size = (int64_t)reg->size;
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        amp[i] = i < n ? data[i] * scale : 0.0;
+    }
+    INSTRUMENT_COUNT(COUNTER_AMPLITUDES, reg->size);
+    return 0;
+}
+
+// Function to load a complex vector as the amplitudes of a register, normalized
+int prepareComplexAmplitudes(QubitRegister* reg, const double complex* data, uint64_t count) {
+    if (count == 0 || count > reg->size) {
+        fprintf(stderr, "Error: %llu values do not fit in %d qubits.\n", (unsigned long long)count, reg->num_qubits);
+        return -1;
+    }
+    const int64_t n = (int64_t)count;
+    double norm = 0.0;
+    #pragma omp parallel for reduction(+:norm) schedule(static) if (count >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < n; i++) {
+        norm += creal(data[i]) * creal(data[i]) + cimag(data[i]) * cimag(data[i]);
+    }
+    if (norm == 0.0) {
+        fprintf(stderr, "Error: Cannot normalize an all-zero vector.\n");
+        return -1;
+    }
+
+    const double scale = 1.0 / sqrt(norm);
+    double complex* amp = reg->amplitudes;
+    const int64_t size = (int64_t)reg->size;
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        amp[i] = i < n ? data[i] * scale : 0.0;
+    }
+    INSTRUMENT_COUNT(COUNTER_AMPLITUDES, reg->size);
+    return 0;
+}
+
+// Function to allocate the smallest register holding count values and load them
+QubitRegister* amplitudeEncoding(const double* data, uint64_t count) {
+    if (count == 0 || count > (1ULL << 62)) {
+        fprintf(stderr, "Error: Cannot amplitude-encode %llu values.\n", (unsigned long long)count);
+        return NULL;
+    }
+    QubitRegister* reg = initializeRegister(indexQubits(count));
+    if (reg == NULL) {
+        return NULL;
+    }
+    if (prepareAmplitudes(reg, data, count) != 0) {
+        freeRegister(reg);
+        return NULL;
+    }
+    return reg;
+}
+
+// Function to get the qubits of a FRQI image: its position bits plus one color qubit
+int frqiQubits(int rows, int cols) {
+    int col_bits;
+    return positionBits(rows, cols, &col_bits) + 1;
+}
+
+// Function to load a grayscale image (0..255 per pixel) in the FRQI encoding
+//   1/sqrt(P) sum_p (cos t_p |0> + sin t_p |1>) |p>,  t_p = pi/2 * pixel_p / 255
+// with the color qubit just above the position qubits. Every amplitude of the
+// register is written once, in order.
+int prepareFrqi(QubitRegister* reg, const double* pixels, int rows, int cols) {
+    int col_bits;
+    const int pos_bits = positionBits(rows, cols, &col_bits);
+    if (checkImage(reg, rows, cols, pos_bits + 1) != 0) {
+        return -1;
+    }
+    const uint64_t pos_mask = (1ULL << pos_bits) - 1;
+    const uint64_t col_mask = (1ULL << col_bits) - 1;
+    const uint64_t used = 2ULL << pos_bits;
+    const double scale = 1.0 / sqrt((double)rows * (double)cols);
+    double complex* amp = reg->amplitudes;
+    const int64_t size = (int64_t)reg->size;
+
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        uint64_t pos = (uint64_t)i & pos_mask;
+        uint64_t y = pos >> col_bits, x = pos & col_mask;
+        if ((uint64_t)i >= used || y >= (uint64_t)rows || x >= (uint64_t)cols) {
+            amp[i] = 0.0;
+            continue;
+        }
+        double level = fmin(fmax(pixels[y * (uint64_t)cols + x] / 255.0, 0.0), 1.0);
+        double angle = 0.5 * M_PI * level;
+        amp[i] = scale * ((uint64_t)i >> pos_bits ? sin(angle) : cos(angle));
+    }
+    INSTRUMENT_COUNT(COUNTER_AMPLITUDES, reg->size);
+    return 0;
+}
+
+// Function to allocate a register for a FRQI image and load it
+QubitRegister* frqiEncoding(const double* pixels, int rows, int cols) {
+    if (rows < 1 || cols < 1) {
+        fprintf(stderr, "Error: Image must be at least 1x1.\n");
+        return NULL;
+    }
+    QubitRegister* reg = initializeRegister(frqiQubits(rows, cols));
+    if (reg == NULL) {
+        return NULL;
+    }
+    if (prepareFrqi(reg, pixels, rows, cols) != 0) {
+        freeRegister(reg);
+        return NULL;
+    }
+    return reg;
+}
+
+// Function to get the qubits of a NEQR image: its position bits plus color_bits
+int neqrQubits(int rows, int cols, int color_bits) {
+    int col_bits;
+    return positionBits(rows, cols, &col_bits) + color_bits;
+}
+
+// Function to load a grayscale image in the NEQR encoding
+//   1/sqrt(P) sum_p |c_p> |p>
+// where c_p is the pixel's top color_bits bits (1..8), held in the qubits just
+// above the position qubits. Every amplitude of the register is written once.
+int prepareNeqr(QubitRegister* reg, const uint8_t* pixels, int rows, int cols, int color_bits) {
+    if (color_bits < 1 || color_bits > 8) {
+        fprintf(stderr, "Error: NEQR color depth must be 1 to 8 bits.\n");
+        return -1;
+    }
+    int col_bits;
+    const int pos_bits = positionBits(rows, cols, &col_bits);
+    if (checkImage(reg, rows, cols, pos_bits + color_bits) != 0) {
+        return -1;
+    }
+    const uint64_t pos_mask = (1ULL << pos_bits) - 1;
+    const uint64_t col_mask = (1ULL << col_bits) - 1;
+    const uint64_t used = 1ULL << (pos_bits + color_bits);
+    const double scale = 1.0 / sqrt((double)rows * (double)cols);
+    double complex* amp = reg->amplitudes;
+    const int64_t size = (int64_t)reg->size;
+
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        uint64_t pos = (uint64_t)i & pos_mask;
+        uint64_t y = pos >> col_bits, x = pos & col_mask;
+        if ((uint64_t)i >= used || y >= (uint64_t)rows || x >= (uint64_t)cols) {
+            amp[i] = 0.0;
+            continue;
+        }
+        uint64_t color = (uint64_t)(pixels[y * (uint64_t)cols + x] >> (8 - color_bits));
+        amp[i] = ((uint64_t)i >> pos_bits) == color ? scale : 0.0;
+    }
+    INSTRUMENT_COUNT(COUNTER_AMPLITUDES, reg->size);
+    return 0;
+}
+
+// Function to allocate a register for a NEQR image and load it
+QubitRegister* neqrEncoding(const uint8_t* pixels, int rows, int cols, int color_bits) {
+    if (rows < 1 || cols < 1 || color_bits < 1 || color_bits > 8) {
+        fprintf(stderr, "Error: Invalid NEQR image size or color depth.\n");
+        return NULL;
+    }
+    QubitRegister* reg = initializeRegister(neqrQubits(rows, cols, color_bits));
+    if (reg == NULL) {
+        return NULL;
+    }
+    if (prepareNeqr(reg, pixels, rows, cols, color_bits) != 0) {
+        freeRegister(reg);
+        return NULL;
+    }
+    return reg;
+}
@@ -0,0 +1,31 @@
+#ifndef STATEPREP_H
+#define STATEPREP_H
+
+#include <stdint.h>
+#include <complex.h>
+#include "statevector.h"
+
+// State preparation straight from classical data: the amplitudes are written in
+// one parallel pass instead of being built up by a gate decomposition.
+//
+// Images are row-major with rows x cols pixels. A pixel's position is
+// (y << col_bits) | x on the low row_bits + col_bits qubits, where col_bits and
+// row_bits are the bits needed for cols and rows; positions past the image get
+// zero amplitude.
+
+// Function to get the qubits needed to index count items (at least 1)
+int indexQubits(uint64_t count);
+
+int prepareAmplitudes(QubitRegister* reg, const double* data, uint64_t count);
+int prepareComplexAmplitudes(QubitRegister* reg, const double complex* data, uint64_t count);
+QubitRegister* amplitudeEncoding(const double* data, uint64_t count);
+
+int frqiQubits(int rows, int cols);
+int prepareFrqi(QubitRegister* reg, const double* pixels, int rows, int cols);
+QubitRegister* frqiEncoding(const double* pixels, int rows, int cols);
+
+int neqrQubits(int rows, int cols, int color_bits);
+int prepareNeqr(QubitRegister* reg, const uint8_t* pixels, int rows, int cols, int color_bits);
+QubitRegister* neqrEncoding(const uint8_t* pixels, int rows, int cols, int color_bits);
+
+#endif
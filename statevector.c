@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "allocator.h"
+#include "statevector.h"
+#include "rng.h"
+#include "instrument.h"
+
+// Function to allocate a register of num_qubits qubits in the |0...0> state
+QubitRegister* initializeRegister(int num_qubits) {
+    if (num_qubits < 1 || num_qubits > 62) {
+        return NULL;
+    }
+    QubitRegister* reg = (QubitRegister*)malloc(sizeof(QubitRegister));
+    if (reg == NULL) {
+        return NULL;
+    }
+    reg->num_qubits = num_qubits;
+    reg->size = 1ULL << num_qubits;
+
+    reg->amplitudes = (double complex*)allocateAmplitudes(reg->size * sizeof(double complex));
+    if (reg->amplitudes == NULL) {
+        free(reg);
+        return NULL;
+    }
+    resetRegister(reg);
+    return reg;
+}
+
+// Function to free memory allocated for a register
+void freeRegister(QubitRegister* reg) {
+    if (reg == NULL) {
+        return;
+    }
+    freeAmplitudes(reg->amplitudes, reg->size * sizeof(double complex));
+    free(reg);
+}
+
+// Function to put a register back into the |0...0> state
+void resetRegister(QubitRegister* reg) {
+    double complex* amp = reg->amplitudes;
+    int64_t size = (int64_t)reg->size;
+
+    // Zero in parallel with the same static schedule as the gate sweeps,
+    // so each page is first touched by the thread that will later work on it
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        amp[i] = 0.0;
+    }
+    amp[0] = 1.0;
+}
+
+// Function to copy the amplitudes of one register into another of the same width
+void copyRegister(QubitRegister* dst, const QubitRegister* src) {
+    double complex* restrict out = dst->amplitudes;
+    const double complex* restrict in = src->amplitudes;
+    int64_t size = (int64_t)src->size;
+
+    #pragma omp parallel for schedule(static) if (src->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        out[i] = in[i];
+    }
+}
+
+// Function to apply a 2x2 unitary to one qubit of the register
+void applySingleQubitGate(QubitRegister* reg, int target, const double complex gate[2][2]) {
+    double complex* amp = reg->amplitudes;
+    const uint64_t stride = 1ULL << target;
+    const int64_t half = (int64_t)(reg->size >> 1);
+    const double complex m00 = gate[0][0], m01 = gate[0][1];
+    const double complex m10 = gate[1][0], m11 = gate[1][1];
+
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < half; k++) {
+        // Insert a zero at the target bit to get the |..0..> index of the pair
+        uint64_t i0 = (((uint64_t)k >> target) << (target + 1)) | ((uint64_t)k & (stride - 1));
+        uint64_t i1 = i0 | stride;
+        double complex a0 = amp[i0];
+        double complex a1 = amp[i1];
+        amp[i0] = m00 * a0 + m01 * a1;
+        amp[i1] = m10 * a0 + m11 * a1;
+    }
+}
+
+// Function to apply a 2x2 unitary to the target qubit on the subspace where
+// every control qubit is |1>. Only the 2^(n - controls - 1) active pairs are
+// enumerated, so an n-1 control MCX touches two amplitudes instead of the whole
+// register. X-like and diagonal matrices get swap-only and multiply-only loops.
+void applyControlledGate(QubitRegister* reg, uint64_t controls, int target, const double complex gate[2][2]) {
+    if (controls == 0) {
+        applySingleQubitGate(reg, target, gate);
+        return;
+    }
+    double complex* amp = reg->amplitudes;
+    const uint64_t stride = 1ULL << target;
+    const uint64_t fixed = controls | stride;
+    const int64_t count = (int64_t)(reg->size >> __builtin_popcountll(fixed));
+    const double complex m00 = gate[0][0], m01 = gate[0][1];
+    const double complex m10 = gate[1][0], m11 = gate[1][1];
+
+    if (m00 == 0 && m11 == 0 && m01 == 1 && m10 == 1) {
+        #pragma omp parallel for schedule(static) if (count >= (int64_t)PARALLEL_THRESHOLD)
+        for (int64_t k = 0; k < count; k++) {
+            uint64_t i0 = insertZeroBits((uint64_t)k, fixed) | controls;
+            double complex a0 = amp[i0];
+            amp[i0] = amp[i0 | stride];
+            amp[i0 | stride] = a0;
+        }
+    } else if (m01 == 0 && m10 == 0) {
+        const int touch_zero = (m00 != 1);
+        #pragma omp parallel for schedule(static) if (count >= (int64_t)PARALLEL_THRESHOLD)
+        for (int64_t k = 0; k < count; k++) {
+            uint64_t i0 = insertZeroBits((uint64_t)k, fixed) | controls;
+            if (touch_zero) {
+                amp[i0] *= m00;
+            }
+            amp[i0 | stride] *= m11;
+        }
+    } else {
+        #pragma omp parallel for schedule(static) if (count >= (int64_t)PARALLEL_THRESHOLD)
+        for (int64_t k = 0; k < count; k++) {
+            uint64_t i0 = insertZeroBits((uint64_t)k, fixed) | controls;
+            uint64_t i1 = i0 | stride;
+            double complex a0 = amp[i0];
+            double complex a1 = amp[i1];
+            amp[i0] = m00 * a0 + m01 * a1;
+            amp[i1] = m10 * a0 + m11 * a1;
+        }
+    }
+}
+
+// Function to apply a 4x4 unitary to qubits q0 and q1.
+// Matrix rows and columns are indexed by (bit q0 << 1) | bit q1, so q0 is the
+// most significant qubit of the gate, as in Cirq.
+void applyTwoQubitGate(QubitRegister* reg, int q0, int q1, const double complex gate[4][4]) {
+    double complex* amp = reg->amplitudes;
+    const uint64_t b0 = 1ULL << q0;
+    const uint64_t b1 = 1ULL << q1;
+    const int lo = q0 < q1 ? q0 : q1;
+    const int hi = q0 < q1 ? q1 : q0;
+    const int64_t quarter = (int64_t)(reg->size >> 2);
+
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < quarter; k++) {
+        uint64_t base = (uint64_t)k;
+        base = ((base >> lo) << (lo + 1)) | (base & ((1ULL << lo) - 1));
+        base = ((base >> hi) << (hi + 1)) | (base & ((1ULL << hi) - 1));
+        uint64_t idx[4] = { base, base | b1, base | b0, base | b0 | b1 };
+        double complex in[4];
+        for (int r = 0; r < 4; r++) {
+            in[r] = amp[idx[r]];
+        }
+        for (int r = 0; r < 4; r++) {
+            amp[idx[r]] = gate[r][0] * in[0] + gate[r][1] * in[1]
+                        + gate[r][2] * in[2] + gate[r][3] * in[3];
+        }
+    }
+}
+
+// Function to exchange qubits q0 and q1. Only the |..1..0..> / |..0..1..> pairs
+// move, so a quarter of the register is read and written.
+void applySwap(QubitRegister* reg, int q0, int q1) {
+    double complex* amp = reg->amplitudes;
+    const uint64_t b0 = 1ULL << q0;
+    const uint64_t b1 = 1ULL << q1;
+    const int64_t quarter = (int64_t)(reg->size >> 2);
+
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < quarter; k++) {
+        uint64_t base = insertZeroBits((uint64_t)k, b0 | b1);
+        double complex a = amp[base | b0];
+        amp[base | b0] = amp[base | b1];
+        amp[base | b1] = a;
+    }
+}
+
+// Function to compute the squared norm <psi|psi> of a register
+double registerNorm(const QubitRegister* reg) {
+    const double complex* amp = reg->amplitudes;
+    int64_t size = (int64_t)reg->size;
+    double sum = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:sum) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        double re = creal(amp[i]);
+        double im = cimag(amp[i]);
+        sum += re * re + im * im;
+    }
+    return sum;
+}
+
+// Function to compute the probability that measuring target gives 1
+double qubitProbability(const QubitRegister* reg, int target) {
+    const double complex* amp = reg->amplitudes;
+    const uint64_t stride = 1ULL << target;
+    const int64_t half = (int64_t)(reg->size >> 1);
+    double sum = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:sum) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < half; k++) {
+        uint64_t i1 = insertZeroBits((uint64_t)k, stride) | stride;
+        double re = creal(amp[i1]);
+        double im = cimag(amp[i1]);
+        sum += re * re + im * im;
+    }
+    return sum;
+}
+
+// Function to draw num_samples basis states from |amplitude|^2 with the given
+// seed. The cumulative distribution is built once and each draw is a binary
+// search. Returns 0 on success, -1 if the table cannot be allocated.
+int sampleRegister(const QubitRegister* reg, uint64_t num_samples, uint64_t seed, uint64_t* samples) {
+    INSTRUMENT_SCOPE("sampleRegister");
+    double* cumulative = (double*)malloc(reg->size * sizeof(double));
+    if (cumulative == NULL) {
+        return -1;
+    }
+    double total = 0.0;
+    for (uint64_t i = 0; i < reg->size; i++) {
+        double re = creal(reg->amplitudes[i]);
+        double im = cimag(reg->amplitudes[i]);
+        total += re * re + im * im;
+        cumulative[i] = total;
+    }
+
+    Rng rng;
+    seedRng(&rng, seed, 0);
+    for (uint64_t s = 0; s < num_samples; s++) {
+        double u = uniformRng(&rng) * total;
+        uint64_t lo = 0, hi = reg->size - 1;
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (cumulative[mid] > u) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        samples[s] = lo;
+    }
+    free(cumulative);
+    return 0;
+}
+
+// Function to compute the inner product <a|b> of two registers of the same width
+double complex innerProduct(const QubitRegister* a, const QubitRegister* b) {
+    const double complex* x = a->amplitudes;
+    const double complex* y = b->amplitudes;
+    int64_t size = (int64_t)a->size;
+    double re = 0.0, im = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:re, im) if (a->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        double complex p = conj(x[i]) * y[i];
+        re += creal(p);
+        im += cimag(p);
+    }
+    return re + im * I;
+}
+
+// Function to compute <bra|M|ket> for a (possibly controlled) 2x2 matrix M on the
+// target qubit. M acts as zero where a control is |0>, which is what the
+// derivative of a controlled gate looks like.
+double complex singleQubitOverlap(const QubitRegister* bra, const QubitRegister* ket, uint64_t controls,
+                                  int target, const double complex m[2][2]) {
+    const double complex* x = bra->amplitudes;
+    const double complex* y = ket->amplitudes;
+    const uint64_t stride = 1ULL << target;
+    const uint64_t fixed = controls | stride;
+    const int64_t count = (int64_t)(ket->size >> __builtin_popcountll(fixed));
+    double re = 0.0, im = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:re, im) if (count >= (int64_t)PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < count; k++) {
+        uint64_t i0 = insertZeroBits((uint64_t)k, fixed) | controls;
+        uint64_t i1 = i0 | stride;
+        double complex p = conj(x[i0]) * (m[0][0] * y[i0] + m[0][1] * y[i1])
+                         + conj(x[i1]) * (m[1][0] * y[i0] + m[1][1] * y[i1]);
+        re += creal(p);
+        im += cimag(p);
+    }
+    return re + im * I;
+}
+
+// Function to compute <bra|M|ket> for a 4x4 matrix M on qubits q0 and q1
+double complex twoQubitOverlap(const QubitRegister* bra, const QubitRegister* ket, int q0, int q1,
+                               const double complex m[4][4]) {
+    const double complex* x = bra->amplitudes;
+    const double complex* y = ket->amplitudes;
+    const uint64_t b0 = 1ULL << q0;
+    const uint64_t b1 = 1ULL << q1;
+    const int lo = q0 < q1 ? q0 : q1;
+    const int hi = q0 < q1 ? q1 : q0;
+    const int64_t quarter = (int64_t)(ket->size >> 2);
+    double re = 0.0, im = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:re, im) if (ket->size >= PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < quarter; k++) {
+        uint64_t base = (uint64_t)k;
+        base = ((base >> lo) << (lo + 1)) | (base & ((1ULL << lo) - 1));
+        base = ((base >> hi) << (hi + 1)) | (base & ((1ULL << hi) - 1));
+        uint64_t idx[4] = { base, base | b1, base | b0, base | b0 | b1 };
+        double complex p = 0.0;
+        for (int r = 0; r < 4; r++) {
+            double complex row = m[r][0] * y[idx[0]] + m[r][1] * y[idx[1]]
+                               + m[r][2] * y[idx[2]] + m[r][3] * y[idx[3]];
+            p += conj(x[idx[r]]) * row;
+        }
+        re += creal(p);
+        im += cimag(p);
+    }
+    return re + im * I;
+}
@@ -0,0 +1,55 @@
+#ifndef STATEVECTOR_H
+#define STATEVECTOR_H
+
+#include <stdint.h>
+#include <complex.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+// Dense state vector over num_qubits qubits.
+// Qubit k is bit k of the basis index, so amplitudes[i] is the coefficient of |i>.
+typedef struct {
+    int num_qubits;
+    uint64_t size;               // 2^num_qubits
+    double complex* amplitudes;
+} QubitRegister;
+
+// Registers below this many amplitudes are swept on a single thread
+#define PARALLEL_THRESHOLD (1ULL << 14)
+
+// Spread the bits of k over the positions not in mask, leaving zeros at mask.
+// Enumerating k = 0 .. 2^(n - |mask|) - 1 visits every index with those bits clear.
+static inline uint64_t insertZeroBits(uint64_t k, uint64_t mask) {
+#ifdef __BMI2__
+    return _pdep_u64(k, ~mask);
+#else
+    while (mask != 0) {
+        uint64_t low = mask & (0 - mask);
+        k = ((k & ~(low - 1)) << 1) | (k & (low - 1));
+        mask &= mask - 1;
+    }
+    return k;
+#endif
+}
+
+QubitRegister* initializeRegister(int num_qubits);
+void freeRegister(QubitRegister* reg);
+void resetRegister(QubitRegister* reg);
+void copyRegister(QubitRegister* dst, const QubitRegister* src);
+
+void applySingleQubitGate(QubitRegister* reg, int target, const double complex gate[2][2]);
+void applyControlledGate(QubitRegister* reg, uint64_t controls, int target, const double complex gate[2][2]);
+void applyTwoQubitGate(QubitRegister* reg, int q0, int q1, const double complex gate[4][4]);
+void applySwap(QubitRegister* reg, int q0, int q1);
+
+double registerNorm(const QubitRegister* reg);
+double qubitProbability(const QubitRegister* reg, int target);
+int sampleRegister(const QubitRegister* reg, uint64_t num_samples, uint64_t seed, uint64_t* samples);
+double complex innerProduct(const QubitRegister* a, const QubitRegister* b);
+double complex singleQubitOverlap(const QubitRegister* bra, const QubitRegister* ket, uint64_t controls,
+                                  int target, const double complex m[2][2]);
+double complex twoQubitOverlap(const QubitRegister* bra, const QubitRegister* ket, int q0, int q1,
+                               const double complex m[4][4]);
+
+#endif
@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+#include "allocator.h"
+#include "statevector32.h"
+#include "rng.h"
+#include "instrument.h"
+
+// Function to allocate a single-precision register of num_qubits qubits in |0...0>
+QubitRegister32* initializeRegister32(int num_qubits) {
+    if (num_qubits < 1 || num_qubits > 62) {
+        return NULL;
+    }
+    QubitRegister32* reg = (QubitRegister32*)malloc(sizeof(QubitRegister32));
+    if (reg == NULL) {
+        return NULL;
+    }
+    reg->num_qubits = num_qubits;
+    reg->size = 1ULL << num_qubits;
+
+    reg->amplitudes = (float complex*)allocateAmplitudes(reg->size * sizeof(float complex));
+    if (reg->amplitudes == NULL) {
+        free(reg);
+        return NULL;
+    }
+    resetRegister32(reg);
+    return reg;
+}
+
+// Function to free memory allocated for a single-precision register
+void freeRegister32(QubitRegister32* reg) {
+    if (reg == NULL) {
+        return;
+    }
+    freeAmplitudes(reg->amplitudes, reg->size * sizeof(float complex));
+    free(reg);
+}
+
+// Function to put a single-precision register back into the |0...0> state
+void resetRegister32(QubitRegister32* reg) {
+    float complex* amp = reg->amplitudes;
+    int64_t size = (int64_t)reg->size;
+
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        amp[i] = 0.0f;
+    }
+    amp[0] = 1.0f;
+}
+
+#ifdef __AVX__
+// Function to multiply four packed complex floats by the complex scalar re + i im
+static inline __m256 complexScale(__m256 a, __m256 re, __m256 im) {
+    __m256 swapped = _mm256_permute_ps(a, 0xB1);
+    return _mm256_addsub_ps(_mm256_mul_ps(a, re), _mm256_mul_ps(swapped, im));
+}
+#endif
+
+// Function to apply a 2x2 unitary to one qubit of a single-precision register.
+// With AVX, targets >= 2 have runs of at least four contiguous pairs, which are
+// processed four complex amplitudes (one 256-bit vector) at a time.
+void applySingleQubitGate32(QubitRegister32* reg, int target, const double complex gate[2][2]) {
+    float complex* amp = reg->amplitudes;
+    const uint64_t stride = 1ULL << target;
+    const int64_t half = (int64_t)(reg->size >> 1);
+    const float complex m00 = (float complex)gate[0][0], m01 = (float complex)gate[0][1];
+    const float complex m10 = (float complex)gate[1][0], m11 = (float complex)gate[1][1];
+
+#ifdef __AVX__
+    if (target >= 2) {
+        const __m256 r00 = _mm256_set1_ps(crealf(m00)), i00 = _mm256_set1_ps(cimagf(m00));
+        const __m256 r01 = _mm256_set1_ps(crealf(m01)), i01 = _mm256_set1_ps(cimagf(m01));
+        const __m256 r10 = _mm256_set1_ps(crealf(m10)), i10 = _mm256_set1_ps(cimagf(m10));
+        const __m256 r11 = _mm256_set1_ps(crealf(m11)), i11 = _mm256_set1_ps(cimagf(m11));
+        const int64_t blocks = half >> 2;
+
+        #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+        for (int64_t b = 0; b < blocks; b++) {
+            uint64_t k = (uint64_t)b << 2;
+            uint64_t i0 = ((k >> target) << (target + 1)) | (k & (stride - 1));
+            float* p0 = (float*)(amp + i0);
+            float* p1 = (float*)(amp + i0 + stride);
+            __m256 a0 = _mm256_load_ps(p0);
+            __m256 a1 = _mm256_load_ps(p1);
+            _mm256_store_ps(p0, _mm256_add_ps(complexScale(a0, r00, i00), complexScale(a1, r01, i01)));
+            _mm256_store_ps(p1, _mm256_add_ps(complexScale(a0, r10, i10), complexScale(a1, r11, i11)));
+        }
+        return;
+    }
+#endif
+
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < half; k++) {
+        uint64_t i0 = (((uint64_t)k >> target) << (target + 1)) | ((uint64_t)k & (stride - 1));
+        uint64_t i1 = i0 | stride;
+        float complex a0 = amp[i0];
+        float complex a1 = amp[i1];
+        amp[i0] = m00 * a0 + m01 * a1;
+        amp[i1] = m10 * a0 + m11 * a1;
+    }
+}
+
+// Function to apply a 2x2 unitary to the target qubit on the subspace where
+// every control is |1>, enumerating only the active pairs
+void applyControlledGate32(QubitRegister32* reg, uint64_t controls, int target, const double complex gate[2][2]) {
+    if (controls == 0) {
+        applySingleQubitGate32(reg, target, gate);
+        return;
+    }
+    float complex* amp = reg->amplitudes;
+    const uint64_t stride = 1ULL << target;
+    const uint64_t fixed = controls | stride;
+    const int64_t count = (int64_t)(reg->size >> __builtin_popcountll(fixed));
+    const float complex m00 = (float complex)gate[0][0], m01 = (float complex)gate[0][1];
+    const float complex m10 = (float complex)gate[1][0], m11 = (float complex)gate[1][1];
+
+    if (m01 == 0 && m10 == 0) {
+        #pragma omp parallel for schedule(static) if (count >= (int64_t)PARALLEL_THRESHOLD)
+        for (int64_t k = 0; k < count; k++) {
+            uint64_t i0 = insertZeroBits((uint64_t)k, fixed) | controls;
+            amp[i0] *= m00;
+            amp[i0 | stride] *= m11;
+        }
+    } else {
+        #pragma omp parallel for schedule(static) if (count >= (int64_t)PARALLEL_THRESHOLD)
+        for (int64_t k = 0; k < count; k++) {
+            uint64_t i0 = insertZeroBits((uint64_t)k, fixed) | controls;
+            uint64_t i1 = i0 | stride;
+            float complex a0 = amp[i0];
+            float complex a1 = amp[i1];
+            amp[i0] = m00 * a0 + m01 * a1;
+            amp[i1] = m10 * a0 + m11 * a1;
+        }
+    }
+}
+
+// Function to apply a 4x4 unitary to qubits q0 and q1 (q0 is the gate's MSB)
+void applyTwoQubitGate32(QubitRegister32* reg, int q0, int q1, const double complex gate[4][4]) {
+    float complex* amp = reg->amplitudes;
+    const uint64_t b0 = 1ULL << q0;
+    const uint64_t b1 = 1ULL << q1;
+    const int64_t quarter = (int64_t)(reg->size >> 2);
+    float complex m[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            m[r][c] = (float complex)gate[r][c];
+        }
+    }
+
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < quarter; k++) {
+        uint64_t base = insertZeroBits((uint64_t)k, b0 | b1);
+        uint64_t idx[4] = { base, base | b1, base | b0, base | b0 | b1 };
+        float complex in[4];
+        for (int r = 0; r < 4; r++) {
+            in[r] = amp[idx[r]];
+        }
+        for (int r = 0; r < 4; r++) {
+            amp[idx[r]] = m[r][0] * in[0] + m[r][1] * in[1] + m[r][2] * in[2] + m[r][3] * in[3];
+        }
+    }
+}
+
+// Function to exchange qubits q0 and q1 of a single-precision register
+void applySwap32(QubitRegister32* reg, int q0, int q1) {
+    float complex* amp = reg->amplitudes;
+    const uint64_t b0 = 1ULL << q0;
+    const uint64_t b1 = 1ULL << q1;
+    const int64_t quarter = (int64_t)(reg->size >> 2);
+
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t k = 0; k < quarter; k++) {
+        uint64_t base = insertZeroBits((uint64_t)k, b0 | b1);
+        float complex a = amp[base | b0];
+        amp[base | b0] = amp[base | b1];
+        amp[base | b1] = a;
+    }
+}
+
+// Function to apply one circuit gate to a single-precision register.
+// Gate matrices are built in double precision and rounded once per gate.
+void applyGate32(QubitRegister32* reg, const Gate* gate, double parameter) {
+    INSTRUMENT_GATE(gate->type, reg->size >> __builtin_popcountll(gate->controls), sizeof(float complex));
+    if (gate->type == GATE_SWAP) {
+        applySwap32(reg, gate->targets[0], gate->targets[1]);
+    } else if (isTwoQubitGate(gate->type)) {
+        double complex m[4][4];
+        twoQubitGateMatrix(gate->type, parameter, m);
+        applyTwoQubitGate32(reg, gate->targets[0], gate->targets[1], m);
+    } else {
+        double complex m[2][2];
+        singleQubitGateMatrix(gate->type, parameter, m);
+        applyControlledGate32(reg, gate->controls, gate->targets[0], m);
+    }
+}
+
+// Function to run a circuit on a single-precision register.
+// With renormalize_period > 0 the state is rescaled to unit norm every that
+// many gates and once at the end; 0 leaves the norm alone.
+void applyCircuit32(QubitRegister32* reg, const Circuit* circuit, int renormalize_period) {
+    INSTRUMENT_SCOPE("applyCircuit32");
+    for (int g = 0; g < circuit->num_gates; g++) {
+        const Gate* gate = &circuit->gates[g];
+        applyGate32(reg, gate, gateParameter(circuit, gate));
+        if (renormalize_period > 0 && (g + 1) % renormalize_period == 0) {
+            renormalizeRegister32(reg);
+        }
+    }
+    if (renormalize_period > 0 && circuit->num_gates % renormalize_period != 0) {
+        renormalizeRegister32(reg);
+    }
+}
+
+// Function to draw num_samples basis states from |amplitude|^2 with the given
+// seed, accumulating in double precision. Draws match sampleRegister on the
+// same state up to rounding. Returns 0 on success, -1 if the table cannot be
+// allocated.
+int sampleRegister32(const QubitRegister32* reg, uint64_t num_samples, uint64_t seed, uint64_t* samples) {
+    double* cumulative = (double*)malloc(reg->size * sizeof(double));
+    if (cumulative == NULL) {
+        return -1;
+    }
+    double total = 0.0;
+    for (uint64_t i = 0; i < reg->size; i++) {
+        double re = crealf(reg->amplitudes[i]);
+        double im = cimagf(reg->amplitudes[i]);
+        total += re * re + im * im;
+        cumulative[i] = total;
+    }
+
+    Rng rng;
+    seedRng(&rng, seed, 0);
+    for (uint64_t s = 0; s < num_samples; s++) {
+        double u = uniformRng(&rng) * total;
+        uint64_t lo = 0, hi = reg->size - 1;
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (cumulative[mid] > u) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        samples[s] = lo;
+    }
+    free(cumulative);
+    return 0;
+}
+
+// Function to compute the squared norm of a single-precision register,
+// accumulated in double precision
+double registerNorm32(const QubitRegister32* reg) {
+    const float complex* amp = reg->amplitudes;
+    int64_t size = (int64_t)reg->size;
+    double sum = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:sum) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        double re = crealf(amp[i]);
+        double im = cimagf(amp[i]);
+        sum += re * re + im * im;
+    }
+    return sum;
+}
+
+// Function to rescale a single-precision register to unit norm
+void renormalizeRegister32(QubitRegister32* reg) {
+    double norm = registerNorm32(reg);
+    if (norm <= 0.0) {
+        return;
+    }
+    float scale = (float)(1.0 / sqrt(norm));
+    float complex* amp = reg->amplitudes;
+    int64_t size = (int64_t)reg->size;
+
+    #pragma omp parallel for schedule(static) if (reg->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        amp[i] *= scale;
+    }
+}
+
+// Function to round a double-precision register into a single-precision one of the same width
+void convertRegisterTo32(QubitRegister32* dst, const QubitRegister* src) {
+    float complex* out = dst->amplitudes;
+    const double complex* in = src->amplitudes;
+    int64_t size = (int64_t)src->size;
+
+    #pragma omp parallel for schedule(static) if (src->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        out[i] = (float complex)in[i];
+    }
+}
+
+// Function to widen a single-precision register into a double-precision one of the same width
+void convertRegisterFrom32(QubitRegister* dst, const QubitRegister32* src) {
+    double complex* out = dst->amplitudes;
+    const float complex* in = src->amplitudes;
+    int64_t size = (int64_t)src->size;
+
+    #pragma omp parallel for schedule(static) if (src->size >= PARALLEL_THRESHOLD)
+    for (int64_t i = 0; i < size; i++) {
+        out[i] = (double complex)in[i];
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef STATEVECTOR32_H
+#define STATEVECTOR32_H
+
+#include <stdint.h>
+#include <complex.h>
+#include "statevector.h"
+#include "circuit.h"
+
+// Single-precision state vector: same layout as QubitRegister with float complex
+// amplitudes, so it takes half the memory and twice as many amplitudes per vector.
+// Rounding error grows with circuit depth, mostly as drift of the norm, which
+// applyCircuit32 can correct by renormalizing every few gates.
+typedef struct {
+    int num_qubits;
+    uint64_t size;              // 2^num_qubits
+    float complex* amplitudes;
+} QubitRegister32;
+
+QubitRegister32* initializeRegister32(int num_qubits);
+void freeRegister32(QubitRegister32* reg);
+void resetRegister32(QubitRegister32* reg);
+
+void applySingleQubitGate32(QubitRegister32* reg, int target, const double complex gate[2][2]);
+void applyControlledGate32(QubitRegister32* reg, uint64_t controls, int target, const double complex gate[2][2]);
+void applyTwoQubitGate32(QubitRegister32* reg, int q0, int q1, const double complex gate[4][4]);
+void applySwap32(QubitRegister32* reg, int q0, int q1);
+
+void applyGate32(QubitRegister32* reg, const Gate* gate, double parameter);
+void applyCircuit32(QubitRegister32* reg, const Circuit* circuit, int renormalize_period);
+
+double registerNorm32(const QubitRegister32* reg);
+void renormalizeRegister32(QubitRegister32* reg);
+int sampleRegister32(const QubitRegister32* reg, uint64_t num_samples, uint64_t seed, uint64_t* samples);
+
+void convertRegisterTo32(QubitRegister32* dst, const QubitRegister* src);
+void convertRegisterFrom32(QubitRegister* dst, const QubitRegister32* src);
+
+#endif
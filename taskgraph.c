@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <omp.h>
+#include "taskgraph.h"
+#include "rng.h"
+
+// Failed steal rounds a worker spins through before yielding its core
+#define TASK_SPINS_BEFORE_YIELD 64
+
+// Chase-Lev deque of task indices. The owner pushes and takes at the bottom,
+// thieves take from the top; only the last item needs a compare-and-swap. The
+// capacity is fixed at the number of tasks, since no task is pushed twice.
+typedef struct {
+    _Alignas(64) _Atomic int64_t top;
+    _Alignas(64) _Atomic int64_t bottom;
+    _Atomic int* slots;
+    int64_t mask;
+} TaskDeque;
+
+// Function to find the distinct tasks a task depends on: the last task before it
+// to use each of its resources. Updates last to make the task the newest user.
+static int taskPredecessors(uint64_t resources, int task, int last[64], int predecessors[64]) {
+    int count = 0;
+    for (uint64_t rest = resources; rest != 0; rest &= rest - 1) {
+        int r = __builtin_ctzll(rest);
+        int p = last[r];
+        last[r] = task;
+        if (p < 0) {
+            continue;
+        }
+        int seen = 0;
+        for (int i = 0; i < count && !seen; i++) {
+            seen = predecessors[i] == p;
+        }
+        if (!seen) {
+            predecessors[count++] = p;
+        }
+    }
+    return count;
+}
+
+// Function to build the dependency graph of tasks that each use a set of
+// resources, given as a bitmask per task. Edges are stored compactly by source
+// task. Returns 0 on success, -1 on allocation failure.
+int buildTaskGraph(TaskGraph* graph, const uint64_t* resources, int num_tasks) {
+    memset(graph, 0, sizeof(*graph));
+    if (num_tasks < 0) {
+        fprintf(stderr, "Error: Invalid task count %d.\n", num_tasks);
+        return -1;
+    }
+    graph->num_tasks = num_tasks;
+    graph->first_successor = (int*)calloc((size_t)num_tasks + 1, sizeof(int));
+    graph->num_predecessors = (int*)calloc((size_t)num_tasks + 1, sizeof(int));
+    int* level = (int*)calloc((size_t)num_tasks + 1, sizeof(int));
+    if (graph->first_successor == NULL || graph->num_predecessors == NULL || level == NULL) {
+        fprintf(stderr, "Error: Out of memory for a task graph of %d tasks.\n", num_tasks);
+        free(level);
+        freeTaskGraph(graph);
+        return -1;
+    }
+
+    // First sweep: count the edges out of every task and find the longest chain
+    int last[64], predecessors[64];
+    for (int r = 0; r < 64; r++) {
+        last[r] = -1;
+    }
+    for (int t = 0; t < num_tasks; t++) {
+        int count = taskPredecessors(resources[t], t, last, predecessors);
+        graph->num_predecessors[t] = count;
+        level[t] = 1;
+        for (int i = 0; i < count; i++) {
+            graph->first_successor[predecessors[i] + 1]++;
+            if (level[predecessors[i]] + 1 > level[t]) {
+                level[t] = level[predecessors[i]] + 1;
+            }
+        }
+        if (level[t] > graph->depth) {
+            graph->depth = level[t];
+        }
+    }
+    free(level);
+    for (int t = 0; t < num_tasks; t++) {
+        graph->first_successor[t + 1] += graph->first_successor[t];
+    }
+    graph->num_edges = graph->first_successor[num_tasks];
+
+    // Second sweep: fill in the edges, each source's in task order
+    graph->successors = (int*)malloc(((size_t)graph->num_edges + 1) * sizeof(int));
+    int* cursor = (int*)malloc(((size_t)num_tasks + 1) * sizeof(int));
+    if (graph->successors == NULL || cursor == NULL) {
+        fprintf(stderr, "Error: Out of memory for %d task graph edges.\n", graph->num_edges);
+        free(cursor);
+        freeTaskGraph(graph);
+        return -1;
+    }
+    memcpy(cursor, graph->first_successor, (size_t)num_tasks * sizeof(int));
+    for (int r = 0; r < 64; r++) {
+        last[r] = -1;
+    }
+    for (int t = 0; t < num_tasks; t++) {
+        int count = taskPredecessors(resources[t], t, last, predecessors);
+        for (int i = 0; i < count; i++) {
+            graph->successors[cursor[predecessors[i]]++] = t;
+        }
+    }
+    free(cursor);
+    return 0;
+}
+
+void freeTaskGraph(TaskGraph* graph) {
+    free(graph->first_successor);
+    free(graph->successors);
+    free(graph->num_predecessors);
+    graph->first_successor = NULL;
+    graph->successors = NULL;
+    graph->num_predecessors = NULL;
+    graph->num_tasks = 0;
+    graph->num_edges = 0;
+}
+
+// Function to push a task on the bottom of a deque, from its owner only
+static void dequePush(TaskDeque* deque, int task) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    atomic_store_explicit(&deque->slots[bottom & deque->mask], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+}
+
+// Function to take the newest task from the bottom of a deque, from its owner
+// only. Returns -1 if the deque is empty or a thief won the last task.
+static int dequeTake(TaskDeque* deque) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return -1;
+    }
+    int task = atomic_load_explicit(&deque->slots[bottom & deque->mask], memory_order_relaxed);
+    if (top == bottom) {
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed)) {
+            task = -1;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// Function to steal the oldest task from the top of a deque, from any thread.
+// Returns -1 if the deque is empty or another thread got there first.
+static int dequeSteal(TaskDeque* deque) {
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) {
+        return -1;
+    }
+    int task = atomic_load_explicit(&deque->slots[top & deque->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return -1;
+    }
+    return task;
+}
+
+// Function to run every task of a graph once, each after the tasks it depends
+// on, on num_workers workers (0 for the OpenMP default). The run function must
+// be safe to call concurrently for tasks with disjoint resources. Statistics
+// are filled in if stats is not NULL. Returns 0, or -1 on allocation failure.
+int runTaskGraph(const TaskGraph* graph, TaskFunction run, void* context, int num_workers, TaskStats* stats) {
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+    }
+    const int num_tasks = graph->num_tasks;
+    if (num_tasks == 0) {
+        return 0;
+    }
+    if (num_workers <= 0) {
+        num_workers = omp_get_max_threads();
+    }
+    if (num_workers > num_tasks) {
+        num_workers = num_tasks;
+    }
+
+    int64_t capacity = 2;
+    while (capacity < num_tasks) {
+        capacity <<= 1;
+    }
+    TaskDeque* deques = (TaskDeque*)aligned_alloc(64, (size_t)num_workers * sizeof(TaskDeque));
+    _Atomic int* pending = (_Atomic int*)malloc((size_t)num_tasks * sizeof(_Atomic int));
+    _Atomic int* slots = (_Atomic int*)malloc((size_t)num_workers * capacity * sizeof(_Atomic int));
+    if (deques == NULL || pending == NULL || slots == NULL) {
+        fprintf(stderr, "Error: Out of memory for %d task workers.\n", num_workers);
+        free(deques);
+        free((void*)pending);
+        free((void*)slots);
+        return -1;
+    }
+    for (int w = 0; w < num_workers; w++) {
+        atomic_init(&deques[w].top, 0);
+        atomic_init(&deques[w].bottom, 0);
+        deques[w].slots = slots + w * capacity;
+        deques[w].mask = capacity - 1;
+    }
+
+    // Deal the tasks that are ready from the start round-robin over the deques
+    int ready = 0;
+    for (int t = 0; t < num_tasks; t++) {
+        atomic_init(&pending[t], graph->num_predecessors[t]);
+        if (graph->num_predecessors[t] == 0) {
+            dequePush(&deques[ready++ % num_workers], t);
+        }
+    }
+
+    _Atomic int remaining;
+    atomic_init(&remaining, num_tasks);
+    uint64_t tasks = 0, steals = 0, idle_spins = 0;
+
+    // A smaller team than asked for still drains every deque, since idle
+    // workers steal from all of them
+    #pragma omp parallel num_threads(num_workers) reduction(+:tasks, steals, idle_spins)
+    {
+        const int worker = omp_get_thread_num();
+        TaskDeque* own = &deques[worker];
+        uint64_t seed = 0x9E3779B97F4A7C15ULL * (uint64_t)(worker + 1);
+        int spins = 0;
+
+        while (atomic_load_explicit(&remaining, memory_order_acquire) > 0) {
+            int task = dequeTake(own);
+            if (task < 0) {
+                int start = (int)(splitMix64(&seed) % (uint64_t)num_workers);
+                for (int i = 0; i < num_workers && task < 0; i++) {
+                    int victim = (start + i) % num_workers;
+                    if (victim != worker) {
+                        task = dequeSteal(&deques[victim]);
+                    }
+                }
+                if (task < 0) {
+                    idle_spins++;
+                    if (++spins >= TASK_SPINS_BEFORE_YIELD) {
+                        spins = 0;
+                        sched_yield();
+                    }
+                    continue;
+                }
+                steals++;
+            }
+            spins = 0;
+
+            run(context, task, worker);
+            tasks++;
+            for (int e = graph->first_successor[task]; e < graph->first_successor[task + 1]; e++) {
+                int next = graph->successors[e];
+                if (atomic_fetch_sub_explicit(&pending[next], 1, memory_order_acq_rel) == 1) {
+                    dequePush(own, next);
+                }
+            }
+            atomic_fetch_sub_explicit(&remaining, 1, memory_order_release);
+        }
+    }
+
+    if (stats != NULL) {
+        stats->tasks = tasks;
+        stats->steals = steals;
+        stats->idle_spins = idle_spins;
+    }
+    free(deques);
+    free((void*)pending);
+    free((void*)slots);
+    return 0;
+}
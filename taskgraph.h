@@ -0,0 +1,40 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <stdint.h>
+
+// Dependency graphs over up to 64 resources (qubits, or groups of them) and a
+// work-stealing executor for them. Task t depends on the last earlier task that
+// used any of its resources, so tasks on disjoint resources are independent and
+// may run at the same time, while tasks sharing a resource keep program order.
+//
+// The executor runs the graph on an OpenMP team. Each worker owns a Chase-Lev
+// deque: tasks made ready by a worker go on the bottom of its own deque and are
+// taken back last-in first-out, so a chain of gates on one group tends to stay
+// on one core; idle workers steal the oldest task from the top of another
+// worker's deque. Parallel loops inside a task run on the calling worker alone
+// unless nested parallelism has been enabled.
+
+typedef struct {
+    int num_tasks;
+    int num_edges;
+    int* first_successor;   // Successors of task t are successors[first_successor[t] .. first_successor[t + 1]]
+    int* successors;
+    int* num_predecessors;
+    int depth;              // Tasks on the longest dependency chain
+} TaskGraph;
+
+// Run one task; worker is the index of the calling worker, from 0
+typedef void (*TaskFunction)(void* context, int task, int worker);
+
+typedef struct {
+    uint64_t tasks;         // Tasks run
+    uint64_t steals;        // Tasks taken from another worker's deque
+    uint64_t idle_spins;    // Rounds in which a worker found no task anywhere
+} TaskStats;
+
+int buildTaskGraph(TaskGraph* graph, const uint64_t* resources, int num_tasks);
+void freeTaskGraph(TaskGraph* graph);
+int runTaskGraph(const TaskGraph* graph, TaskFunction run, void* context, int num_workers, TaskStats* stats);
+
+#endif
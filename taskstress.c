@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "taskgraph.h"
+#include "rng.h"
+
+// Stress check for the task-graph executor.
+//
+// Usage: taskstress [workers] [tasks] [rounds] [seed]
+//
+// Each round builds three graphs - a single chain as deep as the task count,
+// random tasks over 1-3 of 64 resources, and layers of wide independent tasks
+// joined by a task that touches every resource - and runs them on many more
+// workers than cores, with a random amount of busy work per task so steals
+// interleave with completions. Every task stamps a global counter when it
+// starts and ends; afterwards each task must have run exactly once, and for
+// every resource each user must have ended before the next one started.
+// Exits 0 when every round passes.
+
+typedef struct {
+    const uint32_t* work;
+    _Atomic int* runs;
+    uint64_t* start;
+    uint64_t* end;
+    _Atomic uint64_t clock;
+} StressContext;
+
+// Function to run one task: stamp its start, spin for its work, stamp its end
+static void stressTask(void* context, int task, int worker) {
+    (void)worker;
+    StressContext* ctx = (StressContext*)context;
+    atomic_fetch_add_explicit(&ctx->runs[task], 1, memory_order_relaxed);
+    ctx->start[task] = atomic_fetch_add_explicit(&ctx->clock, 1, memory_order_acq_rel);
+    volatile uint32_t sink = 0;
+    for (uint32_t i = 0; i < ctx->work[task]; i++) {
+        sink += i;
+    }
+    ctx->end[task] = atomic_fetch_add_explicit(&ctx->clock, 1, memory_order_acq_rel);
+}
+
+// Function to fill the resource masks of one of the three graph shapes
+static void buildResources(uint64_t* resources, int num_tasks, int shape, Rng* rng) {
+    for (int t = 0; t < num_tasks; t++) {
+        if (shape == 0) {
+            resources[t] = 1;
+        } else if (shape == 1) {
+            int count = 1 + (int)(nextRng(rng) % 3);
+            resources[t] = 0;
+            for (int k = 0; k < count; k++) {
+                resources[t] |= 1ULL << (nextRng(rng) % 64);
+            }
+        } else {
+            resources[t] = t % 65 == 64 ? ~0ULL : 1ULL << (t % 65);
+        }
+    }
+}
+
+// Function to run one graph and check it; expected_depth of 0 skips the depth
+// check. Returns the number of violations.
+static int checkGraph(const uint64_t* resources, int num_tasks, int expected_depth, int num_workers,
+                      Rng* rng, const char* name) {
+    TaskGraph graph;
+    if (buildTaskGraph(&graph, resources, num_tasks) != 0) {
+        fprintf(stderr, "Error: Could not build the %s graph\n", name);
+        return 1;
+    }
+    uint32_t* work = (uint32_t*)malloc(num_tasks * sizeof(uint32_t));
+    _Atomic int* runs = (_Atomic int*)calloc(num_tasks, sizeof(_Atomic int));
+    uint64_t* start = (uint64_t*)malloc(num_tasks * sizeof(uint64_t));
+    uint64_t* end = (uint64_t*)malloc(num_tasks * sizeof(uint64_t));
+    if (work == NULL || runs == NULL || start == NULL || end == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        freeTaskGraph(&graph);
+        free(work);
+        free(runs);
+        free(start);
+        free(end);
+        return 1;
+    }
+    for (int t = 0; t < num_tasks; t++) {
+        // Most tasks are empty so completions race each other; some are long
+        uint64_t r = nextRng(rng) % 100;
+        work[t] = r < 70 ? 0 : r < 98 ? (uint32_t)(r * 10) : 200000;
+    }
+
+    StressContext ctx = { work, runs, start, end, 0 };
+    TaskStats stats;
+    int violations = 0;
+    if (runTaskGraph(&graph, stressTask, &ctx, num_workers, &stats) != 0) {
+        fprintf(stderr, "Error: runTaskGraph failed on the %s graph\n", name);
+        violations++;
+    }
+
+    for (int t = 0; t < num_tasks && violations < 10; t++) {
+        if (atomic_load(&runs[t]) != 1) {
+            fprintf(stderr, "Error: %s task %d ran %d times\n", name, t, atomic_load(&runs[t]));
+            violations++;
+        }
+    }
+    int last[64];
+    for (int r = 0; r < 64; r++) {
+        last[r] = -1;
+    }
+    for (int t = 0; t < num_tasks && violations < 10; t++) {
+        for (uint64_t m = resources[t]; m != 0; m &= m - 1) {
+            int r = __builtin_ctzll(m);
+            if (last[r] >= 0 && end[last[r]] > start[t]) {
+                fprintf(stderr, "Error: %s task %d started before task %d on resource %d ended\n",
+                        name, t, last[r], r);
+                violations++;
+            }
+            last[r] = t;
+        }
+    }
+    if (stats.tasks != (uint64_t)num_tasks) {
+        fprintf(stderr, "Error: %s graph reported %llu of %d tasks\n", name, (unsigned long long)stats.tasks, num_tasks);
+        violations++;
+    }
+    if (expected_depth != 0 && graph.depth != expected_depth) {
+        fprintf(stderr, "Error: %s graph has depth %d, expected %d\n", name, graph.depth, expected_depth);
+        violations++;
+    }
+    printf("%-8s %7d tasks, depth %7d, %9llu steals, %10llu idle spins: %s\n", name, num_tasks, graph.depth,
+           (unsigned long long)stats.steals, (unsigned long long)stats.idle_spins, violations ? "FAIL" : "ok");
+
+    freeTaskGraph(&graph);
+    free(work);
+    free(runs);
+    free(start);
+    free(end);
+    return violations;
+}
+
+int main(int argc, char* argv[]) {
+    int num_workers = argc > 1 ? atoi(argv[1]) : 64;
+    int num_tasks = argc > 2 ? atoi(argv[2]) : 20000;
+    int rounds = argc > 3 ? atoi(argv[3]) : 10;
+    uint64_t seed = argc > 4 ? strtoull(argv[4], NULL, 10) : 1;
+    if (num_workers < 1 || num_tasks < 1 || rounds < 1) {
+        fprintf(stderr, "Usage: %s [workers] [tasks] [rounds] [seed]\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t* resources = (uint64_t*)malloc(num_tasks * sizeof(uint64_t));
+    if (resources == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+    static const char* const names[3] = { "chain", "random", "layered" };
+    Rng rng;
+    seedRng(&rng, seed, 0);
+    int violations = 0;
+    for (int round = 0; round < rounds; round++) {
+        for (int shape = 0; shape < 3; shape++) {
+            buildResources(resources, num_tasks, shape, &rng);
+            violations += checkGraph(resources, num_tasks, shape == 0 ? num_tasks : 0, num_workers, &rng, names[shape]);
+        }
+    }
+    free(resources);
+    printf("%s\n", violations ? "FAILED" : "All graphs ran every task once, in dependency order");
+    return violations ? 1 : 0;
+}
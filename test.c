@@ -5,8 +5,12 @@
 #include <string.h>
 #include <openssl/md5.h>
 #include <openssl/evp.h> // Include the OpenSSL EVP header for MD5 functions
+#include <unistd.h>
+#include "pipeline.h"
 
+#ifndef NUM_QUBITS
 #define NUM_QUBITS 32 // Assuming each character of the input string is represented by a qubit
+#endif
 
 // Define qubit structure
 typedef struct {
@@ -57,13 +61,8 @@ void hadamard_gate(qubit* q) {
     q->state = (q->amplitude[0] > q->amplitude[1]) ? 0 : 1;
 }
 
-// Function to measure a qubit (collapse its state to either |0⟩ or |1⟩)
-int measure_qubit(qubit* q) {
-    // Generate a random value between 0 and 1
-    double random_val = (double)rand() / RAND_MAX;
-    // Collapse the qubit's state based on the random value
-    int result = (random_val < q->amplitude[0]) ? 0 : 1;
-    // Update the qubit's state
+// Function to collapse a qubit onto a measurement result
+void collapse_qubit(qubit* q, int result) {
     if (result == 0) {
         q->amplitude[1] = 0.0;
         q->eigenvalues[1] = 0.0;
@@ -72,6 +71,15 @@ int measure_qubit(qubit* q) {
         q->eigenvalues[0] = 0.0;
     }
     q->state = result;
+}
+
+// Function to measure a qubit (collapse its state to either |0⟩ or |1⟩)
+int measure_qubit(qubit* q) {
+    // Generate a random value between 0 and 1
+    double random_val = (double)rand() / RAND_MAX;
+    // Collapse the qubit's state based on the random value
+    int result = (random_val < q->amplitude[0]) ? 0 : 1;
+    collapse_qubit(q, result);
     return result;
 }
 
@@ -86,9 +94,6 @@ void md5_hash(const char *input, unsigned char *digest) {
 
 // Function to brute-force a given MD5 hash using qubits
 void brute_force_md5_qubits(const char *target_hash) {
-    // Seed random number generator
-    srand(time(NULL));
-
     // Create qubits for each character in the input string
     qubit* qubits[NUM_QUBITS];
     for (int i = 0; i < NUM_QUBITS; i++) {
@@ -100,27 +105,37 @@ void brute_force_md5_qubits(const char *target_hash) {
         hadamard_gate(qubits[i]);
     }
 
-    // Generate binary representation of each character and measure qubits
-    unsigned char hash[MD5_DIGEST_LENGTH];
-    int found_match = 0; // Flag to indicate if a matching input is found
-    clock_t start_time = clock(); // Start the timer
-    do {
-        char input_str[NUM_QUBITS + 1];
-        input_str[NUM_QUBITS] = '\0';
+    // Measuring the qubits gives one NUM_QUBITS-bit string per shot. The shots
+    // are produced by the pipeline's sampler threads a batch at a time, hashed
+    // by its hasher threads and checked by its matcher (see pipeline.c). Shots
+    // are drawn without replacement: each sampler claims its own slices of
+    // positions in a keyed Feistel order (permute.h), so no string is hashed
+    // twice and the search ends after every string has been tried.
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    PipelineConfig config;
+    config.alphabet = "01";
+    config.length = NUM_QUBITS;
+    memcpy(config.target, target_hash, MD5_DIGEST_LENGTH);
+    config.samplers = cores >= 4 ? 2 : 1;
+    config.hashers = cores > config.samplers + 1 ? (int)cores - config.samplers - 1 : 1;
+    config.ring_batches = 16;
+    config.random_order = 1;
+    config.seed = (uint64_t)time(NULL);
+
+    PipelineStats stats;
+    int status = runHashPipeline(&config, &stats);
+    if (status == 0 && stats.found) {
+        printf("Matching input found using qubits: %s\n", stats.match);
+        // Leave each qubit collapsed onto its bit of the match
         for (int i = 0; i < NUM_QUBITS; i++) {
-            int measurement = measure_qubit(qubits[i]);
-            input_str[i] = (measurement == 0) ? '0' : '1';
+            collapse_qubit(qubits[i], stats.match[i] == '1');
         }
-        // Compute MD5 hash for the generated input string
-        md5_hash(input_str, hash);
-        // Compare the computed hash with the target hash
-        if (memcmp(hash, target_hash, MD5_DIGEST_LENGTH) == 0) {
-            printf("Matching input found using qubits: %s\n", input_str);
-            found_match = 1;
-            break; // Break out of the loop once a matching input is found
-        }
-    } while (!found_match);
-    clock_t end_time = clock(); // Stop the timer
+    } else if (status == 0) {
+        printf("No matching input among the %d-qubit measurements.\n", NUM_QUBITS);
+    }
+    if (status == 0) {
+        printPipelineStats(&stats);
+    }
 
     // Print qubit values
     for (int i = 0; i < NUM_QUBITS; i++) {
@@ -132,9 +147,8 @@ void brute_force_md5_qubits(const char *target_hash) {
         destroy_qubit(qubits[i]);
     }
 
-    // Calculate and print the time taken
-    double time_taken = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
-    printf("Time taken using qubits: %f seconds\n", time_taken);
+    // Print the wall-clock time of the search
+    printf("Time taken using qubits: %f seconds\n", stats.seconds);
 }
 
 // Function to brute-force a given MD5 hash using classical bits
@@ -151,6 +165,7 @@ void brute_force_md5_classical(const char *target_hash) {
     // Generate binary representation of each character
     unsigned char hash[MD5_DIGEST_LENGTH];
     int found_match = 0; // Flag to indicate if a matching input is found
+    uint64_t tried = 0;  // The bits wrap around after 2^NUM_QUBITS inputs
     clock_t start_time = clock(); // Start the timer
     do {
         char input_str[NUM_QUBITS + 1];
@@ -173,17 +188,42 @@ void brute_force_md5_classical(const char *target_hash) {
                 break;
             }
         }
-    } while (!found_match);
+    } while (!found_match && ++tried < (1ULL << NUM_QUBITS));
     clock_t end_time = clock(); // Stop the timer
+    if (!found_match) {
+        printf("No matching input among the %d-bit strings.\n", NUM_QUBITS);
+    }
 
     // Calculate and print the time taken
     double time_taken = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
     printf("Time taken using classical bits: %f seconds\n", time_taken);
 }
 
-int main() {
-    // Target MD5 hash to match
-    const char *target_hash = "47bce5c74f589f4867dbd57e9ca9f808"; // Example target hash for "0a1"
+// Function to parse a 32-digit hex MD5 digest into its 16 bytes.
+// Returns 0 on success, -1 if the text is not a digest.
+int parse_md5_hex(const char *hex, char *digest) {
+    if (strlen(hex) != 2 * MD5_DIGEST_LENGTH) {
+        return -1;
+    }
+    for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
+        unsigned int byte;
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+            return -1;
+        }
+        digest[i] = (char)byte;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // Target MD5 hash to match, as hex on the command line or the example.
+    // The searches compare raw digests, so the hex text is decoded first.
+    const char *target_hex = argc > 1 ? argv[1] : "47bce5c74f589f4867dbd57e9ca9f808"; // Example target hash
+    char target_hash[MD5_DIGEST_LENGTH];
+    if (parse_md5_hex(target_hex, target_hash) != 0) {
+        fprintf(stderr, "Error: Target must be a 32-digit hex MD5 digest.\n");
+        return 1;
+    }
 
     // Brute-force the MD5 hash using qubits
     brute_force_md5_qubits(target_hash);
@@ -3,12 +3,8 @@
 #include <string.h>
 #include <math.h>
 #include <ctype.h>
-
-// Define the qubit structure
-typedef struct {
-    double alpha; // Complex coefficient for |0>
-    double beta;  // Complex coefficient for |1>
-} Qubit;
+#include "resultsink.h"
+#include "qubitstate.h"
 
 // Function to initialize a qubit
 Qubit* initializeQubit(double alpha, double beta) {
@@ -127,21 +123,6 @@ void quantumTeleportation(Qubit** sender_qubits, Qubit** receiver_qubits, int nu
     }
 }
 
-// Function to print the state of a qubit
-void printQubit(Qubit* qubit) {
-    printf("|0>: %.2f\n", qubit->alpha);
-    printf("|1>: %.2f\n", qubit->beta);
-}
-
-// Function to print the states of qubits
-void printQubitStates(Qubit** qubits, int num_bits) {
-    for (int i = 0; i < num_bits; i++) {
-        printf("Qubit %d:\n", i);
-        printQubit(qubits[i]);
-        printf("\n");
-    }
-}
-
 // Function to decode binary string to original string
 char* binaryToString(char* binary_string) {
     int length = strlen(binary_string) / 5; // Each character takes 5 bits
@@ -160,7 +141,32 @@ char* binaryToString(char* binary_string) {
     return decoded_string;
 }
 
-int main() {
+// Usage: tp [result file] [--text]
+// With a result file, the qubit states and decoded bits are written to it as
+// binary columns (see resultsink.h) and the per-qubit text is only printed with
+// --text. Without one, the states are printed as text.
+int main(int argc, char** argv) {
+    const char* result_path = NULL;
+    int text = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--text") == 0) {
+            text = 1;
+        } else {
+            result_path = argv[i];
+        }
+    }
+    ResultSink* sink = NULL;
+    if (result_path != NULL) {
+        sink = openResultSink(result_path);
+        if (sink == NULL) {
+            return 1;
+        }
+    } else {
+        text = 1;
+    }
+    // Set when a result column could not be written; the run still finishes
+    int failed = 0;
+
     // Get input word from user
     char input_word[4];
     printf("Enter a word of 3 characters (only alphabets): ");
@@ -179,31 +185,47 @@ int main() {
         receiver_qubits[i] = initializeQubit(1, 0); // |0>
     }
 
-    // Print initial qubit states
-    printf("Initial states of sender's qubits:\n");
-    printQubitStates(sender_qubits, num_bits);
-    printf("\n");
-
-    printf("Initial states of receiver's qubits:\n");
-    printQubitStates(receiver_qubits, num_bits);
-    printf("\n");
+    // Report initial qubit states
+    failed |= reportQubitStates(sink, text, "Initial states of sender's qubits:", "sender.initial",
+                                sender_qubits, num_bits) != 0;
+    failed |= reportQubitStates(sink, text, "\nInitial states of receiver's qubits:", "receiver.initial",
+                                receiver_qubits, num_bits) != 0;
 
     // Perform quantum teleportation
     quantumTeleportation(sender_qubits, receiver_qubits, num_bits);
 
-    // Print final qubit states
-    printf("Final states of sender's qubits (after teleportation):\n");
-    printQubitStates(sender_qubits, num_bits);
-    printf("\n");
-
-    printf("Final states of receiver's qubits (after teleportation):\n");
-    printQubitStates(receiver_qubits, num_bits);
-    printf("\n");
+    // Report final qubit states
+    failed |= reportQubitStates(sink, text, "\nFinal states of sender's qubits (after teleportation):", "sender.final",
+                                sender_qubits, num_bits) != 0;
+    failed |= reportQubitStates(sink, text, "\nFinal states of receiver's qubits (after teleportation):", "receiver.final",
+                                receiver_qubits, num_bits) != 0;
 
     // Decode the binary string from receiver's qubits and print it
-    char* decoded_string = binaryToString(qubitsToBinaryString(receiver_qubits, num_bits));
+    char* received_bits = qubitsToBinaryString(receiver_qubits, num_bits);
+    char* decoded_string = binaryToString(received_bits);
     printf("Decoded word from receiver's qubits: %s\n", decoded_string);
 
+    // Store the received bits as one-bit records
+    if (sink != NULL) {
+        uint64_t* records = (uint64_t*)malloc(num_bits * sizeof(uint64_t));
+        if (records == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for the decoded records.\n");
+            failed = 1;
+        } else {
+            for (int i = 0; i < num_bits; i++) {
+                records[i] = received_bits[i] == '1';
+            }
+            failed |= writeShotColumn(sink, "receiver.decoded", records, num_bits, 1) != 0;
+            free(records);
+        }
+        failed |= closeResultSink(sink) != 0;
+        if (failed) {
+            fprintf(stderr, "Error: Results in %s are incomplete\n", result_path);
+        } else {
+            printf("Results written to %s\n", result_path);
+        }
+    }
+
     // Free memory
     for (int i = 0; i < num_bits; i++) {
         freeQubit(sender_qubits[i]);
@@ -212,7 +234,8 @@ int main() {
     free(sender_qubits);
     free(receiver_qubits);
     free(binary_string);
+    free(received_bits);
     free(decoded_string);
 
-    return 0;
+    return failed ? 1 : 0;
 }
@@ -1,22 +1,72 @@
+import shutil
+import subprocess
+import sys
 import cirq
 import numpy as np
 import cv2
 
-# Function to create a quantum circuit for encoding the average pixel value
-def create_quantum_circuit(image_shape):
-    num_pixels = np.prod(image_shape)
+# Use the native engine when its extension is built, otherwise plain Cirq
+try:
+    from nativesim import NativeSimulator as Simulator
+except ImportError:
+    Simulator = cirq.Simulator
+
+# The native frame accumulator (framesum.c) streams Y4M and raw video
+try:
+    import qusim
+except ImportError:
+    qusim = None
+
+# Function to create a quantum circuit encoding one RX angle per qubit
+def create_quantum_circuit(image_shape, angles):
     circuit = cirq.Circuit()
     qubits = cirq.GridQubit.rect(image_shape[0], image_shape[1])
 
-    # Define operations to encode the average pixel value into each qubit
-    # For simplicity, let's assume each qubit represents a pixel
-    avg_pixel_value = 128  # Assuming the average pixel value is 128
-    for qubit in qubits:
-        theta = np.arccos(np.sqrt(avg_pixel_value / 255.0)) * 2
-        circuit.append(cirq.rx(theta).on(qubit))
+    # Each qubit represents a pixel of the average frame
+    for qubit, theta in zip(qubits, np.ravel(angles)):
+        circuit.append(cirq.rx(float(theta)).on(qubit))
 
     return circuit
 
+# Function to average a compressed video through the native accumulator by
+# having ffmpeg decode it to a gray Y4M pipe, so no frame goes through OpenCV.
+# Returns None when ffmpeg is missing or fails.
+def ffmpeg_encoding_angles(video_path, rows, cols):
+    if shutil.which('ffmpeg') is None:
+        return None
+    command = ['ffmpeg', '-v', 'error', '-i', video_path, '-f', 'yuv4mpegpipe', '-pix_fmt', 'gray', '-']
+    with subprocess.Popen(command, stdout=subprocess.PIPE) as ffmpeg:
+        try:
+            angles, frames = qusim.encode_frames('/dev/fd/%d' % ffmpeg.stdout.fileno(), rows, cols)
+        except OSError:
+            angles, frames = None, 0
+        ffmpeg.stdout.close()
+    if ffmpeg.returncode != 0 or frames == 0:
+        return None
+    return angles
+
+# Function to get the RX angle of each pixel of image_shape from the average
+# frame of a video. Y4M (and raw .yuv/.gray with raw_size=(width, height)) is
+# streamed by the native accumulator, and other containers are piped to it as
+# Y4M through ffmpeg; OpenCV decodes only when neither is available.
+def video_encoding_angles(video_path, image_shape, raw_size=None):
+    rows, cols = image_shape
+    if qusim is not None:
+        if video_path == '-' or video_path.endswith('.y4m'):
+            angles, _ = qusim.encode_frames(video_path, rows, cols)
+            return np.asarray(angles).reshape(image_shape)
+        if raw_size is not None and video_path.endswith(('.yuv', '.gray')):
+            fmt = 'i420' if video_path.endswith('.yuv') else 'gray8'
+            angles, _ = qusim.encode_frames(video_path, rows, cols, fmt, raw_size[0], raw_size[1])
+            return np.asarray(angles).reshape(image_shape)
+        angles = ffmpeg_encoding_angles(video_path, rows, cols)
+        if angles is not None:
+            return np.asarray(angles).reshape(image_shape)
+
+    average_frame = read_video_and_sum_frames(video_path)
+    average_frame = cv2.resize(average_frame, (cols, rows), interpolation=cv2.INTER_AREA)
+    return np.arccos(np.sqrt(np.clip(average_frame / 255.0, 0.0, 1.0))) * 2
+
 # Function to read video and sum all frames
 def read_video_and_sum_frames(video_path):
     cap = cv2.VideoCapture(video_path)
@@ -24,6 +74,7 @@ def read_video_and_sum_frames(video_path):
     height = int(cap.get(cv2.CAP_PROP_FRAME_HEIGHT))
     width = int(cap.get(cv2.CAP_PROP_FRAME_WIDTH))
     sum_frame = np.zeros((height, width), dtype=np.float32)
+    frames_read = 0
 
     while(cap.isOpened()):
         ret, frame = cap.read()
@@ -31,9 +82,10 @@ def read_video_and_sum_frames(video_path):
             break
         gray_frame = cv2.cvtColor(frame, cv2.COLOR_BGR2GRAY)
         sum_frame += gray_frame
+        frames_read += 1
 
     cap.release()
-    return sum_frame / frame_count  # Compute average pixel value
+    return sum_frame / max(frames_read, 1)  # Compute average pixel value
 
 # Function to generate image based on probability
 def generate_image_from_probability(probabilities, image_shape):
@@ -44,24 +96,56 @@ def generate_image_from_probability(probabilities, image_shape):
         image[x][y] = pixel_value
     return image
 
+# Function to index bits of n positions, matching stateprep.c
+def index_bits(n):
+    return max(1, (n - 1).bit_length()) if n > 1 else 0
+
+# Function to read an image back from the probabilities of a FRQI state: each
+# pixel's color qubit is sin(t)|1> + cos(t)|0> with t = pi/2 * pixel / 255
+def image_from_frqi(probabilities, image_shape):
+    rows, cols = image_shape
+    col_bits = index_bits(cols)
+    pos_bits = max(1, index_bits(rows) + col_bits)
+    y, x = np.meshgrid(np.arange(rows), np.arange(cols), indexing='ij')
+    positions = (y << col_bits) | x
+    p0 = probabilities[positions]
+    p1 = probabilities[positions + (1 << pos_bits)]
+    angle = np.arctan2(np.sqrt(p1), np.sqrt(p0))
+    return np.round(angle / (np.pi / 2) * 255).astype(np.uint8)
+
 # Main function
+# Usage: vidgen.py [video] [width height]
+# The video may be a Y4M file, '-' for a Y4M stream on stdin, raw .yuv (I420) or
+# .gray (8-bit) frames with their width and height, or any container ffmpeg or
+# OpenCV can decode.
 def main():
-    video_path = 'video.mp4'
+    video_path = sys.argv[1] if len(sys.argv) > 1 else 'video.mp4'
+    raw_size = (int(sys.argv[2]), int(sys.argv[3])) if len(sys.argv) > 3 else None
     image_shape = (100, 100)  # Define image shape
 
-    # Step 1: Read video and sum all frames
-    average_frame = read_video_and_sum_frames(video_path)
+    # Step 1: Read video and average all frames into per-pixel angles
+    angles = video_encoding_angles(video_path, image_shape, raw_size)
+
+    if qusim is not None:
+        # Step 2: Load the average frame straight into a FRQI state, which needs
+        # the position bits plus one qubit instead of one qubit per pixel
+        levels = 255.0 * np.cos(np.ravel(angles) / 2) ** 2
+        state = qusim.prepare_state(np.ascontiguousarray(levels, dtype=np.float64), "frqi", *image_shape)
 
-    # Step 2: Create quantum circuit and encode average pixel value
-    circuit = create_quantum_circuit(image_shape)
+        # Step 3: Read the image back from the state's probabilities
+        probabilities = np.asarray(state.probabilities())
+        generated_image = image_from_frqi(probabilities, image_shape)
+    else:
+        # Step 2: Create quantum circuit and encode the average pixel values
+        circuit = create_quantum_circuit(image_shape, angles)
 
-    # Step 3: Simulate quantum circuit to get probabilities
-    simulator = cirq.Simulator()
-    result = simulator.simulate(circuit)
+        # Step 3: Simulate quantum circuit to get probabilities
+        simulator = Simulator()
+        result = simulator.simulate(circuit)
 
-    # Step 4: Generate image based on probabilities
-    probabilities = np.abs(result.state_vector()) ** 2
-    generated_image = generate_image_from_probability(probabilities, image_shape)
+        # Step 4: Generate image based on probabilities
+        probabilities = np.abs(result.state_vector()) ** 2
+        generated_image = generate_image_from_probability(probabilities, image_shape)
 
     # Display or save the generated image
     cv2.imshow('Generated Image', generated_image)